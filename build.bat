@@ -10,4 +10,9 @@ set Win32Libs=opengl32.lib glfw3dll.lib
 set LinkFlags=-subsystem:console -opt:ref
 pushd build
 cl %Defines% %DebugFlags% %CompilerFlags% %Includes% -Fe%ExecutableName% %CodePath%tracer_main.cpp %Win32Libs% /link %LinkFlags% %LibIncludes%
+cl %Defines% %DebugFlags% %CompilerFlags% %Includes% -Fe%ExecutableName%_headless %CodePath%tracer_headless.cpp ws2_32.lib /link %LinkFlags%
+cl %Defines% %DebugFlags% %CompilerFlags% %Includes% -Fe%ExecutableName%_convert %CodePath%tracer_convert.cpp /link %LinkFlags%
+cl %Defines% %DebugFlags% %CompilerFlags% %Includes% -Fe%ExecutableName%_benchmark %CodePath%tracer_benchmark.cpp /link %LinkFlags%
+cl %Defines% %DebugFlags% %CompilerFlags% %Includes% -DENABLE_SIMD=1 -Fe%ExecutableName%_microbench_simd %CodePath%tracer_microbench.cpp /link %LinkFlags%
+cl %Defines% %DebugFlags% %CompilerFlags% %Includes% -DENABLE_SIMD=0 -Fe%ExecutableName%_microbench_scalar %CodePath%tracer_microbench.cpp /link %LinkFlags%
 popd
\ No newline at end of file
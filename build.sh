@@ -0,0 +1,18 @@
+#!/bin/sh
+# note: linux/mac only build the headless renderer, the interactive viewer links against the win32 glfw in vendor/libs
+# note: add -DTRACER_PROFILE=1 to record the timers and counters --profile writes out
+Defines="-DTRACER_DEBUG=1 -DTRACER_INTERNAL=1 -DTRACER_ASSERTIONS=1"
+Includes="-I../vendor -I../source/vendor"
+# note: swap -msse4.1 for -mavx2 to build the 8 lane simd kernels
+CompilerFlags="-std=c++17 -O2 -g -msse4.1 -ffast-math -Wall -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable -Wno-missing-braces"
+CodePath=../source/
+LinkFlags="-pthread"
+
+mkdir -p build
+cd build
+c++ $Defines $CompilerFlags $Includes -o tracer_headless ${CodePath}tracer_headless.cpp $LinkFlags
+c++ $Defines $CompilerFlags $Includes -o tracer_convert ${CodePath}tracer_convert.cpp $LinkFlags
+c++ $Defines $CompilerFlags $Includes -o tracer_benchmark ${CodePath}tracer_benchmark.cpp $LinkFlags
+# note: the microbenchmarks are built twice to compare v3 as __m128 against v3 as a struct
+c++ $Defines $CompilerFlags $Includes -DENABLE_SIMD=1 -o tracer_microbench_simd ${CodePath}tracer_microbench.cpp $LinkFlags
+c++ $Defines $CompilerFlags $Includes -DENABLE_SIMD=0 -o tracer_microbench_scalar ${CodePath}tracer_microbench.cpp $LinkFlags
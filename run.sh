@@ -0,0 +1,4 @@
+#!/bin/sh
+
+cd data
+../build/tracer_headless "$@"
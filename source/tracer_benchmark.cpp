@@ -0,0 +1,520 @@
+#include <stdlib.h>
+#include <chrono>
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+
+#include "tracer_math.cpp"
+#include "tracer_memory.cpp"
+#include "tracer_profile.cpp"
+#include "tracer_random.cpp"
+#include "tracer_framebuffer.cpp"
+#include "tracer_camera.cpp"
+#include "tracer_bvh.cpp"
+#include "tracer_world.cpp"
+#include "tracer_file.cpp"
+#include "tracer_jobs.cpp"
+#include "tracer_wavefront.cpp"
+
+// note(harlequin): end to end benchmark, renders a fixed set of scenes with a fixed seed and sample count
+// on every requested thread count and writes the results as json so runs of different builds can be diffed
+
+#define BENCHMARK_MAX_THREAD_COUNTS 16
+
+typedef bool build_benchmark_scene(world *World, u32 Seed);
+
+struct benchmark_scene
+{
+    const char            *Name;
+    build_benchmark_scene *Build;
+    u32                    RayBounceCount;
+};
+
+struct benchmark_settings
+{
+    u32         Width;
+    u32         Height;
+    u32         SampleCount;
+    u32         Seed;
+    integrator  Integrator;
+    u32         PacketTracing;
+    u32         ThreadCountCount;
+    u32         ThreadCounts[BENCHMARK_MAX_THREAD_COUNTS];
+    const char *SceneFilter; // comma separated scene names, null runs every scene
+    const char *OutputPath;
+};
+
+struct benchmark_result
+{
+    u64 PrimaryRayCount;
+    u64 RayCount;
+    f64 WallSeconds;
+    u64 Checksum;
+};
+
+function bool
+BuildDemoScene(world *World, u32 Seed)
+{
+    PushDemoScene(World);
+    return true;
+}
+
+// note(harlequin): Count spheres scattered through a fixed box in front of the camera, the radius shrinks
+// with the spacing so every field has the same density of empty space
+function bool
+BuildSphereField(world *World, u32 Seed, u32 Count)
+{
+    v3 Min = V3(-10.0f, -0.5f, -30.0f);
+    v3 Max = V3(10.0f, 4.0f, -2.0f);
+    v3 Extent = Max - Min;
+    f32 Volume  = VectorComponent(Extent, 0) * VectorComponent(Extent, 1) * VectorComponent(Extent, 2);
+    f32 Spacing = cbrtf(Volume / (f32)Count);
+
+    if (!ReserveWorld(World, 9, (u64)Count + 1, 0, 0))
+    {
+        return false;
+    }
+
+    u32 GroundMaterial = PushMaterial(World, V3(0.5f, 0.5f, 0.5f), 0.8f);
+    u32 FirstMaterial  = World->MaterialCount;
+    for (u32 MaterialIndex = 0; MaterialIndex < 8; MaterialIndex++)
+    {
+        random_series Series = RandomSeries(Seed, MaterialIndex, 1);
+        PushMaterial(World, RandomV3(&Series, 0.1f, 1.0f), RandomCanonical(&Series));
+    }
+    PushSphere(World, V3(0.0f, -1000.5f, -15.0f), 1000.0f, GroundMaterial);
+
+    for (u32 SphereIndex = 0; SphereIndex < Count; SphereIndex++)
+    {
+        random_series Series = RandomSeries(Seed, SphereIndex, 0);
+        v3 Center = Min + Hadamard(RandomV3(&Series, 0.0f, 1.0f), Extent);
+        f32 Radius = Spacing * RandomBetween(&Series, 0.15f, 0.35f);
+        u32 MaterialIndex = FirstMaterial + (RandomU32(&Series) & 7);
+        if (PushSphere(World, Center, Radius, MaterialIndex) == WORLD_INVALID_INDEX)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+function bool
+BuildSphereField10k(world *World, u32 Seed)
+{
+    return BuildSphereField(World, Seed, 10000);
+}
+
+function bool
+BuildSphereField1m(world *World, u32 Seed)
+{
+    return BuildSphereField(World, Seed, 1000000);
+}
+
+// note(harlequin): a closed box of perfect mirrors around the camera, every path runs to the bounce limit
+function bool
+BuildMirrorBox(world *World, u32 Seed)
+{
+    u32 MirrorMaterial = PushMaterial(World, V3(0.9f, 0.9f, 0.9f), 0.0f);
+    u32 RedMaterial    = PushMaterial(World, V3(0.9f, 0.2f, 0.2f), 0.05f);
+    u32 BlueMaterial   = PushMaterial(World, V3(0.2f, 0.3f, 0.9f), 0.05f);
+
+    const f32 Positions[] =
+    {
+        -3.0f, -1.0f,  1.0f,   3.0f, -1.0f,  1.0f,   3.0f,  3.0f,  1.0f,  -3.0f,  3.0f,  1.0f,
+        -3.0f, -1.0f, -6.0f,   3.0f, -1.0f, -6.0f,   3.0f,  3.0f, -6.0f,  -3.0f,  3.0f, -6.0f,
+    };
+    const u32 Indices[] =
+    {
+        0, 1, 2,  0, 2, 3, // front
+        5, 4, 7,  5, 7, 6, // back
+        4, 0, 3,  4, 3, 7, // left
+        1, 5, 6,  1, 6, 2, // right
+        4, 5, 1,  4, 1, 0, // floor
+        3, 2, 6,  3, 6, 7, // ceiling
+    };
+
+    u32 FirstVertex = 0;
+    if (!PushVertices(World, Positions, ArrayCount(Positions) / 3, &FirstVertex) ||
+        !PushTriangles(World, Indices, ArrayCount(Indices) / 3, FirstVertex, MirrorMaterial))
+    {
+        return false;
+    }
+
+    PushSphere(World, V3(-0.8f, 0.0f, -2.5f), 0.8f, RedMaterial);
+    PushSphere(World, V3(1.0f, -0.3f, -3.5f), 0.6f, BlueMaterial);
+    return true;
+}
+
+global_variable const benchmark_scene BenchmarkScenes[] =
+{
+    { "demo",          BuildDemoScene,      8  },
+    { "spheres_10k",   BuildSphereField10k, 8  },
+    { "spheres_1m",    BuildSphereField1m,  8  },
+    { "mirror_box",    BuildMirrorBox,      64 },
+};
+
+function bool
+IsSceneSelected(const char *SceneFilter, const char *Name)
+{
+    if (!SceneFilter)
+    {
+        return true;
+    }
+
+    u64 NameLength = strlen(Name);
+    for (const char *Start = SceneFilter; *Start; )
+    {
+        const char *End = strchr(Start, ',');
+        u64 Length = End ? (u64)(End - Start) : strlen(Start);
+        if (Length == NameLength && strncmp(Start, Name, Length) == 0)
+        {
+            return true;
+        }
+        Start += Length + (End ? 1 : 0);
+    }
+    return false;
+}
+
+// note(harlequin): fnv-1a over the accumulated radiance, equal checksums mean bit identical images
+function u64
+HashFrameBuffer(const frame_buffer *FrameBuffer)
+{
+    u64 Hash = 14695981039346656037ull;
+    for (u32 PixelIndex = 0; PixelIndex < FrameBuffer->Width * FrameBuffer->Height; PixelIndex++)
+    {
+        f32 Components[3] = { VectorComponent(FrameBuffer->Pixels[PixelIndex], 0),
+                              VectorComponent(FrameBuffer->Pixels[PixelIndex], 1),
+                              VectorComponent(FrameBuffer->Pixels[PixelIndex], 2) };
+        const u8 *Bytes = (const u8 *)Components;
+        for (u32 ByteIndex = 0; ByteIndex < sizeof(Components); ByteIndex++)
+        {
+            Hash = (Hash ^ Bytes[ByteIndex]) * 1099511628211ull;
+        }
+    }
+    return Hash;
+}
+
+function benchmark_result
+RunBenchmark(const benchmark_settings &Settings,
+             const benchmark_scene    &Scene,
+             world                    *World,
+             camera                   *Camera,
+             u32                       ThreadCount)
+{
+    frame_buffer AccumulationFrameBuffer = {};
+    InitializeFrameBuffer(&AccumulationFrameBuffer, Settings.Width, Settings.Height);
+    sample_buffer SampleBuffer = {};
+    InitializeSampleBuffer(&SampleBuffer, Settings.Width, Settings.Height);
+    frame_buffer FrameBuffer = {};
+    InitializeFrameBuffer(&FrameBuffer, Settings.Width, Settings.Height);
+
+    job_system *JobSystem = new(malloc(sizeof(job_system))) job_system {};
+    InitializeJobSystem(JobSystem, ThreadCount);
+
+    trace_settings TraceSettings = {};
+    TraceSettings.RayBounceCount = Scene.RayBounceCount;
+    TraceSettings.Integrator     = Settings.Integrator;
+    TraceSettings.PacketTracing  = Settings.PacketTracing != 0;
+    TraceSettings.Seed           = Settings.Seed;
+
+    // note(harlequin): one untimed frame warms the caches, the thread pool and the scratch arenas,
+    // the first timed frame restarts the accumulation
+    TraceFrame(JobSystem, World, Camera, TraceSettings, &AccumulationFrameBuffer, &SampleBuffer, nullptr, &FrameBuffer, 1);
+
+    benchmark_result Result = {};
+    auto StartTime = std::chrono::steady_clock::now();
+    for (u32 FrameCount = 1; FrameCount <= Settings.SampleCount; FrameCount++)
+    {
+        TraceFrame(JobSystem, World, Camera, TraceSettings, &AccumulationFrameBuffer, &SampleBuffer, nullptr, &FrameBuffer, FrameCount);
+        Result.RayCount += JobSystem->FrameStats.RayCount;
+    }
+    Result.WallSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - StartTime).count();
+    Result.PrimaryRayCount = (u64)Settings.Width * Settings.Height * Settings.SampleCount;
+    Result.Checksum = HashFrameBuffer(&AccumulationFrameBuffer);
+
+    ShutdownJobSystem(JobSystem);
+    JobSystem->~job_system();
+    free(JobSystem);
+    FreeFrameBuffer(&AccumulationFrameBuffer);
+    FreeFrameBuffer(&FrameBuffer);
+    FreeSampleBuffer(&SampleBuffer);
+    return Result;
+}
+
+function void
+PrintUsage(const char *ProgramName)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --width <pixels>      image width (default 640)\n"
+            "  --height <pixels>     image height (default 360)\n"
+            "  --samples <count>     samples per pixel (default 16)\n"
+            "  --seed <value>        random seed (default 0)\n"
+            "  --threads <list>      comma separated thread counts (default 1, 2, 4, ... up to every core)\n"
+            "  --scenes <list>       comma separated scene names (default every scene)\n"
+            "  --packets <0|1>       trace primary rays in packets (default 1)\n"
+            "  --integrator <name>   recursive or wavefront (default recursive)\n"
+            "  --output <path>       json results path (default benchmark.json)\n"
+            "scenes:",
+            ProgramName);
+    for (u32 SceneIndex = 0; SceneIndex < ArrayCount(BenchmarkScenes); SceneIndex++)
+    {
+        fprintf(stderr, " %s", BenchmarkScenes[SceneIndex].Name);
+    }
+    fprintf(stderr, "\n");
+}
+
+function bool
+ParseU32(const char *Text, u32 *OutValue)
+{
+    char *End = nullptr;
+    unsigned long Value = strtoul(Text, &End, 10);
+    if (End == Text || *End != '\0' || Value > UINT_MAX)
+    {
+        return false;
+    }
+    *OutValue = (u32)Value;
+    return true;
+}
+
+function bool
+ParseThreadCounts(const char *Text, benchmark_settings *Settings)
+{
+    Settings->ThreadCountCount = 0;
+    for (const char *Start = Text; ; )
+    {
+        char *End = nullptr;
+        unsigned long Value = strtoul(Start, &End, 10);
+        if (End == Start || !Value || Value > MAX_THREAD_COUNT ||
+            (*End != ',' && *End != '\0') ||
+            Settings->ThreadCountCount == BENCHMARK_MAX_THREAD_COUNTS)
+        {
+            return false;
+        }
+        Settings->ThreadCounts[Settings->ThreadCountCount++] = (u32)Value;
+        if (*End == '\0')
+        {
+            return true;
+        }
+        Start = End + 1;
+    }
+}
+
+function bool
+ParseBenchmarkSettings(i32                 ArgumentCount,
+                       char              **Arguments,
+                       benchmark_settings *Settings)
+{
+    for (i32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ArgumentIndex++)
+    {
+        const char *Argument = Arguments[ArgumentIndex];
+        const char *Value    = ArgumentIndex + 1 < ArgumentCount ? Arguments[ArgumentIndex + 1] : nullptr;
+        if (!Value)
+        {
+            fprintf(stderr, "missing value for %s\n", Argument);
+            return false;
+        }
+        ArgumentIndex++;
+
+        u32 *U32Option = nullptr;
+        if (strcmp(Argument, "--width") == 0)        U32Option = &Settings->Width;
+        else if (strcmp(Argument, "--height") == 0)  U32Option = &Settings->Height;
+        else if (strcmp(Argument, "--samples") == 0) U32Option = &Settings->SampleCount;
+        else if (strcmp(Argument, "--seed") == 0)    U32Option = &Settings->Seed;
+        else if (strcmp(Argument, "--packets") == 0) U32Option = &Settings->PacketTracing;
+        else if (strcmp(Argument, "--scenes") == 0)  Settings->SceneFilter = Value;
+        else if (strcmp(Argument, "--output") == 0)  Settings->OutputPath = Value;
+        else if (strcmp(Argument, "--threads") == 0)
+        {
+            if (!ParseThreadCounts(Value, Settings))
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+        }
+        else if (strcmp(Argument, "--integrator") == 0)
+        {
+            bool Found = false;
+            for (u32 IntegratorIndex = 0; IntegratorIndex < Integrator_Count; IntegratorIndex++)
+            {
+                if (strcmp(Value, IntegratorNames[IntegratorIndex]) == 0)
+                {
+                    Settings->Integrator = (integrator)IntegratorIndex;
+                    Found = true;
+                }
+            }
+            if (!Found)
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", Argument);
+            return false;
+        }
+
+        if (U32Option && !ParseU32(Value, U32Option))
+        {
+            fprintf(stderr, "invalid value for %s\n", Argument);
+            return false;
+        }
+    }
+
+    if (!Settings->Width || !Settings->Height || !Settings->SampleCount)
+    {
+        fprintf(stderr, "width, height and samples must be greater than zero\n");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int ArgumentCount, char **Arguments)
+{
+    benchmark_settings Settings = {};
+    Settings.Width         = 640;
+    Settings.Height        = 360;
+    Settings.SampleCount   = 16;
+    Settings.Seed          = 0;
+    Settings.Integrator    = Integrator_Recursive;
+    Settings.PacketTracing = 1;
+    Settings.OutputPath    = "benchmark.json";
+
+    if (!ParseBenchmarkSettings(ArgumentCount, Arguments, &Settings))
+    {
+        PrintUsage(Arguments[0]);
+        return 1;
+    }
+
+    if (!Settings.ThreadCountCount)
+    {
+        u32 HardwareThreadCount = std::thread::hardware_concurrency();
+        HardwareThreadCount = HardwareThreadCount ? HardwareThreadCount : 1;
+        HardwareThreadCount = HardwareThreadCount < MAX_THREAD_COUNT ? HardwareThreadCount : MAX_THREAD_COUNT;
+        for (u32 ThreadCount = 1;
+             ThreadCount < HardwareThreadCount && Settings.ThreadCountCount < BENCHMARK_MAX_THREAD_COUNTS - 1;
+             ThreadCount *= 2)
+        {
+            Settings.ThreadCounts[Settings.ThreadCountCount++] = ThreadCount;
+        }
+        Settings.ThreadCounts[Settings.ThreadCountCount++] = HardwareThreadCount;
+    }
+
+    FILE *Output = fopen(Settings.OutputPath, "w");
+    if (!Output)
+    {
+        fprintf(stderr, "failed to open %s for writing\n", Settings.OutputPath);
+        return 1;
+    }
+
+    camera Camera = {};
+    InitializeCamera(&Camera, Settings.Width, Settings.Height, 1.0f, V3(0.0f, 0.0f, 0.0f));
+
+    fprintf(Output,
+            "{\n"
+            "  \"lane_width\": %u,\n"
+            "  \"simd\": %s,\n"
+            "  \"width\": %u,\n"
+            "  \"height\": %u,\n"
+            "  \"samples\": %u,\n"
+            "  \"seed\": %u,\n"
+            "  \"integrator\": \"%s\",\n"
+            "  \"packets\": %s,\n"
+            "  \"results\": [",
+            LANE_WIDTH,
+            ENABLE_SIMD ? "true" : "false",
+            Settings.Width,
+            Settings.Height,
+            Settings.SampleCount,
+            Settings.Seed,
+            IntegratorNames[Settings.Integrator],
+            Settings.PacketTracing ? "true" : "false");
+
+    fprintf(stderr, "%-12s %7s %9s %12s %12s %9s %16s\n",
+            "scene", "threads", "wall s", "primary/s", "rays/s", "ns/ray", "checksum");
+
+    bool FirstResult = true;
+    for (u32 SceneIndex = 0; SceneIndex < ArrayCount(BenchmarkScenes); SceneIndex++)
+    {
+        const benchmark_scene &Scene = BenchmarkScenes[SceneIndex];
+        if (!IsSceneSelected(Settings.SceneFilter, Scene.Name))
+        {
+            continue;
+        }
+
+        auto BuildStartTime = std::chrono::steady_clock::now();
+        world *World = (world *)calloc(1, sizeof(world));
+        if (!Scene.Build(World, Settings.Seed) || !BuildWorldBvh(World))
+        {
+            fprintf(stderr, "failed to build the %s scene\n", Scene.Name);
+            return 1;
+        }
+        f64 BuildSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - BuildStartTime).count();
+
+        for (u32 ThreadCountIndex = 0; ThreadCountIndex < Settings.ThreadCountCount; ThreadCountIndex++)
+        {
+            u32 ThreadCount = Settings.ThreadCounts[ThreadCountIndex];
+            benchmark_result Result = RunBenchmark(Settings, Scene, World, &Camera, ThreadCount);
+
+            // note(harlequin): ns/ray is wall time over every ray traced, so it drops as threads are added
+            f64 OneOverSeconds       = Result.WallSeconds > 0.0 ? 1.0 / Result.WallSeconds : 0.0;
+            f64 PrimaryRaysPerSecond = (f64)Result.PrimaryRayCount * OneOverSeconds;
+            f64 RaysPerSecond        = (f64)Result.RayCount * OneOverSeconds;
+            f64 NanosecondsPerRay    = Result.RayCount ? Result.WallSeconds * 1e9 / (f64)Result.RayCount : 0.0;
+
+            fprintf(stderr, "%-12s %7u %9.3f %12.0f %12.0f %9.2f %16llx\n",
+                    Scene.Name, ThreadCount, Result.WallSeconds, PrimaryRaysPerSecond, RaysPerSecond,
+                    NanosecondsPerRay, (unsigned long long)Result.Checksum);
+
+            fprintf(Output,
+                    "%s\n"
+                    "    {\n"
+                    "      \"scene\": \"%s\",\n"
+                    "      \"spheres\": %u,\n"
+                    "      \"triangles\": %u,\n"
+                    "      \"bounces\": %u,\n"
+                    "      \"build_seconds\": %.6f,\n"
+                    "      \"threads\": %u,\n"
+                    "      \"wall_seconds\": %.6f,\n"
+                    "      \"primary_rays\": %llu,\n"
+                    "      \"rays\": %llu,\n"
+                    "      \"primary_rays_per_second\": %.1f,\n"
+                    "      \"rays_per_second\": %.1f,\n"
+                    "      \"ns_per_ray\": %.3f,\n"
+                    "      \"checksum\": \"%016llx\"\n"
+                    "    }",
+                    FirstResult ? "" : ",",
+                    Scene.Name,
+                    World->SphereCount,
+                    World->TriangleCount,
+                    Scene.RayBounceCount,
+                    BuildSeconds,
+                    ThreadCount,
+                    Result.WallSeconds,
+                    (unsigned long long)Result.PrimaryRayCount,
+                    (unsigned long long)Result.RayCount,
+                    PrimaryRaysPerSecond,
+                    RaysPerSecond,
+                    NanosecondsPerRay,
+                    (unsigned long long)Result.Checksum);
+            FirstResult = false;
+        }
+
+        FreeWorld(World);
+        free(World);
+    }
+
+    fprintf(Output, "\n  ]\n}\n");
+    bool Success = fclose(Output) == 0;
+    if (Success)
+    {
+        fprintf(stderr, "%s saved successfully\n", Settings.OutputPath);
+    }
+    else
+    {
+        fprintf(stderr, "failed to write %s\n", Settings.OutputPath);
+    }
+    return Success ? 0 : 1;
+}
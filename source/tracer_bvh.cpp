@@ -0,0 +1,268 @@
+#include "tracer_bvh.h"
+
+struct bvh_bin
+{
+    aabb Bounds;
+    u32  PrimitiveCount;
+};
+
+struct bvh_builder
+{
+    bvh        *Bvh;
+    const aabb *PrimitiveBounds;
+    v3         *PrimitiveCentroids;
+};
+
+function void
+SetBvhNodeBounds(bvh_node *Node, const aabb &Bounds)
+{
+    for (u32 Axis = 0; Axis < 3; Axis++)
+    {
+        Node->Min[Axis] = VectorComponent(Bounds.Min, Axis);
+        Node->Max[Axis] = VectorComponent(Bounds.Max, Axis);
+    }
+}
+
+function u32
+GetBvhBinIndex(f32 Centroid, f32 CentroidMin, f32 BinScale)
+{
+    i32 BinIndex = (i32)((Centroid - CentroidMin) * BinScale);
+    if (BinIndex < 0)
+    {
+        BinIndex = 0;
+    }
+    if (BinIndex > BVH_BIN_COUNT - 1)
+    {
+        BinIndex = BVH_BIN_COUNT - 1;
+    }
+    return (u32)BinIndex;
+}
+
+// note(harlequin): binned sah over the centroid bounds, returns false when keeping a leaf is cheaper
+function bool
+FindBvhSplit(bvh_builder *Builder,
+             u32          FirstPrimitive,
+             u32          PrimitiveCount,
+             const aabb  &NodeBounds,
+             const aabb  &CentroidBounds,
+             u32         *OutAxis,
+             f32         *OutSplit)
+{
+    const f32 TraversalCost = 1.0f;
+    const f32 IntersectCost = 1.0f;
+
+    f32 BestCost = MAX_F32;
+    u32 BestAxis = 0;
+    f32 BestSplit = 0.0f;
+
+    u32 *Indices = Builder->Bvh->PrimitiveIndices + FirstPrimitive;
+
+    for (u32 Axis = 0; Axis < 3; Axis++)
+    {
+        f32 CentroidMin = VectorComponent(CentroidBounds.Min, Axis);
+        f32 CentroidMax = VectorComponent(CentroidBounds.Max, Axis);
+        if (CentroidMax - CentroidMin <= 0.0f)
+        {
+            continue;
+        }
+
+        bvh_bin Bins[BVH_BIN_COUNT];
+        for (u32 BinIndex = 0; BinIndex < BVH_BIN_COUNT; BinIndex++)
+        {
+            Bins[BinIndex].Bounds         = EmptyAabb();
+            Bins[BinIndex].PrimitiveCount = 0;
+        }
+
+        f32 BinScale = (f32)BVH_BIN_COUNT / (CentroidMax - CentroidMin);
+        for (u32 Index = 0; Index < PrimitiveCount; Index++)
+        {
+            u32 PrimitiveIndex = Indices[Index];
+            f32 Centroid = VectorComponent(Builder->PrimitiveCentroids[PrimitiveIndex], Axis);
+            bvh_bin *Bin = Bins + GetBvhBinIndex(Centroid, CentroidMin, BinScale);
+            Bin->Bounds = Union(Bin->Bounds, Builder->PrimitiveBounds[PrimitiveIndex]);
+            Bin->PrimitiveCount++;
+        }
+
+        // note(harlequin): sweep from both sides so every plane between bins costs O(1)
+        f32 LeftArea[BVH_BIN_COUNT - 1];
+        u32 LeftCount[BVH_BIN_COUNT - 1];
+        aabb LeftBounds = EmptyAabb();
+        u32  LeftSum    = 0;
+        for (u32 PlaneIndex = 0; PlaneIndex < BVH_BIN_COUNT - 1; PlaneIndex++)
+        {
+            LeftBounds = Union(LeftBounds, Bins[PlaneIndex].Bounds);
+            LeftSum   += Bins[PlaneIndex].PrimitiveCount;
+            LeftArea[PlaneIndex]  = GetAabbSurfaceArea(LeftBounds);
+            LeftCount[PlaneIndex] = LeftSum;
+        }
+
+        aabb RightBounds = EmptyAabb();
+        u32  RightSum    = 0;
+        for (u32 PlaneIndex = BVH_BIN_COUNT - 1; PlaneIndex > 0; PlaneIndex--)
+        {
+            RightBounds = Union(RightBounds, Bins[PlaneIndex].Bounds);
+            RightSum   += Bins[PlaneIndex].PrimitiveCount;
+
+            u32 LeftPlane = PlaneIndex - 1;
+            if (!LeftCount[LeftPlane] || !RightSum)
+            {
+                continue;
+            }
+
+            u32 LeftGroupCount  = (LeftCount[LeftPlane] + LANE_WIDTH - 1) / LANE_WIDTH;
+            u32 RightGroupCount = (RightSum + LANE_WIDTH - 1) / LANE_WIDTH;
+            f32 Cost = LeftArea[LeftPlane] * LeftGroupCount +
+                       GetAabbSurfaceArea(RightBounds) * RightGroupCount;
+            if (Cost < BestCost)
+            {
+                BestCost  = Cost;
+                BestAxis  = Axis;
+                BestSplit = CentroidMin + (f32)PlaneIndex / BinScale;
+            }
+        }
+    }
+
+    if (BestCost == MAX_F32)
+    {
+        return false;
+    }
+
+    f32 NodeArea = GetAabbSurfaceArea(NodeBounds);
+    f32 SplitCost = TraversalCost + IntersectCost * BestCost / (NodeArea > 0.0f ? NodeArea : 1.0f);
+    // note(harlequin): leaves are intersected LANE_WIDTH primitives at a time
+    f32 LeafCost  = IntersectCost * (f32)((PrimitiveCount + LANE_WIDTH - 1) / LANE_WIDTH);
+
+    *OutAxis  = BestAxis;
+    *OutSplit = BestSplit;
+    return SplitCost < LeafCost || PrimitiveCount > BVH_MAX_LEAF_PRIMITIVE_COUNT;
+}
+
+function u32
+BuildBvhNode(bvh_builder *Builder,
+             u32          FirstPrimitive,
+             u32          PrimitiveCount,
+             u32          Depth)
+{
+    bvh *Bvh = Builder->Bvh;
+    u32 NodeIndex = Bvh->NodeCount++;
+    bvh_node *Node = Bvh->Nodes + NodeIndex;
+
+    u32 *Indices = Bvh->PrimitiveIndices + FirstPrimitive;
+
+    aabb NodeBounds     = EmptyAabb();
+    aabb CentroidBounds = EmptyAabb();
+    for (u32 Index = 0; Index < PrimitiveCount; Index++)
+    {
+        u32 PrimitiveIndex = Indices[Index];
+        NodeBounds     = Union(NodeBounds, Builder->PrimitiveBounds[PrimitiveIndex]);
+        CentroidBounds = Union(CentroidBounds, Builder->PrimitiveCentroids[PrimitiveIndex]);
+    }
+    SetBvhNodeBounds(Node, NodeBounds);
+
+    u32 SplitAxis = 0;
+    f32 Split     = 0.0f;
+    u32 LeftCount = 0;
+
+    bool ShouldSplit = PrimitiveCount > 1 && Depth < BVH_MAX_DEPTH - 1 &&
+                       FindBvhSplit(Builder,
+                                    FirstPrimitive,
+                                    PrimitiveCount,
+                                    NodeBounds,
+                                    CentroidBounds,
+                                    &SplitAxis,
+                                    &Split);
+    if (ShouldSplit)
+    {
+        u32 Left  = 0;
+        u32 Right = PrimitiveCount;
+        while (Left < Right)
+        {
+            f32 Centroid = VectorComponent(Builder->PrimitiveCentroids[Indices[Left]], SplitAxis);
+            if (Centroid < Split)
+            {
+                Left++;
+            }
+            else
+            {
+                Right--;
+                u32 Temp       = Indices[Left];
+                Indices[Left]  = Indices[Right];
+                Indices[Right] = Temp;
+            }
+        }
+        LeftCount = Left;
+    }
+
+    // note(harlequin): sah can not separate the primitives when all centroids coincide, and the partition can still
+    // put every primitive on one side when the centroids sit right at the plane. split the range in half either way
+    // instead of keeping a leaf of any size
+    bool Degenerate = !LeftCount || LeftCount == PrimitiveCount;
+    if (Degenerate && PrimitiveCount > BVH_MAX_LEAF_PRIMITIVE_COUNT && Depth < BVH_MAX_DEPTH - 1)
+    {
+        LeftCount = PrimitiveCount / 2;
+    }
+
+    if (!LeftCount || LeftCount == PrimitiveCount)
+    {
+        Node->PrimitiveCount = PrimitiveCount;
+        Node->Offset         = FirstPrimitive;
+        return NodeIndex;
+    }
+
+    Node->PrimitiveCount = 0;
+    BuildBvhNode(Builder, FirstPrimitive, LeftCount, Depth + 1);
+    u32 SecondChildIndex = BuildBvhNode(Builder,
+                                        FirstPrimitive + LeftCount,
+                                        PrimitiveCount - LeftCount,
+                                        Depth + 1);
+    Node->Offset = SecondChildIndex;
+    return NodeIndex;
+}
+
+bool
+BuildBvh(bvh        *Bvh,
+         const aabb *PrimitiveBounds,
+         u32         PrimitiveCount)
+{
+    FreeBvh(Bvh);
+
+    if (!PrimitiveCount)
+    {
+        return true;
+    }
+
+    u32 MaxNodeCount = 2 * PrimitiveCount - 1;
+    Bvh->Nodes            = (bvh_node *)_aligned_malloc(sizeof(bvh_node) * MaxNodeCount, 64);
+    Bvh->PrimitiveIndices = (u32 *)malloc(sizeof(u32) * PrimitiveCount);
+    v3 *Centroids         = (v3 *)_aligned_malloc(sizeof(v3) * PrimitiveCount, alignof(v3));
+    if (!Bvh->Nodes || !Bvh->PrimitiveIndices || !Centroids)
+    {
+        _aligned_free(Centroids);
+        FreeBvh(Bvh);
+        return false;
+    }
+
+    Bvh->PrimitiveCount = PrimitiveCount;
+    for (u32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveCount; PrimitiveIndex++)
+    {
+        Bvh->PrimitiveIndices[PrimitiveIndex] = PrimitiveIndex;
+        Centroids[PrimitiveIndex] = GetAabbCenter(PrimitiveBounds[PrimitiveIndex]);
+    }
+
+    bvh_builder Builder = {};
+    Builder.Bvh                = Bvh;
+    Builder.PrimitiveBounds    = PrimitiveBounds;
+    Builder.PrimitiveCentroids = Centroids;
+    BuildBvhNode(&Builder, 0, PrimitiveCount, 0);
+
+    _aligned_free(Centroids);
+    return true;
+}
+
+void
+FreeBvh(bvh *Bvh)
+{
+    _aligned_free(Bvh->Nodes);
+    free(Bvh->PrimitiveIndices);
+    *Bvh = {};
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+
+#define BVH_MAX_DEPTH 64
+#define BVH_MAX_LEAF_PRIMITIVE_COUNT LANE_WIDTH
+#define BVH_BIN_COUNT 16
+
+// note(harlequin): nodes are stored depth first so the first child of an interior node is always
+// the next node in the array and only the second child needs an index, 32 bytes puts two nodes on a cache line
+struct bvh_node
+{
+    f32 Min[3];
+    u32 PrimitiveCount; // 0 for interior nodes
+    f32 Max[3];
+    u32 Offset;         // interior: index of the second child, leaf: index of the first primitive
+};
+
+struct bvh
+{
+    u32       NodeCount;
+    bvh_node *Nodes;
+
+    u32  PrimitiveCount;
+    u32 *PrimitiveIndices; // leaf primitive ranges index into this, it maps back to the caller's primitive order
+};
+
+function bool
+BuildBvh(bvh        *Bvh,
+         const aabb *PrimitiveBounds,
+         u32         PrimitiveCount);
+
+function void
+FreeBvh(bvh *Bvh);
+
+struct bvh_ray
+{
+    f32 Origin[3];
+    f32 InverseDirection[3];
+};
+
+function inline bvh_ray
+BvhRayFromRay(const ray &Ray)
+{
+    bvh_ray Result;
+    for (u32 Axis = 0; Axis < 3; Axis++)
+    {
+        f32 Direction = VectorComponent(Ray.Direction, Axis);
+        // note(harlequin): keep the slabs finite when a direction component is zero
+        if (fabsf(Direction) < 1e-8f)
+        {
+            Direction = Direction < 0.0f ? -1e-8f : 1e-8f;
+        }
+        Result.Origin[Axis]           = VectorComponent(Ray.Origin, Axis);
+        Result.InverseDirection[Axis] = 1.0f / Direction;
+    }
+    return Result;
+}
+
+// returns the entry distance of the ray into the node or MAX_F32 if it misses or enters beyond MaxT
+function inline f32
+RayCastBvhNode(const bvh_ray  &Ray,
+               const bvh_node *Node,
+               f32             MaxT)
+{
+    f32 TMin = 0.0f;
+    f32 TMax = MaxT;
+    for (u32 Axis = 0; Axis < 3; Axis++)
+    {
+        f32 T0 = (Node->Min[Axis] - Ray.Origin[Axis]) * Ray.InverseDirection[Axis];
+        f32 T1 = (Node->Max[Axis] - Ray.Origin[Axis]) * Ray.InverseDirection[Axis];
+        if (T0 > T1)
+        {
+            f32 Temp = T0;
+            T0 = T1;
+            T1 = Temp;
+        }
+        TMin = T0 > TMin ? T0 : TMin;
+        TMax = T1 < TMax ? T1 : TMax;
+    }
+    return TMin <= TMax ? TMin : MAX_F32;
+}
+
+// note(harlequin): slab test for every ray of a packet at once, a lane only counts as hitting when it enters
+// the node before its own closest hit so far (interval culling), *OutEntryT holds the per lane entry distance
+function inline lane_f32
+RayPacketCastBvhNode(const ray_packet &Packet,
+                     const bvh_node   *Node,
+                     lane_f32          ClosestT,
+                     lane_f32         *OutEntryT)
+{
+    lane_f32 T0X = (LaneF32(Node->Min[0]) - Packet.OriginX) * Packet.InverseDirectionX;
+    lane_f32 T1X = (LaneF32(Node->Max[0]) - Packet.OriginX) * Packet.InverseDirectionX;
+    lane_f32 T0Y = (LaneF32(Node->Min[1]) - Packet.OriginY) * Packet.InverseDirectionY;
+    lane_f32 T1Y = (LaneF32(Node->Max[1]) - Packet.OriginY) * Packet.InverseDirectionY;
+    lane_f32 T0Z = (LaneF32(Node->Min[2]) - Packet.OriginZ) * Packet.InverseDirectionZ;
+    lane_f32 T1Z = (LaneF32(Node->Max[2]) - Packet.OriginZ) * Packet.InverseDirectionZ;
+
+    lane_f32 TMin = Maximium(Maximium(Minimum(T0X, T1X), Minimum(T0Y, T1Y)),
+                             Maximium(Minimum(T0Z, T1Z), LaneF32(0.0f)));
+    lane_f32 TMax = Minimum(Minimum(Maximium(T0X, T1X), Maximium(T0Y, T1Y)),
+                            Minimum(Maximium(T0Z, T1Z), ClosestT));
+
+    *OutEntryT = TMin;
+    return TMin <= TMax;
+}
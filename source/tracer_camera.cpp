@@ -5,37 +5,21 @@ ResizeCamera(camera *Camera,
              u32     Width,
              u32     Height)
 {
-    f32 AspectRatio         = (f32)Width / (f32)Height;
-    Camera->AspectRatio     = AspectRatio;
-    f32 ViewportHeight      = 2.0f;
-    Camera->ViewportSize    = V2(AspectRatio * ViewportHeight, ViewportHeight);
-    v2 HalfViewportSize     = Camera->ViewportSize * 0.5f;
-    Camera->LowerLeftCornor = Camera->Origin - V3(HalfViewportSize, 0.0f) - V3(0.0f, 0.0f, Camera->FocalLength);
+    f32 AspectRatio     = (f32)Width / (f32)Height;
+    Camera->AspectRatio = AspectRatio;
+    Camera->Width       = Width;
+    Camera->Height      = Height;
 
-    u32 RayCount = Width * Height;
-    Camera->RayCount = RayCount;
-    Camera->Rays     = (ray*)_aligned_realloc(Camera->Rays, sizeof(ray) * RayCount, alignof(ray));
+    // note(harlequin): the image plane is 2 units high at FocalLength, scaled out to the focus plane
+    f32 HalfHeight = Camera->FocusDistance / Camera->FocalLength;
+    f32 HalfWidth  = AspectRatio * HalfHeight;
 
-    const u32 OneMinusWidth  = Width  - 1;
-    const u32 OneMinusHeight = Height - 1;
-    const f32 OneOverOneMinusWidth  = 1.0f / OneMinusWidth;
-    const f32 OneOverOneMinusHeight = 1.0f / OneMinusHeight;
-
-    for (u32 Y = 0; Y < Height; Y++)
-    {
-        for (u32 X = 0; X < Width; X++)
-        {
-            f32 SampleU = ((f32)X + 0.5f) * OneOverOneMinusWidth;
-            f32 SampleV = ((f32)(Height - Y) - 0.5f) * OneOverOneMinusHeight;
-            v3  SampleP = V3(SampleU * Camera->ViewportSize.X,
-                             SampleV * Camera->ViewportSize.Y,
-                             0.0f);
-
-            v3  Direction  = Normalize(Camera->LowerLeftCornor + SampleP - Camera->Origin);
-            u32 PixelIndex = GetPixelIndex(X, Y, Width);
-            Camera->Rays[PixelIndex] = RayOriginDirection(Camera->Origin, Direction);
-        }
-    }
+    Camera->UpperLeftCorner = Camera->Origin +
+                              Camera->Forward * Camera->FocusDistance -
+                              Camera->Right * HalfWidth +
+                              Camera->Up * HalfHeight;
+    Camera->PixelDeltaX     = Camera->Right * (2.0f * HalfWidth / (f32)Width);
+    Camera->PixelDeltaY     = Camera->Up * (-2.0f * HalfHeight / (f32)Height);
 }
 
 void
@@ -45,7 +29,36 @@ InitializeCamera(camera *Camera,
                  f32     FocalLength,
                  v3      Origin)
 {
-    Camera->FocalLength     = FocalLength;
-    Camera->Origin          = Origin;
+    Camera->FocalLength    = FocalLength;
+    Camera->ApertureRadius = 0.0f;
+    Camera->FocusDistance  = FocalLength;
+    Camera->Origin         = Origin;
+    Camera->Right          = V3(1.0f, 0.0f, 0.0f);
+    Camera->Up             = V3(0.0f, 1.0f, 0.0f);
+    Camera->Forward        = V3(0.0f, 0.0f, -1.0f);
     ResizeCamera(Camera, FrameBufferWidth, FrameBufferHeight);
-}
\ No newline at end of file
+}
+
+void
+LookAtCamera(camera *Camera,
+             v3      Origin,
+             v3      Target,
+             v3      Up)
+{
+    Camera->Origin  = Origin;
+    Camera->Forward = Normalize(Target - Origin);
+    Camera->Right   = Normalize(Cross(Camera->Forward, Up));
+    Camera->Up      = Cross(Camera->Right, Camera->Forward);
+    ResizeCamera(Camera, Camera->Width, Camera->Height);
+}
+
+void
+SetCameraLens(camera *Camera,
+              f32     ApertureRadius,
+              f32     FocusDistance)
+{
+    Assert(FocusDistance > 0.0f);
+    Camera->ApertureRadius = ApertureRadius;
+    Camera->FocusDistance  = FocusDistance;
+    ResizeCamera(Camera, Camera->Width, Camera->Height);
+}
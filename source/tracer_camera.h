@@ -2,29 +2,79 @@
 
 #include "tracer_core.h"
 #include "tracer_math.h"
+#include "tracer_random.h"
 
+// note(harlequin): the camera is a handful of vectors, every sample builds its primary ray from them instead of
+// reading a per pixel ray array, so resizing costs nothing and each sample lands somewhere else in its pixel
 struct camera
 {
-    f32 FocalLength;
+    f32 FocalLength;    // distance of the image plane when the image is 2 units high
     f32 AspectRatio;
-
-    v2 ViewportSize;
+    f32 ApertureRadius; // 0 is a pinhole
+    f32 FocusDistance;  // everything this far along Forward is sharp
 
     v3 Origin;
-    v3 LowerLeftCornor;
+    v3 Right;
+    v3 Up;
+    v3 Forward;
 
-    u32  RayCount;
-    ray *Rays;
+    // note(harlequin): derived by ResizeCamera, the image on the focus plane
+    u32 Width;
+    u32 Height;
+    v3  UpperLeftCorner;
+    v3  PixelDeltaX;
+    v3  PixelDeltaY;
 };
 
+// note(harlequin): the camera draws its numbers past the last bounce so they never collide with the path's
+#define CAMERA_RANDOM_BOUNCE 0xFFFF
+
 function void
 ResizeCamera(camera *Camera,
              u32     Width,
              u32     Height);
 
+// looks down -z from Origin with a pinhole
 function void
 InitializeCamera(camera *Camera,
                  u32     FrameBufferWidth,
                  u32     FrameBufferHeight,
                  f32     FocalLength,
-                 v3      Origin);
\ No newline at end of file
+                 v3      Origin);
+
+// Up only has to be somewhere above the view direction, it is orthogonalized
+function void
+LookAtCamera(camera *Camera,
+             v3      Origin,
+             v3      Target,
+             v3      Up);
+
+function void
+SetCameraLens(camera *Camera,
+              f32     ApertureRadius,
+              f32     FocusDistance);
+
+// note(harlequin): a uniformly jittered point in the pixel for antialiasing and a point on the lens for depth of
+// field, both from Series which the caller keys on the pixel and sample at CAMERA_RANDOM_BOUNCE
+inline ray
+GenerateCameraRay(const camera  *Camera,
+                  u32            X,
+                  u32            Y,
+                  random_series *Series)
+{
+    f32 JitterX = RandomCanonical(Series);
+    f32 JitterY = RandomCanonical(Series);
+    v3 Target = Camera->UpperLeftCorner +
+                Camera->PixelDeltaX * ((f32)X + JitterX) +
+                Camera->PixelDeltaY * ((f32)Y + JitterY);
+
+    v3 Origin = Camera->Origin;
+    if (Camera->ApertureRadius > 0.0f)
+    {
+        f32 Radius = Camera->ApertureRadius * SquareRoot(RandomCanonical(Series));
+        f32 Angle  = Two_PI * RandomCanonical(Series);
+        Origin += Camera->Right * (Radius * cosf(Angle)) + Camera->Up * (Radius * sinf(Angle));
+    }
+
+    return RayOriginDirection(Origin, Normalize(Target - Origin));
+}
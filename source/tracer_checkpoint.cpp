@@ -0,0 +1,341 @@
+#include "tracer_checkpoint.h"
+#include "tracer_camera.h"
+#include "tracer_world.h"
+#include "tracer_jobs.h"
+#include "tracer_file.h"
+#include "tracer_profile.h"
+
+#define CHECKPOINT_FEATURE_COUNT 7
+
+function u64
+HashBytes(u64 Hash, const void *Bytes, u64 Size)
+{
+    const u8 *Byte = (const u8 *)Bytes;
+    for (u64 ByteIndex = 0; ByteIndex < Size; ByteIndex++)
+    {
+        Hash = (Hash ^ Byte[ByteIndex]) * 1099511628211ull;
+    }
+    return Hash;
+}
+
+// note(harlequin): component by component, the fourth lane of a simd v3 is not part of the value
+function u64
+HashV3(u64 Hash, const v3 &Value)
+{
+    f32 Components[3] = { VectorComponent(Value, 0), VectorComponent(Value, 1), VectorComponent(Value, 2) };
+    return HashBytes(Hash, Components, sizeof(Components));
+}
+
+function u64
+HashF32(u64 Hash, f32 Value)
+{
+    return HashBytes(Hash, &Value, sizeof(Value));
+}
+
+function u64
+HashU32(u64 Hash, u32 Value)
+{
+    return HashBytes(Hash, &Value, sizeof(Value));
+}
+
+u64
+HashRenderInputs(const world          *World,
+                 const camera         *Camera,
+                 const trace_settings &Settings)
+{
+    u64 Hash = 14695981039346656037ull;
+
+    for (u32 MaterialIndex = 0; MaterialIndex < World->MaterialCount; MaterialIndex++)
+    {
+        Hash = HashV3(Hash, World->Materials[MaterialIndex].Albedo);
+        Hash = HashF32(Hash, World->Materials[MaterialIndex].Roughness);
+    }
+    for (u32 SphereIndex = 0; SphereIndex < World->SphereCount; SphereIndex++)
+    {
+        Hash = HashV3(Hash, World->Spheres[SphereIndex].Center);
+        Hash = HashF32(Hash, World->Spheres[SphereIndex].Radius);
+    }
+    Hash = HashBytes(Hash, World->SphereMaterialIndices, sizeof(u32) * World->SphereCount);
+    for (u32 VertexIndex = 0; VertexIndex < World->VertexCount; VertexIndex++)
+    {
+        Hash = HashV3(Hash, World->Vertices[VertexIndex]);
+    }
+    Hash = HashBytes(Hash, World->TriangleVertexIndices, sizeof(u32) * 3 * World->TriangleCount);
+    Hash = HashBytes(Hash, World->TriangleMaterialIndices, sizeof(u32) * World->TriangleCount);
+
+    Hash = HashU32(Hash, Camera->Width);
+    Hash = HashU32(Hash, Camera->Height);
+    Hash = HashF32(Hash, Camera->ApertureRadius);
+    Hash = HashF32(Hash, Camera->FocusDistance);
+    Hash = HashV3(Hash, Camera->Origin);
+    Hash = HashV3(Hash, Camera->UpperLeftCorner);
+    Hash = HashV3(Hash, Camera->PixelDeltaX);
+    Hash = HashV3(Hash, Camera->PixelDeltaY);
+
+    Hash = HashU32(Hash, Settings.RayBounceCount);
+    Hash = HashU32(Hash, (u32)Settings.Integrator);
+    Hash = HashU32(Hash, Settings.PacketTracing);
+    Hash = HashU32(Hash, Settings.Seed);
+    Hash = HashU32(Hash, Settings.FirstRow);
+    Hash = HashU32(Hash, Settings.AdaptiveSampling);
+    Hash = HashF32(Hash, Settings.AdaptiveSampling ? Settings.NoiseThreshold : 0.0f);
+    Hash = HashU32(Hash, Settings.AdaptiveSampling ? Settings.MinimumSampleCount : 0);
+    return Hash;
+}
+
+function bool
+WriteCheckpointFile(checkpoint_writer *Writer)
+{
+    FILE *File = fopen(Writer->TemporaryPath, "wb");
+    if (!File)
+    {
+        return false;
+    }
+
+    u64 PixelCount = Writer->PixelCount;
+    bool Success = fwrite(&Writer->Header, sizeof(Writer->Header), 1, File) == 1 &&
+                   fwrite(Writer->Accumulation, sizeof(f32) * 3, PixelCount, File) == PixelCount &&
+                   fwrite(Writer->Statistics, sizeof(pixel_statistics), PixelCount, File) == PixelCount;
+    if (Success && Writer->Header.HasFeatures)
+    {
+        Success = fwrite(Writer->Features, sizeof(f32) * CHECKPOINT_FEATURE_COUNT, PixelCount, File) == PixelCount;
+    }
+    Success &= FlushFileToDisk(File);
+    Success &= fclose(File) == 0;
+    return Success && RenameFileOver(Writer->TemporaryPath, Writer->FilePath);
+}
+
+function void
+CheckpointWriterThread(checkpoint_writer *Writer)
+{
+    PROFILE_THREAD_NAME("checkpoint writer");
+    for (;;)
+    {
+        {
+            std::unique_lock< std::mutex > Lock(Writer->Mutex);
+            Writer->SignalCV.wait(Lock, [&]() -> bool
+            {
+                return Writer->Pending || Writer->Quit;
+            });
+            if (!Writer->Pending)
+            {
+                return;
+            }
+        }
+
+        PROFILE_SCOPE("WriteCheckpoint");
+        bool Written = WriteCheckpointFile(Writer);
+        if (!Written)
+        {
+            fprintf(stderr, "\nfailed to write the checkpoint %s\n", Writer->FilePath);
+        }
+
+        std::lock_guard< std::mutex > Lock(Writer->Mutex);
+        Writer->Pending       = false;
+        Writer->Failed       |= !Written;
+        Writer->WrittenCount += Written;
+        Writer->SignalCV.notify_all();
+    }
+}
+
+bool
+StartCheckpointWriter(checkpoint_writer *Writer,
+                      const char        *FilePath,
+                      u32                Width,
+                      u32                Height,
+                      bool               HasFeatures)
+{
+    Writer->FilePath   = FilePath;
+    Writer->PixelCount = Width * Height;
+    Writer->Pending    = false;
+    Writer->Quit       = false;
+    Writer->Failed     = false;
+    snprintf(Writer->TemporaryPath, sizeof(Writer->TemporaryPath), "%s.tmp", FilePath);
+
+    u64 PixelCount = Writer->PixelCount;
+    Writer->Accumulation = (f32 *)malloc(sizeof(f32) * 3 * PixelCount);
+    Writer->Statistics   = (pixel_statistics *)malloc(sizeof(pixel_statistics) * PixelCount);
+    Writer->Features     = HasFeatures ? (f32 *)malloc(sizeof(f32) * CHECKPOINT_FEATURE_COUNT * PixelCount) : nullptr;
+    if (!Writer->Accumulation || !Writer->Statistics || (HasFeatures && !Writer->Features))
+    {
+        fprintf(stderr, "failed to allocate the checkpoint of %s\n", FilePath);
+        free(Writer->Accumulation);
+        free(Writer->Statistics);
+        free(Writer->Features);
+        Writer->Accumulation = nullptr;
+        Writer->Statistics   = nullptr;
+        Writer->Features     = nullptr;
+        return false;
+    }
+
+    Writer->Thread = std::thread(CheckpointWriterThread, Writer);
+    return true;
+}
+
+bool
+QueueCheckpoint(checkpoint_writer       *Writer,
+                const checkpoint_header &Header,
+                const frame_buffer      *AccumulationFrameBuffer,
+                const sample_buffer     *SampleBuffer,
+                const feature_buffer    *FeatureBuffer)
+{
+    {
+        std::lock_guard< std::mutex > Lock(Writer->Mutex);
+        if (Writer->Pending)
+        {
+            return false;
+        }
+    }
+
+    // note(harlequin): the writer thread only reads the staging arrays while a checkpoint is pending
+    u32 PixelCount = Writer->PixelCount;
+    Assert(AccumulationFrameBuffer->Width * AccumulationFrameBuffer->Height == PixelCount);
+    f32 *Accumulation = Writer->Accumulation;
+    for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+    {
+        const v3 &Color = AccumulationFrameBuffer->Pixels[PixelIndex];
+        *Accumulation++ = VectorComponent(Color, 0);
+        *Accumulation++ = VectorComponent(Color, 1);
+        *Accumulation++ = VectorComponent(Color, 2);
+    }
+    memcpy(Writer->Statistics, SampleBuffer->Pixels, sizeof(pixel_statistics) * PixelCount);
+
+    if (Writer->Features)
+    {
+        f32 *Features = Writer->Features;
+        for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+        {
+            const v3 &Albedo = FeatureBuffer->Albedo[PixelIndex];
+            const v3 &Normal = FeatureBuffer->Normal[PixelIndex];
+            *Features++ = VectorComponent(Albedo, 0);
+            *Features++ = VectorComponent(Albedo, 1);
+            *Features++ = VectorComponent(Albedo, 2);
+            *Features++ = VectorComponent(Normal, 0);
+            *Features++ = VectorComponent(Normal, 1);
+            *Features++ = VectorComponent(Normal, 2);
+            *Features++ = FeatureBuffer->Depth[PixelIndex];
+        }
+    }
+
+    std::lock_guard< std::mutex > Lock(Writer->Mutex);
+    Writer->Header             = Header;
+    Writer->Header.Magic       = CHECKPOINT_MAGIC;
+    Writer->Header.Version     = CHECKPOINT_VERSION;
+    Writer->Header.Width       = AccumulationFrameBuffer->Width;
+    Writer->Header.Height      = AccumulationFrameBuffer->Height;
+    Writer->Header.HasFeatures = Writer->Features != nullptr;
+    Writer->Pending            = true;
+    Writer->SignalCV.notify_all();
+    return true;
+}
+
+bool
+WaitForCheckpoint(checkpoint_writer *Writer)
+{
+    std::unique_lock< std::mutex > Lock(Writer->Mutex);
+    Writer->SignalCV.wait(Lock, [&]() -> bool
+    {
+        return !Writer->Pending;
+    });
+    return !Writer->Failed;
+}
+
+bool
+StopCheckpointWriter(checkpoint_writer *Writer)
+{
+    if (!Writer->Thread.joinable())
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard< std::mutex > Lock(Writer->Mutex);
+        Writer->Quit = true;
+        Writer->SignalCV.notify_all();
+    }
+    Writer->Thread.join();
+
+    free(Writer->Accumulation);
+    free(Writer->Statistics);
+    free(Writer->Features);
+    Writer->Accumulation = nullptr;
+    Writer->Statistics   = nullptr;
+    Writer->Features     = nullptr;
+    return !Writer->Failed;
+}
+
+checkpoint_load
+LoadCheckpoint(const char        *FilePath,
+               checkpoint_header *Header,
+               frame_buffer      *AccumulationFrameBuffer,
+               sample_buffer     *SampleBuffer,
+               feature_buffer    *FeatureBuffer)
+{
+    FILE *File = fopen(FilePath, "rb");
+    if (!File)
+    {
+        return CheckpointLoad_Missing;
+    }
+
+    checkpoint_header FileHeader;
+    if (fread(&FileHeader, sizeof(FileHeader), 1, File) != 1 ||
+        FileHeader.Magic != CHECKPOINT_MAGIC ||
+        FileHeader.Version != CHECKPOINT_VERSION)
+    {
+        fprintf(stderr, "%s is not a checkpoint of this version\n", FilePath);
+        fclose(File);
+        return CheckpointLoad_Failed;
+    }
+    if (FileHeader.InputHash != Header->InputHash ||
+        FileHeader.Width != Header->Width ||
+        FileHeader.Height != Header->Height ||
+        FileHeader.HasFeatures != Header->HasFeatures)
+    {
+        fprintf(stderr, "%s is a checkpoint of another scene, camera or settings\n", FilePath);
+        fclose(File);
+        return CheckpointLoad_Failed;
+    }
+
+    Assert(AccumulationFrameBuffer->Width == FileHeader.Width && AccumulationFrameBuffer->Height == FileHeader.Height);
+    Assert(SampleBuffer->Width == FileHeader.Width && SampleBuffer->Height == FileHeader.Height);
+
+    // note(harlequin): a row at a time, so loading needs no second copy of the image
+    bool Success = true;
+    u32 Width = FileHeader.Width;
+    f32 *Row = (f32 *)malloc(sizeof(f32) * CHECKPOINT_FEATURE_COUNT * Width);
+    Success &= Row != nullptr;
+    for (u32 Y = 0; Success && Y < FileHeader.Height; Y++)
+    {
+        Success = fread(Row, sizeof(f32) * 3, Width, File) == Width;
+        for (u32 X = 0; Success && X < Width; X++)
+        {
+            AccumulationFrameBuffer->Pixels[GetPixelIndex(X, Y, Width)] = V3(Row[X * 3 + 0], Row[X * 3 + 1], Row[X * 3 + 2]);
+        }
+    }
+
+    u64 PixelCount = (u64)Width * FileHeader.Height;
+    Success = Success && fread(SampleBuffer->Pixels, sizeof(pixel_statistics), PixelCount, File) == PixelCount;
+
+    for (u32 Y = 0; Success && FileHeader.HasFeatures && Y < FileHeader.Height; Y++)
+    {
+        Success = fread(Row, sizeof(f32) * CHECKPOINT_FEATURE_COUNT, Width, File) == Width;
+        for (u32 X = 0; Success && X < Width; X++)
+        {
+            const f32 *Features = Row + X * CHECKPOINT_FEATURE_COUNT;
+            u32 PixelIndex = GetPixelIndex(X, Y, Width);
+            FeatureBuffer->Albedo[PixelIndex] = V3(Features[0], Features[1], Features[2]);
+            FeatureBuffer->Normal[PixelIndex] = V3(Features[3], Features[4], Features[5]);
+            FeatureBuffer->Depth[PixelIndex]  = Features[6];
+        }
+    }
+    free(Row);
+    fclose(File);
+
+    if (!Success)
+    {
+        fprintf(stderr, "failed to read the checkpoint %s\n", FilePath);
+        return CheckpointLoad_Failed;
+    }
+    *Header = FileHeader;
+    return CheckpointLoad_Loaded;
+}
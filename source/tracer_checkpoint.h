@@ -0,0 +1,104 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_framebuffer.h"
+
+struct world;
+struct camera;
+struct trace_settings;
+
+// note(harlequin): a checkpoint is everything a progressive render needs to go on as if it never stopped, the
+// linear accumulation, the statistics of every pixel and the first hit features. the random numbers of a sample
+// are keyed by the pixel and its sample count, so the statistics are the state of the random number generators
+// too. the file is written next to its path and renamed over it once it is on disk, a crash leaves either the
+// previous checkpoint or the new one
+
+#define CHECKPOINT_MAGIC   0x4B435254 // "TRCK"
+#define CHECKPOINT_VERSION 1
+
+struct checkpoint_header
+{
+    u32 Magic;
+    u32 Version;
+    u64 InputHash;      // of the scene, the camera and every setting that changes the samples
+    u32 Width;
+    u32 Height;
+    u32 HasFeatures;
+    u32 FrameCount;
+    u64 RayCount;
+    f64 ElapsedSeconds;
+};
+
+// note(harlequin): the buffers are copied into the staging arrays between two frames and written out by the
+// writer thread while the next frames trace, a checkpoint that comes while the last one is still being written
+// is skipped
+struct checkpoint_writer
+{
+    const char *FilePath;
+    char        TemporaryPath[1024];
+
+    checkpoint_header Header;
+    f32              *Accumulation; // 3 floats a pixel, the same file for simd and scalar builds
+    pixel_statistics *Statistics;
+    f32              *Features;     // albedo, normal and depth, 7 floats a pixel
+    u32               PixelCount;
+
+    std::thread             Thread;
+    std::mutex              Mutex;
+    std::condition_variable SignalCV;
+    bool                    Pending;
+    bool                    Quit;
+    bool                    Failed;
+    u32                     WrittenCount;
+};
+
+// fnv-1a over the world, the camera and the trace settings that change what a sample returns, the sample
+// limits and the tonemapper can change between a checkpoint and its resume
+function u64
+HashRenderInputs(const world          *World,
+                 const camera         *Camera,
+                 const trace_settings &Settings);
+
+function bool
+StartCheckpointWriter(checkpoint_writer *Writer,
+                      const char        *FilePath,
+                      u32                Width,
+                      u32                Height,
+                      bool               HasFeatures);
+
+// false if the last checkpoint is still being written, nothing is copied then. FeatureBuffer is only read when
+// the writer was started with features
+function bool
+QueueCheckpoint(checkpoint_writer       *Writer,
+                const checkpoint_header &Header,
+                const frame_buffer      *AccumulationFrameBuffer,
+                const sample_buffer     *SampleBuffer,
+                const feature_buffer    *FeatureBuffer);
+
+// blocks until the queued checkpoint is on disk, false if any checkpoint failed to write
+function bool
+WaitForCheckpoint(checkpoint_writer *Writer);
+
+function bool
+StopCheckpointWriter(checkpoint_writer *Writer);
+
+enum checkpoint_load
+{
+    CheckpointLoad_Missing,
+    CheckpointLoad_Loaded,
+    CheckpointLoad_Failed, // unreadable or of another render, the buffers are left in an unknown state
+};
+
+// reads a checkpoint into buffers of its size, Header has the hash, the size and HasFeatures it has to match
+// and gets the rest of the header
+function checkpoint_load
+LoadCheckpoint(const char        *FilePath,
+               checkpoint_header *Header,
+               frame_buffer      *AccumulationFrameBuffer,
+               sample_buffer     *SampleBuffer,
+               feature_buffer    *FeatureBuffer);
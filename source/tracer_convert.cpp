@@ -0,0 +1,59 @@
+#include <stdlib.h>
+#include <chrono>
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+
+#include "tracer_math.cpp"
+#include "tracer_memory.cpp"
+#include "tracer_profile.cpp"
+#include "tracer_random.cpp"
+#include "tracer_bvh.cpp"
+#include "tracer_world.cpp"
+#include "tracer_file.cpp"
+#include "tracer_mesh.cpp"
+#include "tracer_scene.cpp"
+
+// note(harlequin): offline step that turns a text scene into a binary .scene file, all the parsing
+// and bvh building happens here once so the renderers only map the result
+
+int main(int ArgumentCount, char **Arguments)
+{
+    if (ArgumentCount != 3)
+    {
+        fprintf(stderr, "usage: %s <input scene.txt> <output .scene>\n", Arguments[0]);
+        return 1;
+    }
+
+    const char *InputPath  = Arguments[1];
+    const char *OutputPath = Arguments[2];
+
+    auto StartTime = std::chrono::steady_clock::now();
+
+    world *World = (world *)calloc(1, sizeof(world));
+    if (!LoadScene(World, InputPath))
+    {
+        return 1;
+    }
+    if (World->SceneFile.Data)
+    {
+        fprintf(stderr, "%s is already a binary scene\n", InputPath);
+        return 1;
+    }
+    if (!SaveSceneFile(World, OutputPath))
+    {
+        return 1;
+    }
+
+    fprintf(stderr,
+            "converted %s: %u materials, %u spheres, %u triangles in %.3f s\n",
+            InputPath,
+            World->MaterialCount,
+            World->SphereCount,
+            World->TriangleCount,
+            std::chrono::duration< f64 >(std::chrono::steady_clock::now() - StartTime).count());
+
+    FreeWorld(World);
+    free(World);
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <limits.h>
 
 typedef int8_t  i8;
 typedef int16_t i16;
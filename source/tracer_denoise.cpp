@@ -0,0 +1,361 @@
+#include "tracer_denoise.h"
+#include "tracer_jobs.h"
+#include "tracer_framebuffer.h"
+#include "tracer_world.h"
+#include "tracer_profile.h"
+
+#define DENOISE_MAX_DISTANCE 20.0f
+
+enum denoise_stage
+{
+    DenoiseStage_Prepare,
+    DenoiseStage_EstimateNoise,
+    DenoiseStage_Filter,
+    DenoiseStage_Resolve
+};
+
+// note(harlequin): everything a tile of one stage needs, the stages run one RunTilePass after the other
+struct denoise_job
+{
+    denoise_stage         Stage;
+    const denoiser       *Denoiser;
+    const frame_buffer   *AccumulationFrameBuffer;
+    const sample_buffer  *SampleBuffer;
+    const feature_buffer *FeatureBuffer;
+    frame_buffer         *FrameBuffer;
+
+    const v3   *Source;
+    const f32  *SourceLuminance;
+    v3         *Destination;
+    f32        *DestinationLuminance;
+    u32         StepSize;
+    f32         ColorSigma;
+    f32         NormalPower;
+    f32         DepthSigma;
+    f32         OneOverAlbedoSigmaSquared;
+    tonemapper  Tonemapper;
+};
+
+function void
+PrepareTile(const denoise_job *Job, const tile &Tile)
+{
+    u32 Width = Job->Denoiser->Width;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        for (u32 X = Tile.MinX; X < Tile.MaxX; X++)
+        {
+            u32 PixelIndex = GetPixelIndex(X, Y, Width);
+            const pixel_statistics *Statistics = Job->SampleBuffer->Pixels + PixelIndex;
+
+            u32 SampleCount = Statistics->SampleCount;
+            v3 Mean = SampleCount ? Job->AccumulationFrameBuffer->Pixels[PixelIndex] / (f32)SampleCount : V3(0.0f);
+            f32 Luminance = GetLuminance(Mean);
+            Job->Destination[PixelIndex]          = Mean;
+            Job->DestinationLuminance[PixelIndex] = Luminance;
+            Job->Denoiser->InverseDepth[PixelIndex] = 1.0f / Job->FeatureBuffer->Depth[PixelIndex];
+
+            // note(harlequin): a pixel without a variance estimate is as noisy as it is bright
+            f32 Variance  = Luminance * Luminance;
+            if (SampleCount >= 2)
+            {
+                Variance = Statistics->M2 / ((f32)(SampleCount - 1) * (f32)SampleCount);
+            }
+            Job->Denoiser->Variance[PixelIndex] = Variance;
+        }
+    }
+}
+
+// note(harlequin): a few samples often agree by chance, so the variance of a pixel is averaged with its
+// neighbours before it decides how far apart two pixels can be
+function void
+EstimateNoiseTile(const denoise_job *Job, const tile &Tile)
+{
+    u32 Width  = Job->Denoiser->Width;
+    u32 Height = Job->Denoiser->Height;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        u32 MinY = Y > 0 ? Y - 1 : Y;
+        u32 MaxY = Y + 1 < Height ? Y + 1 : Y;
+        for (u32 X = Tile.MinX; X < Tile.MaxX; X++)
+        {
+            u32 MinX = X > 0 ? X - 1 : X;
+            u32 MaxX = X + 1 < Width ? X + 1 : X;
+
+            f32 VarianceSum = 0.0f;
+            for (u32 SampleY = MinY; SampleY <= MaxY; SampleY++)
+            {
+                for (u32 SampleX = MinX; SampleX <= MaxX; SampleX++)
+                {
+                    VarianceSum += Job->Denoiser->Variance[GetPixelIndex(SampleX, SampleY, Width)];
+                }
+            }
+            f32 SampleCount = (f32)((MaxX - MinX + 1) * (MaxY - MinY + 1));
+            Job->Denoiser->Noise[GetPixelIndex(X, Y, Width)] = SquareRoot(VarianceSum / SampleCount);
+        }
+    }
+}
+
+global_variable const f32 DenoiseKernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+// note(harlequin): 2^(x log2 e) with a cubic for the fraction, good to about 1e-4 which is plenty for a weight.
+// only called with -DENOISE_MAX_DISTANCE <= X <= 0
+inline f32
+ApproximateExp(f32 X)
+{
+    f32 Y = X * 1.44269504f;
+    i32 Integer = (i32)Y;
+    Integer -= (f32)Integer > Y;
+    f32 Fraction = Y - (f32)Integer;
+    f32 Power = 1.0f + Fraction * (0.6960656f + Fraction * (0.2244943f + Fraction * 0.0794402f));
+
+    u32 ScaleBits = (u32)(Integer + 127) << 23;
+    f32 Scale;
+    memcpy(&Scale, &ScaleBits, sizeof(Scale));
+    return Power * Scale;
+}
+
+function void
+FilterTile(const denoise_job *Job, const tile &Tile)
+{
+    const denoiser       *Denoiser = Job->Denoiser;
+    const feature_buffer *Features = Job->FeatureBuffer;
+    u32 Width  = Denoiser->Width;
+    u32 Height = Denoiser->Height;
+    i32 Step   = (i32)Job->StepSize;
+
+    // note(harlequin): the kernel weight and the depth tolerance of every tap only depend on the step
+    f32 TapWeights[5][5];
+    f32 TapDepthScales[5][5];
+    for (i32 TapY = -2; TapY <= 2; TapY++)
+    {
+        for (i32 TapX = -2; TapX <= 2; TapX++)
+        {
+            f32 PixelDistance = (f32)Step * SquareRoot((f32)(TapX * TapX + TapY * TapY));
+            TapWeights[TapY + 2][TapX + 2]     = DenoiseKernel[TapX + 2] * DenoiseKernel[TapY + 2];
+            TapDepthScales[TapY + 2][TapX + 2] = PixelDistance > 0.0f ? 1.0f / (Job->DepthSigma * PixelDistance) : 0.0f;
+        }
+    }
+
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        for (u32 X = Tile.MinX; X < Tile.MaxX; X++)
+        {
+            u32 PixelIndex = GetPixelIndex(X, Y, Width);
+            f32 CenterLuminance    = Job->SourceLuminance[PixelIndex];
+            v3  CenterNormal       = Features->Normal[PixelIndex];
+            f32 CenterDepth        = Features->Depth[PixelIndex];
+            f32 CenterInverseDepth = Denoiser->InverseDepth[PixelIndex];
+            v3  CenterAlbedo       = Features->Albedo[PixelIndex];
+            f32 OneOverColorSigma  = 1.0f / (Job->ColorSigma * Denoiser->Noise[PixelIndex] + 1e-4f);
+
+            v3  Sum       = V3(0.0f);
+            f32 WeightSum = 0.0f;
+            for (i32 TapY = -2; TapY <= 2; TapY++)
+            {
+                i32 SampleY = (i32)Y + TapY * Step;
+                if (SampleY < 0 || SampleY >= (i32)Height)
+                {
+                    continue;
+                }
+
+                for (i32 TapX = -2; TapX <= 2; TapX++)
+                {
+                    i32 SampleX = (i32)X + TapX * Step;
+                    if (SampleX < 0 || SampleX >= (i32)Width)
+                    {
+                        continue;
+                    }
+
+                    u32 SampleIndex = GetPixelIndex((u32)SampleX, (u32)SampleY, Width);
+
+                    // note(harlequin): exp(-k (1 - dot)) falls off like dot^k near 1 and folds into the one exp
+                    f32 NormalDot = Dot(CenterNormal, Features->Normal[SampleIndex]);
+                    if (NormalDot <= 0.0f)
+                    {
+                        continue;
+                    }
+                    f32 NormalDistance = Job->NormalPower * (1.0f - NormalDot);
+
+                    f32 LuminanceDistance = fabsf(Job->SourceLuminance[SampleIndex] - CenterLuminance) * OneOverColorSigma;
+
+                    // note(harlequin): the tolerance scales with the closer of the two depths
+                    f32 SampleInverseDepth = Denoiser->InverseDepth[SampleIndex];
+                    f32 CloserInverseDepth = SampleInverseDepth > CenterInverseDepth ? SampleInverseDepth : CenterInverseDepth;
+                    f32 DepthDistance = fabsf(Features->Depth[SampleIndex] - CenterDepth) * CloserInverseDepth * TapDepthScales[TapY + 2][TapX + 2];
+
+                    v3  AlbedoDelta    = Features->Albedo[SampleIndex] - CenterAlbedo;
+                    f32 AlbedoDistance = Dot(AlbedoDelta, AlbedoDelta) * Job->OneOverAlbedoSigmaSquared;
+
+                    // note(harlequin): taps this far away weigh less than 1e-9
+                    f32 Distance = LuminanceDistance + NormalDistance + DepthDistance + AlbedoDistance;
+                    if (Distance > DENOISE_MAX_DISTANCE)
+                    {
+                        continue;
+                    }
+
+                    f32 Weight = TapWeights[TapY + 2][TapX + 2] * ApproximateExp(-Distance);
+                    Sum       += Job->Source[SampleIndex] * Weight;
+                    WeightSum += Weight;
+                }
+            }
+
+            // note(harlequin): the center tap always has a weight of 9/64, so WeightSum is never 0
+            v3 Filtered = Sum / WeightSum;
+            Job->Destination[PixelIndex]          = Filtered;
+            Job->DestinationLuminance[PixelIndex] = GetLuminance(Filtered);
+        }
+    }
+}
+
+function void
+ResolveTile(const denoise_job *Job, const tile &Tile)
+{
+    u32 Width = Job->Denoiser->Width;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        u32 PixelIndex = GetPixelIndex(Tile.MinX, Y, Width);
+        ResolvePixels(Job->Source + PixelIndex, nullptr, Job->FrameBuffer->Pixels + PixelIndex, Tile.MaxX - Tile.MinX,
+                      Job->Tonemapper);
+    }
+}
+
+function void
+DenoiseTile(void *Data, const tile &Tile)
+{
+    const denoise_job *Job = (const denoise_job *)Data;
+    switch (Job->Stage)
+    {
+        case DenoiseStage_Prepare:       PrepareTile(Job, Tile);       break;
+        case DenoiseStage_EstimateNoise: EstimateNoiseTile(Job, Tile); break;
+        case DenoiseStage_Filter:        FilterTile(Job, Tile);        break;
+        case DenoiseStage_Resolve:       ResolveTile(Job, Tile);       break;
+    }
+}
+
+function bool
+ResizeDenoiser(denoiser *Denoiser, u32 Width, u32 Height)
+{
+    if (Denoiser->Width == Width && Denoiser->Height == Height && Denoiser->Noise)
+    {
+        return true;
+    }
+
+    u64 PixelCount = (u64)Width * Height;
+    for (u32 BufferIndex = 0; BufferIndex < ArrayCount(Denoiser->Radiance); BufferIndex++)
+    {
+        v3 *Radiance = (v3 *)_aligned_realloc(Denoiser->Radiance[BufferIndex], sizeof(v3) * PixelCount, alignof(v3));
+        if (!Radiance)
+        {
+            return false;
+        }
+        Denoiser->Radiance[BufferIndex] = Radiance;
+    }
+
+    f32 **ScalarBuffers[] =
+    {
+        &Denoiser->Luminance[0],
+        &Denoiser->Luminance[1],
+        &Denoiser->InverseDepth,
+        &Denoiser->Variance,
+        &Denoiser->Noise,
+    };
+    for (u32 BufferIndex = 0; BufferIndex < ArrayCount(ScalarBuffers); BufferIndex++)
+    {
+        f32 *Buffer = (f32 *)_aligned_realloc(*ScalarBuffers[BufferIndex], sizeof(f32) * PixelCount, 64);
+        if (!Buffer)
+        {
+            return false;
+        }
+        *ScalarBuffers[BufferIndex] = Buffer;
+    }
+
+    Denoiser->Width  = Width;
+    Denoiser->Height = Height;
+    return true;
+}
+
+bool
+DenoiseFrame(job_system             *JobSystem,
+             denoiser               *Denoiser,
+             const denoise_settings &Settings,
+             const frame_buffer     *AccumulationFrameBuffer,
+             const sample_buffer    *SampleBuffer,
+             const feature_buffer   *FeatureBuffer,
+             frame_buffer           *FrameBuffer)
+{
+    PROFILE_SCOPE("DenoiseFrame");
+    u32 Width  = FrameBuffer->Width;
+    u32 Height = FrameBuffer->Height;
+    Assert(AccumulationFrameBuffer->Width == Width && AccumulationFrameBuffer->Height == Height);
+    Assert(SampleBuffer->Width == Width && SampleBuffer->Height == Height);
+    Assert(FeatureBuffer->Width == Width && FeatureBuffer->Height == Height);
+
+    if (!ResizeDenoiser(Denoiser, Width, Height))
+    {
+        fprintf(stderr, "failed to allocate the denoiser buffers\n");
+        return false;
+    }
+
+    denoise_job Job = {};
+    Job.Denoiser                  = Denoiser;
+    Job.AccumulationFrameBuffer   = AccumulationFrameBuffer;
+    Job.SampleBuffer              = SampleBuffer;
+    Job.FeatureBuffer             = FeatureBuffer;
+    Job.FrameBuffer               = FrameBuffer;
+    Job.NormalPower               = Settings.NormalPower;
+    Job.DepthSigma                = Settings.DepthSigma;
+    Job.OneOverAlbedoSigmaSquared = 1.0f / (Settings.AlbedoSigma * Settings.AlbedoSigma);
+    Job.Tonemapper                = Settings.Tonemapper;
+
+    Job.Stage                = DenoiseStage_Prepare;
+    Job.Destination          = Denoiser->Radiance[0];
+    Job.DestinationLuminance = Denoiser->Luminance[0];
+    if (!RunTilePass(JobSystem, Width, Height, DenoiseTile, &Job))
+    {
+        return false;
+    }
+
+    Job.Stage = DenoiseStage_EstimateNoise;
+    if (!RunTilePass(JobSystem, Width, Height, DenoiseTile, &Job))
+    {
+        return false;
+    }
+
+    // note(harlequin): every iteration reads the whole previous one, so each is a pass of its own
+    u32 IterationCount = Settings.IterationCount < DENOISE_MAX_ITERATION_COUNT ? Settings.IterationCount : DENOISE_MAX_ITERATION_COUNT;
+    u32 SourceIndex = 0;
+    Job.Stage      = DenoiseStage_Filter;
+    Job.ColorSigma = Settings.ColorSigma;
+    for (u32 Iteration = 0; Iteration < IterationCount; Iteration++)
+    {
+        Job.Source               = Denoiser->Radiance[SourceIndex];
+        Job.SourceLuminance      = Denoiser->Luminance[SourceIndex];
+        Job.Destination          = Denoiser->Radiance[SourceIndex ^ 1];
+        Job.DestinationLuminance = Denoiser->Luminance[SourceIndex ^ 1];
+        Job.StepSize             = 1u << Iteration;
+        if (!RunTilePass(JobSystem, Width, Height, DenoiseTile, &Job))
+        {
+            return false;
+        }
+        SourceIndex ^= 1;
+        Job.ColorSigma *= 0.5f;
+    }
+
+    Job.Stage  = DenoiseStage_Resolve;
+    Job.Source = Denoiser->Radiance[SourceIndex];
+    return RunTilePass(JobSystem, Width, Height, DenoiseTile, &Job);
+}
+
+void
+FreeDenoiser(denoiser *Denoiser)
+{
+    for (u32 BufferIndex = 0; BufferIndex < ArrayCount(Denoiser->Radiance); BufferIndex++)
+    {
+        _aligned_free(Denoiser->Radiance[BufferIndex]);
+        _aligned_free(Denoiser->Luminance[BufferIndex]);
+    }
+    _aligned_free(Denoiser->InverseDepth);
+    _aligned_free(Denoiser->Variance);
+    _aligned_free(Denoiser->Noise);
+    *Denoiser = {};
+}
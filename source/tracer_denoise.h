@@ -0,0 +1,65 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_framebuffer.h"
+
+struct job_system;
+
+// note(harlequin): edge avoiding a-trous wavelet filter (dammertz et al. 2010) over the mean radiance, the 5x5
+// b3 spline kernel runs IterationCount times with its taps twice as far apart every time. the taps are
+// weighted by how close their normal, depth and albedo are to the center and by how far their luminance is
+// from it in units of the standard error around the center, so edges in the features survive and converged
+// pixels are barely touched. the materials have no textures, so the radiance is filtered without dividing
+// out the albedo first
+
+#define DENOISE_MAX_ITERATION_COUNT 8
+
+struct denoise_settings
+{
+    u32        IterationCount; // the footprint is 4 * (2^IterationCount - 1) + 1 pixels wide
+    f32        ColorSigma;     // in standard errors of the center pixel, halved every iteration
+    f32        NormalPower;
+    f32        DepthSigma;     // relative to the depth of the closer pixel, per pixel of distance
+    f32        AlbedoSigma;
+    tonemapper Tonemapper;     // of the denoised image, the same as the one of the trace settings
+};
+
+inline denoise_settings
+DefaultDenoiseSettings()
+{
+    denoise_settings Result;
+    Result.IterationCount = 5;
+    Result.ColorSigma     = 4.0f;
+    Result.NormalPower    = 64.0f;
+    Result.DepthSigma     = 0.02f;
+    Result.AlbedoSigma    = 0.1f;
+    Result.Tonemapper     = Tonemapper_Clamp;
+    return Result;
+}
+
+// note(harlequin): scratch images of the filter, sized by the first DenoiseFrame and resized with the frame
+struct denoiser
+{
+    u32  Width;
+    u32  Height;
+    v3  *Radiance[2];
+    f32 *Luminance[2];  // of Radiance, the filter reads it once per tap
+    f32 *InverseDepth;
+    f32 *Variance;      // of the mean luminance
+    f32 *Noise;         // standard error of the mean luminance, from the variance around the pixel
+};
+
+// writes the denoised mean of AccumulationFrameBuffer to FrameBuffer, the accumulation itself is left alone
+// so the render can keep converging. FeatureBuffer has to have been passed to every TraceFrame since the restart
+function bool
+DenoiseFrame(job_system             *JobSystem,
+             denoiser               *Denoiser,
+             const denoise_settings &Settings,
+             const frame_buffer     *AccumulationFrameBuffer,
+             const sample_buffer    *SampleBuffer,
+             const feature_buffer   *FeatureBuffer,
+             frame_buffer           *FrameBuffer);
+
+function void
+FreeDenoiser(denoiser *Denoiser);
@@ -0,0 +1,733 @@
+#include "tracer_distributed.h"
+
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_handle;
+#define INVALID_SOCKET_HANDLE INVALID_SOCKET
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+typedef int socket_handle;
+#define INVALID_SOCKET_HANDLE -1
+#endif
+
+// note(harlequin): a send to a worker that died has to fail instead of raising sigpipe
+#ifdef MSG_NOSIGNAL
+#define SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SOCKET_SEND_FLAGS 0
+#endif
+
+#define DISTRIBUTED_FEATURE_COUNT   7
+#define DISTRIBUTED_CONNECT_SECONDS 30 // workers can be started before the coordinator
+#define DISTRIBUTED_MAX_CHUNK_SIZE  (1 << 30)
+
+function bool
+InitializeSockets()
+{
+#ifdef _WIN32
+    WSADATA Data;
+    if (WSAStartup(MAKEWORD(2, 2), &Data) != 0)
+    {
+        fprintf(stderr, "failed to initialize winsock\n");
+        return false;
+    }
+#endif
+    return true;
+}
+
+function void
+ShutdownSockets()
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+function void
+CloseSocket(socket_handle Socket)
+{
+#ifdef _WIN32
+    closesocket(Socket);
+#else
+    close(Socket);
+#endif
+}
+
+// note(harlequin): no receive timeout, the coordinator only receives what select says is there and keeps its own
+// deadlines, a worker waits for as long as the last units take on the others
+function void
+ConfigureSocket(socket_handle Socket)
+{
+    int Enabled = 1;
+    setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&Enabled, sizeof(Enabled));
+    setsockopt(Socket, SOL_SOCKET, SO_KEEPALIVE, (const char *)&Enabled, sizeof(Enabled));
+#ifdef SO_NOSIGPIPE
+    setsockopt(Socket, SOL_SOCKET, SO_NOSIGPIPE, (const char *)&Enabled, sizeof(Enabled));
+#endif
+}
+
+function bool
+SendAll(socket_handle Socket, const void *Data, u64 Size)
+{
+    const char *Byte = (const char *)Data;
+    while (Size)
+    {
+        int ChunkSize = (int)(Size < DISTRIBUTED_MAX_CHUNK_SIZE ? Size : DISTRIBUTED_MAX_CHUNK_SIZE);
+        int SentSize = (int)send(Socket, Byte, ChunkSize, SOCKET_SEND_FLAGS);
+        if (SentSize <= 0)
+        {
+            return false;
+        }
+        Byte += SentSize;
+        Size -= (u64)SentSize;
+    }
+    return true;
+}
+
+// false on a closed connection or an error
+function bool
+ReceiveAll(socket_handle Socket, void *Data, u64 Size)
+{
+    char *Byte = (char *)Data;
+    while (Size)
+    {
+        int ChunkSize = (int)(Size < DISTRIBUTED_MAX_CHUNK_SIZE ? Size : DISTRIBUTED_MAX_CHUNK_SIZE);
+        int ReceivedSize = (int)recv(Socket, Byte, ChunkSize, 0);
+        if (ReceivedSize <= 0)
+        {
+            return false;
+        }
+        Byte += ReceivedSize;
+        Size -= (u64)ReceivedSize;
+    }
+    return true;
+}
+
+function bool
+SendMessage(socket_handle Socket, distributed_message Message)
+{
+    Message.Magic   = DISTRIBUTED_MAGIC;
+    Message.Version = DISTRIBUTED_VERSION;
+    return SendAll(Socket, &Message, sizeof(Message));
+}
+
+function bool
+ReceiveMessage(socket_handle Socket, distributed_message *Message)
+{
+    return ReceiveAll(Socket, Message, sizeof(*Message)) &&
+           Message->Magic == DISTRIBUTED_MAGIC &&
+           Message->Version == DISTRIBUTED_VERSION;
+}
+
+function socket_handle
+OpenListenSocket(u16 Port)
+{
+    socket_handle Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Socket == INVALID_SOCKET_HANDLE)
+    {
+        fprintf(stderr, "failed to create the coordinator socket\n");
+        return INVALID_SOCKET_HANDLE;
+    }
+
+    int Enabled = 1;
+    setsockopt(Socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&Enabled, sizeof(Enabled));
+
+    sockaddr_in Address = {};
+    Address.sin_family      = AF_INET;
+    Address.sin_port        = htons(Port);
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(Socket, (const sockaddr *)&Address, sizeof(Address)) != 0 ||
+        listen(Socket, DISTRIBUTED_MAX_WORKER_COUNT) != 0)
+    {
+        fprintf(stderr, "failed to listen on port %u\n", (u32)Port);
+        CloseSocket(Socket);
+        return INVALID_SOCKET_HANDLE;
+    }
+    return Socket;
+}
+
+function socket_handle
+ConnectToCoordinator(const char *Address)
+{
+    char Host[256];
+    const char *Colon = strrchr(Address, ':');
+    u64 HostLength = Colon ? (u64)(Colon - Address) : 0;
+    if (!Colon || !HostLength || HostLength >= sizeof(Host) || !Colon[1])
+    {
+        fprintf(stderr, "the coordinator address %s is not host:port\n", Address);
+        return INVALID_SOCKET_HANDLE;
+    }
+    memcpy(Host, Address, HostLength);
+    Host[HostLength] = 0;
+
+    addrinfo Hints = {};
+    Hints.ai_family   = AF_UNSPEC;
+    Hints.ai_socktype = SOCK_STREAM;
+    Hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo *AddressList = nullptr;
+    if (getaddrinfo(Host, Colon + 1, &Hints, &AddressList) != 0)
+    {
+        fprintf(stderr, "failed to resolve %s\n", Address);
+        return INVALID_SOCKET_HANDLE;
+    }
+
+    auto StartTime = std::chrono::steady_clock::now();
+    socket_handle Socket = INVALID_SOCKET_HANDLE;
+    for (;;)
+    {
+        for (addrinfo *Info = AddressList; Info && Socket == INVALID_SOCKET_HANDLE; Info = Info->ai_next)
+        {
+            Socket = socket(Info->ai_family, Info->ai_socktype, Info->ai_protocol);
+            if (Socket != INVALID_SOCKET_HANDLE && connect(Socket, Info->ai_addr, (int)Info->ai_addrlen) != 0)
+            {
+                CloseSocket(Socket);
+                Socket = INVALID_SOCKET_HANDLE;
+            }
+        }
+
+        f64 WaitedSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - StartTime).count();
+        if (Socket != INVALID_SOCKET_HANDLE || WaitedSeconds >= DISTRIBUTED_CONNECT_SECONDS)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+    freeaddrinfo(AddressList);
+
+    if (Socket == INVALID_SOCKET_HANDLE)
+    {
+        fprintf(stderr, "failed to connect to the coordinator at %s\n", Address);
+    }
+    return Socket;
+}
+
+function u64
+GetUnitPayloadSize(u32 Width, u32 RowCount, bool GatherFeatures)
+{
+    u64 PixelCount = (u64)Width * RowCount;
+    u64 Size = PixelCount * (sizeof(f32) * 3 + sizeof(pixel_statistics));
+    if (GatherFeatures)
+    {
+        Size += PixelCount * sizeof(f32) * DISTRIBUTED_FEATURE_COUNT;
+    }
+    return Size;
+}
+
+// note(harlequin): 3 floats a color, so simd and scalar builds can work on the same render
+function void
+PackUnit(u8                   *Payload,
+         const frame_buffer   *AccumulationFrameBuffer,
+         const sample_buffer  *SampleBuffer,
+         const feature_buffer *FeatureBuffer)
+{
+    u32 PixelCount = AccumulationFrameBuffer->Width * AccumulationFrameBuffer->Height;
+
+    f32 *Accumulation = (f32 *)Payload;
+    for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+    {
+        const v3 &Color = AccumulationFrameBuffer->Pixels[PixelIndex];
+        *Accumulation++ = VectorComponent(Color, 0);
+        *Accumulation++ = VectorComponent(Color, 1);
+        *Accumulation++ = VectorComponent(Color, 2);
+    }
+    memcpy(Accumulation, SampleBuffer->Pixels, sizeof(pixel_statistics) * PixelCount);
+
+    if (FeatureBuffer)
+    {
+        f32 *Features = (f32 *)((pixel_statistics *)Accumulation + PixelCount);
+        for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+        {
+            const v3 &Albedo = FeatureBuffer->Albedo[PixelIndex];
+            const v3 &Normal = FeatureBuffer->Normal[PixelIndex];
+            *Features++ = VectorComponent(Albedo, 0);
+            *Features++ = VectorComponent(Albedo, 1);
+            *Features++ = VectorComponent(Albedo, 2);
+            *Features++ = VectorComponent(Normal, 0);
+            *Features++ = VectorComponent(Normal, 1);
+            *Features++ = VectorComponent(Normal, 2);
+            *Features++ = FeatureBuffer->Depth[PixelIndex];
+        }
+    }
+}
+
+// copies a unit into the rows starting at FirstRow of the whole image buffers
+function void
+UnpackUnit(const u8       *Payload,
+           u32             FirstRow,
+           u32             RowCount,
+           frame_buffer   *AccumulationFrameBuffer,
+           sample_buffer  *SampleBuffer,
+           feature_buffer *FeatureBuffer)
+{
+    u32 PixelCount = AccumulationFrameBuffer->Width * RowCount;
+    u32 FirstPixel = AccumulationFrameBuffer->Width * FirstRow;
+
+    const f32 *Accumulation = (const f32 *)Payload;
+    for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++, Accumulation += 3)
+    {
+        AccumulationFrameBuffer->Pixels[FirstPixel + PixelIndex] = V3(Accumulation[0], Accumulation[1], Accumulation[2]);
+    }
+    memcpy(SampleBuffer->Pixels + FirstPixel, Accumulation, sizeof(pixel_statistics) * PixelCount);
+
+    if (FeatureBuffer)
+    {
+        const f32 *Features = (const f32 *)((const pixel_statistics *)Accumulation + PixelCount);
+        for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++, Features += DISTRIBUTED_FEATURE_COUNT)
+        {
+            FeatureBuffer->Albedo[FirstPixel + PixelIndex] = V3(Features[0], Features[1], Features[2]);
+            FeatureBuffer->Normal[FirstPixel + PixelIndex] = V3(Features[3], Features[4], Features[5]);
+            FeatureBuffer->Depth[FirstPixel + PixelIndex]  = Features[6];
+        }
+    }
+}
+
+enum unit_state
+{
+    UnitState_Queued,
+    UnitState_Assigned,
+    UnitState_Done,
+};
+
+// note(harlequin): a worker is not handed units until its hello arrived with the right hash. a message comes in
+// over as many selects as it takes, the header first and then the payload of a result, so a worker that sends
+// slowly never holds up the others
+struct worker_connection
+{
+    socket_handle Socket;
+    bool          Greeted;
+    i32           UnitIndex; // -1 while it has none
+    u32           UnitCount;
+    std::chrono::steady_clock::time_point Deadline; // for the hello, the unit or the rest of a message, whichever it owes
+
+    distributed_message Message;
+    bool                ReceivingPayload; // the header of a result is in, its payload is not
+    u64                 ReceivedSize;     // of Message, or of the payload once ReceivingPayload is set
+    u8                 *Payload;          // room for the largest unit, allocated with its first result
+};
+
+inline std::chrono::steady_clock::time_point
+GetDeadline(f64 Seconds)
+{
+    return std::chrono::steady_clock::now() +
+           std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< f64 >(Seconds));
+}
+
+// a worker only has a deadline while the coordinator waits on it, a greeted one without a unit owes nothing
+inline bool
+IsWorkerOwing(const worker_connection *Worker)
+{
+    return !Worker->Greeted || Worker->UnitIndex >= 0 || Worker->ReceivingPayload || Worker->ReceivedSize;
+}
+
+function void
+DropWorker(worker_connection *Worker, u8 *UnitStates, u32 *QueuedCount, const char *Reason)
+{
+    if (Worker->UnitIndex >= 0)
+    {
+        UnitStates[Worker->UnitIndex] = UnitState_Queued;
+        (*QueuedCount)++;
+    }
+    fprintf(stderr, "\nworker dropped after %u units, %s\n", Worker->UnitCount, Reason);
+    CloseSocket(Worker->Socket);
+    free(Worker->Payload);
+    Worker->Socket           = INVALID_SOCKET_HANDLE;
+    Worker->UnitIndex        = -1;
+    Worker->ReceivingPayload = false;
+    Worker->ReceivedSize     = 0;
+    Worker->Payload          = nullptr;
+}
+
+// the first queued unit goes to Worker, false if the send failed
+function bool
+AssignUnit(worker_connection          *Worker,
+           const distributed_settings &Settings,
+           u8                         *UnitStates,
+           u32                         UnitCount,
+           u32                        *QueuedCount)
+{
+    for (u32 UnitIndex = 0; UnitIndex < UnitCount; UnitIndex++)
+    {
+        if (UnitStates[UnitIndex] != UnitState_Queued)
+        {
+            continue;
+        }
+
+        u32 FirstRow = UnitIndex * Settings.UnitHeight;
+        distributed_message Message = {};
+        Message.Type               = DistributedMessage_Work;
+        Message.FirstRow           = FirstRow;
+        Message.RowCount           = Settings.Height - FirstRow < Settings.UnitHeight ? Settings.Height - FirstRow : Settings.UnitHeight;
+        Message.SampleCount        = Settings.SampleCount;
+        Message.TargetError        = Settings.TargetError;
+        Message.MinimumSampleCount = Settings.MinimumSampleCount;
+        Message.GatherFeatures     = Settings.GatherFeatures;
+
+        UnitStates[UnitIndex] = UnitState_Assigned;
+        (*QueuedCount)--;
+        Worker->UnitIndex = (i32)UnitIndex;
+        Worker->Deadline  = GetDeadline(Settings.UnitSeconds);
+        return SendMessage(Worker->Socket, Message);
+    }
+    return true;
+}
+
+bool
+RunCoordinator(u16                         Port,
+               const distributed_settings &Settings,
+               frame_buffer               *AccumulationFrameBuffer,
+               sample_buffer              *SampleBuffer,
+               feature_buffer             *FeatureBuffer,
+               u64                        *OutRayCount)
+{
+    Assert(Settings.UnitHeight);
+    Assert(AccumulationFrameBuffer->Width == Settings.Width && AccumulationFrameBuffer->Height == Settings.Height);
+    Assert(!Settings.GatherFeatures || FeatureBuffer);
+
+    if (!InitializeSockets())
+    {
+        return false;
+    }
+    socket_handle ListenSocket = OpenListenSocket(Port);
+    if (ListenSocket == INVALID_SOCKET_HANDLE)
+    {
+        ShutdownSockets();
+        return false;
+    }
+
+    u32 UnitCount   = (Settings.Height + Settings.UnitHeight - 1) / Settings.UnitHeight;
+    u32 QueuedCount = UnitCount;
+    u32 DoneCount   = 0;
+    u8 *UnitStates  = (u8 *)calloc(UnitCount, sizeof(u8));
+    if (!UnitStates)
+    {
+        fprintf(stderr, "failed to allocate the coordinator\n");
+        CloseSocket(ListenSocket);
+        ShutdownSockets();
+        return false;
+    }
+    u64 MaxPayloadSize = GetUnitPayloadSize(Settings.Width, Settings.UnitHeight, Settings.GatherFeatures);
+
+    worker_connection Workers[DISTRIBUTED_MAX_WORKER_COUNT];
+    u32 WorkerCount = 0;
+    u64 RayCount    = 0;
+
+    fprintf(stderr, "waiting for workers on port %u, %u units of %u rows\n", (u32)Port, UnitCount, Settings.UnitHeight);
+
+    while (DoneCount < UnitCount)
+    {
+        fd_set ReadSet;
+        FD_ZERO(&ReadSet);
+        FD_SET(ListenSocket, &ReadSet);
+        socket_handle LargestSocket = ListenSocket;
+        for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++)
+        {
+            FD_SET(Workers[WorkerIndex].Socket, &ReadSet);
+            LargestSocket = Workers[WorkerIndex].Socket > LargestSocket ? Workers[WorkerIndex].Socket : LargestSocket;
+        }
+
+        timeval Timeout = {};
+        Timeout.tv_sec = 1;
+        int ReadyCount = select((int)LargestSocket + 1, &ReadSet, nullptr, nullptr, &Timeout);
+        if (ReadyCount < 0)
+        {
+            fprintf(stderr, "\nfailed to wait on the worker sockets\n");
+            break;
+        }
+
+        if (FD_ISSET(ListenSocket, &ReadSet))
+        {
+            socket_handle Socket = accept(ListenSocket, nullptr, nullptr);
+            if (Socket != INVALID_SOCKET_HANDLE && WorkerCount < DISTRIBUTED_MAX_WORKER_COUNT)
+            {
+                ConfigureSocket(Socket);
+                worker_connection *Worker = Workers + WorkerCount++;
+                *Worker = {};
+                Worker->Socket    = Socket;
+                Worker->UnitIndex = -1;
+                Worker->Deadline  = GetDeadline(DISTRIBUTED_HELLO_SECONDS);
+            }
+            else if (Socket != INVALID_SOCKET_HANDLE)
+            {
+                fprintf(stderr, "\nturned a worker away, there are already %u\n", WorkerCount);
+                CloseSocket(Socket);
+            }
+        }
+
+        for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++)
+        {
+            worker_connection *Worker = Workers + WorkerIndex;
+            if (!FD_ISSET(Worker->Socket, &ReadSet))
+            {
+                continue;
+            }
+
+            // note(harlequin): one recv of what select says is there, the rest of the message comes with a later select
+            u8 *Target     = Worker->ReceivingPayload ? Worker->Payload : (u8 *)&Worker->Message;
+            u64 TargetSize = Worker->ReceivingPayload ? GetUnitPayloadSize(Settings.Width, Worker->Message.RowCount, Settings.GatherFeatures) : sizeof(Worker->Message);
+            u64 LeftSize   = TargetSize - Worker->ReceivedSize;
+            int ChunkSize  = (int)(LeftSize < DISTRIBUTED_MAX_CHUNK_SIZE ? LeftSize : DISTRIBUTED_MAX_CHUNK_SIZE);
+            int ReceivedSize = (int)recv(Worker->Socket, (char *)Target + Worker->ReceivedSize, ChunkSize, 0);
+            if (ReceivedSize <= 0)
+            {
+                DropWorker(Worker, UnitStates, &QueuedCount,
+                           Worker->ReceivingPayload ? "it stopped in the middle of a unit" : "it disconnected");
+                continue;
+            }
+            Worker->ReceivedSize += (u64)ReceivedSize;
+            if (Worker->ReceivedSize < TargetSize)
+            {
+                Worker->Deadline = GetDeadline(DISTRIBUTED_RECEIVE_SECONDS);
+                continue;
+            }
+            Worker->ReceivedSize = 0;
+
+            const distributed_message &Message = Worker->Message;
+            if (Worker->ReceivingPayload)
+            {
+                u32 FirstRow = Message.FirstRow;
+                u32 RowCount = Message.RowCount;
+                UnpackUnit(Worker->Payload, FirstRow, RowCount,
+                           AccumulationFrameBuffer, SampleBuffer, Settings.GatherFeatures ? FeatureBuffer : nullptr);
+                UnitStates[Worker->UnitIndex] = UnitState_Done;
+                Worker->ReceivingPayload = false;
+                Worker->UnitIndex        = -1;
+                Worker->UnitCount++;
+                RayCount += Message.Value;
+                DoneCount++;
+            }
+            else if (Message.Magic != DISTRIBUTED_MAGIC || Message.Version != DISTRIBUTED_VERSION)
+            {
+                DropWorker(Worker, UnitStates, &QueuedCount, "it broke the protocol");
+            }
+            else if (Message.Type == DistributedMessage_Hello && !Worker->Greeted)
+            {
+                if (Message.Value != Settings.RenderHash)
+                {
+                    DropWorker(Worker, UnitStates, &QueuedCount, "its scene, camera or settings differ");
+                    continue;
+                }
+                Worker->Greeted = true;
+            }
+            else if (Message.Type == DistributedMessage_Result && Worker->UnitIndex >= 0)
+            {
+                u32 FirstRow = (u32)Worker->UnitIndex * Settings.UnitHeight;
+                u32 RowCount = Settings.Height - FirstRow < Settings.UnitHeight ? Settings.Height - FirstRow : Settings.UnitHeight;
+                if (Message.FirstRow != FirstRow || Message.RowCount != RowCount)
+                {
+                    DropWorker(Worker, UnitStates, &QueuedCount, "it sent rows it was not given");
+                    continue;
+                }
+                if (!Worker->Payload)
+                {
+                    Worker->Payload = (u8 *)malloc(MaxPayloadSize);
+                    if (!Worker->Payload)
+                    {
+                        DropWorker(Worker, UnitStates, &QueuedCount, "there is no memory for its unit");
+                        continue;
+                    }
+                }
+                Worker->ReceivingPayload = true;
+                Worker->Deadline         = GetDeadline(DISTRIBUTED_RECEIVE_SECONDS);
+            }
+            else
+            {
+                DropWorker(Worker, UnitStates, &QueuedCount, "it broke the protocol");
+            }
+        }
+
+        // note(harlequin): a worker that hangs or never says hello would keep its unit or its slot forever
+        auto Now = std::chrono::steady_clock::now();
+        for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++)
+        {
+            worker_connection *Worker = Workers + WorkerIndex;
+            if (Worker->Socket == INVALID_SOCKET_HANDLE || !IsWorkerOwing(Worker) || Now < Worker->Deadline)
+            {
+                continue;
+            }
+            const char *Reason = !Worker->Greeted                                 ? "it sent no hello in time" :
+                                 Worker->ReceivingPayload || Worker->ReceivedSize ? "it stalled in the middle of a message" :
+                                                                                    "it held its unit past the deadline";
+            DropWorker(Worker, UnitStates, &QueuedCount, Reason);
+        }
+
+        // note(harlequin): the units of dropped workers go to the next idle one
+        for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++)
+        {
+            worker_connection *Worker = Workers + WorkerIndex;
+            if (Worker->Socket != INVALID_SOCKET_HANDLE && Worker->Greeted && Worker->UnitIndex < 0 && QueuedCount &&
+                !AssignUnit(Worker, Settings, UnitStates, UnitCount, &QueuedCount))
+            {
+                DropWorker(Worker, UnitStates, &QueuedCount, "it could not be sent its unit");
+            }
+        }
+
+        u32 LiveCount = 0;
+        for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++)
+        {
+            if (Workers[WorkerIndex].Socket != INVALID_SOCKET_HANDLE)
+            {
+                Workers[LiveCount++] = Workers[WorkerIndex];
+            }
+        }
+        WorkerCount = LiveCount;
+
+        fprintf(stderr, "\r%u/%u units, %u workers   ", DoneCount, UnitCount, WorkerCount);
+        fflush(stderr);
+    }
+
+    distributed_message Message = {};
+    Message.Type = DistributedMessage_Done;
+    for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++)
+    {
+        SendMessage(Workers[WorkerIndex].Socket, Message);
+        CloseSocket(Workers[WorkerIndex].Socket);
+        free(Workers[WorkerIndex].Payload);
+    }
+    CloseSocket(ListenSocket);
+    ShutdownSockets();
+
+    free(UnitStates);
+    *OutRayCount = RayCount;
+    return DoneCount == UnitCount;
+}
+
+bool
+RunWorker(const char                 *Address,
+          const distributed_settings &Settings,
+          trace_unit_function        *TraceUnit,
+          void                       *Data)
+{
+    if (!InitializeSockets())
+    {
+        return false;
+    }
+    socket_handle Socket = ConnectToCoordinator(Address);
+    if (Socket == INVALID_SOCKET_HANDLE)
+    {
+        ShutdownSockets();
+        return false;
+    }
+    ConfigureSocket(Socket);
+
+    distributed_message Hello = {};
+    Hello.Type  = DistributedMessage_Hello;
+    Hello.Value = Settings.RenderHash;
+
+    frame_buffer   AccumulationFrameBuffer = {};
+    sample_buffer  SampleBuffer            = {};
+    feature_buffer FeatureBuffer           = {};
+    u8            *Payload                 = nullptr;
+    u64            PayloadSize             = 0;
+    u32            UnitCount               = 0;
+
+    bool Success = SendMessage(Socket, Hello);
+    bool Done    = false;
+    while (Success && !Done)
+    {
+        distributed_message Message;
+        if (!ReceiveMessage(Socket, &Message))
+        {
+            fprintf(stderr, "\nthe coordinator closed the connection, it finished, went away or turned this worker away\n");
+            Success = false;
+            break;
+        }
+
+        if (Message.Type == DistributedMessage_Done)
+        {
+            Done = true;
+            continue;
+        }
+        if (Message.Type != DistributedMessage_Work || !Message.RowCount ||
+            Message.FirstRow + Message.RowCount > Settings.Height)
+        {
+            fprintf(stderr, "\nthe coordinator broke the protocol\n");
+            Success = false;
+            break;
+        }
+
+        u32 Width = Settings.Width;
+        if (!AccumulationFrameBuffer.Pixels)
+        {
+            InitializeFrameBuffer(&AccumulationFrameBuffer, Width, Message.RowCount);
+            InitializeSampleBuffer(&SampleBuffer, Width, Message.RowCount);
+        }
+        else if (AccumulationFrameBuffer.Height != Message.RowCount)
+        {
+            ResizeFrameBuffer(&AccumulationFrameBuffer, Width, Message.RowCount);
+            ResizeSampleBuffer(&SampleBuffer, Width, Message.RowCount);
+        }
+        if (Message.GatherFeatures && !FeatureBuffer.Albedo)
+        {
+            InitializeFeatureBuffer(&FeatureBuffer, Width, Message.RowCount);
+        }
+        else if (Message.GatherFeatures && FeatureBuffer.Height != Message.RowCount)
+        {
+            ResizeFeatureBuffer(&FeatureBuffer, Width, Message.RowCount);
+        }
+
+        u64 UnitPayloadSize = GetUnitPayloadSize(Width, Message.RowCount, Message.GatherFeatures != 0);
+        if (UnitPayloadSize > PayloadSize)
+        {
+            free(Payload);
+            Payload     = (u8 *)malloc(UnitPayloadSize);
+            PayloadSize = Payload ? UnitPayloadSize : 0;
+            if (!Payload)
+            {
+                fprintf(stderr, "failed to allocate a unit of %u rows\n", Message.RowCount);
+                Success = false;
+                break;
+            }
+        }
+
+        distributed_unit Unit;
+        Unit.FirstRow           = Message.FirstRow;
+        Unit.RowCount           = Message.RowCount;
+        Unit.SampleCount        = Message.SampleCount;
+        Unit.TargetError        = Message.TargetError;
+        Unit.MinimumSampleCount = Message.MinimumSampleCount;
+        Unit.GatherFeatures     = Message.GatherFeatures != 0;
+
+        feature_buffer *UnitFeatureBuffer = Unit.GatherFeatures ? &FeatureBuffer : nullptr;
+        u64 RayCount = TraceUnit(Data, Unit, &AccumulationFrameBuffer, &SampleBuffer, UnitFeatureBuffer);
+        PackUnit(Payload, &AccumulationFrameBuffer, &SampleBuffer, UnitFeatureBuffer);
+
+        distributed_message Result = {};
+        Result.Type     = DistributedMessage_Result;
+        Result.FirstRow = Message.FirstRow;
+        Result.RowCount = Message.RowCount;
+        Result.Value    = RayCount;
+        Success = SendMessage(Socket, Result) && SendAll(Socket, Payload, UnitPayloadSize);
+        if (!Success)
+        {
+            fprintf(stderr, "\nfailed to send rows %u to %u to the coordinator\n",
+                    Message.FirstRow, Message.FirstRow + Message.RowCount - 1);
+        }
+        UnitCount++;
+    }
+
+    if (Done)
+    {
+        fprintf(stderr, "\ntraced %u units\n", UnitCount);
+    }
+
+    free(Payload);
+    FreeFrameBuffer(&AccumulationFrameBuffer);
+    FreeSampleBuffer(&SampleBuffer);
+    FreeFeatureBuffer(&FeatureBuffer);
+    CloseSocket(Socket);
+    ShutdownSockets();
+    return Success;
+}
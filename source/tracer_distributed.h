@@ -0,0 +1,91 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_framebuffer.h"
+
+// note(harlequin): a coordinator process splits the image into units of full width rows and hands them to
+// worker processes over tcp, one unit per worker at a time. a worker traces its unit like a band of a local
+// render, so the pixels come out the same on any number of workers, and sends back the linear accumulation,
+// the pixel statistics and the first hit features, which the coordinator copies into its whole image buffers.
+// a worker that disconnects or holds its unit past its deadline gives the unit back to the queue, workers can
+// join at any time. every worker has to load the same scene with the same camera and trace settings, it sends
+// the hash of them when it connects and the coordinator turns it away if it differs
+
+#define DISTRIBUTED_MAGIC            0x44435254 // "TRCD"
+#define DISTRIBUTED_VERSION          1
+#define DISTRIBUTED_MAX_WORKER_COUNT 63         // select on windows watches 64 sockets, one is the listener
+#define DISTRIBUTED_RECEIVE_SECONDS  120        // a worker that stalls this long in the middle of a message is dropped
+#define DISTRIBUTED_HELLO_SECONDS    30         // a worker that connected and sent no hello for this long is dropped
+#define DISTRIBUTED_UNIT_SECONDS     600        // a worker that holds a unit this long is dropped unless set otherwise
+#define DISTRIBUTED_UNIT_HEIGHT      32         // rows of a unit unless --band-height says otherwise
+
+enum distributed_message_type
+{
+    DistributedMessage_Hello,  // worker to coordinator, Value is the render hash
+    DistributedMessage_Work,   // coordinator to worker, a unit to trace
+    DistributedMessage_Result, // worker to coordinator, Value is the ray count, the unit's pixels follow
+    DistributedMessage_Done,   // coordinator to worker, every unit is in
+};
+
+struct distributed_message
+{
+    u32 Magic;
+    u32 Version;
+    u32 Type;
+    u32 FirstRow;
+    u32 RowCount;
+    u32 SampleCount;        // the most samples a pixel of the unit gets
+    f32 TargetError;        // the unit stops once its error is below this, 0 is off
+    u32 MinimumSampleCount; // before the target error is trusted
+    u32 GatherFeatures;
+    u32 Reserved;
+    u64 Value;
+};
+
+struct distributed_unit
+{
+    u32  FirstRow;
+    u32  RowCount;
+    u32  SampleCount;
+    f32  TargetError;
+    u32  MinimumSampleCount;
+    bool GatherFeatures;
+};
+
+struct distributed_settings
+{
+    u64  RenderHash;     // HashRenderInputs, the same on the coordinator and every worker
+    u32  Width;
+    u32  Height;
+    u32  UnitHeight;     // rows of a unit
+    u32  SampleCount;
+    f32  TargetError;
+    u32  MinimumSampleCount;
+    bool GatherFeatures;
+    f32  UnitSeconds;    // the coordinator drops a worker that holds a unit longer and queues the unit again
+};
+
+// traces Unit into buffers of its size, returns the rays traced
+typedef u64 trace_unit_function(void                   *Data,
+                                const distributed_unit &Unit,
+                                frame_buffer           *AccumulationFrameBuffer,
+                                sample_buffer          *SampleBuffer,
+                                feature_buffer         *FeatureBuffer);
+
+// hands out the units of the image to the workers that connect on Port until every one is back in the whole
+// image buffers, FeatureBuffer is only written when Settings.GatherFeatures is set
+function bool
+RunCoordinator(u16                         Port,
+               const distributed_settings &Settings,
+               frame_buffer               *AccumulationFrameBuffer,
+               sample_buffer              *SampleBuffer,
+               feature_buffer             *FeatureBuffer,
+               u64                        *OutRayCount);
+
+// connects to the coordinator at Address (host:port) and traces the units it hands out until it is done
+function bool
+RunWorker(const char                 *Address,
+          const distributed_settings &Settings,
+          trace_unit_function        *TraceUnit,
+          void                       *Data);
@@ -0,0 +1,218 @@
+#include "tracer_file.h"
+
+#include <ctype.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool
+ReadEntireFile(const char    *FilePath,
+               file_contents *OutContents)
+{
+    *OutContents = {};
+
+    FILE *File = fopen(FilePath, "rb");
+    if (!File)
+    {
+        fprintf(stderr, "failed to open %s\n", FilePath);
+        return false;
+    }
+
+    bool Success = false;
+    if (fseek(File, 0, SEEK_END) == 0)
+    {
+        long Size = ftell(File);
+        if (Size >= 0 && fseek(File, 0, SEEK_SET) == 0)
+        {
+            u8 *Data = (u8 *)malloc((size_t)Size + 1);
+            if (Data && fread(Data, 1, (size_t)Size, File) == (size_t)Size)
+            {
+                Data[Size]        = 0;
+                OutContents->Size = (u64)Size;
+                OutContents->Data = Data;
+                Success = true;
+            }
+            else
+            {
+                free(Data);
+            }
+        }
+    }
+
+    if (!Success)
+    {
+        fprintf(stderr, "failed to read %s\n", FilePath);
+    }
+
+    fclose(File);
+    return Success;
+}
+
+void
+FreeFileContents(file_contents *Contents)
+{
+    free(Contents->Data);
+    *Contents = {};
+}
+
+#ifdef _WIN32
+
+bool
+MapFile(const char  *FilePath,
+        mapped_file *OutFile)
+{
+    *OutFile = {};
+
+    HANDLE File = CreateFileA(FilePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "failed to open %s\n", FilePath);
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    HANDLE Mapping = nullptr;
+    void *Data = nullptr;
+    if (GetFileSizeEx(File, &Size) && Size.QuadPart > 0)
+    {
+        Mapping = CreateFileMappingA(File, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (Mapping)
+        {
+            Data = MapViewOfFile(Mapping, FILE_MAP_COPY, 0, 0, 0);
+        }
+    }
+
+    // note(harlequin): the view keeps the file alive
+    CloseHandle(File);
+
+    if (!Data)
+    {
+        if (Mapping)
+        {
+            CloseHandle(Mapping);
+        }
+        fprintf(stderr, "failed to map %s\n", FilePath);
+        return false;
+    }
+
+    OutFile->Size          = (u64)Size.QuadPart;
+    OutFile->Data          = (u8 *)Data;
+    OutFile->MappingHandle = Mapping;
+    return true;
+}
+
+void
+UnmapFile(mapped_file *File)
+{
+    if (File->Data)
+    {
+        UnmapViewOfFile(File->Data);
+        CloseHandle((HANDLE)File->MappingHandle);
+    }
+    *File = {};
+}
+
+bool
+FlushFileToDisk(FILE *File)
+{
+    return fflush(File) == 0 && _commit(_fileno(File)) == 0;
+}
+
+bool
+RenameFileOver(const char *SourcePath,
+               const char *FilePath)
+{
+    return MoveFileExA(SourcePath, FilePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+#else
+
+bool
+MapFile(const char  *FilePath,
+        mapped_file *OutFile)
+{
+    *OutFile = {};
+
+    int File = open(FilePath, O_RDONLY);
+    if (File < 0)
+    {
+        fprintf(stderr, "failed to open %s\n", FilePath);
+        return false;
+    }
+
+    struct stat Stat;
+    void *Data = MAP_FAILED;
+    if (fstat(File, &Stat) == 0 && Stat.st_size > 0)
+    {
+        Data = mmap(nullptr, (size_t)Stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, File, 0);
+    }
+
+    // note(harlequin): the mapping keeps the file alive
+    close(File);
+
+    if (Data == MAP_FAILED)
+    {
+        fprintf(stderr, "failed to map %s\n", FilePath);
+        return false;
+    }
+
+    OutFile->Size = (u64)Stat.st_size;
+    OutFile->Data = (u8 *)Data;
+    return true;
+}
+
+void
+UnmapFile(mapped_file *File)
+{
+    if (File->Data)
+    {
+        munmap(File->Data, (size_t)File->Size);
+    }
+    *File = {};
+}
+
+bool
+FlushFileToDisk(FILE *File)
+{
+    return fflush(File) == 0 && fsync(fileno(File)) == 0;
+}
+
+bool
+RenameFileOver(const char *SourcePath,
+               const char *FilePath)
+{
+    return rename(SourcePath, FilePath) == 0;
+}
+
+#endif
+
+bool
+HasExtension(const char *FilePath,
+             const char *Extension)
+{
+    const char *Dot = strrchr(FilePath, '.');
+    if (!Dot)
+    {
+        return false;
+    }
+    for (const char *A = Dot + 1, *B = Extension; ; A++, B++)
+    {
+        if (tolower((unsigned char)*A) != tolower((unsigned char)*B))
+        {
+            return false;
+        }
+        if (!*A)
+        {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "tracer_core.h"
+
+struct file_contents
+{
+    u64 Size;
+    u8 *Data; // Size + 1 bytes, the extra byte is a null terminator for text parsers
+};
+
+function bool
+ReadEntireFile(const char    *FilePath,
+               file_contents *OutContents);
+
+function void
+FreeFileContents(file_contents *Contents);
+
+// note(harlequin): a private copy on write mapping, writes through Data never reach the file
+struct mapped_file
+{
+    u64   Size;
+    u8   *Data;
+    void *MappingHandle; // win32 only
+};
+
+function bool
+MapFile(const char  *FilePath,
+        mapped_file *OutFile);
+
+function void
+UnmapFile(mapped_file *File);
+
+// note(harlequin): flushes the stdio buffers and asks the os to put the file on disk, a rename after it can
+// then never be seen with the old contents of the file missing
+function bool
+FlushFileToDisk(FILE *File);
+
+// replaces FilePath with SourcePath in one step, either the old or the new file is there after a crash
+function bool
+RenameFileOver(const char *SourcePath,
+               const char *FilePath);
+
+// case insensitive, Extension without the dot
+function bool
+HasExtension(const char *FilePath,
+             const char *Extension);
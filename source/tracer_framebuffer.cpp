@@ -1,4 +1,5 @@
 #include "tracer_framebuffer.h"
+#include "tracer_lane.h"
 #include <stdlib.h>
 void
 InitializeFrameBuffer(frame_buffer *FrameBuffer,
@@ -26,4 +27,162 @@ void
 ClearFrameBuffer(frame_buffer *FrameBuffer)
 {
     memset(FrameBuffer->Pixels, 0, sizeof(v3) * FrameBuffer->Width * FrameBuffer->Height);
-}
\ No newline at end of file
+}
+
+void
+FreeFrameBuffer(frame_buffer *FrameBuffer)
+{
+    _aligned_free(FrameBuffer->Pixels);
+    *FrameBuffer = {};
+}
+
+void
+InitializeSampleBuffer(sample_buffer *SampleBuffer,
+                       u32            Width,
+                       u32            Height)
+{
+    Assert(Width);
+    Assert(Height);
+    SampleBuffer->Width  = Width;
+    SampleBuffer->Height = Height;
+    SampleBuffer->Pixels = (pixel_statistics *)calloc((size_t)Width * Height, sizeof(pixel_statistics));
+}
+
+void
+ResizeSampleBuffer(sample_buffer *SampleBuffer,
+                   u32            NewWidth,
+                   u32            NewHeight)
+{
+    SampleBuffer->Width  = NewWidth;
+    SampleBuffer->Height = NewHeight;
+    SampleBuffer->Pixels = (pixel_statistics *)realloc(SampleBuffer->Pixels, sizeof(pixel_statistics) * NewWidth * NewHeight);
+    ClearSampleBuffer(SampleBuffer);
+}
+
+void
+ClearSampleBuffer(sample_buffer *SampleBuffer)
+{
+    memset(SampleBuffer->Pixels, 0, sizeof(pixel_statistics) * SampleBuffer->Width * SampleBuffer->Height);
+}
+
+void
+FreeSampleBuffer(sample_buffer *SampleBuffer)
+{
+    free(SampleBuffer->Pixels);
+    *SampleBuffer = {};
+}
+
+void
+InitializeFeatureBuffer(feature_buffer *FeatureBuffer,
+                        u32             Width,
+                        u32             Height)
+{
+    Assert(Width);
+    Assert(Height);
+    FeatureBuffer->Width  = Width;
+    FeatureBuffer->Height = Height;
+    FeatureBuffer->Albedo = (v3 *)_aligned_malloc(sizeof(v3) * Width * Height, alignof(v3));
+    FeatureBuffer->Normal = (v3 *)_aligned_malloc(sizeof(v3) * Width * Height, alignof(v3));
+    FeatureBuffer->Depth  = (f32 *)_aligned_malloc(sizeof(f32) * Width * Height, 64);
+}
+
+void
+ResizeFeatureBuffer(feature_buffer *FeatureBuffer,
+                    u32             NewWidth,
+                    u32             NewHeight)
+{
+    FeatureBuffer->Width  = NewWidth;
+    FeatureBuffer->Height = NewHeight;
+    FeatureBuffer->Albedo = (v3 *)_aligned_realloc(FeatureBuffer->Albedo, sizeof(v3) * NewWidth * NewHeight, alignof(v3));
+    FeatureBuffer->Normal = (v3 *)_aligned_realloc(FeatureBuffer->Normal, sizeof(v3) * NewWidth * NewHeight, alignof(v3));
+    FeatureBuffer->Depth  = (f32 *)_aligned_realloc(FeatureBuffer->Depth, sizeof(f32) * NewWidth * NewHeight, 64);
+}
+
+void
+FreeFeatureBuffer(feature_buffer *FeatureBuffer)
+{
+    _aligned_free(FeatureBuffer->Albedo);
+    _aligned_free(FeatureBuffer->Normal);
+    _aligned_free(FeatureBuffer->Depth);
+    *FeatureBuffer = {};
+}
+
+inline lane_f32
+TonemapLane(lane_f32 Color, tonemapper Tonemapper)
+{
+    lane_f32 Zero = LaneF32(0.0f);
+    lane_f32 One  = LaneF32(1.0f);
+    Color = Maximium(Color, Zero);
+    switch (Tonemapper)
+    {
+        case Tonemapper_Reinhard:
+        {
+            Color = Color / (One + Color);
+        } break;
+
+        case Tonemapper_Aces:
+        {
+            lane_f32 Numerator   = Color * (LaneF32(2.51f) * Color + LaneF32(0.03f));
+            lane_f32 Denominator = Color * (LaneF32(2.43f) * Color + LaneF32(0.59f)) + LaneF32(0.14f);
+            Color = Numerator / Denominator;
+        } break;
+
+        default: break;
+    }
+    return Minimum(Color, One);
+}
+
+// note(harlequin): 1.055 x^(1/2.4) - 0.055 fitted over x^(1/2), x^(1/4) and x^(1/8) (ian taylor's "fast srgb
+// approximations"), the linear toe is exact
+inline lane_f32
+LinearToSRGBLane(lane_f32 Linear)
+{
+    lane_f32 Root2 = SquareRoot(Linear);
+    lane_f32 Root4 = SquareRoot(Root2);
+    lane_f32 Root8 = SquareRoot(Root4);
+    lane_f32 Curve = LaneF32(0.662002687f) * Root2 + LaneF32(0.684122060f) * Root4 -
+                     LaneF32(0.323583601f) * Root8 - LaneF32(0.0225411470f) * Linear;
+    return Select(Linear <= LaneF32(0.0031308f), Linear * LaneF32(12.92f), Curve);
+}
+
+void
+ResolvePixels(const v3               *Colors,
+              const pixel_statistics *Statistics,
+              v3                     *Output,
+              u32                     Count,
+              tonemapper              Tonemapper)
+{
+    for (u32 FirstIndex = 0; FirstIndex < Count; FirstIndex += LANE_WIDTH)
+    {
+        u32 LaneCount = Count - FirstIndex < LANE_WIDTH ? Count - FirstIndex : LANE_WIDTH;
+
+        // note(harlequin): the pixels are stored as v3 so the lanes are gathered component by component
+        f32 R[LANE_WIDTH] = {};
+        f32 G[LANE_WIDTH] = {};
+        f32 B[LANE_WIDTH] = {};
+        f32 Scale[LANE_WIDTH] = {};
+        for (u32 LaneIndex = 0; LaneIndex < LaneCount; LaneIndex++)
+        {
+            const v3 &Color = Colors[FirstIndex + LaneIndex];
+            R[LaneIndex] = VectorComponent(Color, 0);
+            G[LaneIndex] = VectorComponent(Color, 1);
+            B[LaneIndex] = VectorComponent(Color, 2);
+
+            u32 SampleCount = Statistics ? Statistics[FirstIndex + LaneIndex].SampleCount : 1;
+            Scale[LaneIndex] = SampleCount ? 1.0f / (f32)SampleCount : 0.0f;
+        }
+
+        lane_f32 OneOverSampleCount = LoadLaneF32(Scale);
+        lane_f32 ResolvedR = LinearToSRGBLane(TonemapLane(LoadLaneF32(R) * OneOverSampleCount, Tonemapper));
+        lane_f32 ResolvedG = LinearToSRGBLane(TonemapLane(LoadLaneF32(G) * OneOverSampleCount, Tonemapper));
+        lane_f32 ResolvedB = LinearToSRGBLane(TonemapLane(LoadLaneF32(B) * OneOverSampleCount, Tonemapper));
+        StoreLaneF32(R, ResolvedR);
+        StoreLaneF32(G, ResolvedG);
+        StoreLaneF32(B, ResolvedB);
+
+        for (u32 LaneIndex = 0; LaneIndex < LaneCount; LaneIndex++)
+        {
+            Output[FirstIndex + LaneIndex] = V3(R[LaneIndex], G[LaneIndex], B[LaneIndex]);
+        }
+    }
+}
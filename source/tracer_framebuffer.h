@@ -21,4 +21,123 @@ ResizeFrameBuffer(frame_buffer *FrameBuffer,
                   u32           NewHeight);
 
 function void
-ClearFrameBuffer(frame_buffer *FrameBuffer);
\ No newline at end of file
+ClearFrameBuffer(frame_buffer *FrameBuffer);
+
+function void
+FreeFrameBuffer(frame_buffer *FrameBuffer);
+
+// note(harlequin): per pixel sample count and the welford running mean and variance of the sample luminance,
+// kept next to the accumulation buffer so adaptive sampling knows which pixels are still noisy
+struct pixel_statistics
+{
+    u32 SampleCount;
+    f32 Mean;
+    f32 M2; // sum of squared differences from the mean
+};
+
+struct sample_buffer
+{
+    u32               Width;
+    u32               Height;
+    pixel_statistics *Pixels;
+};
+
+function void
+InitializeSampleBuffer(sample_buffer *SampleBuffer,
+                       u32            Width,
+                       u32            Height);
+
+function void
+ResizeSampleBuffer(sample_buffer *SampleBuffer,
+                   u32            NewWidth,
+                   u32            NewHeight);
+
+function void
+ClearSampleBuffer(sample_buffer *SampleBuffer);
+
+function void
+FreeSampleBuffer(sample_buffer *SampleBuffer);
+
+// note(harlequin): per pixel mean of the first hit features of every sample, written next to the accumulation
+// when the frame is going to be denoised
+struct feature_buffer
+{
+    u32  Width;
+    u32  Height;
+    v3  *Albedo;
+    v3  *Normal;
+    f32 *Depth;
+};
+
+function void
+InitializeFeatureBuffer(feature_buffer *FeatureBuffer,
+                        u32             Width,
+                        u32             Height);
+
+function void
+ResizeFeatureBuffer(feature_buffer *FeatureBuffer,
+                    u32             NewWidth,
+                    u32             NewHeight);
+
+function void
+FreeFeatureBuffer(feature_buffer *FeatureBuffer);
+
+inline f32
+GetLuminance(const v3 &Color)
+{
+    return 0.2126f * VectorComponent(Color, 0) + 0.7152f * VectorComponent(Color, 1) + 0.0722f * VectorComponent(Color, 2);
+}
+
+inline void
+AddPixelSample(pixel_statistics *Statistics, f32 Luminance)
+{
+    Statistics->SampleCount++;
+    f32 Delta = Luminance - Statistics->Mean;
+    Statistics->Mean += Delta / (f32)Statistics->SampleCount;
+    Statistics->M2   += Delta * (Luminance - Statistics->Mean);
+}
+
+// note(harlequin): the random numbers of a sample are keyed on this, so it has to count per pixel once
+// pixels stop receiving the same number of samples
+inline u32
+GetPixelSampleIndex(const sample_buffer *SampleBuffer, u32 PixelIndex)
+{
+    return SampleBuffer->Pixels[PixelIndex].SampleCount + 1;
+}
+
+#define PIXEL_ERROR_MIN_LUMINANCE 0.01f
+
+// note(harlequin): standard error of the mean over the mean, the floor keeps black pixels from never converging.
+// a pixel with fewer than two samples has no variance estimate yet and reports MAX_F32
+inline f32
+GetPixelRelativeError(const pixel_statistics *Statistics)
+{
+    u32 SampleCount = Statistics->SampleCount;
+    if (SampleCount < 2)
+    {
+        return MAX_F32;
+    }
+    f32 VarianceOfMean = Statistics->M2 / ((f32)(SampleCount - 1) * (f32)SampleCount);
+    f32 Mean = Statistics->Mean > PIXEL_ERROR_MIN_LUMINANCE ? Statistics->Mean : PIXEL_ERROR_MIN_LUMINANCE;
+    return SquareRoot(VarianceOfMean) / Mean;
+}
+
+enum tonemapper
+{
+    Tonemapper_Clamp,
+    Tonemapper_Reinhard, // x / (1 + x) per channel
+    Tonemapper_Aces,     // narkowicz's fit of the aces filmic curve
+    Tonemapper_Count
+};
+
+global_variable const char *TonemapperNames[Tonemapper_Count] = { "clamp", "reinhard", "aces" };
+
+// note(harlequin): turns Count linear colors into tonemapped srgb in [0, 1], LANE_WIDTH pixels at a time. Colors
+// are sums over the samples counted in Statistics, or already means when Statistics is null. the srgb curve is a
+// polynomial in square roots that stays within a quarter of an 8 bit step of the exact one
+function void
+ResolvePixels(const v3               *Colors,
+              const pixel_statistics *Statistics,
+              v3                     *Output,
+              u32                     Count,
+              tonemapper              Tonemapper);
@@ -0,0 +1,1173 @@
+#include <stdlib.h>
+#include <chrono>
+#include <utility>
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+
+#include "tracer_math.cpp"
+#include "tracer_memory.cpp"
+#include "tracer_profile.cpp"
+#include "tracer_random.cpp"
+#include "tracer_framebuffer.cpp"
+#include "tracer_camera.cpp"
+#include "tracer_bvh.cpp"
+#include "tracer_world.cpp"
+#include "tracer_file.cpp"
+#include "tracer_mesh.cpp"
+#include "tracer_scene.cpp"
+#include "tracer_jobs.cpp"
+#include "tracer_wavefront.cpp"
+#include "tracer_image.cpp"
+#include "tracer_progressive.cpp"
+#include "tracer_denoise.cpp"
+#include "tracer_checkpoint.cpp"
+#include "tracer_distributed.cpp"
+
+// note(harlequin): headless entry point for render nodes without a display, nothing in this
+// translation unit touches glfw, imgui or opengl so it links against the crt and threads only
+
+struct headless_settings
+{
+    u32         Width;
+    u32         Height;
+    u32         SampleCount;
+    u32         RayBounceCount;
+    u32         ThreadCount;
+    u32         IdleSpinCount;
+    u32         PacketTracing;
+    u32         Seed;
+    f32         NoiseThreshold; // 0 disables adaptive sampling
+    u32         MinimumSampleCount;
+    f32         TimeBudgetSeconds; // 0 renders every sample
+    f32         TargetError;       // 0 renders every sample
+    u32         DenoiseIterationCount; // 0 disables the denoiser
+    u32         BandHeight;            // 0 renders the whole image at once, the rows of a unit for the coordinator
+    u32         CoordinatorPort;       // 0 renders locally
+    f32         CheckpointSeconds;     // between two checkpoints
+    f32         UnitTimeoutSeconds;    // the coordinator takes a unit back from a worker that holds it this long
+    u32         Resume;
+    u32         AovMask;
+    v3          LookFrom;
+    v3          LookAt;
+    f32         ApertureRadius; // 0 is a pinhole
+    f32         FocusDistance;  // 0 focuses on LookAt
+    integrator  Integrator;
+    tonemapper  Tonemapper;
+    const char *OutputPath;
+    const char *MeshPath;
+    const char *ScenePath;
+    const char *CurvePath;
+    const char *AovPath;
+    const char *CheckpointPath;
+    const char *WorkerAddress;
+    const char *ProfilePath;
+};
+
+function void
+PrintUsage(const char *ProgramName)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --width <pixels>      image width (default 1280)\n"
+            "  --height <pixels>     image height (default 720)\n"
+            "  --samples <count>     samples per pixel, the upper bound of a progressive render (default 64)\n"
+            "  --time <seconds>      stop before the render would run past this wall clock budget (default off)\n"
+            "  --target-error <e>    stop once the rms relative pixel error is below this (default off)\n"
+            "  --curve <path>        write the convergence curve (error against time) as csv\n"
+            "  --denoise <count>     a-trous iterations of the denoiser run on the final image, 5 is a good start (default 0, off)\n"
+            "  --bounces <count>     ray bounce count (default 64)\n"
+            "  --threads <count>     thread count, 0 uses every core (default 0)\n"
+            "  --idle-spin <count>   pauses an idle thread spins through before it sleeps, 0 sleeps right away (default 4096)\n"
+            "  --packets <0|1>       trace primary rays in packets (default 1)\n"
+            "  --seed <value>        random seed, the same seed renders the same image on any thread count (default 0)\n"
+            "  --adaptive <error>    retire tiles once every pixel is below this relative error, --samples is the limit (default off)\n"
+            "  --min-samples <count> samples before adaptive sampling or --target-error can stop a pixel (default 8)\n"
+            "  --integrator <name>   recursive or wavefront (default recursive)\n"
+            "  --tonemap <name>      clamp, reinhard or aces, applied to the png or ppm, the rest stays linear (default clamp)\n"
+            "  --output <path>       output .png or .ppm, or .pfm or .exr of the linear radiance (default output.png)\n"
+            "  --band-height <rows>  render and write the image this many rows at a time, memory then only grows with\n"
+            "                        the width (default 0, the whole image at once)\n"
+            "  --checkpoint <path>   save the accumulation there every --checkpoint-time seconds and once done\n"
+            "  --checkpoint-time <s> seconds between two checkpoints (default 60)\n"
+            "  --resume              continue from --checkpoint if it exists, the scene, camera and seed have to match\n"
+            "  --coordinator <port>  hand the image out to --worker processes in units of --band-height rows (default 32),\n"
+            "                        merge what they trace and write the output here\n"
+            "  --unit-timeout <s>    seconds a worker gets for a unit before the coordinator hands it to another (default 600)\n"
+            "  --worker <host:port>  trace units for the coordinator there, the rest of the command line has to match its\n"
+            "  --profile <path>      write where the time went as chrome trace json, needs a TRACER_PROFILE=1 build\n"
+            "  --aov <path>          also write the linear aovs, as layers of one .exr or as one .pfm per aov\n"
+            "  --aovs <names>        comma separated aovs to write: radiance, albedo, normal, depth, samples and\n"
+            "                        variance (default all of them)\n"
+            "  --look-from <x,y,z>   camera position (default 0,0,0)\n"
+            "  --look-at <x,y,z>     point the camera looks at (default 0,0,-1)\n"
+            "  --aperture <radius>   lens radius for depth of field, 0 is a pinhole (default 0)\n"
+            "  --focus <distance>    distance of the sharp plane (default the distance to --look-at)\n"
+            "  --scene <path>        text scene or binary .scene file rendered instead of the demo scene\n"
+            "  --mesh <path>         obj or binary ply mesh placed behind the spheres of a text scene\n",
+            ProgramName);
+}
+
+function bool
+ParseU32(const char *Text, u32 *OutValue)
+{
+    char *End = nullptr;
+    unsigned long Value = strtoul(Text, &End, 10);
+    if (End == Text || *End != '\0' || Value > UINT_MAX)
+    {
+        return false;
+    }
+    *OutValue = (u32)Value;
+    return true;
+}
+
+function bool
+ParseF32(const char *Text, f32 *OutValue)
+{
+    char *End = nullptr;
+    f32 Value = strtof(Text, &End);
+    if (End == Text || *End != '\0' || !(Value >= 0.0f))
+    {
+        return false;
+    }
+    *OutValue = Value;
+    return true;
+}
+
+function bool
+ParseV3(const char *Text, v3 *OutValue)
+{
+    f32 Components[3];
+    for (u32 ComponentIndex = 0; ComponentIndex < ArrayCount(Components); ComponentIndex++)
+    {
+        char *End = nullptr;
+        Components[ComponentIndex] = strtof(Text, &End);
+        char Expected = ComponentIndex + 1 < ArrayCount(Components) ? ',' : '\0';
+        if (End == Text || *End != Expected)
+        {
+            return false;
+        }
+        Text = End + 1;
+    }
+    *OutValue = V3(Components[0], Components[1], Components[2]);
+    return true;
+}
+
+function bool
+ParseAovMask(const char *Text, u32 *OutMask)
+{
+    u32 Mask = 0;
+    while (*Text)
+    {
+        const char *End = strchr(Text, ',');
+        u32 Length = End ? (u32)(End - Text) : (u32)strlen(Text);
+
+        bool Found = false;
+        for (u32 AovIndex = 0; AovIndex < Aov_Count; AovIndex++)
+        {
+            if (strlen(AovNames[AovIndex]) == Length && strncmp(Text, AovNames[AovIndex], Length) == 0)
+            {
+                Mask |= 1u << AovIndex;
+                Found = true;
+            }
+        }
+        if (!Found)
+        {
+            return false;
+        }
+        Text += End ? Length + 1 : Length;
+    }
+
+    *OutMask = Mask;
+    return Mask != 0;
+}
+
+function bool
+ParseHeadlessSettings(i32                ArgumentCount,
+                      char             **Arguments,
+                      headless_settings *Settings)
+{
+    for (i32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ArgumentIndex++)
+    {
+        const char *Argument = Arguments[ArgumentIndex];
+        const char *Value    = ArgumentIndex + 1 < ArgumentCount ? Arguments[ArgumentIndex + 1] : nullptr;
+
+        u32 *U32Option = nullptr;
+        if (strcmp(Argument, "--width") == 0)            U32Option = &Settings->Width;
+        else if (strcmp(Argument, "--height") == 0)      U32Option = &Settings->Height;
+        else if (strcmp(Argument, "--samples") == 0)     U32Option = &Settings->SampleCount;
+        else if (strcmp(Argument, "--bounces") == 0)     U32Option = &Settings->RayBounceCount;
+        else if (strcmp(Argument, "--threads") == 0)     U32Option = &Settings->ThreadCount;
+        else if (strcmp(Argument, "--idle-spin") == 0)   U32Option = &Settings->IdleSpinCount;
+        else if (strcmp(Argument, "--packets") == 0)     U32Option = &Settings->PacketTracing;
+        else if (strcmp(Argument, "--seed") == 0)        U32Option = &Settings->Seed;
+        else if (strcmp(Argument, "--min-samples") == 0) U32Option = &Settings->MinimumSampleCount;
+        else if (strcmp(Argument, "--denoise") == 0)     U32Option = &Settings->DenoiseIterationCount;
+        else if (strcmp(Argument, "--band-height") == 0) U32Option = &Settings->BandHeight;
+        else if (strcmp(Argument, "--coordinator") == 0) U32Option = &Settings->CoordinatorPort;
+        else if (strcmp(Argument, "--adaptive") == 0 ||
+                 strcmp(Argument, "--time") == 0 ||
+                 strcmp(Argument, "--target-error") == 0 ||
+                 strcmp(Argument, "--aperture") == 0 ||
+                 strcmp(Argument, "--focus") == 0 ||
+                 strcmp(Argument, "--checkpoint-time") == 0 ||
+                 strcmp(Argument, "--unit-timeout") == 0)
+        {
+            f32 *F32Option = strcmp(Argument, "--adaptive") == 0        ? &Settings->NoiseThreshold :
+                             strcmp(Argument, "--time") == 0            ? &Settings->TimeBudgetSeconds :
+                             strcmp(Argument, "--aperture") == 0        ? &Settings->ApertureRadius :
+                             strcmp(Argument, "--focus") == 0           ? &Settings->FocusDistance :
+                             strcmp(Argument, "--checkpoint-time") == 0 ? &Settings->CheckpointSeconds :
+                             strcmp(Argument, "--unit-timeout") == 0    ? &Settings->UnitTimeoutSeconds :
+                                                                          &Settings->TargetError;
+            if (!Value || !ParseF32(Value, F32Option))
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+            ArgumentIndex++;
+            continue;
+        }
+        else if (strcmp(Argument, "--tonemap") == 0)
+        {
+            bool Found = false;
+            for (u32 TonemapperIndex = 0; Value && TonemapperIndex < Tonemapper_Count; TonemapperIndex++)
+            {
+                if (strcmp(Value, TonemapperNames[TonemapperIndex]) == 0)
+                {
+                    Settings->Tonemapper = (tonemapper)TonemapperIndex;
+                    Found = true;
+                }
+            }
+            if (!Found)
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+            ArgumentIndex++;
+            continue;
+        }
+        else if (strcmp(Argument, "--integrator") == 0)
+        {
+            bool Found = false;
+            for (u32 IntegratorIndex = 0; Value && IntegratorIndex < Integrator_Count; IntegratorIndex++)
+            {
+                if (strcmp(Value, IntegratorNames[IntegratorIndex]) == 0)
+                {
+                    Settings->Integrator = (integrator)IntegratorIndex;
+                    Found = true;
+                }
+            }
+            if (!Found)
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+            ArgumentIndex++;
+            continue;
+        }
+        else if (strcmp(Argument, "--look-from") == 0 ||
+                 strcmp(Argument, "--look-at") == 0)
+        {
+            v3 *V3Option = strcmp(Argument, "--look-from") == 0 ? &Settings->LookFrom : &Settings->LookAt;
+            if (!Value || !ParseV3(Value, V3Option))
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+            ArgumentIndex++;
+            continue;
+        }
+        else if (strcmp(Argument, "--resume") == 0)
+        {
+            Settings->Resume = 1;
+            continue;
+        }
+        else if (strcmp(Argument, "--aovs") == 0)
+        {
+            if (!Value || !ParseAovMask(Value, &Settings->AovMask))
+            {
+                fprintf(stderr, "invalid value for %s\n", Argument);
+                return false;
+            }
+            ArgumentIndex++;
+            continue;
+        }
+        else if (strcmp(Argument, "--output") == 0 ||
+                 strcmp(Argument, "--mesh") == 0 ||
+                 strcmp(Argument, "--scene") == 0 ||
+                 strcmp(Argument, "--curve") == 0 ||
+                 strcmp(Argument, "--aov") == 0 ||
+                 strcmp(Argument, "--checkpoint") == 0 ||
+                 strcmp(Argument, "--worker") == 0 ||
+                 strcmp(Argument, "--profile") == 0)
+        {
+            if (!Value)
+            {
+                fprintf(stderr, "missing value for %s\n", Argument);
+                return false;
+            }
+            if (strcmp(Argument, "--output") == 0)
+            {
+                Settings->OutputPath = Value;
+            }
+            else if (strcmp(Argument, "--mesh") == 0)
+            {
+                Settings->MeshPath = Value;
+            }
+            else if (strcmp(Argument, "--curve") == 0)
+            {
+                Settings->CurvePath = Value;
+            }
+            else if (strcmp(Argument, "--aov") == 0)
+            {
+                Settings->AovPath = Value;
+            }
+            else if (strcmp(Argument, "--checkpoint") == 0)
+            {
+                Settings->CheckpointPath = Value;
+            }
+            else if (strcmp(Argument, "--worker") == 0)
+            {
+                Settings->WorkerAddress = Value;
+            }
+            else if (strcmp(Argument, "--profile") == 0)
+            {
+                Settings->ProfilePath = Value;
+            }
+            else
+            {
+                Settings->ScenePath = Value;
+            }
+            ArgumentIndex++;
+            continue;
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", Argument);
+            return false;
+        }
+
+        if (!Value || !ParseU32(Value, U32Option))
+        {
+            fprintf(stderr, "invalid value for %s\n", Argument);
+            return false;
+        }
+        ArgumentIndex++;
+    }
+
+    if (!Settings->Width || !Settings->Height || !Settings->SampleCount || !Settings->RayBounceCount)
+    {
+        fprintf(stderr, "width, height, samples and bounces must be greater than zero\n");
+        return false;
+    }
+
+    image_format OutputFormat;
+    if (!GetImageFormat(Settings->OutputPath, &OutputFormat))
+    {
+        fprintf(stderr, "%s is not a .png, .ppm, .pfm or .exr path\n", Settings->OutputPath);
+        return false;
+    }
+    if (Settings->DenoiseIterationCount && OutputFormat != ImageFormat_Png && OutputFormat != ImageFormat_Ppm)
+    {
+        fprintf(stderr, "--denoise only applies to a .png or .ppm output, the linear outputs are never denoised\n");
+        return false;
+    }
+
+    // note(harlequin): the denoiser would need the rows around a band, the curve follows a single frame and the
+    // bands before the checkpointed one are only in the output file
+    if (!Settings->CoordinatorPort && !Settings->WorkerAddress && Settings->BandHeight && Settings->BandHeight < Settings->Height &&
+        (Settings->DenoiseIterationCount || Settings->CurvePath || Settings->CheckpointPath))
+    {
+        fprintf(stderr, "--band-height cannot be combined with --denoise, --curve or --checkpoint\n");
+        return false;
+    }
+
+    // note(harlequin): a worker traces every unit to the sample count or the target error, a time budget would make
+    // the image depend on how fast the workers are
+    if (Settings->CoordinatorPort > 65535 || (Settings->CoordinatorPort && Settings->WorkerAddress))
+    {
+        fprintf(stderr, "--coordinator takes a port up to 65535 and cannot be combined with --worker\n");
+        return false;
+    }
+    if ((Settings->CoordinatorPort || Settings->WorkerAddress) &&
+        (Settings->TimeBudgetSeconds > 0.0f || Settings->CurvePath || Settings->CheckpointPath))
+    {
+        fprintf(stderr, "--coordinator and --worker cannot be combined with --time, --curve or --checkpoint\n");
+        return false;
+    }
+
+    if (Settings->Resume && !Settings->CheckpointPath)
+    {
+        fprintf(stderr, "--resume needs the --checkpoint to resume from\n");
+        return false;
+    }
+    if (Settings->CheckpointPath && !(Settings->CheckpointSeconds > 0.0f))
+    {
+        fprintf(stderr, "--checkpoint-time has to be greater than zero\n");
+        return false;
+    }
+    if (Settings->CoordinatorPort && !(Settings->UnitTimeoutSeconds > 0.0f))
+    {
+        fprintf(stderr, "--unit-timeout has to be greater than zero\n");
+        return false;
+    }
+
+#if !TRACER_PROFILE
+    if (Settings->ProfilePath)
+    {
+        fprintf(stderr, "--profile needs a build with -DTRACER_PROFILE=1\n");
+        return false;
+    }
+#endif
+
+    v3 ViewDirection = Settings->LookAt - Settings->LookFrom;
+    if (Length(ViewDirection) == 0.0f || Length(Cross(ViewDirection, V3(0.0f, 1.0f, 0.0f))) == 0.0f)
+    {
+        fprintf(stderr, "--look-at has to differ from --look-from and not be straight above or below it\n");
+        return false;
+    }
+
+    return true;
+}
+
+// note(harlequin): the output goes out AOV_BAND_HEIGHT rows at a time, png and ppm take the tonemapped frame buffer,
+// pfm and exr the linear mean radiance like the radiance aov
+function bool
+WriteOutputRows(image_writer        *Writer,
+                const frame_buffer  *AccumulationFrameBuffer,
+                const sample_buffer *SampleBuffer,
+                const frame_buffer  *FrameBuffer,
+                f32                 *Scratch)
+{
+    u32 Width  = FrameBuffer->Width;
+    u32 Height = FrameBuffer->Height;
+    bool Linear = Writer->Format == ImageFormat_Pfm || Writer->Format == ImageFormat_Exr;
+
+    bool Success = true;
+    for (u32 MinY = 0; Success && MinY < Height; MinY += AOV_BAND_HEIGHT)
+    {
+        u32 MaxY = MinY + AOV_BAND_HEIGHT < Height ? MinY + AOV_BAND_HEIGHT : Height;
+        f32 *Out = Scratch;
+        for (u32 PixelIndex = MinY * Width; PixelIndex < MaxY * Width; PixelIndex++)
+        {
+            v3 Color = FrameBuffer->Pixels[PixelIndex];
+            if (Linear)
+            {
+                u32 SampleCount = SampleBuffer->Pixels[PixelIndex].SampleCount;
+                Color = SampleCount ? AccumulationFrameBuffer->Pixels[PixelIndex] / (f32)SampleCount : V3(0.0f);
+            }
+            *Out++ = VectorComponent(Color, 0);
+            *Out++ = VectorComponent(Color, 1);
+            *Out++ = VectorComponent(Color, 2);
+        }
+        Success = WriteImageRows(Writer, Scratch, MaxY - MinY);
+    }
+    return Success;
+}
+
+// note(harlequin): the rows of a traced band go out on a worker while the next band traces into the other set of
+// buffers, the buffers here are copies of the band's, which stay untouched until both jobs ran
+struct band_write
+{
+    image_writer   *OutputWriter;
+    aov_output     *AovOutput;    // null without --aov
+    frame_buffer    AccumulationFrameBuffer;
+    sample_buffer   SampleBuffer;
+    feature_buffer  FeatureBuffer;
+    frame_buffer    FrameBuffer;
+    f32            *Scratch;
+    bool            OutputWritten;
+    bool            AovsWritten;
+    bool            Pending;
+    job             OutputJob;
+    job             AovJob;
+};
+
+function void
+WriteBandOutput(void *Data)
+{
+    PROFILE_SCOPE("WriteBandOutput");
+    band_write *Write = (band_write *)Data;
+    Write->OutputWritten = WriteOutputRows(Write->OutputWriter, &Write->AccumulationFrameBuffer, &Write->SampleBuffer,
+                                           &Write->FrameBuffer, Write->Scratch);
+}
+
+function void
+WriteBandAovs(void *Data)
+{
+    PROFILE_SCOPE("WriteBandAovs");
+    band_write *Write = (band_write *)Data;
+    Write->AovsWritten = WriteAovRows(Write->AovOutput, &Write->AccumulationFrameBuffer, &Write->SampleBuffer,
+                                      &Write->FeatureBuffer);
+}
+
+// false if a row of the band failed to write
+function bool
+WaitForBandWrite(job_system *JobSystem, band_write *Write)
+{
+    if (!Write->Pending)
+    {
+        return true;
+    }
+    WaitForJob(JobSystem, &Write->OutputJob);
+    if (Write->AovOutput)
+    {
+        WaitForJob(JobSystem, &Write->AovJob);
+    }
+    Write->Pending = false;
+    return Write->OutputWritten && (!Write->AovOutput || Write->AovsWritten);
+}
+
+// note(harlequin): every thread that records has to be stopped, a build without TRACER_PROFILE never has a path
+function bool
+SaveProfile(const char *ProfilePath)
+{
+#if TRACER_PROFILE
+    bool Success = true;
+    if (ProfilePath)
+    {
+        Success = WriteProfile(ProfilePath);
+        if (Success)
+        {
+            fprintf(stderr, "%s saved successfully\n", ProfilePath);
+        }
+        else
+        {
+            fprintf(stderr, "failed to save %s\n", ProfilePath);
+        }
+    }
+    FreeProfile();
+    return Success;
+#else
+    return true;
+#endif
+}
+
+// note(harlequin): what a worker traces its units with, FrameBuffer only takes the pixels TraceFrame resolves
+struct worker_context
+{
+    job_system     *JobSystem;
+    world          *World;
+    camera         *Camera;
+    trace_settings  TraceSettings;
+    frame_buffer   *FrameBuffer;
+};
+
+// a unit is a progressive render of its own, traced like a band of a local render
+function u64
+TraceWorkerUnit(void                   *Data,
+                const distributed_unit &Unit,
+                frame_buffer           *AccumulationFrameBuffer,
+                sample_buffer          *SampleBuffer,
+                feature_buffer         *FeatureBuffer)
+{
+    worker_context *Context = (worker_context *)Data;
+    if (Context->FrameBuffer->Height != Unit.RowCount)
+    {
+        ResizeFrameBuffer(Context->FrameBuffer, AccumulationFrameBuffer->Width, Unit.RowCount);
+    }
+
+    trace_settings TraceSettings = Context->TraceSettings;
+    TraceSettings.FirstRow       = Unit.FirstRow;
+    TraceSettings.MaxSampleCount = Unit.SampleCount;
+
+    progressive_settings ProgressiveSettings = {};
+    ProgressiveSettings.MaxSampleCount     = Unit.SampleCount;
+    ProgressiveSettings.TargetError        = Unit.TargetError;
+    ProgressiveSettings.MinimumSampleCount = Unit.MinimumSampleCount;
+
+    progressive_render Render = {};
+    BeginProgressiveRender(&Render, ProgressiveSettings);
+    while (ShouldTraceFrame(&Render))
+    {
+        TraceFrame(Context->JobSystem,
+                   Context->World,
+                   Context->Camera,
+                   TraceSettings,
+                   AccumulationFrameBuffer,
+                   SampleBuffer,
+                   FeatureBuffer,
+                   Context->FrameBuffer,
+                   Render.FrameCount + 1);
+        EndProgressiveFrame(&Render, SampleBuffer, Context->JobSystem->FrameStats.RayCount, Context->JobSystem->ActiveTileCount);
+    }
+    fprintf(stderr, "\rrows %u to %u, %.2f samples/pixel in %.2f s   ", Unit.FirstRow, Unit.FirstRow + Unit.RowCount - 1,
+            Render.SamplesPerPixel, Render.ElapsedSeconds);
+
+    u64 RayCount = Render.RayCount;
+    FreeProgressiveRender(&Render);
+    return RayCount;
+}
+
+int main(int ArgumentCount, char **Arguments)
+{
+    PROFILE_INITIALIZE();
+
+    headless_settings Settings = {};
+    Settings.Width              = 1280;
+    Settings.Height             = 720;
+    Settings.SampleCount        = 64;
+    Settings.RayBounceCount     = 64;
+    Settings.ThreadCount        = 0;
+    Settings.IdleSpinCount      = JOB_IDLE_SPIN_COUNT;
+    Settings.PacketTracing      = 1;
+    Settings.Integrator         = Integrator_Recursive;
+    Settings.Tonemapper         = Tonemapper_Clamp;
+    Settings.OutputPath         = "output.png";
+    Settings.NoiseThreshold     = 0.0f;
+    Settings.MinimumSampleCount = 8;
+    Settings.AovMask            = AOV_ALL_MASK;
+    Settings.LookFrom           = V3(0.0f, 0.0f, 0.0f);
+    Settings.LookAt             = V3(0.0f, 0.0f, -1.0f);
+    Settings.CheckpointSeconds  = 60.0f;
+    Settings.UnitTimeoutSeconds = DISTRIBUTED_UNIT_SECONDS;
+
+    if (!ParseHeadlessSettings(ArgumentCount, Arguments, &Settings))
+    {
+        PrintUsage(Arguments[0]);
+        return 1;
+    }
+
+    // note(harlequin): the buffers hold a band of BandHeight rows and the camera the whole image, every band is
+    // a progressive render of its own that is streamed to the output once it stops. the coordinator merges its
+    // units into the whole image and a worker traces into buffers of the units it is handed
+    u32 BandHeight = Settings.BandHeight && Settings.BandHeight < Settings.Height ? Settings.BandHeight : Settings.Height;
+    BandHeight = Settings.CoordinatorPort ? Settings.Height : Settings.WorkerAddress ? 1 : BandHeight;
+    u32 BandCount  = (Settings.Height + BandHeight - 1) / BandHeight;
+
+    frame_buffer AccumulationFrameBuffer = {};
+    InitializeFrameBuffer(&AccumulationFrameBuffer, Settings.Width, BandHeight);
+    ClearFrameBuffer(&AccumulationFrameBuffer);
+
+    sample_buffer SampleBuffer = {};
+    InitializeSampleBuffer(&SampleBuffer, Settings.Width, BandHeight);
+
+    // note(harlequin): the first hit features are only gathered when something reads them
+    bool GatherFeatures = Settings.DenoiseIterationCount || (Settings.AovPath && (Settings.AovMask & AOV_FEATURE_MASK));
+    feature_buffer FeatureBuffer = {};
+    if (GatherFeatures)
+    {
+        InitializeFeatureBuffer(&FeatureBuffer, Settings.Width, BandHeight);
+    }
+
+    frame_buffer FrameBuffer = {};
+    InitializeFrameBuffer(&FrameBuffer, Settings.Width, BandHeight);
+
+    const f32 FocalLength = 1.0f;
+    camera Camera = {};
+    InitializeCamera(&Camera,
+                     Settings.Width,
+                     Settings.Height,
+                     FocalLength,
+                     Settings.LookFrom);
+    LookAtCamera(&Camera, Settings.LookFrom, Settings.LookAt, V3(0.0f, 1.0f, 0.0f));
+    f32 FocusDistance = Settings.FocusDistance > 0.0f ? Settings.FocusDistance : Length(Settings.LookAt - Settings.LookFrom);
+    SetCameraLens(&Camera, Settings.ApertureRadius, FocusDistance);
+
+    world *World = (world *)calloc(1, sizeof(world));
+    if (Settings.ScenePath)
+    {
+        auto LoadStartTime = std::chrono::steady_clock::now();
+        bool Loaded = HasExtension(Settings.ScenePath, "scene") ? LoadSceneFile(World, Settings.ScenePath)
+                                                                : LoadTextScene(World, Settings.ScenePath, Settings.ThreadCount);
+        if (!Loaded)
+        {
+            return 1;
+        }
+        fprintf(stderr, "loaded %s: %u spheres, %u triangles in %.3f s\n",
+                Settings.ScenePath, World->SphereCount, World->TriangleCount,
+                std::chrono::duration< f64 >(std::chrono::steady_clock::now() - LoadStartTime).count());
+    }
+    else
+    {
+        PushDemoScene(World);
+    }
+
+    if (Settings.MeshPath && World->SceneFile.Data)
+    {
+        fprintf(stderr, "meshes cannot be added to a binary scene, add them to the text scene and convert it again\n");
+        return 1;
+    }
+
+    if (Settings.MeshPath)
+    {
+        auto LoadStartTime = std::chrono::steady_clock::now();
+        triangle_mesh Mesh;
+        if (!LoadTriangleMesh(Settings.MeshPath, &Mesh, Settings.ThreadCount))
+        {
+            return 1;
+        }
+        f64 LoadSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - LoadStartTime).count();
+        fprintf(stderr, "loaded %s: %u vertices, %u triangles in %.3f s\n",
+                Settings.MeshPath, Mesh.VertexCount, Mesh.TriangleCount, LoadSeconds);
+
+        // note(harlequin): fit the mesh into a 1.5 unit box floating above and behind the spheres
+        aabb Bounds = GetTriangleMeshBounds(&Mesh);
+        v3 Extent = Bounds.Max - Bounds.Min;
+        f32 LargestExtent = Maximium(VectorComponent(Extent, 0), Maximium(VectorComponent(Extent, 1), VectorComponent(Extent, 2)));
+        f32 Scale = LargestExtent > 0.0f ? 1.5f / LargestExtent : 1.0f;
+        v3 Translation = V3(0.0f, 0.6f, -2.5f) - GetAabbCenter(Bounds) * Scale;
+
+        u32 MaterialIndex = PushMaterial(World, V3(0.8f, 0.8f, 0.8f), 0.3f);
+        bool Pushed = PushTriangleMesh(World, &Mesh, MaterialIndex, Translation, Scale);
+        FreeTriangleMesh(&Mesh);
+        if (!Pushed)
+        {
+            fprintf(stderr, "failed to add %s to the scene\n", Settings.MeshPath);
+            return 1;
+        }
+    }
+    if (!World->SceneFile.Data)
+    {
+        auto BuildStartTime = std::chrono::steady_clock::now();
+        if (!BuildWorldBvh(World))
+        {
+            fprintf(stderr, "failed to build the scene bvh\n");
+            return 1;
+        }
+        fprintf(stderr, "built the scene bvhs in %.3f s\n",
+                std::chrono::duration< f64 >(std::chrono::steady_clock::now() - BuildStartTime).count());
+    }
+
+    job_system *JobSystem = new(malloc(sizeof(job_system))) job_system {};
+    InitializeJobSystem(JobSystem, Settings.ThreadCount);
+    JobSystem->IdleSpinCount = Settings.IdleSpinCount;
+
+    trace_settings TraceSettings = {};
+    TraceSettings.RayBounceCount     = Settings.RayBounceCount;
+    TraceSettings.Integrator         = Settings.Integrator;
+    TraceSettings.PacketTracing      = Settings.PacketTracing != 0;
+    TraceSettings.Seed               = Settings.Seed;
+    TraceSettings.AdaptiveSampling   = Settings.NoiseThreshold > 0.0f;
+    TraceSettings.NoiseThreshold     = Settings.NoiseThreshold;
+    TraceSettings.MinimumSampleCount = Settings.MinimumSampleCount;
+    TraceSettings.MaxSampleCount     = Settings.SampleCount;
+    TraceSettings.Tonemapper         = Settings.Tonemapper;
+
+    // note(harlequin): the hash is of the whole image, FirstRow is still 0
+    u32 UnitHeight = Settings.BandHeight ? Settings.BandHeight : DISTRIBUTED_UNIT_HEIGHT;
+    distributed_settings Distributed = {};
+    Distributed.RenderHash         = HashRenderInputs(World, &Camera, TraceSettings);
+    Distributed.Width              = Settings.Width;
+    Distributed.Height             = Settings.Height;
+    Distributed.UnitHeight         = UnitHeight < Settings.Height ? UnitHeight : Settings.Height;
+    Distributed.SampleCount        = Settings.SampleCount;
+    Distributed.TargetError        = Settings.TargetError;
+    Distributed.MinimumSampleCount = Settings.MinimumSampleCount;
+    Distributed.GatherFeatures     = GatherFeatures;
+    Distributed.UnitSeconds        = Settings.UnitTimeoutSeconds;
+
+    if (Settings.WorkerAddress)
+    {
+        fprintf(stderr, "tracing units for %s on %u threads\n", Settings.WorkerAddress, JobSystem->ThreadCount);
+        worker_context Context = { JobSystem, World, &Camera, TraceSettings, &FrameBuffer };
+        bool Traced = RunWorker(Settings.WorkerAddress, Distributed, TraceWorkerUnit, &Context);
+        ShutdownJobSystem(JobSystem);
+        JobSystem->~job_system();
+        free(JobSystem);
+        FreeWorld(World);
+        free(World);
+        FreeFrameBuffer(&AccumulationFrameBuffer);
+        FreeSampleBuffer(&SampleBuffer);
+        FreeFeatureBuffer(&FeatureBuffer);
+        FreeFrameBuffer(&FrameBuffer);
+        Traced &= SaveProfile(Settings.ProfilePath);
+        return Traced ? 0 : 1;
+    }
+
+    fprintf(stderr,
+            "rendering %ux%u, %u samples, %u bounces, %s integrator on %u threads\n",
+            Settings.Width,
+            Settings.Height,
+            Settings.SampleCount,
+            Settings.RayBounceCount,
+            IntegratorNames[Settings.Integrator],
+            JobSystem->ThreadCount);
+    if (BandCount > 1)
+    {
+        fprintf(stderr, "in %u bands of %u rows\n", BandCount, BandHeight);
+    }
+
+    trace_stats TotalStats = {};
+    f64 TotalFrameSeconds = 0.0;
+    f64 *TotalBusySeconds = (f64 *)calloc(JobSystem->ThreadCount, sizeof(f64));
+    u32 *TotalStolenTileCount = (u32 *)calloc(JobSystem->ThreadCount, sizeof(u32));
+
+    // note(harlequin): checkpoints only exist for whole image renders, so their buffers are the band buffers
+    checkpoint_writer CheckpointWriter = {};
+    checkpoint_header Checkpoint = {};
+    bool Resumed = false;
+    if (Settings.CheckpointPath)
+    {
+        Checkpoint.InputHash   = HashRenderInputs(World, &Camera, TraceSettings);
+        Checkpoint.Width       = Settings.Width;
+        Checkpoint.Height      = Settings.Height;
+        Checkpoint.HasFeatures = GatherFeatures;
+
+        checkpoint_load Load = CheckpointLoad_Missing;
+        if (Settings.Resume)
+        {
+            Load = LoadCheckpoint(Settings.CheckpointPath, &Checkpoint, &AccumulationFrameBuffer, &SampleBuffer,
+                                  GatherFeatures ? &FeatureBuffer : nullptr);
+        }
+        if (Load == CheckpointLoad_Loaded)
+        {
+            fprintf(stderr, "resuming %s at sample %u after %.2f s\n", Settings.CheckpointPath, Checkpoint.FrameCount,
+                    Checkpoint.ElapsedSeconds);
+            Resumed = true;
+
+            // note(harlequin): tiles retired by adaptive sampling are never traced again, so nothing else would resolve them
+            ResolvePixels(AccumulationFrameBuffer.Pixels, SampleBuffer.Pixels, FrameBuffer.Pixels,
+                          FrameBuffer.Width * FrameBuffer.Height, Settings.Tonemapper);
+        }
+        else if (Settings.Resume && Load == CheckpointLoad_Missing)
+        {
+            fprintf(stderr, "%s does not exist yet, starting a new render\n", Settings.CheckpointPath);
+        }
+        if (Load == CheckpointLoad_Failed ||
+            !StartCheckpointWriter(&CheckpointWriter, Settings.CheckpointPath, Settings.Width, Settings.Height, GatherFeatures))
+        {
+            return 1;
+        }
+    }
+
+    image_format OutputFormat;
+    GetImageFormat(Settings.OutputPath, &OutputFormat);
+    const char *OutputChannelNames[3] = { "R", "G", "B" };
+    image_writer OutputWriter;
+    bool Success = BeginImageWriter(&OutputWriter, Settings.OutputPath, OutputFormat, Settings.Width, Settings.Height,
+                                    OutputChannelNames, ArrayCount(OutputChannelNames));
+
+    // note(harlequin): the aovs come from the accumulation, so they are the linear image from before the denoiser
+    aov_output AovOutput = {};
+    if (Settings.AovPath)
+    {
+        Success &= BeginAovOutput(&AovOutput, Settings.AovPath, Settings.AovMask, Settings.Width, Settings.Height);
+    }
+
+    // note(harlequin): bands trace into two sets of buffers by turns, the spare set is the one being written out
+    frame_buffer   SpareAccumulationFrameBuffer = {};
+    sample_buffer  SpareSampleBuffer            = {};
+    feature_buffer SpareFeatureBuffer           = {};
+    frame_buffer   SpareFrameBuffer             = {};
+    if (BandCount > 1)
+    {
+        InitializeFrameBuffer(&SpareAccumulationFrameBuffer, Settings.Width, BandHeight);
+        InitializeSampleBuffer(&SpareSampleBuffer, Settings.Width, BandHeight);
+        InitializeFrameBuffer(&SpareFrameBuffer, Settings.Width, BandHeight);
+        if (GatherFeatures)
+        {
+            InitializeFeatureBuffer(&SpareFeatureBuffer, Settings.Width, BandHeight);
+        }
+    }
+    band_write BandWrites[2];
+    for (u32 WriteIndex = 0; WriteIndex < ArrayCount(BandWrites); WriteIndex++)
+    {
+        band_write *Write = BandWrites + WriteIndex;
+        Write->OutputWriter = &OutputWriter;
+        Write->AovOutput    = Settings.AovPath ? &AovOutput : nullptr;
+        Write->Scratch      = (f32 *)malloc(sizeof(f32) * 3 * Settings.Width * AOV_BAND_HEIGHT);
+        Write->Pending      = false;
+        Success &= Write->Scratch != nullptr;
+    }
+
+    auto RenderStartTime = std::chrono::steady_clock::now();
+    f64 SampleSum = 0.0;
+    progressive_render Render = {};
+    for (u32 BandIndex = 0; Success && BandIndex < BandCount; BandIndex++)
+    {
+        u32 FirstRow = BandIndex * BandHeight;
+        u32 RowCount = Settings.Height - FirstRow < BandHeight ? Settings.Height - FirstRow : BandHeight;
+
+        // note(harlequin): the buffers are the ones of the band before the last, which have to be out first
+        band_write *Write = BandWrites + BandIndex % ArrayCount(BandWrites);
+        Success &= WaitForBandWrite(JobSystem, Write);
+
+        if (RowCount != FrameBuffer.Height)
+        {
+            ResizeFrameBuffer(&AccumulationFrameBuffer, Settings.Width, RowCount);
+            ResizeSampleBuffer(&SampleBuffer, Settings.Width, RowCount);
+            ResizeFrameBuffer(&FrameBuffer, Settings.Width, RowCount);
+            if (GatherFeatures)
+            {
+                ResizeFeatureBuffer(&FeatureBuffer, Settings.Width, RowCount);
+            }
+        }
+        TraceSettings.FirstRow = FirstRow;
+
+        // note(harlequin): a band gets the share of the time left that its rows are of the rows left, a band past
+        // the budget still traces its first frame so the image is complete
+        f64 ElapsedSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - RenderStartTime).count();
+        f64 BandSeconds    = ((f64)Settings.TimeBudgetSeconds - ElapsedSeconds) * RowCount / (f64)(Settings.Height - FirstRow);
+
+        progressive_settings ProgressiveSettings = {};
+        ProgressiveSettings.TimeBudgetSeconds  = Settings.TimeBudgetSeconds > 0.0f ? (BandSeconds > 1e-6 ? BandSeconds : 1e-6) : 0.0;
+        ProgressiveSettings.MaxSampleCount     = Settings.SampleCount;
+        ProgressiveSettings.TargetError        = Settings.TargetError;
+        ProgressiveSettings.MinimumSampleCount = Settings.MinimumSampleCount;
+
+        FreeProgressiveRender(&Render);
+        BeginProgressiveRender(&Render, ProgressiveSettings);
+        if (Resumed)
+        {
+            ResumeProgressiveRender(&Render, &SampleBuffer, Checkpoint.FrameCount, Checkpoint.RayCount, Checkpoint.ElapsedSeconds);
+        }
+        auto CheckpointTime = std::chrono::steady_clock::now();
+
+        // note(harlequin): the coordinator's only band is the whole image, the workers trace it and the frame loop
+        // below is skipped
+        if (Settings.CoordinatorPort)
+        {
+            u64 RayCount = 0;
+            Success &= RunCoordinator((u16)Settings.CoordinatorPort, Distributed, &AccumulationFrameBuffer, &SampleBuffer,
+                                      GatherFeatures ? &FeatureBuffer : nullptr, &RayCount);
+            ResolvePixels(AccumulationFrameBuffer.Pixels, SampleBuffer.Pixels, FrameBuffer.Pixels,
+                          FrameBuffer.Width * FrameBuffer.Height, Settings.Tonemapper);
+
+            f64 ElapsedSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - RenderStartTime).count();
+            ResumeProgressiveRender(&Render, &SampleBuffer, Settings.SampleCount, RayCount, ElapsedSeconds);
+            TotalStats.RayCount += RayCount;
+            TotalFrameSeconds   += ElapsedSeconds;
+        }
+
+        while (!Settings.CoordinatorPort && ShouldTraceFrame(&Render))
+        {
+            TraceFrame(JobSystem,
+                       World,
+                       &Camera,
+                       TraceSettings,
+                       &AccumulationFrameBuffer,
+                       &SampleBuffer,
+                       GatherFeatures ? &FeatureBuffer : nullptr,
+                       &FrameBuffer,
+                       Render.FrameCount + 1);
+            EndProgressiveFrame(&Render, &SampleBuffer, JobSystem->FrameStats.RayCount, JobSystem->ActiveTileCount);
+
+            // note(harlequin): a checkpoint is skipped, and tried again after the next frame, while the last is still being written
+            if (Settings.CheckpointPath &&
+                std::chrono::duration< f64 >(std::chrono::steady_clock::now() - CheckpointTime).count() >= Settings.CheckpointSeconds)
+            {
+                Checkpoint.FrameCount     = Render.FrameCount;
+                Checkpoint.RayCount       = Render.RayCount;
+                Checkpoint.ElapsedSeconds = Render.ElapsedSeconds;
+                if (QueueCheckpoint(&CheckpointWriter, Checkpoint, &AccumulationFrameBuffer, &SampleBuffer, &FeatureBuffer))
+                {
+                    CheckpointTime = std::chrono::steady_clock::now();
+                }
+            }
+
+            TotalStats.RayCount           += JobSystem->FrameStats.RayCount;
+            TotalStats.NodeTestCount      += JobSystem->FrameStats.NodeTestCount;
+            TotalStats.PrimitiveTestCount += JobSystem->FrameStats.PrimitiveTestCount;
+            TotalFrameSeconds += JobSystem->FrameSeconds;
+            for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+            {
+                TotalBusySeconds[ThreadIndex]     += JobSystem->ThreadStorage[ThreadIndex].BusySeconds;
+                TotalStolenTileCount[ThreadIndex] += JobSystem->ThreadStorage[ThreadIndex].StolenTileCount;
+            }
+
+            // note(harlequin): the convergence curve as it goes, the full curve goes to --curve
+            char ErrorText[32] = "-";
+            if (Render.Error != MAX_F32)
+            {
+                snprintf(ErrorText, sizeof(ErrorText), "%.4f", Render.Error);
+            }
+            fprintf(stderr, "\r");
+            if (BandCount > 1)
+            {
+                fprintf(stderr, "band %u/%u, ", BandIndex + 1, BandCount);
+            }
+            fprintf(stderr, "sample %u/%u, %.2f s, %.2f samples/pixel, error %s", Render.FrameCount, Settings.SampleCount,
+                    Render.ElapsedSeconds, Render.SamplesPerPixel, ErrorText);
+            if (TraceSettings.AdaptiveSampling)
+            {
+                fprintf(stderr, ", %u/%u tiles active", JobSystem->ActiveTileCount, JobSystem->TileCount);
+            }
+            fprintf(stderr, "   ");
+        }
+        SampleSum += (f64)Render.SamplesPerPixel * RowCount;
+
+        // note(harlequin): the last checkpoint is of the finished render, so it can be resumed with more samples
+        if (Settings.CheckpointPath)
+        {
+            Checkpoint.FrameCount     = Render.FrameCount;
+            Checkpoint.RayCount       = Render.RayCount;
+            Checkpoint.ElapsedSeconds = Render.ElapsedSeconds;
+            WaitForCheckpoint(&CheckpointWriter);
+            QueueCheckpoint(&CheckpointWriter, Checkpoint, &AccumulationFrameBuffer, &SampleBuffer, &FeatureBuffer);
+        }
+
+        if (Settings.DenoiseIterationCount)
+        {
+            denoise_settings DenoiseSettings = DefaultDenoiseSettings();
+            DenoiseSettings.IterationCount = Settings.DenoiseIterationCount;
+            DenoiseSettings.Tonemapper     = Settings.Tonemapper;
+
+            denoiser Denoiser = {};
+            auto DenoiseStartTime = std::chrono::steady_clock::now();
+            if (DenoiseFrame(JobSystem, &Denoiser, DenoiseSettings, &AccumulationFrameBuffer, &SampleBuffer, &FeatureBuffer, &FrameBuffer))
+            {
+                fprintf(stderr, "\ndenoised in %.3f s",
+                        std::chrono::duration< f64 >(std::chrono::steady_clock::now() - DenoiseStartTime).count());
+            }
+            FreeDenoiser(&Denoiser);
+        }
+
+        // note(harlequin): a writer takes the bands in order, so the writes of a band run after the ones of the band before
+        Write->AccumulationFrameBuffer = AccumulationFrameBuffer;
+        Write->SampleBuffer            = SampleBuffer;
+        Write->FeatureBuffer           = FeatureBuffer;
+        Write->FrameBuffer             = FrameBuffer;
+        Write->Pending                 = true;
+        band_write *PreviousWrite = BandWrites + (BandIndex + 1) % ArrayCount(BandWrites);
+        InitializeJob(&Write->OutputJob, WriteBandOutput, Write);
+        if (PreviousWrite->Pending)
+        {
+            bool Added = AddJobDependency(&Write->OutputJob, &PreviousWrite->OutputJob);
+            Assert(Added);
+        }
+        SubmitJob(JobSystem, &Write->OutputJob);
+        if (Write->AovOutput)
+        {
+            InitializeJob(&Write->AovJob, WriteBandAovs, Write);
+            if (PreviousWrite->Pending)
+            {
+                bool Added = AddJobDependency(&Write->AovJob, &PreviousWrite->AovJob);
+                Assert(Added);
+            }
+            SubmitJob(JobSystem, &Write->AovJob);
+        }
+
+        if (BandCount > 1)
+        {
+            std::swap(AccumulationFrameBuffer, SpareAccumulationFrameBuffer);
+            std::swap(SampleBuffer, SpareSampleBuffer);
+            std::swap(FeatureBuffer, SpareFeatureBuffer);
+            std::swap(FrameBuffer, SpareFrameBuffer);
+        }
+    }
+    for (u32 WriteIndex = 0; WriteIndex < ArrayCount(BandWrites); WriteIndex++)
+    {
+        Success &= WaitForBandWrite(JobSystem, BandWrites + WriteIndex);
+    }
+
+    f64 RenderSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - RenderStartTime).count();
+    if (BandCount > 1)
+    {
+        fprintf(stderr, "\nrendered %u bands in %.3f s\n", BandCount, RenderSeconds);
+    }
+    else if (Settings.CoordinatorPort)
+    {
+        fprintf(stderr, "\nrendered in %.3f s by the workers\n", Render.ElapsedSeconds);
+    }
+    else
+    {
+        fprintf(stderr, "\nrendered in %.3f s, stopped by the %s\n", Render.ElapsedSeconds,
+                ProgressiveStopReasonNames[Render.StopReason]);
+    }
+
+    // note(harlequin): a worker only reports the rays of a unit, the coordinator has no traversal counts to show
+    f64 OneOverRayCount = TotalStats.RayCount ? 1.0 / (f64)TotalStats.RayCount : 0.0;
+    fprintf(stderr,
+            "%llu rays (%.2f Mrays/s)",
+            (unsigned long long)TotalStats.RayCount,
+            TotalFrameSeconds > 0.0 ? (f64)TotalStats.RayCount / TotalFrameSeconds * 1e-6 : 0.0);
+    if (!Settings.CoordinatorPort)
+    {
+        fprintf(stderr,
+                ", %.2f node tests/ray, %.2f primitive tests/ray",
+                (f64)TotalStats.NodeTestCount * OneOverRayCount,
+                (f64)TotalStats.PrimitiveTestCount * OneOverRayCount);
+    }
+    fprintf(stderr, "\n");
+
+    if (TraceSettings.AdaptiveSampling)
+    {
+        fprintf(stderr, "adaptive sampling: %.2f samples/pixel on average", SampleSum / (f64)Settings.Height);
+        if (BandCount == 1 && !Settings.CoordinatorPort)
+        {
+            fprintf(stderr, ", %u of %u tiles still above %g", JobSystem->ActiveTileCount, JobSystem->TileCount, Settings.NoiseThreshold);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    if (Settings.CurvePath && SaveConvergenceCurve(&Render, Settings.CurvePath))
+    {
+        fprintf(stderr, "%s saved successfully\n", Settings.CurvePath);
+    }
+    FreeProgressiveRender(&Render);
+
+    for (u32 ThreadIndex = 0; !Settings.CoordinatorPort && ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+    {
+        f64 Utilization = TotalFrameSeconds > 0.0 ? TotalBusySeconds[ThreadIndex] / TotalFrameSeconds : 0.0;
+        fprintf(stderr,
+                "thread %3u: %5.1f%% busy, %u tiles stolen\n",
+                ThreadIndex,
+                Utilization * 100.0,
+                TotalStolenTileCount[ThreadIndex]);
+    }
+
+    ShutdownJobSystem(JobSystem);
+    JobSystem->~job_system();
+    free(JobSystem);
+    free(TotalBusySeconds);
+    free(TotalStolenTileCount);
+    FreeWorld(World);
+    free(World);
+
+    if (Settings.CheckpointPath && CheckpointWriter.Thread.joinable())
+    {
+        if (StopCheckpointWriter(&CheckpointWriter))
+        {
+            fprintf(stderr, "%s saved successfully\n", Settings.CheckpointPath);
+        }
+        else
+        {
+            Success = false;
+        }
+    }
+
+    // note(harlequin): only the output file itself, the writer knows about failed or missing rows and a failed
+    // checkpoint already said so
+    if (EndImageWriter(&OutputWriter))
+    {
+        fprintf(stderr, "%s saved successfully\n", Settings.OutputPath);
+    }
+    else
+    {
+        fprintf(stderr, "failed to save %s\n", Settings.OutputPath);
+        Success = false;
+    }
+    for (u32 WriteIndex = 0; WriteIndex < ArrayCount(BandWrites); WriteIndex++)
+    {
+        free(BandWrites[WriteIndex].Scratch);
+    }
+
+    if (Settings.AovPath)
+    {
+        if (EndAovOutput(&AovOutput))
+        {
+            for (u32 FileIndex = 0; FileIndex < AovOutput.FileCount; FileIndex++)
+            {
+                fprintf(stderr, "%s saved successfully\n", AovOutput.FilePaths[FileIndex]);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "failed to write the aovs to %s\n", Settings.AovPath);
+            Success = false;
+        }
+    }
+    FreeFrameBuffer(&AccumulationFrameBuffer);
+    FreeSampleBuffer(&SampleBuffer);
+    FreeFeatureBuffer(&FeatureBuffer);
+    FreeFrameBuffer(&FrameBuffer);
+    FreeFrameBuffer(&SpareAccumulationFrameBuffer);
+    FreeSampleBuffer(&SpareSampleBuffer);
+    FreeFeatureBuffer(&SpareFeatureBuffer);
+    FreeFrameBuffer(&SpareFrameBuffer);
+    Success &= SaveProfile(Settings.ProfilePath);
+
+    return Success ? 0 : 1;
+}
@@ -0,0 +1,979 @@
+#include "tracer_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+bool
+SavePngImageToDisk(const char *FilePath,
+                   color8     *Image,
+                   u32         ImageWidth,
+                   u32         ImageHeight)
+{
+    i32 result = stbi_write_png(FilePath,
+                                ImageWidth,
+                                ImageHeight,
+                                3,
+                                Image,
+                                sizeof(color8) * ImageWidth);
+    return result != 0;
+}
+
+bool
+SaveFrameBufferToPng(const char   *FilePath,
+                     frame_buffer *FrameBuffer)
+{
+    u32 PixelCount = FrameBuffer->Width * FrameBuffer->Height;
+    color8 *OutputImage = (color8 *)malloc(sizeof(color8) * PixelCount);
+    if (!OutputImage)
+    {
+        return false;
+    }
+
+    for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+    {
+        color8 *OutputPixel = OutputImage + PixelIndex;
+        v3 *FrameBufferPixel = FrameBuffer->Pixels + PixelIndex;
+        *OutputPixel = NormalizedColorToColor8(*FrameBufferPixel);
+    }
+
+    bool Success = SavePngImageToDisk(FilePath,
+                                      OutputImage,
+                                      FrameBuffer->Width,
+                                      FrameBuffer->Height);
+    free(OutputImage);
+    return Success;
+}
+
+// note(harlequin): the exr header is built in memory, little endian like every target we build for
+struct header_writer
+{
+    u8  Bytes[4096];
+    u32 Size;
+};
+
+function void
+PushHeaderBytes(header_writer *Header, const void *Bytes, u32 Size)
+{
+    Assert(Header->Size + Size <= sizeof(Header->Bytes));
+    memcpy(Header->Bytes + Header->Size, Bytes, Size);
+    Header->Size += Size;
+}
+
+function void
+PushHeaderString(header_writer *Header, const char *String)
+{
+    PushHeaderBytes(Header, String, (u32)strlen(String) + 1);
+}
+
+function void
+PushHeaderU8(header_writer *Header, u8 Value)
+{
+    PushHeaderBytes(Header, &Value, sizeof(Value));
+}
+
+function void
+PushHeaderI32(header_writer *Header, i32 Value)
+{
+    PushHeaderBytes(Header, &Value, sizeof(Value));
+}
+
+function void
+PushHeaderF32(header_writer *Header, f32 Value)
+{
+    PushHeaderBytes(Header, &Value, sizeof(Value));
+}
+
+function void
+PushHeaderAttribute(header_writer *Header, const char *Name, const char *Type, i32 Size)
+{
+    PushHeaderString(Header, Name);
+    PushHeaderString(Header, Type);
+    PushHeaderI32(Header, Size);
+}
+
+function bool
+WriteExrHeader(image_writer      *Writer,
+               const char *const *ChannelNames)
+{
+    // note(harlequin): insertion sort, there are at most IMAGE_MAX_CHANNEL_COUNT channels
+    u32 ChannelCount = Writer->ChannelCount;
+    for (u32 ChannelIndex = 0; ChannelIndex < ChannelCount; ChannelIndex++)
+    {
+        u32 Slot = ChannelIndex;
+        while (Slot > 0 && strcmp(ChannelNames[Writer->ChannelOrder[Slot - 1]], ChannelNames[ChannelIndex]) > 0)
+        {
+            Writer->ChannelOrder[Slot] = Writer->ChannelOrder[Slot - 1];
+            Slot--;
+        }
+        Writer->ChannelOrder[Slot] = ChannelIndex;
+    }
+
+    header_writer Header = {};
+    const u8 Magic[4]   = { 0x76, 0x2f, 0x31, 0x01 };
+    const u8 Version[4] = { 2, 0, 0, 0 }; // single part scanline image
+    PushHeaderBytes(&Header, Magic, sizeof(Magic));
+    PushHeaderBytes(&Header, Version, sizeof(Version));
+
+    i32 ChannelListSize = 1;
+    for (u32 ChannelIndex = 0; ChannelIndex < ChannelCount; ChannelIndex++)
+    {
+        ChannelListSize += (i32)strlen(ChannelNames[ChannelIndex]) + 1 + 16;
+    }
+    PushHeaderAttribute(&Header, "channels", "chlist", ChannelListSize);
+    for (u32 ChannelIndex = 0; ChannelIndex < ChannelCount; ChannelIndex++)
+    {
+        const u8 Linear[4] = {};
+        PushHeaderString(&Header, ChannelNames[Writer->ChannelOrder[ChannelIndex]]);
+        PushHeaderI32(&Header, 2); // float
+        PushHeaderBytes(&Header, Linear, sizeof(Linear));
+        PushHeaderI32(&Header, 1);
+        PushHeaderI32(&Header, 1);
+    }
+    PushHeaderU8(&Header, 0);
+
+    PushHeaderAttribute(&Header, "compression", "compression", 1);
+    PushHeaderU8(&Header, 0); // none
+
+    const char *WindowNames[2] = { "dataWindow", "displayWindow" };
+    for (u32 WindowIndex = 0; WindowIndex < ArrayCount(WindowNames); WindowIndex++)
+    {
+        PushHeaderAttribute(&Header, WindowNames[WindowIndex], "box2i", 16);
+        PushHeaderI32(&Header, 0);
+        PushHeaderI32(&Header, 0);
+        PushHeaderI32(&Header, (i32)Writer->Width - 1);
+        PushHeaderI32(&Header, (i32)Writer->Height - 1);
+    }
+
+    PushHeaderAttribute(&Header, "lineOrder", "lineOrder", 1);
+    PushHeaderU8(&Header, 0); // increasing y
+
+    PushHeaderAttribute(&Header, "pixelAspectRatio", "float", 4);
+    PushHeaderF32(&Header, 1.0f);
+
+    PushHeaderAttribute(&Header, "screenWindowCenter", "v2f", 8);
+    PushHeaderF32(&Header, 0.0f);
+    PushHeaderF32(&Header, 0.0f);
+
+    PushHeaderAttribute(&Header, "screenWindowWidth", "float", 4);
+    PushHeaderF32(&Header, 1.0f);
+
+    PushHeaderU8(&Header, 0);
+
+    if (fwrite(Header.Bytes, 1, Header.Size, Writer->File) != Header.Size)
+    {
+        return false;
+    }
+
+    // note(harlequin): every scanline chunk has the same size, so the offset table is written before any pixel
+    u64 ChunkSize = 8 + (u64)Writer->Width * ChannelCount * sizeof(f32);
+    Writer->DataOffset = Header.Size + (u64)Writer->Height * sizeof(u64);
+    for (u32 Y = 0; Y < Writer->Height; Y++)
+    {
+        u64 Offset = Writer->DataOffset + (u64)Y * ChunkSize;
+        if (fwrite(&Offset, sizeof(Offset), 1, Writer->File) != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+GetImageFormat(const char   *FilePath,
+               image_format *OutFormat)
+{
+    const char *Extensions[] = { "pfm", "exr", "ppm", "png" };
+    for (u32 FormatIndex = 0; FormatIndex < ArrayCount(Extensions); FormatIndex++)
+    {
+        if (HasExtension(FilePath, Extensions[FormatIndex]))
+        {
+            *OutFormat = (image_format)FormatIndex;
+            return true;
+        }
+    }
+    return false;
+}
+
+// note(harlequin): the png is a single zlib stream cut into one IDAT chunk per WriteImageRows. every band is a
+// deflate block with the fixed huffman codes and greedy lz77 matches that stay inside the band, so the band and
+// the row above it are all that is kept. the bits of a block that do not fill a byte go out with the next chunk
+#define PNG_HASH_BIT_COUNT     15
+#define PNG_MIN_MATCH_LENGTH   3
+#define PNG_MAX_MATCH_LENGTH   258
+#define PNG_MAX_MATCH_DISTANCE 32768
+#define PNG_BYTES_PER_PIXEL    3
+
+struct png_stream
+{
+    u8  *Filtered;           // the filter type and the filtered bytes of every row of the band
+    u64  FilteredCapacity;
+    u8  *Compressed;
+    u64  CompressedCapacity;
+    u64  CompressedSize;
+    u8  *Row;
+    u8  *PreviousRow;        // zeros above the first row
+    u32 *Hash;               // position + 1 of the last 3 bytes of Filtered with that hash
+    u32  BitBuffer;
+    u32  BitCount;
+    u32  AdlerA;
+    u32  AdlerB;
+};
+
+global_variable const u16 DeflateLengthBases[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+global_variable const u8 DeflateLengthExtraBits[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+global_variable const u16 DeflateDistanceBases[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+
+global_variable const u8 DeflateDistanceExtraBits[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+global_variable u32 PngCrcTable[256];
+
+function u32
+UpdatePngCrc(u32 Crc, const u8 *Bytes, u64 Size)
+{
+    if (!PngCrcTable[1])
+    {
+        for (u32 Index = 0; Index < 256; Index++)
+        {
+            u32 Value = Index;
+            for (u32 BitIndex = 0; BitIndex < 8; BitIndex++)
+            {
+                Value = Value & 1 ? 0xEDB88320u ^ (Value >> 1) : Value >> 1;
+            }
+            PngCrcTable[Index] = Value;
+        }
+    }
+
+    for (u64 Index = 0; Index < Size; Index++)
+    {
+        Crc = PngCrcTable[(Crc ^ Bytes[Index]) & 0xFF] ^ (Crc >> 8);
+    }
+    return Crc;
+}
+
+function void
+PushBigEndianU32(u8 *Bytes, u32 Value)
+{
+    Bytes[0] = (u8)(Value >> 24);
+    Bytes[1] = (u8)(Value >> 16);
+    Bytes[2] = (u8)(Value >> 8);
+    Bytes[3] = (u8)Value;
+}
+
+function bool
+WritePngChunk(FILE *File, const char *Type, const u8 *Data, u64 Size)
+{
+    Assert(Size < 0x80000000ull);
+
+    u8 Header[8];
+    PushBigEndianU32(Header, (u32)Size);
+    memcpy(Header + 4, Type, 4);
+
+    u8 Footer[4];
+    u32 Crc = UpdatePngCrc(0xFFFFFFFFu, Header + 4, 4);
+    Crc = UpdatePngCrc(Crc, Data, Size);
+    PushBigEndianU32(Footer, Crc ^ 0xFFFFFFFFu);
+
+    return fwrite(Header, sizeof(Header), 1, File) == 1 &&
+           (!Size || fwrite(Data, 1, Size, File) == Size) &&
+           fwrite(Footer, sizeof(Footer), 1, File) == 1;
+}
+
+function void
+PushDeflateBits(png_stream *Png, u32 Bits, u32 BitCount)
+{
+    Png->BitBuffer |= Bits << Png->BitCount;
+    Png->BitCount  += BitCount;
+    while (Png->BitCount >= 8)
+    {
+        Png->Compressed[Png->CompressedSize++] = (u8)Png->BitBuffer;
+        Png->BitBuffer >>= 8;
+        Png->BitCount   -= 8;
+    }
+}
+
+// note(harlequin): huffman codes go out from their most significant bit, everything else from the least
+function void
+PushDeflateCode(png_stream *Png, u32 Code, u32 BitCount)
+{
+    u32 Reversed = 0;
+    for (u32 BitIndex = 0; BitIndex < BitCount; BitIndex++)
+    {
+        Reversed = (Reversed << 1) | ((Code >> BitIndex) & 1);
+    }
+    PushDeflateBits(Png, Reversed, BitCount);
+}
+
+function void
+PushDeflateSymbol(png_stream *Png, u32 Symbol)
+{
+    if (Symbol < 144)
+    {
+        PushDeflateCode(Png, 0x30 + Symbol, 8);
+    }
+    else if (Symbol < 256)
+    {
+        PushDeflateCode(Png, 0x190 + Symbol - 144, 9);
+    }
+    else if (Symbol < 280)
+    {
+        PushDeflateCode(Png, Symbol - 256, 7);
+    }
+    else
+    {
+        PushDeflateCode(Png, 0xC0 + Symbol - 280, 8);
+    }
+}
+
+function void
+PushDeflateMatch(png_stream *Png, u32 Length, u32 Distance)
+{
+    u32 LengthCode = ArrayCount(DeflateLengthBases) - 1;
+    while (DeflateLengthBases[LengthCode] > Length)
+    {
+        LengthCode--;
+    }
+    PushDeflateSymbol(Png, 257 + LengthCode);
+    PushDeflateBits(Png, Length - DeflateLengthBases[LengthCode], DeflateLengthExtraBits[LengthCode]);
+
+    u32 DistanceCode = ArrayCount(DeflateDistanceBases) - 1;
+    while (DeflateDistanceBases[DistanceCode] > Distance)
+    {
+        DistanceCode--;
+    }
+    PushDeflateCode(Png, DistanceCode, 5);
+    PushDeflateBits(Png, Distance - DeflateDistanceBases[DistanceCode], DeflateDistanceExtraBits[DistanceCode]);
+}
+
+inline u32
+HashDeflateBytes(const u8 *Bytes)
+{
+    u32 Value = ((u32)Bytes[0] << 16) | ((u32)Bytes[1] << 8) | (u32)Bytes[2];
+    return (Value * 2654435761u) >> (32 - PNG_HASH_BIT_COUNT);
+}
+
+function void
+DeflateBlock(png_stream *Png, const u8 *Data, u32 Size)
+{
+    PushDeflateBits(Png, 2, 3); // not the final block, fixed huffman codes
+    memset(Png->Hash, 0, sizeof(u32) << PNG_HASH_BIT_COUNT);
+
+    u32 Position = 0;
+    while (Position < Size)
+    {
+        u32 MatchLength   = 0;
+        u32 MatchDistance = 0;
+        if (Position + PNG_MIN_MATCH_LENGTH <= Size)
+        {
+            u32 HashIndex = HashDeflateBytes(Data + Position);
+            u32 Candidate = Png->Hash[HashIndex];
+            Png->Hash[HashIndex] = Position + 1;
+
+            if (Candidate && Position + 1 - Candidate <= PNG_MAX_MATCH_DISTANCE)
+            {
+                const u8 *Match = Data + Candidate - 1;
+                u32 MaxLength = Size - Position < PNG_MAX_MATCH_LENGTH ? Size - Position : PNG_MAX_MATCH_LENGTH;
+                u32 Length = 0;
+                while (Length < MaxLength && Match[Length] == Data[Position + Length])
+                {
+                    Length++;
+                }
+                if (Length >= PNG_MIN_MATCH_LENGTH)
+                {
+                    MatchLength   = Length;
+                    MatchDistance = Position + 1 - Candidate;
+                }
+            }
+        }
+
+        if (MatchLength)
+        {
+            PushDeflateMatch(Png, MatchLength, MatchDistance);
+            for (u32 Skipped = Position + 1; Skipped < Position + MatchLength && Skipped + PNG_MIN_MATCH_LENGTH <= Size; Skipped++)
+            {
+                Png->Hash[HashDeflateBytes(Data + Skipped)] = Skipped + 1;
+            }
+            Position += MatchLength;
+        }
+        else
+        {
+            PushDeflateSymbol(Png, Data[Position++]);
+        }
+    }
+    PushDeflateSymbol(Png, 256);
+}
+
+function void
+UpdateAdler(png_stream *Png, const u8 *Bytes, u64 Size)
+{
+    // note(harlequin): 5552 bytes is the most that can be summed before the 32 bit sums have to be reduced
+    while (Size)
+    {
+        u64 BlockSize = Size < 5552 ? Size : 5552;
+        for (u64 Index = 0; Index < BlockSize; Index++)
+        {
+            Png->AdlerA += Bytes[Index];
+            Png->AdlerB += Png->AdlerA;
+        }
+        Png->AdlerA %= 65521;
+        Png->AdlerB %= 65521;
+        Bytes += BlockSize;
+        Size  -= BlockSize;
+    }
+}
+
+inline u8
+PngPaethPredictor(u8 Left, u8 Up, u8 UpLeft)
+{
+    i32 Estimate       = (i32)Left + (i32)Up - (i32)UpLeft;
+    i32 LeftDistance   = abs(Estimate - (i32)Left);
+    i32 UpDistance     = abs(Estimate - (i32)Up);
+    i32 UpLeftDistance = abs(Estimate - (i32)UpLeft);
+    if (LeftDistance <= UpDistance && LeftDistance <= UpLeftDistance)
+    {
+        return Left;
+    }
+    return UpDistance <= UpLeftDistance ? Up : UpLeft;
+}
+
+inline u8
+FilterPngByte(u32 FilterType, const u8 *Row, const u8 *PreviousRow, u32 Index)
+{
+    u8 Left   = Index >= PNG_BYTES_PER_PIXEL ? Row[Index - PNG_BYTES_PER_PIXEL] : 0;
+    u8 Up     = PreviousRow[Index];
+    u8 UpLeft = Index >= PNG_BYTES_PER_PIXEL ? PreviousRow[Index - PNG_BYTES_PER_PIXEL] : 0;
+    switch (FilterType)
+    {
+        case 1: return (u8)(Row[Index] - Left);
+        case 2: return (u8)(Row[Index] - Up);
+        case 3: return (u8)(Row[Index] - (u8)(((u32)Left + (u32)Up) / 2));
+        case 4: return (u8)(Row[Index] - PngPaethPredictor(Left, Up, UpLeft));
+    }
+    return Row[Index];
+}
+
+// note(harlequin): picks the filter with the smallest sum of the filtered bytes as signed values, the usual
+// heuristic of png encoders, and writes the filter type and the filtered row to Out
+function u8 *
+FilterPngRow(const u8 *Row, const u8 *PreviousRow, u32 Size, u8 *Out)
+{
+    u32 BestFilterType = 0;
+    u64 BestSum        = 0;
+    for (u32 FilterType = 0; FilterType < 5; FilterType++)
+    {
+        u64 Sum = 0;
+        for (u32 Index = 0; Index < Size; Index++)
+        {
+            Sum += (u64)abs((i32)(i8)FilterPngByte(FilterType, Row, PreviousRow, Index));
+        }
+        if (!FilterType || Sum < BestSum)
+        {
+            BestFilterType = FilterType;
+            BestSum        = Sum;
+        }
+    }
+
+    *Out++ = (u8)BestFilterType;
+    for (u32 Index = 0; Index < Size; Index++)
+    {
+        *Out++ = FilterPngByte(BestFilterType, Row, PreviousRow, Index);
+    }
+    return Out;
+}
+
+function bool
+GrowPngBuffer(u8 **Buffer, u64 *Capacity, u64 Size)
+{
+    if (Size <= *Capacity)
+    {
+        return true;
+    }
+    u8 *Grown = (u8 *)realloc(*Buffer, Size);
+    if (!Grown)
+    {
+        return false;
+    }
+    *Buffer   = Grown;
+    *Capacity = Size;
+    return true;
+}
+
+function bool
+BeginPngStream(image_writer *Writer)
+{
+    png_stream *Png = (png_stream *)calloc(1, sizeof(png_stream));
+    Writer->Png = Png;
+    if (!Png)
+    {
+        return false;
+    }
+
+    u32 RowSize = Writer->Width * PNG_BYTES_PER_PIXEL;
+    Png->Row         = (u8 *)malloc(RowSize);
+    Png->PreviousRow = (u8 *)calloc(RowSize, 1);
+    Png->Hash        = (u32 *)malloc(sizeof(u32) << PNG_HASH_BIT_COUNT);
+    Png->AdlerA      = 1;
+    Png->AdlerB      = 0;
+    if (!Png->Row || !Png->PreviousRow || !Png->Hash || !GrowPngBuffer(&Png->Compressed, &Png->CompressedCapacity, 64))
+    {
+        return false;
+    }
+
+    // note(harlequin): 8 bit rgb, no interlacing
+    const u8 Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    u8 Header[13] = {};
+    PushBigEndianU32(Header + 0, Writer->Width);
+    PushBigEndianU32(Header + 4, Writer->Height);
+    Header[8] = 8;
+    Header[9] = 2;
+
+    // note(harlequin): the zlib header of a 32k window without a preset dictionary, it leads the first IDAT
+    Png->Compressed[Png->CompressedSize++] = 0x78;
+    Png->Compressed[Png->CompressedSize++] = 0x01;
+
+    return fwrite(Signature, sizeof(Signature), 1, Writer->File) == 1 &&
+           WritePngChunk(Writer->File, "IHDR", Header, sizeof(Header));
+}
+
+function bool
+WritePngRows(image_writer *Writer,
+             const f32    *Rows,
+             u32           RowCount)
+{
+    png_stream *Png = Writer->Png;
+    u32 RowSize = Writer->Width * PNG_BYTES_PER_PIXEL;
+    u64 FilteredSize = (u64)(RowSize + 1) * RowCount;
+    Assert(FilteredSize < 0xFFFFFFFFull);
+
+    // note(harlequin): fixed huffman codes take at most 9 bits a byte
+    if (!GrowPngBuffer(&Png->Filtered, &Png->FilteredCapacity, FilteredSize) ||
+        !GrowPngBuffer(&Png->Compressed, &Png->CompressedCapacity, Png->CompressedSize + FilteredSize / 8 * 9 + 64))
+    {
+        return false;
+    }
+
+    u8 *Out = Png->Filtered;
+    for (u32 RowIndex = 0; RowIndex < RowCount; RowIndex++)
+    {
+        const f32 *Row = Rows + (u64)RowIndex * RowSize;
+        for (u32 Index = 0; Index < RowSize; Index++)
+        {
+            Png->Row[Index] = (u8)(Clamp(Row[Index], 0.0f, 1.0f) * 255.0f);
+        }
+        Out = FilterPngRow(Png->Row, Png->PreviousRow, RowSize, Out);
+
+        u8 *Swap         = Png->PreviousRow;
+        Png->PreviousRow = Png->Row;
+        Png->Row         = Swap;
+    }
+    Assert((u64)(Out - Png->Filtered) == FilteredSize);
+
+    UpdateAdler(Png, Png->Filtered, FilteredSize);
+    DeflateBlock(Png, Png->Filtered, (u32)FilteredSize);
+
+    bool Success = WritePngChunk(Writer->File, "IDAT", Png->Compressed, Png->CompressedSize);
+    Png->CompressedSize = 0;
+    return Success;
+}
+
+function bool
+EndPngStream(image_writer *Writer)
+{
+    png_stream *Png = Writer->Png;
+    PushDeflateBits(Png, 3, 3); // the final block, fixed huffman codes
+    PushDeflateSymbol(Png, 256);
+    if (Png->BitCount)
+    {
+        PushDeflateBits(Png, 0, 8 - Png->BitCount);
+    }
+    PushBigEndianU32(Png->Compressed + Png->CompressedSize, (Png->AdlerB << 16) | Png->AdlerA);
+    Png->CompressedSize += 4;
+
+    return WritePngChunk(Writer->File, "IDAT", Png->Compressed, Png->CompressedSize) &&
+           WritePngChunk(Writer->File, "IEND", nullptr, 0);
+}
+
+function void
+FreePngStream(png_stream *Png)
+{
+    if (Png)
+    {
+        free(Png->Filtered);
+        free(Png->Compressed);
+        free(Png->Row);
+        free(Png->PreviousRow);
+        free(Png->Hash);
+        free(Png);
+    }
+}
+
+bool
+BeginImageWriter(image_writer      *Writer,
+                 const char        *FilePath,
+                 image_format       Format,
+                 u32                Width,
+                 u32                Height,
+                 const char *const *ChannelNames,
+                 u32                ChannelCount)
+{
+    Assert(ChannelCount && ChannelCount <= IMAGE_MAX_CHANNEL_COUNT);
+    Assert(Format != ImageFormat_Pfm || ChannelCount == 1 || ChannelCount == 3);
+    Assert((Format != ImageFormat_Ppm && Format != ImageFormat_Png) || ChannelCount == 3);
+
+    *Writer = {};
+    Writer->Format       = Format;
+    Writer->Width        = Width;
+    Writer->Height       = Height;
+    Writer->ChannelCount = ChannelCount;
+    Writer->RowScratch   = (f32 *)malloc(sizeof(f32) * Width * ChannelCount);
+    Writer->File         = fopen(FilePath, "wb");
+    if (!Writer->File || !Writer->RowScratch)
+    {
+        fprintf(stderr, "failed to open %s for writing\n", FilePath);
+        Writer->Failed = true;
+        return false;
+    }
+
+    bool Success = true;
+    if (Format == ImageFormat_Pfm)
+    {
+        // note(harlequin): a negative scale marks the data little endian
+        i32 HeaderSize = fprintf(Writer->File, "%s\n%u %u\n-1.0\n", ChannelCount == 3 ? "PF" : "Pf", Width, Height);
+        Success = HeaderSize > 0;
+        Writer->DataOffset = (u64)HeaderSize;
+    }
+    else if (Format == ImageFormat_Exr)
+    {
+        Success = WriteExrHeader(Writer, ChannelNames);
+    }
+    else if (Format == ImageFormat_Ppm)
+    {
+        Success = fprintf(Writer->File, "P6\n%u %u\n255\n", Width, Height) > 0;
+    }
+    else
+    {
+        Success = BeginPngStream(Writer);
+    }
+
+    if (!Success)
+    {
+        fprintf(stderr, "failed to write the header of %s\n", FilePath);
+        Writer->Failed = true;
+    }
+    return Success;
+}
+
+bool
+WriteImageRows(image_writer *Writer,
+               const f32    *Rows,
+               u32           RowCount)
+{
+    if (Writer->Failed)
+    {
+        return false;
+    }
+    Assert(Writer->NextRow + RowCount <= Writer->Height);
+
+    if (Writer->Format == ImageFormat_Png)
+    {
+        Writer->NextRow += RowCount;
+        Writer->Failed   = !WritePngRows(Writer, Rows, RowCount);
+        return !Writer->Failed;
+    }
+
+    u32 Width        = Writer->Width;
+    u32 ChannelCount = Writer->ChannelCount;
+    u64 RowSize      = sizeof(f32) * (u64)Width * ChannelCount;
+    for (u32 RowIndex = 0; RowIndex < RowCount; RowIndex++)
+    {
+        u32 Y = Writer->NextRow++;
+        const f32 *Row = Rows + (u64)RowIndex * Width * ChannelCount;
+
+        if (Writer->Format == ImageFormat_Pfm)
+        {
+            u64 Offset = Writer->DataOffset + (u64)(Writer->Height - 1 - Y) * RowSize;
+            if (_fseeki64(Writer->File, (long long)Offset, SEEK_SET) != 0 ||
+                fwrite(Row, 1, RowSize, Writer->File) != RowSize)
+            {
+                Writer->Failed = true;
+                return false;
+            }
+        }
+        else if (Writer->Format == ImageFormat_Ppm)
+        {
+            u8 *Bytes = (u8 *)Writer->RowScratch;
+            u32 ByteCount = Width * ChannelCount;
+            for (u32 Index = 0; Index < ByteCount; Index++)
+            {
+                Bytes[Index] = (u8)(Clamp(Row[Index], 0.0f, 1.0f) * 255.0f);
+            }
+            if (fwrite(Bytes, 1, ByteCount, Writer->File) != ByteCount)
+            {
+                Writer->Failed = true;
+                return false;
+            }
+        }
+        else
+        {
+            // note(harlequin): exr stores a scanline channel by channel
+            f32 *Planar = Writer->RowScratch;
+            for (u32 ChannelIndex = 0; ChannelIndex < ChannelCount; ChannelIndex++)
+            {
+                u32 SourceChannel = Writer->ChannelOrder[ChannelIndex];
+                for (u32 X = 0; X < Width; X++)
+                {
+                    *Planar++ = Row[X * ChannelCount + SourceChannel];
+                }
+            }
+
+            i32 ChunkHeader[2] = { (i32)Y, (i32)RowSize };
+            if (fwrite(ChunkHeader, sizeof(ChunkHeader), 1, Writer->File) != 1 ||
+                fwrite(Writer->RowScratch, 1, RowSize, Writer->File) != RowSize)
+            {
+                Writer->Failed = true;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool
+EndImageWriter(image_writer *Writer)
+{
+    bool Success = !Writer->Failed && Writer->NextRow == Writer->Height;
+    if (Success && Writer->Format == ImageFormat_Png)
+    {
+        Success = EndPngStream(Writer);
+    }
+    if (Writer->File && fclose(Writer->File) != 0)
+    {
+        Success = false;
+    }
+    FreePngStream(Writer->Png);
+    free(Writer->RowScratch);
+    Writer->File       = nullptr;
+    Writer->RowScratch = nullptr;
+    Writer->Png        = nullptr;
+    return Success;
+}
+
+// note(harlequin): exr channel names of every aov, single channel aovs are luminance like so they go by Y
+// except for depth which compositors look for in Z
+global_variable const char *AovChannelNames[Aov_Count][3] =
+{
+    { "R", "G", "B" },
+    { "albedo.R", "albedo.G", "albedo.B" },
+    { "normal.X", "normal.Y", "normal.Z" },
+    { "Z" },
+    { "samples.Y" },
+    { "variance.Y" },
+};
+
+global_variable const u32 AovChannelCounts[Aov_Count] = { 3, 3, 3, 1, 1, 1 };
+
+function f32 *
+GetAovPixel(aov                   Aov,
+            u32                   PixelIndex,
+            const frame_buffer   *AccumulationFrameBuffer,
+            const sample_buffer  *SampleBuffer,
+            const feature_buffer *FeatureBuffer,
+            f32                  *Out)
+{
+    const pixel_statistics *Statistics = SampleBuffer->Pixels + PixelIndex;
+    u32 SampleCount = Statistics->SampleCount;
+
+    v3 Color = V3(0.0f);
+    switch (Aov)
+    {
+        case Aov_Radiance:
+        {
+            Color = SampleCount ? AccumulationFrameBuffer->Pixels[PixelIndex] / (f32)SampleCount : V3(0.0f);
+        } break;
+
+        case Aov_Albedo: Color = FeatureBuffer->Albedo[PixelIndex]; break;
+        case Aov_Normal: Color = FeatureBuffer->Normal[PixelIndex]; break;
+
+        case Aov_Depth:
+        {
+            *Out++ = FeatureBuffer->Depth[PixelIndex];
+            return Out;
+        }
+
+        case Aov_SampleCount:
+        {
+            *Out++ = (f32)SampleCount;
+            return Out;
+        }
+
+        case Aov_Variance:
+        {
+            *Out++ = SampleCount >= 2 ? Statistics->M2 / (f32)(SampleCount - 1) : 0.0f;
+            return Out;
+        }
+
+        default: Assert(!"unknown aov");
+    }
+
+    *Out++ = VectorComponent(Color, 0);
+    *Out++ = VectorComponent(Color, 1);
+    *Out++ = VectorComponent(Color, 2);
+    return Out;
+}
+
+bool
+BeginAovOutput(aov_output *Output,
+               const char *FilePath,
+               u32         AovMask,
+               u32         Width,
+               u32         Height)
+{
+    *Output = {};
+
+    image_format Format;
+    if (!GetImageFormat(FilePath, &Format) || (Format != ImageFormat_Exr && Format != ImageFormat_Pfm))
+    {
+        fprintf(stderr, "%s is neither a .exr nor a .pfm path\n", FilePath);
+        Output->Failed = true;
+        return false;
+    }
+
+    for (u32 AovIndex = 0; AovIndex < Aov_Count; AovIndex++)
+    {
+        if (AovMask & (1u << AovIndex))
+        {
+            u32 FileIndex = Format == ImageFormat_Exr ? 0 : Output->FileCount;
+            Output->FileAovs[FileIndex][Output->FileAovCounts[FileIndex]++] = (aov)AovIndex;
+            Output->FileCount = FileIndex + 1;
+        }
+    }
+
+    bool Success = true;
+    const char *Extension = strrchr(FilePath, '.');
+    for (u32 FileIndex = 0; FileIndex < Output->FileCount; FileIndex++)
+    {
+        const char *ChannelNames[IMAGE_MAX_CHANNEL_COUNT];
+        u32 ChannelCount = 0;
+        for (u32 AovIndex = 0; AovIndex < Output->FileAovCounts[FileIndex]; AovIndex++)
+        {
+            aov Aov = Output->FileAovs[FileIndex][AovIndex];
+            for (u32 ChannelIndex = 0; ChannelIndex < AovChannelCounts[Aov]; ChannelIndex++)
+            {
+                ChannelNames[ChannelCount++] = AovChannelNames[Aov][ChannelIndex];
+            }
+        }
+
+        char *AovFilePath = Output->FilePaths[FileIndex];
+        if (Format == ImageFormat_Exr)
+        {
+            snprintf(AovFilePath, sizeof(Output->FilePaths[FileIndex]), "%s", FilePath);
+        }
+        else
+        {
+            snprintf(AovFilePath, sizeof(Output->FilePaths[FileIndex]), "%.*s.%s.pfm", (i32)(Extension - FilePath), FilePath,
+                     AovNames[Output->FileAovs[FileIndex][0]]);
+        }
+        Success &= BeginImageWriter(Output->Writers + FileIndex, AovFilePath, Format, Width, Height, ChannelNames, ChannelCount);
+    }
+
+    Output->Band = (f32 *)malloc(sizeof(f32) * Width * AOV_BAND_HEIGHT * IMAGE_MAX_CHANNEL_COUNT);
+    Success &= Output->Band != nullptr;
+    Output->Failed = !Success;
+    return Success;
+}
+
+bool
+WriteAovRows(aov_output           *Output,
+             const frame_buffer   *AccumulationFrameBuffer,
+             const sample_buffer  *SampleBuffer,
+             const feature_buffer *FeatureBuffer)
+{
+    if (Output->Failed)
+    {
+        return false;
+    }
+
+    u32 Width  = AccumulationFrameBuffer->Width;
+    u32 Height = AccumulationFrameBuffer->Height;
+    Assert(SampleBuffer->Width == Width && SampleBuffer->Height == Height);
+
+    // note(harlequin): a band of rows is gathered and streamed out at a time, so only one band of each file is ever
+    // in its output layout
+    f32 *Band = Output->Band;
+    bool Success = true;
+    for (u32 MinY = 0; Success && MinY < Height; MinY += AOV_BAND_HEIGHT)
+    {
+        u32 MaxY = MinY + AOV_BAND_HEIGHT < Height ? MinY + AOV_BAND_HEIGHT : Height;
+        for (u32 FileIndex = 0; Success && FileIndex < Output->FileCount; FileIndex++)
+        {
+            image_writer *Writer = Output->Writers + FileIndex;
+            Assert(Writer->Width == Width);
+
+            f32 *Out = Band;
+            for (u32 Y = MinY; Y < MaxY; Y++)
+            {
+                for (u32 X = 0; X < Width; X++)
+                {
+                    u32 PixelIndex = GetPixelIndex(X, Y, Width);
+                    for (u32 AovIndex = 0; AovIndex < Output->FileAovCounts[FileIndex]; AovIndex++)
+                    {
+                        aov Aov = Output->FileAovs[FileIndex][AovIndex];
+                        Assert(!((1u << Aov) & AOV_FEATURE_MASK) || (FeatureBuffer->Width == Width && FeatureBuffer->Height == Height));
+                        Out = GetAovPixel(Aov, PixelIndex, AccumulationFrameBuffer, SampleBuffer, FeatureBuffer, Out);
+                    }
+                }
+            }
+            Assert(Out == Band + (u64)(MaxY - MinY) * Width * Writer->ChannelCount);
+            Success &= WriteImageRows(Writer, Band, MaxY - MinY);
+        }
+    }
+
+    Output->Failed = !Success;
+    return Success;
+}
+
+bool
+EndAovOutput(aov_output *Output)
+{
+    bool Success = !Output->Failed;
+    for (u32 FileIndex = 0; FileIndex < Output->FileCount; FileIndex++)
+    {
+        Success &= EndImageWriter(Output->Writers + FileIndex);
+    }
+    free(Output->Band);
+    Output->Band = nullptr;
+    return Success;
+}
+
+bool
+SaveAovs(const char           *FilePath,
+         u32                   AovMask,
+         const frame_buffer   *AccumulationFrameBuffer,
+         const sample_buffer  *SampleBuffer,
+         const feature_buffer *FeatureBuffer)
+{
+    aov_output Output;
+    BeginAovOutput(&Output, FilePath, AovMask, AccumulationFrameBuffer->Width, AccumulationFrameBuffer->Height);
+    WriteAovRows(&Output, AccumulationFrameBuffer, SampleBuffer, FeatureBuffer);
+
+    bool Success = EndAovOutput(&Output);
+    if (!Success)
+    {
+        fprintf(stderr, "failed to write the aovs to %s\n", FilePath);
+    }
+    return Success;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_framebuffer.h"
+#include "tracer_file.h"
+
+function bool
+SavePngImageToDisk(const char *FilePath,
+                   color8     *Image,
+                   u32         ImageWidth,
+                   u32         ImageHeight);
+
+function bool
+SaveFrameBufferToPng(const char   *FilePath,
+                     frame_buffer *FrameBuffer);
+
+enum image_format
+{
+    ImageFormat_Pfm,
+    ImageFormat_Exr,
+    ImageFormat_Ppm,
+    ImageFormat_Png,
+};
+
+#define IMAGE_MAX_CHANNEL_COUNT 16
+
+// the format of the extension of FilePath, false if it is none of them
+function bool
+GetImageFormat(const char   *FilePath,
+               image_format *OutFormat);
+
+struct png_stream;
+
+// note(harlequin): writes an image a band of rows at a time from top to bottom, so the image never has to exist
+// in memory in its file layout. pfm and exr take linear floats, pfm only has 1 or 3 channel images and stores
+// them bottom up so its rows are placed with a seek, exr is written as uncompressed float scanlines whose offsets
+// are known up front. ppm and png take 3 channels that are already tonemapped to [0, 1] and store them in 8 bits
+// like SaveFrameBufferToPng, png compresses every band into its own IDAT chunk
+struct image_writer
+{
+    FILE        *File;
+    image_format Format;
+    u32          Width;
+    u32          Height;
+    u32          ChannelCount;
+    u32          NextRow;
+    u64          DataOffset;                            // of the first row (pfm) or the first scanline chunk (exr)
+    u32          ChannelOrder[IMAGE_MAX_CHANNEL_COUNT]; // exr stores the channels sorted by name
+    f32         *RowScratch;
+    png_stream  *Png;
+    bool         Failed;
+};
+
+function bool
+BeginImageWriter(image_writer      *Writer,
+                 const char        *FilePath,
+                 image_format       Format,
+                 u32                Width,
+                 u32                Height,
+                 const char *const *ChannelNames,
+                 u32                ChannelCount);
+
+// Rows holds RowCount rows of Width pixels, each pixel ChannelCount f32 in the order of the channel names
+function bool
+WriteImageRows(image_writer *Writer,
+               const f32    *Rows,
+               u32           RowCount);
+
+// closes the file, false if any write failed or a row was never written
+function bool
+EndImageWriter(image_writer *Writer);
+
+// note(harlequin): arbitrary output variables, the linear data behind the png for compositing. everything is
+// a per pixel mean over the samples so far, the depth of a ray that hit nothing is FIRST_HIT_SKY_DEPTH
+enum aov
+{
+    Aov_Radiance,
+    Aov_Albedo,
+    Aov_Normal,
+    Aov_Depth,
+    Aov_SampleCount,
+    Aov_Variance, // of the luminance of a single sample
+    Aov_Count
+};
+
+global_variable const char *AovNames[Aov_Count] =
+{
+    "radiance",
+    "albedo",
+    "normal",
+    "depth",
+    "samples",
+    "variance"
+};
+
+#define AOV_ALL_MASK     ((1u << Aov_Count) - 1)
+#define AOV_FEATURE_MASK ((1u << Aov_Albedo) | (1u << Aov_Normal) | (1u << Aov_Depth))
+#define AOV_BAND_HEIGHT  32
+
+// note(harlequin): the aov files of one image, written a band of the image at a time like image_writer. an exr
+// holds every aov as a layer, a pfm a single one
+struct aov_output
+{
+    image_writer Writers[Aov_Count];
+    aov          FileAovs[Aov_Count][Aov_Count];
+    u32          FileAovCounts[Aov_Count];
+    u32          FileCount;
+    char         FilePaths[Aov_Count][1024]; // what the files are called, a pfm path gets the aov name added
+    f32         *Band; // AOV_BAND_HEIGHT rows of the widest file
+    bool         Failed;
+};
+
+// opens the aovs in AovMask, all of them as layers of one file if FilePath ends in .exr, or one pfm per aov
+// with its name before the extension if it ends in .pfm
+function bool
+BeginAovOutput(aov_output *Output,
+               const char *FilePath,
+               u32         AovMask,
+               u32         Width,
+               u32         Height);
+
+// writes every row of the buffers as the next rows of the image, FeatureBuffer is only read for AOV_FEATURE_MASK
+function bool
+WriteAovRows(aov_output           *Output,
+             const frame_buffer   *AccumulationFrameBuffer,
+             const sample_buffer  *SampleBuffer,
+             const feature_buffer *FeatureBuffer);
+
+// closes the files, false if any write failed or a row was never written
+function bool
+EndAovOutput(aov_output *Output);
+
+// the aovs of a whole image, BeginAovOutput, WriteAovRows and EndAovOutput in one go
+function bool
+SaveAovs(const char           *FilePath,
+         u32                   AovMask,
+         const frame_buffer   *AccumulationFrameBuffer,
+         const sample_buffer  *SampleBuffer,
+         const feature_buffer *FeatureBuffer);
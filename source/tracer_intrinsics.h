@@ -3,13 +3,80 @@
 #ifdef _MSC_VER
 #include <intrin.h>
 #include <immintrin.h>
+#else
+#include <x86intrin.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
 #endif
 
 inline void LineBreak()
 {
 #ifdef _MSC_VER
     __debugbreak();
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_trap();
 #else
     #error "unsupported compiler"
 #endif
-}
\ No newline at end of file
+}
+
+#ifndef _MSC_VER
+
+// note(harlequin): glibc malloc already hands out 16 byte aligned blocks on x86-64 which covers
+// every alignof we ask for, wider alignments (cache lines) go through posix_memalign
+inline void *_aligned_malloc(size_t Size, size_t Alignment)
+{
+    if (Alignment <= 16)
+    {
+        return malloc(Size);
+    }
+    void *Result = nullptr;
+    if (posix_memalign(&Result, Alignment, Size) != 0)
+    {
+        return nullptr;
+    }
+    return Result;
+}
+
+// note(harlequin): realloc keeps malloc's 16 byte alignment, a wider one takes a fresh posix_memalign block. the
+// caller does not pass the old size, the allocator's usable size covers it and is at least what was asked for
+// (malloc_size on macos, malloc_usable_size in glibc). the old block is kept on failure like realloc does
+inline void *_aligned_realloc(void *Memory, size_t Size, size_t Alignment)
+{
+    if (Alignment <= 16)
+    {
+        return realloc(Memory, Size);
+    }
+
+    void *Result = _aligned_malloc(Size, Alignment);
+    if (Result && Memory)
+    {
+#ifdef __APPLE__
+        size_t OldSize = malloc_size(Memory);
+#else
+        size_t OldSize = malloc_usable_size(Memory);
+#endif
+        memcpy(Result, Memory, OldSize < Size ? OldSize : Size);
+        free(Memory);
+    }
+    return Result;
+}
+
+inline void _aligned_free(void *Memory)
+{
+    free(Memory);
+}
+
+// note(harlequin): fseek takes a long, which is 32 bits on windows, so large files seek through the msvc name
+inline int _fseeki64(FILE *File, long long Offset, int Origin)
+{
+    return fseeko(File, (off_t)Offset, Origin);
+}
+
+#endif
@@ -1,72 +1,649 @@
 #include "tracer_jobs.h"
 #include "tracer_camera.h"
 #include "tracer_framebuffer.h"
+#include "tracer_world.h"
+#include "tracer_profile.h"
+
+// note(harlequin): the first sample of a pixel overwrites the accumulation and the features, so clearing
+// the sample buffer is all it takes to restart
+inline void
+AccumulatePixel(trace_rays_job  *Job,
+                u32              PixelIndex,
+                const v3        &Color,
+                const first_hit *FirstHit)
+{
+    pixel_statistics *Statistics = Job->SampleBuffer->Pixels + PixelIndex;
+    v3 &AccumulatedColor = Job->AccumulationFrameBuffer->Pixels[PixelIndex];
+    AccumulatedColor = Statistics->SampleCount ? AccumulatedColor + Color : Color;
+    AddPixelSample(Statistics, GetLuminance(Color));
+
+    feature_buffer *FeatureBuffer = Job->FeatureBuffer;
+    if (FeatureBuffer)
+    {
+        v3  &Albedo = FeatureBuffer->Albedo[PixelIndex];
+        v3  &Normal = FeatureBuffer->Normal[PixelIndex];
+        f32 &Depth  = FeatureBuffer->Depth[PixelIndex];
+        if (Statistics->SampleCount == 1)
+        {
+            Albedo = FirstHit->Albedo;
+            Normal = FirstHit->Normal;
+            Depth  = FirstHit->Depth;
+        }
+        else
+        {
+            f32 Weight = 1.0f / (f32)Statistics->SampleCount;
+            Albedo += (FirstHit->Albedo - Albedo) * Weight;
+            Normal += (FirstHit->Normal - Normal) * Weight;
+            Depth  += (FirstHit->Depth - Depth) * Weight;
+        }
+    }
+}
 
 function void
+TraceTileSample(trace_rays_job *Job)
+{
+    if (Job->Settings.Integrator == Integrator_Wavefront)
+    {
+        TraceRaysWavefront(Job);
+        return;
+    }
+
+    u32 Width = Job->FrameBuffer->Width;
+    const tile &Tile = Job->Tile;
+
+    // note(harlequin): rays and random numbers are keyed by the image pixel, so a band of the image traced on
+    // its own comes out exactly like the same rows of the whole image
+    const camera *Camera = Job->Camera;
+    u32 FirstRow         = Job->Settings.FirstRow;
+    u32 ImagePixelOffset = FirstRow * Width;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        u32 X             = Tile.MinX;
+        u32 PixelIndex    = GetPixelIndex(Tile.MinX, Y, Width);
+        u32 EndPixelIndex = GetPixelIndex(Tile.MaxX, Y, Width);
+
+        if (Job->Settings.PacketTracing)
+        {
+            for (;
+                 PixelIndex + LANE_WIDTH <= EndPixelIndex;
+                 PixelIndex += LANE_WIDTH, X += LANE_WIDTH)
+            {
+                ray Rays[LANE_WIDTH];
+                random_series Series[LANE_WIDTH];
+                for (u32 LaneIndex = 0; LaneIndex < LANE_WIDTH; LaneIndex++)
+                {
+                    u32 SampleIndex = GetPixelSampleIndex(Job->SampleBuffer, PixelIndex + LaneIndex);
+                    u32 ImagePixelIndex = ImagePixelOffset + PixelIndex + LaneIndex;
+                    random_series CameraSeries = RandomSeries(Job->Settings.Seed, ImagePixelIndex, SampleIndex, CAMERA_RANDOM_BOUNCE);
+                    Rays[LaneIndex]   = GenerateCameraRay(Camera, X + LaneIndex, FirstRow + Y, &CameraSeries);
+                    Series[LaneIndex] = RandomSeries(Job->Settings.Seed, ImagePixelIndex, SampleIndex);
+                }
+
+                v3 Colors[LANE_WIDTH];
+                first_hit FirstHits[LANE_WIDTH];
+                TraceRayPacket(Rays,
+                               Job->World,
+                               Job->Settings.RayBounceCount,
+                               Series,
+                               Job->Stats,
+                               Colors,
+                               Job->FeatureBuffer ? FirstHits : nullptr);
+
+                for (u32 LaneIndex = 0; LaneIndex < LANE_WIDTH; LaneIndex++)
+                {
+                    AccumulatePixel(Job, PixelIndex + LaneIndex, Colors[LaneIndex], FirstHits + LaneIndex);
+                }
+            }
+        }
+
+        for (;
+             PixelIndex < EndPixelIndex;
+             PixelIndex++, X++)
+        {
+            u32 SampleIndex = GetPixelSampleIndex(Job->SampleBuffer, PixelIndex);
+            random_series CameraSeries = RandomSeries(Job->Settings.Seed, ImagePixelOffset + PixelIndex, SampleIndex, CAMERA_RANDOM_BOUNCE);
+            ray Ray = GenerateCameraRay(Camera, X, FirstRow + Y, &CameraSeries);
+            random_series Series = RandomSeries(Job->Settings.Seed, ImagePixelOffset + PixelIndex, SampleIndex);
+            first_hit FirstHit;
+            v3 Color = TraceRay(Ray, Job->World, Job->Settings.RayBounceCount, &Series, Job->Stats,
+                                Job->FeatureBuffer ? &FirstHit : nullptr);
+            AccumulatePixel(Job, PixelIndex, Color, &FirstHit);
+        }
+    }
+}
+
+// note(harlequin): once per tile and frame instead of once per sample, a row of the tile at a time
+function void
+ResolveTracedTile(trace_rays_job *Job)
+{
+    u32 Width = Job->FrameBuffer->Width;
+    const tile &Tile = Job->Tile;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        u32 PixelIndex = GetPixelIndex(Tile.MinX, Y, Width);
+        ResolvePixels(Job->AccumulationFrameBuffer->Pixels + PixelIndex,
+                      Job->SampleBuffer->Pixels + PixelIndex,
+                      Job->FrameBuffer->Pixels + PixelIndex,
+                      Tile.MaxX - Tile.MinX,
+                      Job->Settings.Tonemapper);
+    }
+}
+
+void
 TraceRays(trace_rays_job *Job)
 {
-    for (u32 PixelIndex = Job->StartPixelIndex;
-         PixelIndex < Job->EndPixelIndex;
-         PixelIndex++)
+    PROFILE_SCOPE("TraceRays");
+#if TRACER_PROFILE
+    u64 FirstRayCount = Job->Stats->RayCount;
+#endif
+
+    for (u32 SampleIndex = 0; SampleIndex < Job->TileSampleCount; SampleIndex++)
     {
-        const ray& Ray = Job->Camera->Rays[PixelIndex];
+        TraceTileSample(Job);
+    }
+    ResolveTracedTile(Job);
 
-        v3 &AccumulatedColor = Job->AccumulationFrameBuffer->Pixels[PixelIndex];
-        AccumulatedColor += TraceRay(Ray, Job->World, Job->RayBounceCount, Job->RandomSeries);
-        v3 FinalColor = Clamp(AccumulatedColor / (f32)Job->FrameCount, V3(0.0f), V3(1.0f));
-        Job->FrameBuffer->Pixels[PixelIndex] = LinearToSRGB(FinalColor);
+#if TRACER_PROFILE
+    // note(harlequin): every pixel starts one camera ray per sample, the rest of the rays the tile traced bounced
+    const tile &Tile = Job->Tile;
+    u64 RayCount       = Job->Stats->RayCount - FirstRayCount;
+    u64 CameraRayCount = (u64)(Tile.MaxX - Tile.MinX) * (Tile.MaxY - Tile.MinY) * Job->TileSampleCount;
+    PROFILE_COUNT(ProfileCounter_Rays, RayCount);
+    PROFILE_COUNT(ProfileCounter_Bounces, RayCount > CameraRayCount ? RayCount - CameraRayCount : 0);
+#endif
+}
+
+function u32
+GetTileSampleCount(const sample_buffer *SampleBuffer,
+                   const tile          &Tile)
+{
+    u32 Result = 0;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        const pixel_statistics *Statistics = SampleBuffer->Pixels + GetPixelIndex(Tile.MinX, Y, SampleBuffer->Width);
+        for (u32 X = Tile.MinX; X < Tile.MaxX; X++, Statistics++)
+        {
+            Result = Statistics->SampleCount > Result ? Statistics->SampleCount : Result;
+        }
+    }
+    return Result;
+}
+
+function f32
+GetTileError(const sample_buffer *SampleBuffer,
+             const tile          &Tile,
+             u32                  MinimumSampleCount)
+{
+    f32 Result = 0.0f;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        const pixel_statistics *Statistics = SampleBuffer->Pixels + GetPixelIndex(Tile.MinX, Y, SampleBuffer->Width);
+        for (u32 X = Tile.MinX; X < Tile.MaxX; X++, Statistics++)
+        {
+            if (Statistics->SampleCount < MinimumSampleCount)
+            {
+                return MAX_F32;
+            }
+            f32 Error = GetPixelRelativeError(Statistics);
+            Result = Error > Result ? Error : Result;
+        }
+    }
+    return Result;
+}
+
+bool
+PushTile(work_deque *Deque, u32 TileIndex)
+{
+    i64 Bottom = Deque->Bottom.load(std::memory_order_relaxed);
+    i64 Top    = Deque->Top.load(std::memory_order_acquire);
+    if (Bottom - Top >= WORK_DEQUE_CAPACITY)
+    {
+        return false;
+    }
+
+    Deque->TileIndices[Bottom & (WORK_DEQUE_CAPACITY - 1)] = TileIndex;
+    std::atomic_thread_fence(std::memory_order_release);
+    Deque->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool
+PopTile(work_deque *Deque, u32 *OutTileIndex)
+{
+    i64 Bottom = Deque->Bottom.load(std::memory_order_relaxed) - 1;
+    Deque->Bottom.store(Bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 Top = Deque->Top.load(std::memory_order_relaxed);
+
+    if (Top > Bottom)
+    {
+        Deque->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    *OutTileIndex = Deque->TileIndices[Bottom & (WORK_DEQUE_CAPACITY - 1)];
+    if (Top == Bottom)
+    {
+        // note(harlequin): last tile, race the thieves for it
+        bool Won = Deque->Top.compare_exchange_strong(Top,
+                                                      Top + 1,
+                                                      std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed);
+        Deque->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+        return Won;
     }
+
+    return true;
+}
+
+bool
+StealTile(work_deque *Deque, u32 *OutTileIndex)
+{
+    i64 Top = Deque->Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 Bottom = Deque->Bottom.load(std::memory_order_acquire);
+
+    if (Top >= Bottom)
+    {
+        return false;
+    }
+
+    u32 TileIndex = Deque->TileIndices[Top & (WORK_DEQUE_CAPACITY - 1)];
+    if (!Deque->Top.compare_exchange_strong(Top,
+                                            Top + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    *OutTileIndex = TileIndex;
+    return true;
 }
 
 function void
-WorkerThread(work_queue *WorkQueue)
+TraceTile(job_system *JobSystem,
+          u32         ThreadIndex,
+          u32         TileIndex)
 {
-    auto predicate = [&]() -> bool
+    thread_storage *Storage = JobSystem->ThreadStorage + ThreadIndex;
+
+    trace_rays_job Job = JobSystem->FrameJob;
+    Job.Stats        = &Storage->Stats;
+    Job.ScratchArena = &Storage->ScratchArena;
+    Job.Tile         = JobSystem->Tiles[TileIndex];
+
+    // note(harlequin): samples go where the error is, a tile twice over the threshold gets two this frame
+    bool Adaptive = Job.Settings.AdaptiveSampling;
+    Job.TileSampleCount = 1;
+    if (Adaptive && JobSystem->TileErrors[TileIndex] != MAX_F32)
+    {
+        f32 ErrorRatio = JobSystem->TileErrors[TileIndex] / Job.Settings.NoiseThreshold;
+        Job.TileSampleCount = ErrorRatio < (f32)ADAPTIVE_MAX_TILE_SAMPLE_COUNT ? (u32)ErrorRatio + 1 : ADAPTIVE_MAX_TILE_SAMPLE_COUNT;
+    }
+    if (Adaptive && Job.Settings.MaxSampleCount)
+    {
+        // note(harlequin): the extra samples of a noisy tile come out of its budget, TraceFrame only hands out
+        // tiles that have some left
+        u32 SamplesLeft = Job.Settings.MaxSampleCount - JobSystem->TileSampleCounts[TileIndex];
+        Job.TileSampleCount = Job.TileSampleCount < SamplesLeft ? Job.TileSampleCount : SamplesLeft;
+    }
+
+    auto StartTime = std::chrono::steady_clock::now();
+    TraceRays(&Job);
+    if (Adaptive)
+    {
+        JobSystem->TileErrors[TileIndex] = GetTileError(Job.SampleBuffer, Job.Tile, Job.Settings.MinimumSampleCount);
+    }
+    auto EndTime = std::chrono::steady_clock::now();
+
+    Storage->BusySeconds += std::chrono::duration< f64 >(EndTime - StartTime).count();
+    Storage->TileCount++;
+}
+
+function void
+RunTile(job_system *JobSystem,
+        u32         ThreadIndex,
+        u32         TileIndex)
+{
+    if (JobSystem->TilePassFunction)
+    {
+        PROFILE_SCOPE("TilePass");
+        JobSystem->TilePassFunction(JobSystem->TilePassData, JobSystem->Tiles[TileIndex]);
+    }
+    else
+    {
+        TraceTile(JobSystem, ThreadIndex, TileIndex);
+    }
+}
+
+void
+ResetCompletion(completion *Completion, u32 Count)
+{
+    Completion->Count.store(Count, std::memory_order_release);
+}
+
+void
+SignalCompletion(completion *Completion)
+{
+    // note(harlequin): the count drops under the lock, so a sleeping waiter cannot miss the wake and a waiter that
+    // saw zero and then took the lock knows the completion is no longer touched and can reuse or free it
+    std::lock_guard< std::mutex > Lock(Completion->Mutex);
+    if (Completion->Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        Completion->DoneCV.notify_all();
+    }
+}
+
+void
+WaitForCompletion(completion *Completion, u32 SpinCount)
+{
+    for (u32 SpinIndex = 0; SpinIndex < SpinCount; SpinIndex++)
+    {
+        if (!Completion->Count.load(std::memory_order_acquire))
+        {
+            std::lock_guard< std::mutex > Lock(Completion->Mutex);
+            return;
+        }
+        _mm_pause();
+    }
+
+    std::unique_lock< std::mutex > Lock(Completion->Mutex);
+    Completion->DoneCV.wait(Lock, [&]() -> bool
+    {
+        return Completion->Count.load(std::memory_order_acquire) == 0;
+    });
+}
+
+// note(harlequin): tiles are only pushed before the workers wake up, so once every deque is empty the tiles
+// still running belong to other threads and there is nothing left for this one in the frame
+function bool
+AllDequesEmpty(job_system *JobSystem)
+{
+    for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
     {
-        return WorkQueue->JobIndex != WorkQueue->TailJobIndex || !WorkQueue->running;
-    };
+        work_deque *Deque = &JobSystem->ThreadStorage[ThreadIndex].Deque;
+        if (Deque->Top.load(std::memory_order_acquire) < Deque->Bottom.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-    while (WorkQueue->running)
+// note(harlequin): drain the thread's own deque first, then steal from the others until none has a tile left
+function void
+RunFrameTiles(job_system *JobSystem, u32 ThreadIndex)
+{
+    thread_storage *Storage = JobSystem->ThreadStorage + ThreadIndex;
+
+    for (;;)
     {
-        std::unique_lock< std::mutex > Lock(WorkQueue->WorkMutex);
-        WorkQueue->WorkSignalCV.wait(Lock, predicate);
+        u32 TileIndex = 0;
+        if (PopTile(&Storage->Deque, &TileIndex))
+        {
+            RunTile(JobSystem, ThreadIndex, TileIndex);
+            continue;
+        }
 
-        while (WorkQueue->JobIndex != WorkQueue->TailJobIndex)
+        bool Stole = false;
+        for (u32 Offset = 1; Offset < JobSystem->ThreadCount && !Stole; Offset++)
+        {
+            u32 VictimIndex = (ThreadIndex + Offset) % JobSystem->ThreadCount;
+            Stole = StealTile(&JobSystem->ThreadStorage[VictimIndex].Deque, &TileIndex);
+        }
+
+        if (Stole)
+        {
+            Storage->StolenTileCount++;
+            RunTile(JobSystem, ThreadIndex, TileIndex);
+        }
+        else if (AllDequesEmpty(JobSystem))
+        {
+            break;
+        }
+        else
         {
-            u32 NewJobIndex = (WorkQueue->JobIndex + 1) % ArrayCount(WorkQueue->Jobs);
-            trace_rays_job *Job = &WorkQueue->Jobs[WorkQueue->JobIndex];
-            TraceRays(Job);
-            WorkQueue->JobIndex = NewJobIndex;
+            // note(harlequin): lost a race for a tile, there are more to go around
+            _mm_pause();
         }
+    }
+}
+
+void
+InitializeJob(job          *Job,
+              job_function *Function,
+              void         *Data)
+{
+    Job->Function          = Function;
+    Job->Data              = Data;
+    Job->DependencyCount   = 1;
+    Job->ContinuationCount = 0;
+    Job->Finished          = false;
+    ResetCompletion(&Job->Done, 1);
+}
 
-        Lock.unlock();
-        WorkQueue->WorkSignalCV.notify_one();
+bool
+AddJobDependency(job *Job,
+                 job *Dependency)
+{
+    std::lock_guard< std::mutex > Lock(Dependency->Mutex);
+    if (Dependency->Finished)
+    {
+        return true;
+    }
+    if (Dependency->ContinuationCount == JOB_MAX_CONTINUATION_COUNT)
+    {
+        return false;
     }
+    Job->DependencyCount.fetch_add(1, std::memory_order_relaxed);
+    Dependency->Continuations[Dependency->ContinuationCount++] = Job;
+    return true;
 }
 
+// false when ReadyJobs is full, the caller runs Job itself then
 function bool
-InitializeJobSystem(job_system *JobSystem)
+PushReadyJob(job_system *JobSystem, job *Job)
 {
-    u32 ThreadCount = std::thread::hardware_concurrency();
+    {
+        std::lock_guard< std::mutex > Lock(JobSystem->WorkMutex);
+        u32 ReadyJobCount = JobSystem->ReadyJobCount.load(std::memory_order_relaxed);
+        if (ReadyJobCount == JOB_QUEUE_CAPACITY)
+        {
+            return false;
+        }
+        JobSystem->ReadyJobs[(JobSystem->FirstReadyJob + ReadyJobCount) % JOB_QUEUE_CAPACITY] = Job;
+        JobSystem->ReadyJobCount.store(ReadyJobCount + 1, std::memory_order_release);
+    }
+    JobSystem->WorkSignalCV.notify_one();
+    return true;
+}
+
+// WorkMutex has to be held
+function job *
+PopReadyJob(job_system *JobSystem)
+{
+    u32 ReadyJobCount = JobSystem->ReadyJobCount.load(std::memory_order_relaxed);
+    if (!ReadyJobCount)
+    {
+        return nullptr;
+    }
+    job *Job = JobSystem->ReadyJobs[JobSystem->FirstReadyJob];
+    JobSystem->FirstReadyJob = (JobSystem->FirstReadyJob + 1) % JOB_QUEUE_CAPACITY;
+    JobSystem->ReadyJobCount.store(ReadyJobCount - 1, std::memory_order_release);
+    return Job;
+}
+
+// note(harlequin): Job is not touched once Done is signaled, the waiter can free it right away
+function void
+RunJob(job_system *JobSystem, job *Job)
+{
+    {
+        PROFILE_SCOPE("RunJob");
+        Job->Function(Job->Data);
+    }
+
+    job *Continuations[JOB_MAX_CONTINUATION_COUNT];
+    u32 ContinuationCount = 0;
+    {
+        std::lock_guard< std::mutex > Lock(Job->Mutex);
+        Job->Finished = true;
+        ContinuationCount = Job->ContinuationCount;
+        memcpy(Continuations, Job->Continuations, sizeof(job *) * ContinuationCount);
+    }
+
+    for (u32 ContinuationIndex = 0; ContinuationIndex < ContinuationCount; ContinuationIndex++)
+    {
+        job *Continuation = Continuations[ContinuationIndex];
+        if (Continuation->DependencyCount.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+            !PushReadyJob(JobSystem, Continuation))
+        {
+            RunJob(JobSystem, Continuation);
+        }
+    }
+    SignalCompletion(&Job->Done);
+}
+
+void
+SubmitJob(job_system *JobSystem,
+          job        *Job)
+{
+    // note(harlequin): a full queue means every worker is already behind, running the job here is what waiting
+    // for room would cost anyway and it never drops a job
+    if (Job->DependencyCount.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+        !PushReadyJob(JobSystem, Job))
+    {
+        RunJob(JobSystem, Job);
+    }
+}
+
+void
+WaitForJob(job_system *JobSystem,
+           job        *Job)
+{
+    while (Job->Done.Count.load(std::memory_order_acquire))
+    {
+        job *ReadyJob = nullptr;
+        if (JobSystem->ReadyJobCount.load(std::memory_order_acquire))
+        {
+            std::lock_guard< std::mutex > Lock(JobSystem->WorkMutex);
+            ReadyJob = PopReadyJob(JobSystem);
+        }
+
+        if (!ReadyJob)
+        {
+            break;
+        }
+        RunJob(JobSystem, ReadyJob);
+    }
+
+    // note(harlequin): nothing is ready, so what Job waits on is running on the workers. it also returns through
+    // the lock once Job ran, the caller is then free to reuse it
+    PROFILE_IDLE_SCOPE("WaitForJob");
+    WaitForCompletion(&Job->Done, JobSystem->IdleSpinCount);
+}
+
+// note(harlequin): frames usually follow each other closely, so an idle worker spins on the frame index and the
+// ready jobs for IdleSpinCount pauses before it parks on the condition variable
+function void
+WorkerThread(job_system *JobSystem, u32 ThreadIndex)
+{
+    PROFILE_THREAD_NAME("worker %u", ThreadIndex);
+    u32 SeenFrameIndex = 0;
+
+    for (;;)
+    {
+        job *Job = nullptr;
+        {
+            PROFILE_IDLE_SCOPE("Idle");
+            for (u32 SpinIndex = 0;
+                 SpinIndex < JobSystem->IdleSpinCount &&
+                 JobSystem->FrameIndex.load(std::memory_order_acquire) == SeenFrameIndex &&
+                 !JobSystem->ReadyJobCount.load(std::memory_order_acquire);
+                 SpinIndex++)
+            {
+                _mm_pause();
+            }
+
+            std::unique_lock< std::mutex > Lock(JobSystem->WorkMutex);
+            JobSystem->WorkSignalCV.wait(Lock, [&]() -> bool
+            {
+                return (JobSystem->FrameOpen && JobSystem->FrameIndex.load(std::memory_order_relaxed) != SeenFrameIndex) ||
+                       JobSystem->ReadyJobCount.load(std::memory_order_relaxed) ||
+                       !JobSystem->Running;
+            });
+
+            if (!JobSystem->Running)
+            {
+                break;
+            }
+
+            // note(harlequin): the tiles come first, the main thread is waiting on the frame
+            u32 FrameIndex = JobSystem->FrameIndex.load(std::memory_order_relaxed);
+            if (JobSystem->FrameOpen && FrameIndex != SeenFrameIndex)
+            {
+                SeenFrameIndex = FrameIndex;
+                JobSystem->FrameCompletion.Count.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                Job = PopReadyJob(JobSystem);
+            }
+        }
+
+        if (Job)
+        {
+            RunJob(JobSystem, Job);
+        }
+        else
+        {
+            RunFrameTiles(JobSystem, ThreadIndex);
+            SignalCompletion(&JobSystem->FrameCompletion);
+        }
+    }
+}
+
+function bool
+InitializeJobSystem(job_system *JobSystem,
+                    u32         RequestedThreadCount /* = 0 */)
+{
+    u32 ThreadCount = RequestedThreadCount;
+    if (!ThreadCount)
+    {
+        ThreadCount = std::thread::hardware_concurrency();
+    }
+    if (!ThreadCount)
+    {
+        ThreadCount = 1;
+    }
+    if (ThreadCount > MAX_THREAD_COUNT)
+    {
+        ThreadCount = MAX_THREAD_COUNT;
+    }
+
+    // note(harlequin): the main thread traces tiles too so it is counted as a thread
     u32 WorkerThreadCount = ThreadCount - 1;
-    Assert(WorkerThreadCount);
-    JobSystem->ThreadCount = ThreadCount;
+    JobSystem->ThreadCount   = ThreadCount;
+    JobSystem->FrameIndex    = 0;
+    JobSystem->Running       = true;
+    JobSystem->IdleSpinCount = JOB_IDLE_SPIN_COUNT;
+    JobSystem->FrameOpen     = false;
+    JobSystem->FirstReadyJob = 0;
+    JobSystem->ReadyJobCount = 0;
+    ResetCompletion(&JobSystem->FrameCompletion, 0);
 
     for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
     {
         thread_storage *Storage = JobSystem->ThreadStorage + ThreadIndex;
-        Storage->Series = RandomSeries();
+        Storage->Deque.Top    = 0;
+        Storage->Deque.Bottom = 0;
     }
 
     for (u32 ThreadIndex = 0; ThreadIndex < WorkerThreadCount; ThreadIndex++)
     {
-        work_queue *WorkQueue = JobSystem->WorkQueue + ThreadIndex;
-        WorkQueue->JobIndex = 0;
-        WorkQueue->TailJobIndex = 0;
-        WorkQueue->running = true;
-
         JobSystem->ThreadPool[ThreadIndex] = std::thread(WorkerThread,
-                                                         WorkQueue);
+                                                         JobSystem,
+                                                         ThreadIndex);
     }
 
     return true;
@@ -75,54 +652,296 @@ InitializeJobSystem(job_system *JobSystem)
 function void
 ShutdownJobSystem(job_system *JobSystem)
 {
-    while (!AllJobsCompleted(JobSystem));
+    // note(harlequin): DispatchTiles waits for its frame, this only matters if a frame is ever left running
+    WaitForCompletion(&JobSystem->FrameCompletion, 0);
+    Assert(!JobSystem->ReadyJobCount.load(std::memory_order_acquire));
+
+    {
+        std::lock_guard< std::mutex > Lock(JobSystem->WorkMutex);
+        JobSystem->Running = false;
+    }
+    JobSystem->WorkSignalCV.notify_all();
 
     for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount - 1; ThreadIndex++)
     {
-        work_queue *WorkQueue = JobSystem->WorkQueue + ThreadIndex;
+        std::thread *Thread = &JobSystem->ThreadPool[ThreadIndex];
+        Thread->join();
+    }
+
+    for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+    {
+        FreeArena(&JobSystem->ThreadStorage[ThreadIndex].ScratchArena);
+    }
+
+    FreeArena(&JobSystem->FrameArena);
+    JobSystem->Tiles     = nullptr;
+    JobSystem->TileCount = 0;
+
+    FreeArena(&JobSystem->AdaptiveArena);
+    JobSystem->TileErrors     = nullptr;
+    JobSystem->TileErrorCount = 0;
+}
+
+function bool
+BuildFrameTiles(job_system *JobSystem,
+                u32         Width,
+                u32         Height)
+{
+    // note(harlequin): the deques have a fixed capacity, grow the tiles until every thread's share fits
+    u32 TileSize = TILE_SIZE;
+    u32 TileCountX = 0;
+    u32 TileCountY = 0;
+    for (;;)
+    {
+        TileCountX = (Width + TileSize - 1) / TileSize;
+        TileCountY = (Height + TileSize - 1) / TileSize;
+        u32 TilesPerThread = (TileCountX * TileCountY + JobSystem->ThreadCount - 1) / JobSystem->ThreadCount;
+        if (TilesPerThread <= WORK_DEQUE_CAPACITY)
+        {
+            break;
+        }
+        TileSize *= 2;
+    }
+
+    u32 TileCount = TileCountX * TileCountY;
+    ResetArena(&JobSystem->FrameArena);
+    JobSystem->Tiles = PushArray(&JobSystem->FrameArena, tile, TileCount);
+    if (!JobSystem->Tiles)
+    {
+        return false;
+    }
 
+    for (u32 TileY = 0; TileY < TileCountY; TileY++)
+    {
+        for (u32 TileX = 0; TileX < TileCountX; TileX++)
         {
-            std::lock_guard< std::mutex > Lock(WorkQueue->WorkMutex);
-            WorkQueue->running = false;
+            tile *Tile = JobSystem->Tiles + TileY * TileCountX + TileX;
+            Tile->MinX = TileX * TileSize;
+            Tile->MinY = TileY * TileSize;
+            Tile->MaxX = Tile->MinX + TileSize < Width ? Tile->MinX + TileSize : Width;
+            Tile->MaxY = Tile->MinY + TileSize < Height ? Tile->MinY + TileSize : Height;
         }
+    }
 
-        WorkQueue->WorkSignalCV.notify_one();
+    JobSystem->TileCount = TileCount;
+    return true;
+}
+
+// note(harlequin): the tile errors restart with the accumulation and whenever the tile layout changes. they are
+// estimated again from the sample buffer, which is all MAX_F32 on the first frame and picks a resumed render up
+// with the errors it had
+function bool
+PrepareAdaptiveSampling(job_system          *JobSystem,
+                        const sample_buffer *SampleBuffer,
+                        u32                  MinimumSampleCount,
+                        u32                  FrameCount)
+{
+    u32 Width  = SampleBuffer->Width;
+    u32 Height = SampleBuffer->Height;
+    if (FrameCount != 1 &&
+        JobSystem->TileErrors &&
+        JobSystem->TileErrorCount == JobSystem->TileCount &&
+        JobSystem->AdaptiveWidth == Width &&
+        JobSystem->AdaptiveHeight == Height)
+    {
+        return true;
     }
 
-    for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount - 1; ThreadIndex++)
+    ResetArena(&JobSystem->AdaptiveArena);
+    JobSystem->TileErrors = PushArray(&JobSystem->AdaptiveArena, f32, JobSystem->TileCount);
+    if (!JobSystem->TileErrors)
     {
-        std::thread *Thread = &JobSystem->ThreadPool[ThreadIndex];
-        Thread->join();
+        JobSystem->TileErrorCount = 0;
+        return false;
+    }
+    for (u32 TileIndex = 0; TileIndex < JobSystem->TileCount; TileIndex++)
+    {
+        JobSystem->TileErrors[TileIndex] = FrameCount == 1 ? MAX_F32 : GetTileError(SampleBuffer, JobSystem->Tiles[TileIndex], MinimumSampleCount);
     }
+    JobSystem->TileErrorCount = JobSystem->TileCount;
+    JobSystem->AdaptiveWidth  = Width;
+    JobSystem->AdaptiveHeight = Height;
+    return true;
 }
 
+// note(harlequin): hands TileIndices to every thread, wakes the workers and works on the tiles from the
+// main thread too, returns once every tile ran
 function void
-QueueTraceRaysJobs(job_system *JobSystem,
-                   u32 ThreadIndex,
-                   trace_rays_job Job)
+DispatchTiles(job_system *JobSystem,
+              const u32  *TileIndices,
+              u32         TileCount)
 {
-    work_queue *WorkQueue = &JobSystem->WorkQueue[ThreadIndex];
+    PROFILE_SCOPE("DispatchTiles");
+    u32 ThreadCount = JobSystem->ThreadCount;
+    u32 MainThreadIndex = ThreadCount - 1;
 
+    // note(harlequin): every thread starts with a contiguous run of tiles, stealing evens out the rest.
+    // no worker is in a frame at this point so filling their deques from here does not race with them
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
     {
-        std::lock_guard< std::mutex > Lock(WorkQueue->WorkMutex);
-        u32 NewTailJobIndex = (WorkQueue->TailJobIndex + 1) % ArrayCount(WorkQueue->Jobs);
-        WorkQueue->Jobs[WorkQueue->TailJobIndex] = Job;
-        WorkQueue->TailJobIndex = NewTailJobIndex;
+        u32 FirstTile = (u32)(((u64)TileCount * ThreadIndex) / ThreadCount);
+        u32 EndTile   = (u32)(((u64)TileCount * (ThreadIndex + 1)) / ThreadCount);
+        work_deque *Deque = &JobSystem->ThreadStorage[ThreadIndex].Deque;
+
+        // note(harlequin): pushed in reverse so the owner pops its tiles in scanline order
+        for (u32 Slot = EndTile; Slot > FirstTile; Slot--)
+        {
+            bool Pushed = PushTile(Deque, TileIndices[Slot - 1]);
+            Assert(Pushed);
+        }
     }
 
-    WorkQueue->WorkSignalCV.notify_one();
+    Assert(!JobSystem->FrameCompletion.Count.load(std::memory_order_acquire));
+    {
+        std::lock_guard< std::mutex > Lock(JobSystem->WorkMutex);
+        JobSystem->FrameIndex.fetch_add(1, std::memory_order_release);
+        JobSystem->FrameOpen = true;
+    }
+    JobSystem->WorkSignalCV.notify_all();
+
+    // note(harlequin): the main thread traces like a worker and then only waits for the tiles still in flight.
+    // closing the frame keeps late workers out, the ones that joined must be out of the deques before the next
+    // dispatch fills them again
+    RunFrameTiles(JobSystem, MainThreadIndex);
+    {
+        std::lock_guard< std::mutex > Lock(JobSystem->WorkMutex);
+        JobSystem->FrameOpen = false;
+    }
+    PROFILE_IDLE_SCOPE("WaitForFrame");
+    WaitForCompletion(&JobSystem->FrameCompletion, JobSystem->IdleSpinCount);
 }
 
-function bool
-AllJobsCompleted(job_system *JobSystem)
+function void
+TraceFrame(job_system     *JobSystem,
+           world          *World,
+           camera         *Camera,
+           trace_settings  Settings,
+           frame_buffer   *AccumulationFrameBuffer,
+           sample_buffer  *SampleBuffer,
+           feature_buffer *FeatureBuffer,
+           frame_buffer   *FrameBuffer,
+           u32             FrameCount)
 {
-    for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+    PROFILE_SCOPE("TraceFrame");
+    u32 ThreadCount = JobSystem->ThreadCount;
+
+    if (!BuildFrameTiles(JobSystem, FrameBuffer->Width, FrameBuffer->Height))
+    {
+        return;
+    }
+
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
+    {
+        thread_storage *Storage = JobSystem->ThreadStorage + ThreadIndex;
+        ResetArena(&Storage->ScratchArena);
+        Storage->Stats           = {};
+        Storage->BusySeconds     = 0.0;
+        Storage->TileCount       = 0;
+        Storage->StolenTileCount = 0;
+    }
+
+    trace_rays_job *FrameJob = &JobSystem->FrameJob;
+    *FrameJob = {};
+    FrameJob->World = World;
+    FrameJob->Camera = Camera;
+    FrameJob->Settings = Settings;
+    FrameJob->AccumulationFrameBuffer = AccumulationFrameBuffer;
+    FrameJob->SampleBuffer = SampleBuffer;
+    FrameJob->FeatureBuffer = FeatureBuffer;
+    FrameJob->FrameBuffer = FrameBuffer;
+    FrameJob->FrameCount = FrameCount;
+
+    Assert(SampleBuffer->Width == FrameBuffer->Width && SampleBuffer->Height == FrameBuffer->Height);
+    Assert(!FeatureBuffer || (FeatureBuffer->Width == FrameBuffer->Width && FeatureBuffer->Height == FrameBuffer->Height));
+    if (FrameCount == 1)
+    {
+        ClearSampleBuffer(SampleBuffer);
+    }
+
+    u32 TileCount = JobSystem->TileCount;
+    u32 *ActiveTileIndices = PushArray(&JobSystem->FrameArena, u32, TileCount);
+    if (!ActiveTileIndices ||
+        (Settings.AdaptiveSampling && !PrepareAdaptiveSampling(JobSystem, SampleBuffer, Settings.MinimumSampleCount, FrameCount)))
     {
-        work_queue *WorkQueue = &JobSystem->WorkQueue[ThreadIndex];
-        if (WorkQueue->JobIndex != WorkQueue->TailJobIndex)
+        return;
+    }
+
+    // note(harlequin): a tile a resume or a new tile layout left with uneven pixels is budgeted by its most
+    // sampled one, so no pixel goes past MaxSampleCount
+    bool Budgeted = Settings.AdaptiveSampling && Settings.MaxSampleCount;
+    JobSystem->TileSampleCounts = Budgeted ? PushArray(&JobSystem->FrameArena, u32, TileCount) : nullptr;
+    if (Budgeted && !JobSystem->TileSampleCounts)
+    {
+        return;
+    }
+
+    u32 ActiveTileCount = 0;
+    for (u32 TileIndex = 0; TileIndex < TileCount; TileIndex++)
+    {
+        if (Budgeted)
         {
-            return false;
+            JobSystem->TileSampleCounts[TileIndex] = GetTileSampleCount(SampleBuffer, JobSystem->Tiles[TileIndex]);
+            if (JobSystem->TileSampleCounts[TileIndex] >= Settings.MaxSampleCount)
+            {
+                continue;
+            }
+        }
+        if (!Settings.AdaptiveSampling || JobSystem->TileErrors[TileIndex] > Settings.NoiseThreshold)
+        {
+            ActiveTileIndices[ActiveTileCount++] = TileIndex;
         }
     }
+    JobSystem->ActiveTileCount = ActiveTileCount;
+
+    auto StartTime = std::chrono::steady_clock::now();
+    DispatchTiles(JobSystem, ActiveTileIndices, ActiveTileCount);
+
+    auto EndTime = std::chrono::steady_clock::now();
+    f64 FrameSeconds = std::chrono::duration< f64 >(EndTime - StartTime).count();
+    JobSystem->FrameSeconds = FrameSeconds;
+
+    trace_stats FrameStats = {};
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
+    {
+        thread_storage *Storage = &JobSystem->ThreadStorage[ThreadIndex];
+        trace_stats *Stats = &Storage->Stats;
+        FrameStats.RayCount           += Stats->RayCount;
+        FrameStats.NodeTestCount      += Stats->NodeTestCount;
+        FrameStats.PrimitiveTestCount += Stats->PrimitiveTestCount;
+
+        JobSystem->ThreadUtilization[ThreadIndex] = FrameSeconds > 0.0 ? (f32)(Storage->BusySeconds / FrameSeconds) : 0.0f;
+    }
+    JobSystem->FrameStats = FrameStats;
+    PROFILE_SAMPLE_COUNTERS();
+}
+
+bool
+RunTilePass(job_system         *JobSystem,
+            u32                 Width,
+            u32                 Height,
+            tile_pass_function *Function,
+            void               *Data)
+{
+    if (!BuildFrameTiles(JobSystem, Width, Height))
+    {
+        return false;
+    }
+
+    u32 TileCount = JobSystem->TileCount;
+    u32 *TileIndices = PushArray(&JobSystem->FrameArena, u32, TileCount);
+    if (!TileIndices)
+    {
+        return false;
+    }
+    for (u32 TileIndex = 0; TileIndex < TileCount; TileIndex++)
+    {
+        TileIndices[TileIndex] = TileIndex;
+    }
+
+    JobSystem->TilePassFunction = Function;
+    JobSystem->TilePassData     = Data;
+    DispatchTiles(JobSystem, TileIndices, TileCount);
+    JobSystem->TilePassFunction = nullptr;
+    JobSystem->TilePassData     = nullptr;
     return true;
-}
\ No newline at end of file
+}
@@ -4,68 +4,244 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 #include "tracer_core.h"
 #include "tracer_random.h"
+#include "tracer_world.h"
+#include "tracer_wavefront.h"
+#include "tracer_memory.h"
+#include "tracer_framebuffer.h"
 
 struct world;
 struct camera;
-struct frame_buffer;
+
+#define MAX_THREAD_COUNT 128
+#define TILE_SIZE 32
+#define WORK_DEQUE_CAPACITY 16384 // must be a power of two
+#define ADAPTIVE_MAX_TILE_SAMPLE_COUNT 4
+#define JOB_IDLE_SPIN_COUNT 4096 // pauses an idle thread spins through before it parks
+#define JOB_MAX_CONTINUATION_COUNT 8
+#define JOB_QUEUE_CAPACITY 256
+
+enum integrator
+{
+    Integrator_Recursive, // TraceRay per pixel, one call per bounce
+    Integrator_Wavefront, // TraceRaysWavefront, one stage at a time over every path of the tile
+    Integrator_Count
+};
+
+global_variable const char *IntegratorNames[Integrator_Count] = { "recursive", "wavefront" };
+
+struct trace_settings
+{
+    u32        RayBounceCount;
+    integrator Integrator;
+    bool       PacketTracing; // recursive integrator only, trace primary rays LANE_WIDTH at a time
+    u32        Seed;          // the random numbers of a pixel depend only on the seed, the pixel, the sample and the bounce
+    tonemapper Tonemapper;    // of the resolve from the accumulation to FrameBuffer, the accumulation stays linear
+    u32        FirstRow;      // image row of the first frame buffer row, the camera covers the whole image
+
+    // note(harlequin): adaptive sampling retires a tile once every pixel in it has MinimumSampleCount samples
+    // and a relative error below NoiseThreshold, noisier tiles get up to ADAPTIVE_MAX_TILE_SAMPLE_COUNT samples a frame
+    bool       AdaptiveSampling;
+    f32        NoiseThreshold;
+    u32        MinimumSampleCount;
+    u32        MaxSampleCount; // 0 is no limit, adaptive sampling takes no pixel past it
+};
+
+struct tile
+{
+    u32 MinX;
+    u32 MinY;
+    u32 MaxX; // exclusive
+    u32 MaxY; // exclusive
+};
 
 struct trace_rays_job
 {
     world          *World;
     camera         *Camera;
-    u32             RayBounceCount;
+    trace_settings  Settings;
     frame_buffer   *AccumulationFrameBuffer;
     frame_buffer   *FrameBuffer;
+    sample_buffer  *SampleBuffer;
+    feature_buffer *FeatureBuffer; // optional, the first hit features are only captured when it is set
     u32             FrameCount;
-    random_series  *RandomSeries;
-    u32             StartPixelIndex;
-    u32             EndPixelIndex;
+    trace_stats    *Stats;
+    memory_arena   *ScratchArena;
+    tile            Tile;
+    u32             TileSampleCount;
 };
 
-struct work_queue
+// note(harlequin): chase-lev deque of tile indices, the owning thread pushes and pops at the bottom
+// without locking while the other threads steal from the top with a single compare and swap
+struct work_deque
 {
-    std::condition_variable WorkSignalCV;
-    std::mutex WorkMutex;
+    alignas(64) std::atomic< i64 > Top;
+    alignas(64) std::atomic< i64 > Bottom;
+    alignas(64) u32 TileIndices[WORK_DEQUE_CAPACITY];
+};
 
-    std::atomic< bool > running;
-    std::atomic< u32 > JobIndex;
-    std::atomic< u32 > TailJobIndex;
-    trace_rays_job Jobs[1024];
+// note(harlequin): runs once per tile of a pass on whichever thread picks the tile up
+typedef void tile_pass_function(void *Data, const tile &Tile);
+
+// note(harlequin): counts down to zero as the work it waits on finishes, the waiter spins for a while before it
+// parks on the condition variable so a short wait stays cheap and a long one does not burn a core
+struct completion
+{
+    alignas(64) std::atomic< u32 > Count;
+    std::mutex              Mutex;
+    std::condition_variable DoneCV;
+};
+
+function void
+ResetCompletion(completion *Completion, u32 Count);
+
+// one of the Count pieces of work is done, the last one wakes the waiter
+function void
+SignalCompletion(completion *Completion);
+
+function void
+WaitForCompletion(completion *Completion, u32 SpinCount);
+
+// note(harlequin): coarse work that runs next to the tile frames on whichever worker is idle, like writing out a
+// band while the next one traces. a job runs once every job it depends on ran and then releases the jobs that
+// depend on it. the tiles of a frame stay on the deques, frames are only dispatched from the main thread
+typedef void job_function(void *Data);
+
+struct job
+{
+    job_function       *Function;
+    void               *Data;
+    std::atomic< u32 >  DependencyCount; // jobs it still waits on, plus one until it is submitted
+    std::mutex          Mutex;           // a continuation added while the job finishes is either run or never added
+    job                *Continuations[JOB_MAX_CONTINUATION_COUNT];
+    u32                 ContinuationCount;
+    bool                Finished;
+    completion          Done;
 };
 
 struct thread_storage
 {
-    random_series Series;
+    work_deque Deque;
+
+    alignas(64) trace_stats Stats;
+    memory_arena ScratchArena; // per tile scratch, folded into one block at the start of every frame
+    f64 BusySeconds; // time spent tracing tiles during the current frame
+    u32 TileCount;   // tiles traced during the current frame
+    u32 StolenTileCount;
     u8 Padding[128]; // note(harlequin): false sharing will not get the best of me
 };
 
 struct job_system
 {
     u32 ThreadCount;
-    thread_storage ThreadStorage[128];
-    work_queue WorkQueue[128];
-    std::thread ThreadPool[128];
+    trace_stats FrameStats; // summed over every thread by TraceFrame
+    f64 FrameSeconds;
+    f32 ThreadUtilization[MAX_THREAD_COUNT]; // busy time over frame time of the last frame
+
+    // note(harlequin): everything a tile needs except the tile itself, written before the workers are woken up
+    trace_rays_job FrameJob;
+    u32   TileCount;
+    tile *Tiles;
+    memory_arena FrameArena; // reset by every TraceFrame, holds the tiles
+
+    // note(harlequin): set while RunTilePass runs, the tiles are traced when it is null
+    tile_pass_function *TilePassFunction;
+    void               *TilePassData;
+
+    // note(harlequin): adaptive sampling state, outlives the frames and restarts with the accumulation
+    memory_arena AdaptiveArena;
+    f32 *TileErrors;          // largest relative pixel error of each tile, MAX_F32 until it has an estimate
+    u32  TileErrorCount;
+    u32  AdaptiveWidth;
+    u32  AdaptiveHeight;
+    u32  ActiveTileCount;     // tiles traced by the last frame
+    u32 *TileSampleCounts;    // samples of the most sampled pixel of each tile, in FrameArena, only with a MaxSampleCount
+
+    // note(harlequin): a worker joins a frame while it is open and signals once it ran out of tiles, the frame is
+    // done when every worker that joined did and the main thread ran out too. a worker busy with a job skips the
+    // frame and the others steal its tiles
+    completion FrameCompletion;
+    bool       FrameOpen;
+    u32        IdleSpinCount; // JOB_IDLE_SPIN_COUNT unless the caller changes it, 0 parks right away
+
+    std::mutex WorkMutex;
+    std::condition_variable WorkSignalCV;
+    alignas(64) std::atomic< u32 > FrameIndex; // written under WorkMutex, spinning workers read it without
+    bool Running;
+
+    // note(harlequin): jobs whose dependencies ran, guarded by WorkMutex, the count is read without it while spinning
+    job *ReadyJobs[JOB_QUEUE_CAPACITY];
+    u32  FirstReadyJob;
+    std::atomic< u32 > ReadyJobCount;
+
+    thread_storage ThreadStorage[MAX_THREAD_COUNT];
+    std::thread ThreadPool[MAX_THREAD_COUNT];
 };
 
+// adds Job->TileSampleCount samples to every pixel of Job->Tile
 function void
 TraceRays(trace_rays_job *Job);
 
 function void
-WorkerThread(work_queue *WorkQueue);
+WorkerThread(job_system *JobSystem, u32 ThreadIndex);
 
 function bool
-InitializeJobSystem(job_system *JobSystem);
+InitializeJobSystem(job_system *JobSystem,
+                    u32         RequestedThreadCount = 0);
 
+// every job has to have been waited on
 function void
 ShutdownJobSystem(job_system *JobSystem);
 
 function void
-QueueTraceRaysJobs(job_system *JobSystem,
-                   u32 ThreadIndex,
-                   trace_rays_job Job);
+InitializeJob(job          *Job,
+              job_function *Function,
+              void         *Data);
+
+// Job runs after Dependency, both have to be initialized and Job not submitted yet. false if Dependency has no
+// room for another continuation
+function bool
+AddJobDependency(job *Job,
+                 job *Dependency);
+
+// Job runs as soon as the jobs it depends on ran, right away when it has none. with JOB_QUEUE_CAPACITY jobs
+// already waiting for a thread, a job that is ready runs on the calling thread before this returns
+function void
+SubmitJob(job_system *JobSystem,
+          job        *Job);
+
+// runs ready jobs on the calling thread until Job ran, so jobs also finish on a job system without workers
+function void
+WaitForJob(job_system *JobSystem,
+           job        *Job);
+
+function bool
+PushTile(work_deque *Deque, u32 TileIndex);
+
+function bool
+PopTile(work_deque *Deque, u32 *OutTileIndex);
+
+function bool
+StealTile(work_deque *Deque, u32 *OutTileIndex);
+
+function void
+TraceFrame(job_system     *JobSystem,
+           world          *World,
+           camera         *Camera,
+           trace_settings  Settings,
+           frame_buffer   *AccumulationFrameBuffer,
+           sample_buffer  *SampleBuffer,
+           feature_buffer *FeatureBuffer,
+           frame_buffer   *FrameBuffer,
+           u32             FrameCount);
 
+// calls Function on every tile of a Width x Height image on every thread and returns once all of them ran
 function bool
-AllJobsCompleted(job_system *JobSystem);
\ No newline at end of file
+RunTilePass(job_system         *JobSystem,
+            u32                 Width,
+            u32                 Height,
+            tile_pass_function *Function,
+            void               *Data);
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_intrinsics.h"
+
+// note(harlequin): lane_f32/lane_u32 wrap one simd register so kernels are written once and compile to
+// sse (4 lanes) or avx2 (8 lanes, build with -arch:AVX2 / -mavx2), masks are the all ones/zeros bit patterns
+// produced by the comparisons
+
+#ifndef LANE_WIDTH
+#if defined(__AVX2__)
+#define LANE_WIDTH 8
+#else
+#define LANE_WIDTH 4
+#endif
+#endif
+
+#if LANE_WIDTH == 8
+
+struct lane_f32
+{
+    __m256 V;
+};
+
+struct lane_u32
+{
+    __m256i V;
+};
+
+inline lane_f32 LaneF32(f32 Scalar)                        { lane_f32 Result; Result.V = _mm256_set1_ps(Scalar); return Result; }
+inline lane_u32 LaneU32(u32 Scalar)                        { lane_u32 Result; Result.V = _mm256_set1_epi32((i32)Scalar); return Result; }
+inline lane_f32 LoadLaneF32(const f32 *Memory)             { lane_f32 Result; Result.V = _mm256_loadu_ps(Memory); return Result; }
+inline void     StoreLaneF32(f32 *Memory, lane_f32 A)      { _mm256_storeu_ps(Memory, A.V); }
+inline void     StoreLaneU32(u32 *Memory, lane_u32 A)      { _mm256_storeu_si256((__m256i *)Memory, A.V); }
+inline lane_f32 operator+(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_add_ps(A.V, B.V); return Result; }
+inline lane_f32 operator-(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_sub_ps(A.V, B.V); return Result; }
+inline lane_f32 operator*(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_mul_ps(A.V, B.V); return Result; }
+inline lane_f32 operator/(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_div_ps(A.V, B.V); return Result; }
+inline lane_f32 operator<(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ); return Result; }
+inline lane_f32 operator<=(lane_f32 A, lane_f32 B)         { lane_f32 Result; Result.V = _mm256_cmp_ps(A.V, B.V, _CMP_LE_OQ); return Result; }
+inline lane_f32 operator>(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ); return Result; }
+inline lane_f32 operator>=(lane_f32 A, lane_f32 B)         { lane_f32 Result; Result.V = _mm256_cmp_ps(A.V, B.V, _CMP_GE_OQ); return Result; }
+inline lane_f32 operator==(lane_f32 A, lane_f32 B)         { lane_f32 Result; Result.V = _mm256_cmp_ps(A.V, B.V, _CMP_EQ_OQ); return Result; }
+inline lane_f32 operator&(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_and_ps(A.V, B.V); return Result; }
+inline lane_f32 operator|(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm256_or_ps(A.V, B.V); return Result; }
+inline lane_f32 operator+(lane_f32 A)                      { return A; }
+inline lane_f32 operator-(lane_f32 A)                      { lane_f32 Result; Result.V = _mm256_sub_ps(_mm256_setzero_ps(), A.V); return Result; }
+inline lane_f32 Minimum(lane_f32 A, lane_f32 B)            { lane_f32 Result; Result.V = _mm256_min_ps(A.V, B.V); return Result; }
+inline lane_f32 Maximium(lane_f32 A, lane_f32 B)           { lane_f32 Result; Result.V = _mm256_max_ps(A.V, B.V); return Result; }
+inline lane_f32 SquareRoot(lane_f32 A)                     { lane_f32 Result; Result.V = _mm256_sqrt_ps(A.V); return Result; }
+inline lane_f32 Select(lane_f32 Mask, lane_f32 A, lane_f32 B)
+{
+    // Mask ? A : B
+    lane_f32 Result;
+    Result.V = _mm256_blendv_ps(B.V, A.V, Mask.V);
+    return Result;
+}
+inline lane_u32 Select(lane_f32 Mask, lane_u32 A, lane_u32 B)
+{
+    lane_u32 Result;
+    Result.V = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(B.V), _mm256_castsi256_ps(A.V), Mask.V));
+    return Result;
+}
+inline u32  MaskBits(lane_f32 Mask)                        { return (u32)_mm256_movemask_ps(Mask.V); }
+inline lane_f32 LaneIndexF32()                             { lane_f32 Result; Result.V = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); return Result; }
+inline lane_u32 LaneIndexU32()                             { lane_u32 Result; Result.V = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); return Result; }
+inline lane_u32 operator+(lane_u32 A, lane_u32 B)          { lane_u32 Result; Result.V = _mm256_add_epi32(A.V, B.V); return Result; }
+
+#else
+
+struct lane_f32
+{
+    __m128 V;
+};
+
+struct lane_u32
+{
+    __m128i V;
+};
+
+inline lane_f32 LaneF32(f32 Scalar)                        { lane_f32 Result; Result.V = _mm_set1_ps(Scalar); return Result; }
+inline lane_u32 LaneU32(u32 Scalar)                        { lane_u32 Result; Result.V = _mm_set1_epi32((i32)Scalar); return Result; }
+inline lane_f32 LoadLaneF32(const f32 *Memory)             { lane_f32 Result; Result.V = _mm_loadu_ps(Memory); return Result; }
+inline void     StoreLaneF32(f32 *Memory, lane_f32 A)      { _mm_storeu_ps(Memory, A.V); }
+inline void     StoreLaneU32(u32 *Memory, lane_u32 A)      { _mm_storeu_si128((__m128i *)Memory, A.V); }
+inline lane_f32 operator+(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_add_ps(A.V, B.V); return Result; }
+inline lane_f32 operator-(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_sub_ps(A.V, B.V); return Result; }
+inline lane_f32 operator*(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_mul_ps(A.V, B.V); return Result; }
+inline lane_f32 operator/(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_div_ps(A.V, B.V); return Result; }
+inline lane_f32 operator<(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_cmplt_ps(A.V, B.V); return Result; }
+inline lane_f32 operator<=(lane_f32 A, lane_f32 B)         { lane_f32 Result; Result.V = _mm_cmple_ps(A.V, B.V); return Result; }
+inline lane_f32 operator>(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_cmpgt_ps(A.V, B.V); return Result; }
+inline lane_f32 operator>=(lane_f32 A, lane_f32 B)         { lane_f32 Result; Result.V = _mm_cmpge_ps(A.V, B.V); return Result; }
+inline lane_f32 operator==(lane_f32 A, lane_f32 B)         { lane_f32 Result; Result.V = _mm_cmpeq_ps(A.V, B.V); return Result; }
+inline lane_f32 operator&(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_and_ps(A.V, B.V); return Result; }
+inline lane_f32 operator|(lane_f32 A, lane_f32 B)          { lane_f32 Result; Result.V = _mm_or_ps(A.V, B.V); return Result; }
+inline lane_f32 operator+(lane_f32 A)                      { return A; }
+inline lane_f32 operator-(lane_f32 A)                      { lane_f32 Result; Result.V = _mm_sub_ps(_mm_setzero_ps(), A.V); return Result; }
+inline lane_f32 Minimum(lane_f32 A, lane_f32 B)            { lane_f32 Result; Result.V = _mm_min_ps(A.V, B.V); return Result; }
+inline lane_f32 Maximium(lane_f32 A, lane_f32 B)           { lane_f32 Result; Result.V = _mm_max_ps(A.V, B.V); return Result; }
+inline lane_f32 SquareRoot(lane_f32 A)                     { lane_f32 Result; Result.V = _mm_sqrt_ps(A.V); return Result; }
+inline lane_f32 Select(lane_f32 Mask, lane_f32 A, lane_f32 B)
+{
+    // Mask ? A : B
+    lane_f32 Result;
+    Result.V = _mm_blendv_ps(B.V, A.V, Mask.V);
+    return Result;
+}
+inline lane_u32 Select(lane_f32 Mask, lane_u32 A, lane_u32 B)
+{
+    lane_u32 Result;
+    Result.V = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(B.V), _mm_castsi128_ps(A.V), Mask.V));
+    return Result;
+}
+inline u32  MaskBits(lane_f32 Mask)                        { return (u32)_mm_movemask_ps(Mask.V); }
+inline lane_f32 LaneIndexF32()                             { lane_f32 Result; Result.V = _mm_setr_ps(0, 1, 2, 3); return Result; }
+inline lane_u32 LaneIndexU32()                             { lane_u32 Result; Result.V = _mm_setr_epi32(0, 1, 2, 3); return Result; }
+inline lane_u32 operator+(lane_u32 A, lane_u32 B)          { lane_u32 Result; Result.V = _mm_add_epi32(A.V, B.V); return Result; }
+
+#endif
+
+#define LANE_MASK_ALL ((1u << LANE_WIDTH) - 1)
+
+// note(harlequin): the widest build, data padded for it can be shared between sse and avx2 builds
+#define MAX_LANE_WIDTH 8
+
+inline bool AnyTrue(lane_f32 Mask)  { return MaskBits(Mask) != 0; }
+inline bool AllTrue(lane_f32 Mask)  { return MaskBits(Mask) == LANE_MASK_ALL; }
+
+inline lane_f32 &operator+=(lane_f32 &A, lane_f32 B) { A = A + B; return A; }
+inline lane_f32 &operator*=(lane_f32 &A, lane_f32 B) { A = A * B; return A; }
+inline lane_f32 &operator&=(lane_f32 &A, lane_f32 B) { A = A & B; return A; }
+inline lane_f32 &operator|=(lane_f32 &A, lane_f32 B) { A = A | B; return A; }
+
+// returns the smallest lane and the index of the first lane holding it
+inline f32
+HorizontalMinimum(lane_f32 A, u32 *OutLaneIndex)
+{
+    f32 Values[LANE_WIDTH];
+    StoreLaneF32(Values, A);
+
+    f32 Result = Values[0];
+    u32 ResultIndex = 0;
+    for (u32 LaneIndex = 1; LaneIndex < LANE_WIDTH; LaneIndex++)
+    {
+        if (Values[LaneIndex] < Result)
+        {
+            Result = Values[LaneIndex];
+            ResultIndex = LaneIndex;
+        }
+    }
+    *OutLaneIndex = ResultIndex;
+    return Result;
+}
+
+inline u32
+ExtractLane(lane_u32 A, u32 LaneIndex)
+{
+    u32 Values[LANE_WIDTH];
+    StoreLaneU32(Values, A);
+    return Values[LaneIndex];
+}
+
+inline f32
+ExtractLane(lane_f32 A, u32 LaneIndex)
+{
+    f32 Values[LANE_WIDTH];
+    StoreLaneF32(Values, A);
+    return Values[LaneIndex];
+}
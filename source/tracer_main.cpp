@@ -2,145 +2,27 @@
 #include <glad/glad.c>
 #include <stdlib.h>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb/stb_image_write.h>
-
 #include "tracer_core.h"
 #include "tracer_math.h"
 
-function v3
-TraceRay(ray Ray,
-         const struct world *World,
-         i32 BounceCount,
-         struct random_series *RandomSeries);
-
 #include "tracer_imgui.cpp"
 #include "tracer_math.cpp"
+#include "tracer_memory.cpp"
+#include "tracer_profile.cpp"
 #include "tracer_random.cpp"
+#include "tracer_upload.cpp"
 #include "tracer_texture.cpp"
 #include "tracer_framebuffer.cpp"
 #include "tracer_camera.cpp"
+#include "tracer_bvh.cpp"
+#include "tracer_world.cpp"
+#include "tracer_file.cpp"
+#include "tracer_mesh.cpp"
 #include "tracer_jobs.cpp"
-
-function bool
-SavePngImageToDisk(char   *FilePath,
-                   color8 *Image,
-                   u32     ImageWidth,
-                   u32     ImageHeight)
-{
-    i32 result = stbi_write_png(FilePath,
-                                ImageWidth,
-                                ImageHeight,
-                                3,
-                                Image,
-                                sizeof(color8) * ImageWidth);
-    return result != 0;
-}
-
-#define MAX_MATERIAL_COUNT 1024
-#define MAX_MESH_COUNT 1024
-
-struct material
-{
-    v3  Albedo;
-    f32 Roughness;
-};
-
-struct mesh
-{
-    sphere Sphere;
-    u32    MaterialIndex;
-};
-
-struct world
-{
-    u32      MaterialCount;
-    material Materials[MAX_MATERIAL_COUNT];
-
-    u32  MeshCount;
-    mesh Meshes[MAX_MESH_COUNT];
-};
-
-u32 PushMaterial(world *World, v3 Albedo, f32 Roughness)
-{
-    Assert(World->MaterialCount < MAX_MATERIAL_COUNT);
-    u32 MaterialIndex   = World->MaterialCount++;
-    material *Material  = World->Materials + MaterialIndex;
-    Material->Albedo    = Albedo;
-    Material->Roughness = Roughness;
-    return MaterialIndex;
-}
-
-mesh* PushSphere(world *World, v3 Center, f32 Radius, u32 MaterialIndex = 0)
-{
-    Assert(World->MeshCount < MAX_MESH_COUNT);
-    u32 MeshIndex       = World->MeshCount++;
-    mesh *Mesh          = World->Meshes + MeshIndex;
-    Mesh->Sphere        = SphereCenterRadius(Center, Radius);
-    Mesh->MaterialIndex = MaterialIndex;
-    return Mesh;
-}
-
-inline v3 GetSkyColor(const ray &Ray)
-{
-    f32 T = 0.5f * (VectorComponent(Ray.Direction, 1) + 1.0f);
-    return (1.0f - T) * SRGBToLinear(V3(1.0f)) + T * SRGBToLinear(V3( 0.5f, 0.7f, 1.0f ));
-}
-
-function v3
-TraceRay(ray Ray,
-         const world *World,
-         i32 Depth,
-         random_series *RandomSeries)
-{
-    if (Depth <= 0)
-    {
-        return V3(0.0f);
-    }
-
-    i32 ClosestMeshIndex = -1;
-    f32 ClosestT         = MAX_F32;
-
-    for (u32 MeshIndex = 0; MeshIndex < World->MeshCount; MeshIndex++)
-    {
-        const mesh *Mesh = World->Meshes + MeshIndex;
-
-        f32  T   = 0.0f;
-        bool Hit = RayCastSphere(Ray, Mesh->Sphere, &T);
-        if (Hit && T < ClosestT)
-        {
-            ClosestT         = T;
-            ClosestMeshIndex = MeshIndex;
-        }
-    }
-
-    if (ClosestMeshIndex != -1)
-    {
-        const mesh *Mesh = World->Meshes + ClosestMeshIndex;
-        intersection_info IntersectionInfo = GetRaySphereIntersectionInfo(Ray,
-                                                                          Mesh->Sphere,
-                                                                          ClosestT);
-
-        const v3       &Point    = IntersectionInfo.Point + IntersectionInfo.Normal * 0.00001f;
-        const v3       &Normal   = IntersectionInfo.Normal;
-        const material &Material = World->Materials[Mesh->MaterialIndex];
-
-        v3 NewNormal = Normalize(Normal + Material.Roughness * RandomV3(RandomSeries, -0.5f, 0.5f));
-        v3 Reflected = Reflect(Ray.Direction, NewNormal);
-
-        if (Dot(Reflected, Normal) > 0.0f)
-        {
-            ray NewRay = RayOriginDirection(Point, Reflected);
-            return SRGBToLinear(Material.Albedo) + 0.2f * TraceRay(NewRay, World, Depth - 1, RandomSeries);
-        }
-        else
-        {
-            return V3(0.0f);
-        }
-    }
-
-    return GetSkyColor(Ray);
-}
+#include "tracer_wavefront.cpp"
+#include "tracer_image.cpp"
+#include "tracer_progressive.cpp"
+#include "tracer_denoise.cpp"
 
 global_variable u32 GlobalFrameBufferWidth;
 global_variable u32 GlobalFrameBufferHeight;
@@ -155,6 +37,8 @@ void OnFramebufferResize(GLFWwindow *Window,
 
 int main()
 {
+    PROFILE_INITIALIZE();
+
     if (!glfwInit())
     {
         fprintf(stderr, "failed to initalize glfw\n");
@@ -192,9 +76,15 @@ int main()
     InitializeFrameBuffer(&AccumulationFrameBuffer, 1280, 720);
     ClearFrameBuffer(&AccumulationFrameBuffer);
 
+    sample_buffer SampleBuffer = {};
+    InitializeSampleBuffer(&SampleBuffer, 1280, 720);
+
     frame_buffer ViewportFrameBuffer = {};
     InitializeFrameBuffer(&ViewportFrameBuffer, 1280, 720);
 
+    feature_buffer FeatureBuffer = {};
+    InitializeFeatureBuffer(&FeatureBuffer, 1280, 720);
+
     const f32 FocalLength = 1.0f;
     const v3 Origin       = V3(0.0f, 0.0f, 0.0f);
     camera ViewportCamera = {};
@@ -204,88 +94,217 @@ int main()
                      FocalLength,
                      Origin);
 
+    // note(harlequin): edited as plain floats, v3 may be a simd register
+    f32 CameraPosition[3] = { 0.0f, 0.0f, 0.0f };
+    f32 CameraTarget[3]   = { 0.0f, 0.0f, -1.0f };
+    f32 ApertureRadius    = 0.0f;
+    f32 FocusDistance     = 1.0f;
+
     world World = {};
-    PushMaterial(&World, V3(1.0f, 0.0f, 0.0f), 0.0f);
-    PushMaterial(&World, V3(0.0f, 1.0f, 0.0f), 0.0f);
-    PushMaterial(&World, V3(0.0f, 0.0f, 1.0f), 0.2f);
+    PushDemoScene(&World);
+    BuildWorldBvh(&World);
+
+    trace_settings TraceSettings = {};
+    TraceSettings.RayBounceCount     = 64;
+    TraceSettings.Integrator         = Integrator_Recursive;
+    TraceSettings.PacketTracing      = true;
+    TraceSettings.Seed               = 0;
+    TraceSettings.AdaptiveSampling   = false;
+    TraceSettings.NoiseThreshold     = 0.02f;
+    TraceSettings.MinimumSampleCount = 8;
+    TraceSettings.Tonemapper         = Tonemapper_Clamp;
+    u32 FrameCount = 1;
 
-    PushSphere(&World, V3(0.5f, 0.0f, -1.0f), 0.5f, 0);
-    PushSphere(&World, V3(-0.5f, 0.0f, -1.0f), 0.5f, 1);
-    PushSphere(&World, V3(0.0f, -100.5f, -1.0f), 100.0f, 2);
+    // note(harlequin): all limits off by default, the viewport keeps accumulating until one is set
+    progressive_settings ProgressiveSettings = {};
+    ProgressiveSettings.MinimumSampleCount = 8;
+    progressive_render ViewportRender = {};
+    BeginProgressiveRender(&ViewportRender, ProgressiveSettings);
 
-    u32 RayBounceCount = 64;
-    u32 FrameCount = 1;
+    // note(harlequin): the denoised image only replaces what is shown, the accumulation converges as before
+    bool Denoise = false;
+    denoise_settings DenoiseSettings = DefaultDenoiseSettings();
+    denoiser ViewportDenoiser = {};
+    bool Retonemap = false;
 
     opengl_texture ViewportTexture = {};
     InitializeOpenglTexture(&ViewportTexture,
                             ViewportFrameBuffer.Width,
                             ViewportFrameBuffer.Height,
-                            GL_RGB,
-                            GL_RGB32F,
-                            GL_FLOAT);
+                            GL_RGBA,
+                            GL_RGBA8,
+                            GL_UNSIGNED_BYTE);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, ViewportTexture.Handle);
 
+    // note(harlequin): a frame that finds both upload buffers in flight stays pending until one frees up
+    pixel_upload ViewportUpload = {};
+    InitializePixelUpload(&ViewportUpload,
+                          GetOpenglUploadBackend(),
+                          ViewportFrameBuffer.Width,
+                          ViewportFrameBuffer.Height);
+    bool UploadPending = false;
+
     job_system *JobSystem = new(malloc(sizeof(job_system))) job_system {};
     InitializeJobSystem(JobSystem);
 
     while (!glfwWindowShouldClose(Window))
     {
+        PROFILE_SCOPE("Frame");
         glfwPollEvents();
 
-        u32 PixelCount = ViewportFrameBuffer.Width * ViewportFrameBuffer.Height;
-        u32 PixelCountPerThread = PixelCount / JobSystem->ThreadCount;
-
-        for (u32 ThreadIndex = 0;
-             ThreadIndex < JobSystem->ThreadCount - 1;
-             ThreadIndex++)
+        if (FrameCount == 1)
         {
-            u32 StartPixelIndex = PixelCountPerThread * ThreadIndex;
-            u32 EndPixelIndex   = PixelCountPerThread * (ThreadIndex + 1);
-
-            trace_rays_job Job  = {};
-            Job.World = &World;
-            Job.Camera = &ViewportCamera;
-            Job.RayBounceCount = RayBounceCount;
-            Job.AccumulationFrameBuffer = &AccumulationFrameBuffer;
-            Job.FrameBuffer = &ViewportFrameBuffer;
-            Job.FrameCount = FrameCount;
-            Job.RandomSeries = &JobSystem->ThreadStorage[ThreadIndex].Series;
-            Job.StartPixelIndex = StartPixelIndex;
-            Job.EndPixelIndex = EndPixelIndex;
-
-            QueueTraceRaysJobs(JobSystem, ThreadIndex, Job);
+            BeginProgressiveRender(&ViewportRender, ProgressiveSettings);
         }
 
-        trace_rays_job Job = {};
-        Job.World = &World;
-        Job.Camera = &ViewportCamera;
-        Job.RayBounceCount = RayBounceCount;
-        Job.AccumulationFrameBuffer = &AccumulationFrameBuffer;
-        Job.FrameBuffer = &ViewportFrameBuffer;
-        Job.FrameCount = FrameCount;
-        Job.RandomSeries = &JobSystem->ThreadStorage[JobSystem->ThreadCount - 1].Series;
-        Job.StartPixelIndex = (JobSystem->ThreadCount - 1) * PixelCountPerThread;
-        Job.EndPixelIndex = PixelCount;
-        TraceRays(&Job);
+        bool Traced = ShouldTraceFrame(&ViewportRender);
+        if (Traced)
+        {
+            TraceSettings.MaxSampleCount = ProgressiveSettings.MaxSampleCount;
+            TraceFrame(JobSystem,
+                       &World,
+                       &ViewportCamera,
+                       TraceSettings,
+                       &AccumulationFrameBuffer,
+                       &SampleBuffer,
+                       Denoise ? &FeatureBuffer : nullptr,
+                       &ViewportFrameBuffer,
+                       FrameCount);
+            EndProgressiveFrame(&ViewportRender, &SampleBuffer, JobSystem->FrameStats.RayCount, JobSystem->ActiveTileCount);
+            FrameCount++;
+        }
 
-        while (!AllJobsCompleted(JobSystem));
+        // note(harlequin): the accumulation is linear, a new tonemapper resolves it again instead of restarting.
+        // tiles retired by adaptive sampling or a stopped render would keep the old one otherwise
+        if (Retonemap && !Denoise)
+        {
+            ResolvePixels(AccumulationFrameBuffer.Pixels,
+                          SampleBuffer.Pixels,
+                          ViewportFrameBuffer.Pixels,
+                          ViewportFrameBuffer.Width * ViewportFrameBuffer.Height,
+                          TraceSettings.Tonemapper);
+        }
 
-        FrameCount++;
+        if (Denoise && (Traced || Retonemap))
+        {
+            DenoiseFrame(JobSystem,
+                         &ViewportDenoiser,
+                         DenoiseSettings,
+                         &AccumulationFrameBuffer,
+                         &SampleBuffer,
+                         &FeatureBuffer,
+                         &ViewportFrameBuffer);
+        }
 
-        CopyFrameBufferToTexture(&ViewportFrameBuffer, &ViewportTexture);
+        if (Traced || Retonemap || UploadPending)
+        {
+            UploadPending = !UploadFrameBuffer(&ViewportUpload, &ViewportFrameBuffer, ViewportTexture.Handle);
+        }
+        Retonemap = false;
 
         ImVec2 ViewportSize = {};
 
         ImGuiBeginFrame();
         {
             {ImGui::Begin("Settings");
-				ImGui::SliderInt("RayBounceCount", (i32*)&RayBounceCount, 1, 64);
+				ImGui::SliderInt("RayBounceCount", (i32*)&TraceSettings.RayBounceCount, 1, 64);
+				ImGui::Combo("Integrator", (i32*)&TraceSettings.Integrator, IntegratorNames, Integrator_Count);
+				ImGui::Checkbox("Packet Tracing", &TraceSettings.PacketTracing);
+				if (ImGui::Combo("Tonemapper", (i32*)&TraceSettings.Tonemapper, TonemapperNames, Tonemapper_Count))
+				{
+					DenoiseSettings.Tonemapper = TraceSettings.Tonemapper;
+					Retonemap = true;
+				}
+				if (ImGui::Checkbox("Adaptive Sampling", &TraceSettings.AdaptiveSampling))
+				{
+					FrameCount = 1;
+				}
+				if (TraceSettings.AdaptiveSampling)
+				{
+					ImGui::SliderFloat("Noise Threshold", &TraceSettings.NoiseThreshold, 0.001f, 0.2f, "%.3f", ImGuiSliderFlags_Logarithmic);
+					ImGui::Text("Active Tiles %u/%u", JobSystem->ActiveTileCount, JobSystem->TileCount);
+				}
 				ImGui::SliderInt("FrameCount", (i32*)&FrameCount, 1, UINT_MAX);
 
+				// note(harlequin): the features are only gathered while denoising, so turning it on restarts
+				if (ImGui::Checkbox("Denoise", &Denoise) && Denoise)
+				{
+					FrameCount = 1;
+				}
+				if (Denoise)
+				{
+					ImGui::SliderInt("Denoise Iterations", (i32*)&DenoiseSettings.IterationCount, 1, DENOISE_MAX_ITERATION_COUNT);
+				}
+
+				if (ImGui::CollapsingHeader("Camera"))
+				{
+					bool Changed = false;
+					Changed |= ImGui::DragFloat3("Position", CameraPosition, 0.01f);
+					Changed |= ImGui::DragFloat3("Target", CameraTarget, 0.01f);
+					Changed |= ImGui::SliderFloat("Aperture", &ApertureRadius, 0.0f, 0.5f, "%.3f");
+					Changed |= ImGui::SliderFloat("Focus Distance", &FocusDistance, 0.1f, 20.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+
+					v3 Position = V3(CameraPosition[0], CameraPosition[1], CameraPosition[2]);
+					v3 Target   = V3(CameraTarget[0], CameraTarget[1], CameraTarget[2]);
+					v3 Up       = V3(0.0f, 1.0f, 0.0f);
+					if (Changed && Length(Cross(Target - Position, Up)) > 0.0f)
+					{
+						LookAtCamera(&ViewportCamera, Position, Target, Up);
+						SetCameraLens(&ViewportCamera, ApertureRadius, FocusDistance);
+						FrameCount = 1;
+					}
+				}
+
+				if (ImGui::CollapsingHeader("Progressive"))
+				{
+					// note(harlequin): changing a limit restarts the accumulation so the curve starts from zero
+					bool Changed = false;
+					Changed |= ImGui::InputDouble("Time Budget (s)", &ProgressiveSettings.TimeBudgetSeconds, 1.0, 10.0, "%.1f");
+					Changed |= ImGui::InputInt("Max Samples", (i32*)&ProgressiveSettings.MaxSampleCount);
+					Changed |= ImGui::InputFloat("Target Error", &ProgressiveSettings.TargetError, 0.001f, 0.01f, "%.4f");
+					if (Changed)
+					{
+						FrameCount = 1;
+					}
+
+					ImGui::Text("%s, %.1f s, %.1f samples/pixel, error %.4f",
+								ProgressiveStopReasonNames[ViewportRender.StopReason],
+								ViewportRender.ElapsedSeconds,
+								ViewportRender.SamplesPerPixel,
+								ViewportRender.Error == MAX_F32 ? 0.0f : ViewportRender.Error);
+
+					auto GetCurveError = [](void *Data, i32 Index) -> f32
+					{
+						const convergence_point *Point = (const convergence_point *)Data + Index;
+						return Point->Error == MAX_F32 ? 0.0f : Point->Error;
+					};
+					ImGui::PlotLines("Error", GetCurveError, ViewportRender.Curve, (i32)ViewportRender.CurveCount,
+									 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 80.0f));
+				}
+
 				ImGuiIO &IO = ImGui::GetIO();
 				ImGui::Text("Framerate %.2f ms/frame (%.1f FPS)", 1000.0f / IO.Framerate, IO.Framerate);
+
+				trace_stats *Stats = &JobSystem->FrameStats;
+				f64 OneOverRayCount = Stats->RayCount ? 1.0 / (f64)Stats->RayCount : 0.0;
+				ImGui::Text("Rays %llu (%.2f Mrays/s)",
+							(unsigned long long)Stats->RayCount,
+							JobSystem->FrameSeconds > 0.0 ? (f64)Stats->RayCount / JobSystem->FrameSeconds * 1e-6 : 0.0);
+				ImGui::Text("Node Tests %.2f/ray", (f64)Stats->NodeTestCount * OneOverRayCount);
+				ImGui::Text("Primitive Tests %.2f/ray", (f64)Stats->PrimitiveTestCount * OneOverRayCount);
+
+				if (ImGui::CollapsingHeader("Threads"))
+				{
+					for (u32 ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+					{
+						thread_storage *Storage = JobSystem->ThreadStorage + ThreadIndex;
+						char Label[64];
+						snprintf(Label, sizeof(Label), "%u tiles (%u stolen)", Storage->TileCount, Storage->StolenTileCount);
+						ImGui::ProgressBar(JobSystem->ThreadUtilization[ThreadIndex], ImVec2(-1.0f, 0.0f), Label);
+					}
+				}
 				ImGui::End();}
 
             {ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
@@ -318,6 +337,14 @@ int main()
 							  ViewportWidth,
 							  ViewportHeight);
 
+            ResizeSampleBuffer(&SampleBuffer,
+							   ViewportWidth,
+							   ViewportHeight);
+
+            ResizeFeatureBuffer(&FeatureBuffer,
+								ViewportWidth,
+								ViewportHeight);
+
             ResizeFrameBuffer(&ViewportFrameBuffer,
 							  ViewportWidth,
 							  ViewportHeight);
@@ -325,6 +352,11 @@ int main()
             ResizeTexture(&ViewportTexture,
 						  ViewportWidth,
 						  ViewportHeight);
+
+            ResizePixelUpload(&ViewportUpload,
+							  ViewportWidth,
+							  ViewportHeight);
+            UploadPending = false;
         }
 
         if (FrameCount == 1)
@@ -336,22 +368,15 @@ int main()
     }
 
     ShutdownJobSystem(JobSystem);
+    FreeProgressiveRender(&ViewportRender);
+    FreeDenoiser(&ViewportDenoiser);
+    FreePixelUpload(&ViewportUpload);
+    FreeFeatureBuffer(&FeatureBuffer);
+    FreeWorld(&World);
 
     glfwTerminate();
 
-    u32 PixelCount = ViewportFrameBuffer.Width * ViewportFrameBuffer.Height;
-    color8 *OutputImage = (color8 *)_aligned_malloc(sizeof(color8) * PixelCount, alignof(color8));
-    for (u32 PixelIndex = 0; PixelIndex < PixelCount;PixelIndex++)
-    {
-        color8 *OutputPixel = OutputImage + PixelIndex;
-        v3 *FrameBufferPixel = ViewportFrameBuffer.Pixels + PixelIndex;
-        *OutputPixel = NormalizedColorToColor8(*FrameBufferPixel);
-    }
-
-    bool Success = SavePngImageToDisk("output.png",
-                                      OutputImage,
-                                      ViewportFrameBuffer.Width,
-                                      ViewportFrameBuffer.Height);
+    bool Success = SaveFrameBufferToPng("output.png", &ViewportFrameBuffer);
     if (Success)
     {
         fprintf(stderr, "output.png saved successfully\n");
@@ -360,4 +385,17 @@ int main()
     {
         fprintf(stderr, "failed to save output.png\n");
     }
+
+#if TRACER_PROFILE
+    // note(harlequin): the viewer has no command line, a profiling build always leaves the trace next to the png
+    if (WriteProfile("profile.json"))
+    {
+        fprintf(stderr, "profile.json saved successfully\n");
+    }
+    else
+    {
+        fprintf(stderr, "failed to save profile.json\n");
+    }
+    FreeProfile();
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include "tracer_math.h"
 
-v3 Normalize(const v3& V, const v3 &ReturnedV3IfVLengthIsZero /* = { 0.0f, 0.0f, 0.0f }*/)
+v3 Normalize(const v3& V, const v3 &ReturnedV3IfVLengthIsZero /* = V3(0.0f) */)
 {
     f32 Magnitude = Length(V);
 
@@ -33,4 +33,27 @@ GetRaySphereIntersectionInfo(const ray    &Ray,
     }
     Result.Point = Point;
     return Result;
-}
\ No newline at end of file
+}
+
+intersection_info
+GetRayTriangleIntersectionInfo(const ray      &Ray,
+                               const triangle &Triangle,
+                               f32             T)
+{
+    intersection_info Result;
+    v3 Point  = SampleRay(Ray, T);
+    v3 Normal = Normalize(Cross(Triangle.Edge1, Triangle.Edge2));
+
+    if (Dot(Ray.Direction, Normal) > 0.0f)
+    {
+        Result.Normal    = -Normal;
+        Result.FrontFace = false;
+    }
+    else
+    {
+        Result.Normal    = Normal;
+        Result.FrontFace = true;
+    }
+    Result.Point = Point;
+    return Result;
+}
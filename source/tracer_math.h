@@ -2,11 +2,15 @@
 
 #include "tracer_core.h"
 #include "tracer_intrinsics.h"
+#include "tracer_lane.h"
 
 #include <math.h>
 #include <float.h>
 
+// note(harlequin): v3 is an __m128 when enabled and a plain struct otherwise, the build can override it
+#ifndef ENABLE_SIMD
 #define ENABLE_SIMD 1
+#endif
 #define PI 3.14159265358979323846f
 #define Two_PI 6.28318530718f
 #define PI_OVER_180_DEGREES 0.01745329251f
@@ -148,6 +152,10 @@ V3(f32 Scalar)
 	return Result;
 }
 
+// note(harlequin): gcc and clang treat __m128 as a builtin vector type that already has these
+// operators (and refuses overloads on it), msvc exposes it as a plain struct so we supply them
+#if !ENABLE_SIMD || defined(_MSC_VER)
+
 function inline v3
 operator+(const v3 &A, const v3 &B)
 {
@@ -260,6 +268,8 @@ operator/=(v3 &V, f32 Scalar)
 	return V;
 }
 
+#endif // !ENABLE_SIMD || defined(_MSC_VER)
+
 function inline f32
 SquareRoot(f32 Scalar)
 {
@@ -314,6 +324,14 @@ Reflect(const v3& V, const v3& Normal)
 	return V - 2.0f * Dot(V, Normal) * Normal;
 }
 
+function inline v3
+Cross(const v3 &A, const v3 &B)
+{
+	return V3(VectorComponent(A, 1) * VectorComponent(B, 2) - VectorComponent(A, 2) * VectorComponent(B, 1),
+			  VectorComponent(A, 2) * VectorComponent(B, 0) - VectorComponent(A, 0) * VectorComponent(B, 2),
+			  VectorComponent(A, 0) * VectorComponent(B, 1) - VectorComponent(A, 1) * VectorComponent(B, 0));
+}
+
 function inline v3
 Hadamard(const v3& A, const v3& B)
 {
@@ -362,9 +380,37 @@ Clamp(const v3 &V,
 	return Result;
 }
 
+function inline v3
+Minimum(const v3 &A, const v3 &B)
+{
+#if ENABLE_SIMD
+	v3 Result = _mm_min_ps(A, B);
+#else
+	v3 Result;
+	Result.X = A.X < B.X ? A.X : B.X;
+	Result.Y = A.Y < B.Y ? A.Y : B.Y;
+	Result.Z = A.Z < B.Z ? A.Z : B.Z;
+#endif
+	return Result;
+}
+
+function inline v3
+Maximium(const v3 &A, const v3 &B)
+{
+#if ENABLE_SIMD
+	v3 Result = _mm_max_ps(A, B);
+#else
+	v3 Result;
+	Result.X = A.X > B.X ? A.X : B.X;
+	Result.Y = A.Y > B.Y ? A.Y : B.Y;
+	Result.Z = A.Z > B.Z ? A.Z : B.Z;
+#endif
+	return Result;
+}
+
 function inline v3
 Normalize(const v3 &V,
-		  const v3 &ReturnedV3IfVLengthIsZero = { 0.0f, 0.0f, 0.0f });
+		  const v3 &ReturnedV3IfVLengthIsZero = V3(0.0f));
 
 function inline color8 NormalizedColorToColor8(const v3 &NormalizedColor)
 {
@@ -386,8 +432,13 @@ function inline color8 NormalizedColorToColor8(const v3 &NormalizedColor)
 function inline v3
 Pow(const v3 &Base, f32 Exponent)
 {
-#if ENABLE_SIMD
+#if ENABLE_SIMD && defined(_MSC_VER)
 	v3 Result = _mm_pow_ps(Base, _mm_set1_ps(Exponent));
+#elif ENABLE_SIMD
+	v3 Result = Base;
+	VectorComponent(Result, 0) = Pow(VectorComponent(Base, 0), Exponent);
+	VectorComponent(Result, 1) = Pow(VectorComponent(Base, 1), Exponent);
+	VectorComponent(Result, 2) = Pow(VectorComponent(Base, 2), Exponent);
 #else
 	v3 Result;
 	Result.X = Pow(Base.X, Exponent);
@@ -459,6 +510,96 @@ SphereCenterRadius(const v3 &Center, f32 Radius)
 	return Result;
 }
 
+struct aabb
+{
+	v3 Min;
+	v3 Max;
+};
+
+function inline aabb
+EmptyAabb()
+{
+	aabb Result;
+	Result.Min = V3(MAX_F32);
+	Result.Max = V3(-MAX_F32);
+	return Result;
+}
+
+function inline aabb
+Union(const aabb &A, const aabb &B)
+{
+	aabb Result;
+	Result.Min = Minimum(A.Min, B.Min);
+	Result.Max = Maximium(A.Max, B.Max);
+	return Result;
+}
+
+function inline aabb
+Union(const aabb &A, const v3 &Point)
+{
+	aabb Result;
+	Result.Min = Minimum(A.Min, Point);
+	Result.Max = Maximium(A.Max, Point);
+	return Result;
+}
+
+function inline v3
+GetAabbCenter(const aabb &Box)
+{
+	return (Box.Min + Box.Max) * 0.5f;
+}
+
+function inline f32
+GetAabbSurfaceArea(const aabb &Box)
+{
+	v3  Extent = Box.Max - Box.Min;
+	f32 X      = VectorComponent(Extent, 0);
+	f32 Y      = VectorComponent(Extent, 1);
+	f32 Z      = VectorComponent(Extent, 2);
+	if (X < 0.0f || Y < 0.0f || Z < 0.0f)
+	{
+		return 0.0f;
+	}
+	return 2.0f * (X * Y + Y * Z + Z * X);
+}
+
+function inline aabb
+GetSphereBounds(const sphere &Sphere)
+{
+	aabb Result;
+	Result.Min = Sphere.Center - V3(Sphere.Radius);
+	Result.Max = Sphere.Center + V3(Sphere.Radius);
+	return Result;
+}
+
+struct triangle
+{
+	v3 Vertex0;
+	v3 Edge1; // Vertex1 - Vertex0
+	v3 Edge2; // Vertex2 - Vertex0
+};
+
+function inline triangle
+TriangleVertices(const v3 &Vertex0, const v3 &Vertex1, const v3 &Vertex2)
+{
+	triangle Result;
+	Result.Vertex0 = Vertex0;
+	Result.Edge1   = Vertex1 - Vertex0;
+	Result.Edge2   = Vertex2 - Vertex0;
+	return Result;
+}
+
+function inline aabb
+GetTriangleBounds(const triangle &Triangle)
+{
+	v3 Vertex1 = Triangle.Vertex0 + Triangle.Edge1;
+	v3 Vertex2 = Triangle.Vertex0 + Triangle.Edge2;
+	aabb Result;
+	Result.Min = Minimum(Triangle.Vertex0, Minimum(Vertex1, Vertex2));
+	Result.Max = Maximium(Triangle.Vertex0, Maximium(Vertex1, Vertex2));
+	return Result;
+}
+
 struct intersection_info
 {
 	v3   Point;
@@ -471,6 +612,11 @@ GetRaySphereIntersectionInfo(const ray    &Ray,
 							 const sphere &Sphere,
 							 f32           T);
 
+function intersection_info
+GetRayTriangleIntersectionInfo(const ray      &Ray,
+							   const triangle &Triangle,
+							   f32             T);
+
 function inline v3
 NormalToNormalizedColor(const v3 &Normal)
 {
@@ -494,62 +640,350 @@ RayCastSphere(const ray    &Ray,
 	return DiscriminantOver4 > 0.0f && ClosestT > 0.0f;
 }
 
-global_variable f32 gamma = 2.2f;
+// note(harlequin): the exact srgb transfer functions, only used on the few colors decoded at load time and as
+// the reference of the lane approximation in ResolvePixels
+inline f32 SRGBToLinear(f32 SRGB)
+{
+    return SRGB <= 0.04045f ? SRGB * (1.0f / 12.92f) : powf((SRGB + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+inline f32 LinearToSRGB(f32 Linear)
+{
+    return Linear <= 0.0031308f ? Linear * 12.92f : 1.055f * powf(Linear, 1.0f / 2.4f) - 0.055f;
+}
 
-inline v3 SRGBToLinear(v3 SRGBColor) {
-    v3 result;
-    VectorComponent(result, 0) = powf(VectorComponent(SRGBColor, 0), gamma);
-    VectorComponent(result, 1) = powf(VectorComponent(SRGBColor, 1), gamma);
-    VectorComponent(result, 2) = powf(VectorComponent(SRGBColor, 2), gamma);
-    return result;
+inline v3 SRGBToLinear(v3 SRGBColor)
+{
+    return V3(SRGBToLinear(VectorComponent(SRGBColor, 0)),
+              SRGBToLinear(VectorComponent(SRGBColor, 1)),
+              SRGBToLinear(VectorComponent(SRGBColor, 2)));
 }
 
 inline v3 LinearToSRGB(v3 LinearColor)
 {
-    f32 one_over_gamma = 1.0f / gamma;
-    v3 result;
-    VectorComponent(result, 0) = powf(VectorComponent(LinearColor, 0), one_over_gamma);
-    VectorComponent(result, 1) = powf(VectorComponent(LinearColor, 1), one_over_gamma);
-    VectorComponent(result, 2) = powf(VectorComponent(LinearColor, 2), one_over_gamma);
-    return result;
+    return V3(LinearToSRGB(VectorComponent(LinearColor, 0)),
+              LinearToSRGB(VectorComponent(LinearColor, 1)),
+              LinearToSRGB(VectorComponent(LinearColor, 2)));
 }
 
-#if 0
-function inline bool
-RayCastSphereSIMD(const ray    &Ray,
-				  const sphere &Sphere,
-				  f32          *OutT)
+// note(harlequin): structure of arrays sphere store, the arrays are padded past Count to a multiple of LANE_WIDTH
+// so a kernel can always load a full register starting at any sphere index below Count
+struct sphere_soa
 {
+	u32  Count;
+	u32  PaddedCount;
+	f32 *CenterX;
+	f32 *CenterY;
+	f32 *CenterZ;
+	f32 *RadiusSquared;
+};
 
-	const i32 Mask = 0xff;
+struct ray_lanes
+{
+	lane_f32 OriginX;
+	lane_f32 OriginY;
+	lane_f32 OriginZ;
+	lane_f32 DirectionX;
+	lane_f32 DirectionY;
+	lane_f32 DirectionZ;
+	lane_f32 A;
+	lane_f32 OneOverA;
+};
+
+function inline ray_lanes
+RayLanes(const ray &Ray)
+{
+	ray_lanes Result;
+	Result.OriginX    = LaneF32(VectorComponent(Ray.Origin, 0));
+	Result.OriginY    = LaneF32(VectorComponent(Ray.Origin, 1));
+	Result.OriginZ    = LaneF32(VectorComponent(Ray.Origin, 2));
+	Result.DirectionX = LaneF32(VectorComponent(Ray.Direction, 0));
+	Result.DirectionY = LaneF32(VectorComponent(Ray.Direction, 1));
+	Result.DirectionZ = LaneF32(VectorComponent(Ray.Direction, 2));
+	// note(harlequin): Dot(Ray.Direction, Ray.Direction) once per ray instead of once per sphere
+	f32 A = Dot(Ray.Direction, Ray.Direction);
+	Result.A        = LaneF32(A);
+	Result.OneOverA = LaneF32(1.0f / A);
+	return Result;
+}
+
+// note(harlequin): LANE_WIDTH different rays, one per lane, used to trace coherent primary rays together
+struct ray_packet
+{
+	lane_f32 OriginX;
+	lane_f32 OriginY;
+	lane_f32 OriginZ;
+	lane_f32 DirectionX;
+	lane_f32 DirectionY;
+	lane_f32 DirectionZ;
+	lane_f32 InverseDirectionX;
+	lane_f32 InverseDirectionY;
+	lane_f32 InverseDirectionZ;
+	lane_f32 A;
+	lane_f32 OneOverA;
+};
+
+function inline ray_packet
+RayPacket(const ray *Rays)
+{
+	f32 Components[9][LANE_WIDTH];
+	f32 A[LANE_WIDTH];
+	for (u32 LaneIndex = 0; LaneIndex < LANE_WIDTH; LaneIndex++)
+	{
+		const ray *Ray = Rays + LaneIndex;
+		for (u32 Axis = 0; Axis < 3; Axis++)
+		{
+			f32 Direction = VectorComponent(Ray->Direction, Axis);
+			Components[Axis][LaneIndex]     = VectorComponent(Ray->Origin, Axis);
+			Components[3 + Axis][LaneIndex] = Direction;
+			if (fabsf(Direction) < 1e-8f)
+			{
+				Direction = Direction < 0.0f ? -1e-8f : 1e-8f;
+			}
+			Components[6 + Axis][LaneIndex] = 1.0f / Direction;
+		}
+		A[LaneIndex] = Dot(Ray->Direction, Ray->Direction);
+	}
+
+	ray_packet Result;
+	Result.OriginX           = LoadLaneF32(Components[0]);
+	Result.OriginY           = LoadLaneF32(Components[1]);
+	Result.OriginZ           = LoadLaneF32(Components[2]);
+	Result.DirectionX        = LoadLaneF32(Components[3]);
+	Result.DirectionY        = LoadLaneF32(Components[4]);
+	Result.DirectionZ        = LoadLaneF32(Components[5]);
+	Result.InverseDirectionX = LoadLaneF32(Components[6]);
+	Result.InverseDirectionY = LoadLaneF32(Components[7]);
+	Result.InverseDirectionZ = LoadLaneF32(Components[8]);
+	Result.A                 = LoadLaneF32(A);
+	Result.OneOverA          = LaneF32(1.0f) / Result.A;
+	return Result;
+}
 
-	v4 _RayOrigin = V4(Ray.Origin);
-	v4 _RayDirection = V4(Ray.Direction);
-	v4 _SphereCenter = V4(Sphere.Center);
+// note(harlequin): one sphere against every ray of the packet, lanes that hit closer than
+// *InOutClosestT get their t and sphere index replaced, returns the lanes that did
+function inline lane_f32
+RayPacketCastSphere(const ray_packet &Packet,
+					const sphere_soa *Spheres,
+					u32               SphereIndex,
+					lane_f32         *InOutClosestT,
+					lane_u32         *InOutSphereIndex)
+{
+	lane_f32 Zero = LaneF32(0.0f);
 
-	__m128 RayOrigin = _mm_load_ps((const f32*)&_RayOrigin);
-	__m128 RayDirection = _mm_load_ps((const f32*)&_RayDirection);
-	__m128 SphereCenter = _mm_load_ps((const f32*)&_SphereCenter);
+	lane_f32 RayOriginToSphereCenterX = Packet.OriginX - LaneF32(Spheres->CenterX[SphereIndex]);
+	lane_f32 RayOriginToSphereCenterY = Packet.OriginY - LaneF32(Spheres->CenterY[SphereIndex]);
+	lane_f32 RayOriginToSphereCenterZ = Packet.OriginZ - LaneF32(Spheres->CenterZ[SphereIndex]);
 
-	// const v3 RayOriginToSphereCenter = Ray.Origin - Sphere.Center;
-	__m128 RayOriginToSphereCenter = _mm_sub_ps(RayOrigin, SphereCenter);
+	lane_f32 HalfB = RayOriginToSphereCenterX * Packet.DirectionX +
+					 RayOriginToSphereCenterY * Packet.DirectionY +
+					 RayOriginToSphereCenterZ * Packet.DirectionZ;
+	lane_f32 C = RayOriginToSphereCenterX * RayOriginToSphereCenterX +
+				 RayOriginToSphereCenterY * RayOriginToSphereCenterY +
+				 RayOriginToSphereCenterZ * RayOriginToSphereCenterZ -
+				 LaneF32(Spheres->RadiusSquared[SphereIndex]);
 
-	// const f32 A = Dot(Ray.Direction, Ray.Direction);
-	__m128 RayDirectionSquared = _mm_dp_ps(RayDirection, RayDirection, Mask);
-	const f32 A = ((f32*)&RayDirectionSquared)[0];
+	lane_f32 DiscriminantOver4 = HalfB * HalfB - Packet.A * C;
+	lane_f32 T = (-HalfB - SquareRoot(Maximium(DiscriminantOver4, Zero))) * Packet.OneOverA;
 
-	// const f32 HalfB = Dot(RayOriginToSphereCenter, Ray.Direction);
-	__m128 HalfBMul = _mm_dp_ps(RayOriginToSphereCenter, RayDirection, Mask);
-	const f32 HalfB = ((f32*)&HalfBMul)[0];
+	lane_f32 Hit = (DiscriminantOver4 > Zero) & (T > Zero) & (T < *InOutClosestT);
+	*InOutClosestT    = Select(Hit, T, *InOutClosestT);
+	*InOutSphereIndex = Select(Hit, LaneU32(SphereIndex), *InOutSphereIndex);
+	return Hit;
+}
 
-	// note(harlequin): should we cache Sphere.Radius * Sphere.Radius ?
-	// const f32 C = Dot(RayOriginToSphereCenter, RayOriginToSphereCenter) - Sphere.Radius * Sphere.Radius;
-	__m128 RayOriginToSphereCenterSquared = _mm_dp_ps(RayOriginToSphereCenter, RayOriginToSphereCenter, Mask);
-	const f32 C = ((f32*)&RayOriginToSphereCenterSquared)[0] - Sphere.Radius * Sphere.Radius;
+// note(harlequin): same math as RayCastSphere for LANE_WIDTH spheres per iteration, the closest hit
+// is tracked per lane and reduced once at the end, returns true when a sphere in
+// [FirstSphere, FirstSphere + SphereCount) is hit closer than *InOutClosestT
+function inline bool
+RayCastSphereLanes(const ray_lanes  &Ray,
+				   const sphere_soa *Spheres,
+				   u32               FirstSphere,
+				   u32               SphereCount,
+				   f32              *InOutClosestT,
+				   u32              *OutSphereIndex)
+{
+	lane_f32 ClosestT     = LaneF32(*InOutClosestT);
+	lane_u32 ClosestIndex = LaneU32(0);
+	lane_f32 AnyHit       = LaneF32(0.0f) < LaneF32(0.0f);
+	lane_f32 Zero         = LaneF32(0.0f);
+
+	for (u32 Offset = 0; Offset < SphereCount; Offset += LANE_WIDTH)
+	{
+		u32 SphereIndex = FirstSphere + Offset;
+		Assert(SphereIndex + LANE_WIDTH <= Spheres->PaddedCount);
+
+		lane_f32 RayOriginToSphereCenterX = Ray.OriginX - LoadLaneF32(Spheres->CenterX + SphereIndex);
+		lane_f32 RayOriginToSphereCenterY = Ray.OriginY - LoadLaneF32(Spheres->CenterY + SphereIndex);
+		lane_f32 RayOriginToSphereCenterZ = Ray.OriginZ - LoadLaneF32(Spheres->CenterZ + SphereIndex);
+
+		lane_f32 HalfB = RayOriginToSphereCenterX * Ray.DirectionX +
+						 RayOriginToSphereCenterY * Ray.DirectionY +
+						 RayOriginToSphereCenterZ * Ray.DirectionZ;
+		lane_f32 C = RayOriginToSphereCenterX * RayOriginToSphereCenterX +
+					 RayOriginToSphereCenterY * RayOriginToSphereCenterY +
+					 RayOriginToSphereCenterZ * RayOriginToSphereCenterZ -
+					 LoadLaneF32(Spheres->RadiusSquared + SphereIndex);
+
+		lane_f32 DiscriminantOver4 = HalfB * HalfB - Ray.A * C;
+		lane_f32 T = (-HalfB - SquareRoot(Maximium(DiscriminantOver4, Zero))) * Ray.OneOverA;
+
+		lane_f32 InRange = LaneIndexF32() < LaneF32((f32)(SphereCount - Offset));
+		lane_f32 Hit     = InRange & (DiscriminantOver4 > Zero) & (T > Zero) & (T < ClosestT);
+
+		ClosestT     = Select(Hit, T, ClosestT);
+		ClosestIndex = Select(Hit, LaneU32(SphereIndex) + LaneIndexU32(), ClosestIndex);
+		AnyHit      |= Hit;
+	}
+
+	if (!AnyTrue(AnyHit))
+	{
+		return false;
+	}
+
+	u32 LaneIndex   = 0;
+	*InOutClosestT  = HorizontalMinimum(ClosestT, &LaneIndex);
+	*OutSphereIndex = ExtractLane(ClosestIndex, LaneIndex);
+	return true;
+}
+
+// note(harlequin): structure of arrays triangle store, padded like sphere_soa
+struct triangle_soa
+{
+	u32  Count;
+	u32  PaddedCount;
+	f32 *Vertex0X;
+	f32 *Vertex0Y;
+	f32 *Vertex0Z;
+	f32 *Edge1X;
+	f32 *Edge1Y;
+	f32 *Edge1Z;
+	f32 *Edge2X;
+	f32 *Edge2Y;
+	f32 *Edge2Z;
+};
 
-	const f32 DiscriminantOver4 = HalfB * HalfB - A * C;
-	const f32 ClosestT = (-HalfB - sqrtf(DiscriminantOver4)) / A;
-	*OutT = ClosestT;
-	return DiscriminantOver4 > 0.0f && ClosestT > 0.0f;
+#define TRIANGLE_EPSILON 1e-9f
+
+// note(harlequin): moller-trumbore, two sided, LANE_WIDTH triangles per iteration with the same
+// per lane closest hit tracking as RayCastSphereLanes
+function inline bool
+RayCastTriangleLanes(const ray_lanes    &Ray,
+					 const triangle_soa *Triangles,
+					 u32                 FirstTriangle,
+					 u32                 TriangleCount,
+					 f32                *InOutClosestT,
+					 u32                *OutTriangleIndex)
+{
+	lane_f32 ClosestT     = LaneF32(*InOutClosestT);
+	lane_u32 ClosestIndex = LaneU32(0);
+	lane_f32 AnyHit       = LaneF32(0.0f) < LaneF32(0.0f);
+	lane_f32 Zero         = LaneF32(0.0f);
+	lane_f32 One          = LaneF32(1.0f);
+	lane_f32 Epsilon      = LaneF32(TRIANGLE_EPSILON);
+
+	for (u32 Offset = 0; Offset < TriangleCount; Offset += LANE_WIDTH)
+	{
+		u32 TriangleIndex = FirstTriangle + Offset;
+		Assert(TriangleIndex + LANE_WIDTH <= Triangles->PaddedCount);
+
+		lane_f32 Edge1X = LoadLaneF32(Triangles->Edge1X + TriangleIndex);
+		lane_f32 Edge1Y = LoadLaneF32(Triangles->Edge1Y + TriangleIndex);
+		lane_f32 Edge1Z = LoadLaneF32(Triangles->Edge1Z + TriangleIndex);
+		lane_f32 Edge2X = LoadLaneF32(Triangles->Edge2X + TriangleIndex);
+		lane_f32 Edge2Y = LoadLaneF32(Triangles->Edge2Y + TriangleIndex);
+		lane_f32 Edge2Z = LoadLaneF32(Triangles->Edge2Z + TriangleIndex);
+
+		// P = Direction x Edge2
+		lane_f32 PX = Ray.DirectionY * Edge2Z - Ray.DirectionZ * Edge2Y;
+		lane_f32 PY = Ray.DirectionZ * Edge2X - Ray.DirectionX * Edge2Z;
+		lane_f32 PZ = Ray.DirectionX * Edge2Y - Ray.DirectionY * Edge2X;
+
+		lane_f32 Determinant = Edge1X * PX + Edge1Y * PY + Edge1Z * PZ;
+		lane_f32 NonParallel = (Determinant > Epsilon) | (Determinant < -Epsilon);
+		lane_f32 OneOverDeterminant = One / Select(NonParallel, Determinant, One);
+
+		lane_f32 ToOriginX = Ray.OriginX - LoadLaneF32(Triangles->Vertex0X + TriangleIndex);
+		lane_f32 ToOriginY = Ray.OriginY - LoadLaneF32(Triangles->Vertex0Y + TriangleIndex);
+		lane_f32 ToOriginZ = Ray.OriginZ - LoadLaneF32(Triangles->Vertex0Z + TriangleIndex);
+
+		lane_f32 U = (ToOriginX * PX + ToOriginY * PY + ToOriginZ * PZ) * OneOverDeterminant;
+
+		// Q = ToOrigin x Edge1
+		lane_f32 QX = ToOriginY * Edge1Z - ToOriginZ * Edge1Y;
+		lane_f32 QY = ToOriginZ * Edge1X - ToOriginX * Edge1Z;
+		lane_f32 QZ = ToOriginX * Edge1Y - ToOriginY * Edge1X;
+
+		lane_f32 V = (Ray.DirectionX * QX + Ray.DirectionY * QY + Ray.DirectionZ * QZ) * OneOverDeterminant;
+		lane_f32 T = (Edge2X * QX + Edge2Y * QY + Edge2Z * QZ) * OneOverDeterminant;
+
+		lane_f32 InRange = LaneIndexF32() < LaneF32((f32)(TriangleCount - Offset));
+		lane_f32 Hit = InRange & NonParallel &
+					   (U >= Zero) & (V >= Zero) & ((U + V) <= One) &
+					   (T > Zero) & (T < ClosestT);
+
+		ClosestT     = Select(Hit, T, ClosestT);
+		ClosestIndex = Select(Hit, LaneU32(TriangleIndex) + LaneIndexU32(), ClosestIndex);
+		AnyHit      |= Hit;
+	}
+
+	if (!AnyTrue(AnyHit))
+	{
+		return false;
+	}
+
+	u32 LaneIndex     = 0;
+	*InOutClosestT    = HorizontalMinimum(ClosestT, &LaneIndex);
+	*OutTriangleIndex = ExtractLane(ClosestIndex, LaneIndex);
+	return true;
+}
+
+// note(harlequin): one triangle against every ray of the packet, see RayPacketCastSphere
+function inline lane_f32
+RayPacketCastTriangle(const ray_packet   &Packet,
+					  const triangle_soa *Triangles,
+					  u32                 TriangleIndex,
+					  u32                 PrimitiveIndex,
+					  lane_f32           *InOutClosestT,
+					  lane_u32           *InOutPrimitiveIndex)
+{
+	lane_f32 Zero    = LaneF32(0.0f);
+	lane_f32 One     = LaneF32(1.0f);
+	lane_f32 Epsilon = LaneF32(TRIANGLE_EPSILON);
+
+	lane_f32 Edge1X = LaneF32(Triangles->Edge1X[TriangleIndex]);
+	lane_f32 Edge1Y = LaneF32(Triangles->Edge1Y[TriangleIndex]);
+	lane_f32 Edge1Z = LaneF32(Triangles->Edge1Z[TriangleIndex]);
+	lane_f32 Edge2X = LaneF32(Triangles->Edge2X[TriangleIndex]);
+	lane_f32 Edge2Y = LaneF32(Triangles->Edge2Y[TriangleIndex]);
+	lane_f32 Edge2Z = LaneF32(Triangles->Edge2Z[TriangleIndex]);
+
+	lane_f32 PX = Packet.DirectionY * Edge2Z - Packet.DirectionZ * Edge2Y;
+	lane_f32 PY = Packet.DirectionZ * Edge2X - Packet.DirectionX * Edge2Z;
+	lane_f32 PZ = Packet.DirectionX * Edge2Y - Packet.DirectionY * Edge2X;
+
+	lane_f32 Determinant = Edge1X * PX + Edge1Y * PY + Edge1Z * PZ;
+	lane_f32 NonParallel = (Determinant > Epsilon) | (Determinant < -Epsilon);
+	lane_f32 OneOverDeterminant = One / Select(NonParallel, Determinant, One);
+
+	lane_f32 ToOriginX = Packet.OriginX - LaneF32(Triangles->Vertex0X[TriangleIndex]);
+	lane_f32 ToOriginY = Packet.OriginY - LaneF32(Triangles->Vertex0Y[TriangleIndex]);
+	lane_f32 ToOriginZ = Packet.OriginZ - LaneF32(Triangles->Vertex0Z[TriangleIndex]);
+
+	lane_f32 U = (ToOriginX * PX + ToOriginY * PY + ToOriginZ * PZ) * OneOverDeterminant;
+
+	lane_f32 QX = ToOriginY * Edge1Z - ToOriginZ * Edge1Y;
+	lane_f32 QY = ToOriginZ * Edge1X - ToOriginX * Edge1Z;
+	lane_f32 QZ = ToOriginX * Edge1Y - ToOriginY * Edge1X;
+
+	lane_f32 V = (Packet.DirectionX * QX + Packet.DirectionY * QY + Packet.DirectionZ * QZ) * OneOverDeterminant;
+	lane_f32 T = (Edge2X * QX + Edge2Y * QY + Edge2Z * QZ) * OneOverDeterminant;
+
+	lane_f32 Hit = NonParallel &
+				   (U >= Zero) & (V >= Zero) & ((U + V) <= One) &
+				   (T > Zero) & (T < *InOutClosestT);
+
+	*InOutClosestT       = Select(Hit, T, *InOutClosestT);
+	*InOutPrimitiveIndex = Select(Hit, LaneU32(PrimitiveIndex), *InOutPrimitiveIndex);
+	return Hit;
 }
-#endif
\ No newline at end of file
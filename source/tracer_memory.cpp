@@ -0,0 +1,213 @@
+#include "tracer_memory.h"
+
+void
+InitializeArena(memory_arena *Arena,
+                u64           MinimumBlockSize /* = 0 */)
+{
+    *Arena = {};
+    Arena->MinimumBlockSize = MinimumBlockSize;
+}
+
+function memory_block *
+AllocateMemoryBlock(u64 Size)
+{
+    // note(harlequin): the header sits in front of the data in the same allocation, padded to a cache line
+    u64 HeaderSize = (sizeof(memory_block) + MEMORY_BLOCK_ALIGNMENT - 1) & ~(u64)(MEMORY_BLOCK_ALIGNMENT - 1);
+    u8 *Memory = (u8 *)_aligned_malloc(HeaderSize + Size, MEMORY_BLOCK_ALIGNMENT);
+    if (!Memory)
+    {
+        return nullptr;
+    }
+
+    memory_block *Block = (memory_block *)Memory;
+    Block->Previous = nullptr;
+    Block->Base     = Memory + HeaderSize;
+    Block->Size     = Size;
+    Block->Used     = 0;
+    return Block;
+}
+
+inline u64
+GetAlignmentOffset(const memory_block *Block, u64 Alignment)
+{
+    Assert((Alignment & (Alignment - 1)) == 0);
+    u64 Address = (u64)(Block->Base + Block->Used);
+    return (Alignment - (Address & (Alignment - 1))) & (Alignment - 1);
+}
+
+void *
+PushSize(memory_arena *Arena,
+         u64           Size,
+         u64           Alignment /* = 16 */)
+{
+    memory_block *Block = Arena->CurrentBlock;
+    u64 AlignmentOffset = Block ? GetAlignmentOffset(Block, Alignment) : 0;
+
+    if (!Block || Block->Used + AlignmentOffset + Size > Block->Size)
+    {
+        u64 MinimumBlockSize = Arena->MinimumBlockSize ? Arena->MinimumBlockSize : MEMORY_ARENA_DEFAULT_BLOCK_SIZE;
+        u64 BlockSize = Block ? Block->Size * 2 : MinimumBlockSize;
+        if (BlockSize < MinimumBlockSize)
+        {
+            BlockSize = MinimumBlockSize;
+        }
+        while (BlockSize < Size + Alignment)
+        {
+            BlockSize *= 2;
+        }
+
+        memory_block *NewBlock = AllocateMemoryBlock(BlockSize);
+        if (!NewBlock)
+        {
+            return nullptr;
+        }
+        NewBlock->Previous  = Block;
+        Arena->CurrentBlock = NewBlock;
+        Arena->TotalSize   += BlockSize;
+
+        Block = NewBlock;
+        AlignmentOffset = GetAlignmentOffset(Block, Alignment);
+    }
+
+    void *Result = Block->Base + Block->Used + AlignmentOffset;
+    Block->Used      += AlignmentOffset + Size;
+    Arena->TotalUsed += AlignmentOffset + Size;
+    return Result;
+}
+
+void *
+GrowArenaArray(memory_arena *Arena,
+               void         *Array,
+               u64           ElementSize,
+               u64           Alignment,
+               u32           Count,
+               u32          *InOutCapacity,
+               u64           RequiredCount)
+{
+    u64 Capacity = *InOutCapacity;
+    if (RequiredCount <= Capacity)
+    {
+        return Array;
+    }
+
+    u64 NewCapacity = Capacity ? Capacity * 2 : 64;
+    if (NewCapacity < RequiredCount)
+    {
+        NewCapacity = RequiredCount;
+    }
+    if (NewCapacity > UINT_MAX)
+    {
+        if (RequiredCount > UINT_MAX)
+        {
+            return nullptr;
+        }
+        NewCapacity = UINT_MAX;
+    }
+
+    memory_block *Block = Arena->CurrentBlock;
+    u64 OldSize = Capacity * ElementSize;
+    u64 NewSize = NewCapacity * ElementSize;
+
+    if (Array && Block &&
+        (u8 *)Array + OldSize == Block->Base + Block->Used &&
+        Block->Used - OldSize + NewSize <= Block->Size)
+    {
+        Block->Used      += NewSize - OldSize;
+        Arena->TotalUsed += NewSize - OldSize;
+        *InOutCapacity = (u32)NewCapacity;
+        return Array;
+    }
+
+    void *Result = PushSize(Arena, NewSize, Alignment);
+    if (!Result)
+    {
+        return nullptr;
+    }
+    if (Count)
+    {
+        memcpy(Result, Array, Count * ElementSize);
+    }
+    *InOutCapacity = (u32)NewCapacity;
+    return Result;
+}
+
+void
+ResetArena(memory_arena *Arena)
+{
+    Assert(Arena->TemporaryCount == 0);
+
+    memory_block *Block = Arena->CurrentBlock;
+    if (Block && Block->Previous)
+    {
+        // note(harlequin): fold the chain into one block so the next fill fits without growing
+        u64 TotalSize = Arena->TotalSize;
+        while (Block)
+        {
+            memory_block *Previous = Block->Previous;
+            _aligned_free(Block);
+            Block = Previous;
+        }
+
+        Block = AllocateMemoryBlock(TotalSize);
+        Arena->CurrentBlock = Block;
+        Arena->TotalSize    = Block ? TotalSize : 0;
+    }
+
+    if (Block)
+    {
+        Block->Used = 0;
+    }
+    Arena->TotalUsed = 0;
+}
+
+void
+FreeArena(memory_arena *Arena)
+{
+    Assert(Arena->TemporaryCount == 0);
+
+    memory_block *Block = Arena->CurrentBlock;
+    while (Block)
+    {
+        memory_block *Previous = Block->Previous;
+        _aligned_free(Block);
+        Block = Previous;
+    }
+
+    u64 MinimumBlockSize = Arena->MinimumBlockSize;
+    *Arena = {};
+    Arena->MinimumBlockSize = MinimumBlockSize;
+}
+
+temporary_memory
+BeginTemporaryMemory(memory_arena *Arena)
+{
+    temporary_memory Result;
+    Result.Arena     = Arena;
+    Result.Block     = Arena->CurrentBlock;
+    Result.Used      = Arena->CurrentBlock ? Arena->CurrentBlock->Used : 0;
+    Result.TotalUsed = Arena->TotalUsed;
+    Arena->TemporaryCount++;
+    return Result;
+}
+
+void
+EndTemporaryMemory(temporary_memory TemporaryMemory)
+{
+    memory_arena *Arena = TemporaryMemory.Arena;
+    Assert(Arena->TemporaryCount > 0);
+
+    // note(harlequin): blocks pushed inside the temporary region stay in the chain, the next reset folds them in
+    for (memory_block *Block = Arena->CurrentBlock;
+         Block != TemporaryMemory.Block;
+         Block = Block->Previous)
+    {
+        Block->Used = 0;
+    }
+    if (TemporaryMemory.Block)
+    {
+        TemporaryMemory.Block->Used = TemporaryMemory.Used;
+    }
+
+    Arena->TotalUsed = TemporaryMemory.TotalUsed;
+    Arena->TemporaryCount--;
+}
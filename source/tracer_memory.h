@@ -0,0 +1,80 @@
+#pragma once
+
+#include "tracer_core.h"
+
+#define Kilobytes(Value) ((Value) * 1024ull)
+#define Megabytes(Value) (Kilobytes(Value) * 1024ull)
+#define Gigabytes(Value) (Megabytes(Value) * 1024ull)
+
+#define MEMORY_ARENA_DEFAULT_BLOCK_SIZE Megabytes(1)
+#define MEMORY_BLOCK_ALIGNMENT 64
+
+struct memory_block
+{
+    memory_block *Previous;
+    u8           *Base;
+    u64           Size;
+    u64           Used;
+};
+
+// note(harlequin): a chain of blocks, each new block is at least twice the size of the one before it.
+// a reset folds the chain into one block big enough for everything the arena held, so an arena that
+// is reset every frame stops allocating after the first one
+struct memory_arena
+{
+    memory_block *CurrentBlock;
+    u64           MinimumBlockSize; // 0 means MEMORY_ARENA_DEFAULT_BLOCK_SIZE
+    u64           TotalSize;        // bytes reserved by every block in the chain
+    u64           TotalUsed;        // bytes pushed since the last reset, alignment padding included
+    u32           TemporaryCount;
+};
+
+struct temporary_memory
+{
+    memory_arena *Arena;
+    memory_block *Block;
+    u64           Used;
+    u64           TotalUsed;
+};
+
+function void
+InitializeArena(memory_arena *Arena,
+                u64           MinimumBlockSize = 0);
+
+// returns nullptr when the system is out of memory
+function void *
+PushSize(memory_arena *Arena,
+         u64           Size,
+         u64           Alignment = 16);
+
+#define PushStruct(Arena, Type) (Type *)PushSize(Arena, sizeof(Type), alignof(Type))
+#define PushArray(Arena, Type, Count) (Type *)PushSize(Arena, sizeof(Type) * (u64)(Count), alignof(Type))
+
+// grows Array to hold at least RequiredCount elements. growth is geometric unless RequiredCount asks for more
+// than double, then the capacity is exactly RequiredCount. the array is extended in place when it is the last
+// thing pushed on the arena, otherwise it is copied and the old copy stays in the arena until the next reset,
+// so reserve the final count up front where it is known. returns nullptr and leaves Array untouched when out
+// of memory
+function void *
+GrowArenaArray(memory_arena *Arena,
+               void         *Array,
+               u64           ElementSize,
+               u64           Alignment,
+               u32           Count,
+               u32          *InOutCapacity,
+               u64           RequiredCount);
+
+#define GrowArray(Arena, Array, Count, Capacity, RequiredCount) \
+    GrowArenaArray(Arena, Array, sizeof(*(Array)), alignof(decltype(*(Array))), Count, Capacity, RequiredCount)
+
+function void
+ResetArena(memory_arena *Arena);
+
+function void
+FreeArena(memory_arena *Arena);
+
+function temporary_memory
+BeginTemporaryMemory(memory_arena *Arena);
+
+function void
+EndTemporaryMemory(temporary_memory TemporaryMemory);
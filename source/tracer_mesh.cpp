@@ -0,0 +1,1181 @@
+#include "tracer_mesh.h"
+#include "tracer_file.h"
+
+typedef void mesh_chunk_work(void *Chunk);
+
+// note(harlequin): the first chunk runs on the calling thread, the loaders run before the job system
+// exists so they get their own short lived threads
+function void
+RunMeshChunks(mesh_chunk_work *Work,
+              void            *Chunks,
+              u32              ChunkSize,
+              u32              ChunkCount)
+{
+    std::thread Threads[MESH_LOADER_MAX_THREAD_COUNT];
+    for (u32 ChunkIndex = 1; ChunkIndex < ChunkCount; ChunkIndex++)
+    {
+        Threads[ChunkIndex] = std::thread(Work, (u8 *)Chunks + ChunkIndex * ChunkSize);
+    }
+    Work(Chunks);
+    for (u32 ChunkIndex = 1; ChunkIndex < ChunkCount; ChunkIndex++)
+    {
+        Threads[ChunkIndex].join();
+    }
+}
+
+function u32
+GetMeshChunkCount(u32 ThreadCount, u64 Size)
+{
+    if (ThreadCount == 0)
+    {
+        ThreadCount = std::thread::hardware_concurrency();
+    }
+    u64 ChunkCount = Size / MESH_LOADER_MIN_CHUNK_SIZE + 1;
+    if (ChunkCount > ThreadCount)
+    {
+        ChunkCount = ThreadCount;
+    }
+    if (ChunkCount > MESH_LOADER_MAX_THREAD_COUNT)
+    {
+        ChunkCount = MESH_LOADER_MAX_THREAD_COUNT;
+    }
+    return ChunkCount ? (u32)ChunkCount : 1;
+}
+
+function bool
+AllocateTriangleMesh(triangle_mesh *Mesh,
+                     u64            VertexCount,
+                     u64            TriangleCount)
+{
+    *Mesh = {};
+    if (VertexCount >= TRIANGLE_PRIMITIVE_BIT || TriangleCount >= TRIANGLE_PRIMITIVE_BIT)
+    {
+        fprintf(stderr, "mesh is too large: %llu vertices, %llu triangles\n",
+                (unsigned long long)VertexCount, (unsigned long long)TriangleCount);
+        return false;
+    }
+
+    Mesh->Positions = (f32 *)malloc(sizeof(f32) * 3 * (VertexCount ? VertexCount : 1));
+    Mesh->Indices   = (u32 *)malloc(sizeof(u32) * 3 * (TriangleCount ? TriangleCount : 1));
+    if (!Mesh->Positions || !Mesh->Indices)
+    {
+        FreeTriangleMesh(Mesh);
+        return false;
+    }
+
+    Mesh->VertexCount   = (u32)VertexCount;
+    Mesh->TriangleCount = (u32)TriangleCount;
+    return true;
+}
+
+void
+FreeTriangleMesh(triangle_mesh *Mesh)
+{
+    free(Mesh->Positions);
+    free(Mesh->Indices);
+    *Mesh = {};
+}
+
+//
+// obj
+//
+
+struct obj_chunk
+{
+    const char *Begin;
+    const char *End;
+
+    // note(harlequin): counted by the first pass, the prefix sums over the chunks give every chunk
+    // its own output range so the second pass writes without synchronization
+    u64 VertexCount;
+    u64 TriangleCount;
+    u64 FirstVertex;
+    u64 FirstTriangle;
+
+    triangle_mesh *Mesh;
+    bool           Failed;
+};
+
+inline bool
+IsObjSpace(char C)
+{
+    return C == ' ' || C == '\t' || C == '\r';
+}
+
+inline bool
+IsDigit(char C)
+{
+    return C >= '0' && C <= '9';
+}
+
+inline const char *
+SkipObjSpaces(const char *At, const char *End)
+{
+    while (At < End && IsObjSpace(*At))
+    {
+        At++;
+    }
+    return At;
+}
+
+// note(harlequin): a face ends at the newline or at a trailing comment, "f 1 2 3 # tri" is a triangle
+inline bool
+IsObjFaceEnd(char C)
+{
+    return C == '\n' || C == '#';
+}
+
+inline const char *
+SkipObjLine(const char *At, const char *End)
+{
+    while (At < End && *At != '\n')
+    {
+        At++;
+    }
+    return At < End ? At + 1 : End;
+}
+
+// note(harlequin): strtof goes through the locale and is several times slower than this, the mantissa
+// keeps 18 digits which is more than a float can tell apart
+function bool
+ParseObjFloat(const char **At, const char *End, f32 *OutValue)
+{
+    local_persist const f64 PowersOfTen[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char *C = *At;
+    bool Negative = false;
+    if (C < End && (*C == '-' || *C == '+'))
+    {
+        Negative = *C == '-';
+        C++;
+    }
+
+    u64  Mantissa   = 0;
+    i32  Exponent   = 0;
+    u32  DigitCount = 0;
+    bool AnyDigit   = false;
+
+    for (; C < End && IsDigit(*C); C++)
+    {
+        AnyDigit = true;
+        if (DigitCount < 18)
+        {
+            Mantissa = Mantissa * 10 + (u64)(*C - '0');
+            DigitCount += Mantissa != 0;
+        }
+        else
+        {
+            Exponent++;
+        }
+    }
+
+    if (C < End && *C == '.')
+    {
+        for (C++; C < End && IsDigit(*C); C++)
+        {
+            AnyDigit = true;
+            if (DigitCount < 18)
+            {
+                Mantissa = Mantissa * 10 + (u64)(*C - '0');
+                DigitCount += Mantissa != 0;
+                Exponent--;
+            }
+        }
+    }
+
+    if (!AnyDigit)
+    {
+        return false;
+    }
+
+    if (C < End && (*C == 'e' || *C == 'E'))
+    {
+        C++;
+        bool NegativeExponent = false;
+        if (C < End && (*C == '-' || *C == '+'))
+        {
+            NegativeExponent = *C == '-';
+            C++;
+        }
+        if (C >= End || !IsDigit(*C))
+        {
+            return false;
+        }
+        i32 ExplicitExponent = 0;
+        for (; C < End && IsDigit(*C); C++)
+        {
+            if (ExplicitExponent < 10000)
+            {
+                ExplicitExponent = ExplicitExponent * 10 + (*C - '0');
+            }
+        }
+        Exponent += NegativeExponent ? -ExplicitExponent : ExplicitExponent;
+    }
+
+    f64 Value = (f64)Mantissa;
+    while (Exponent > 22 && Value != 0.0 && Value < 1e300)
+    {
+        Value *= 1e22;
+        Exponent -= 22;
+    }
+    while (Exponent < -22 && Value != 0.0)
+    {
+        Value /= 1e22;
+        Exponent += 22;
+    }
+    if (Exponent > 22)
+    {
+        Exponent = 22;
+    }
+    else if (Exponent < -22)
+    {
+        Exponent = -22;
+    }
+    Value = Exponent < 0 ? Value / PowersOfTen[-Exponent] : Value * PowersOfTen[Exponent];
+
+    *OutValue = (f32)(Negative ? -Value : Value);
+    *At = C;
+    return true;
+}
+
+// note(harlequin): one face corner is "v", "v/vt", "v//vn" or "v/vt/vn", only the position index matters
+function bool
+ParseObjCorner(const char **At, const char *End, i64 VertexCountSoFar, i64 *OutVertexIndex)
+{
+    const char *C = *At;
+    bool Negative = false;
+    if (C < End && *C == '-')
+    {
+        Negative = true;
+        C++;
+    }
+    if (C >= End || !IsDigit(*C))
+    {
+        return false;
+    }
+
+    i64 Index = 0;
+    for (; C < End && IsDigit(*C); C++)
+    {
+        if (Index < ((i64)1 << 40))
+        {
+            Index = Index * 10 + (*C - '0');
+        }
+    }
+    while (C < End && !IsObjSpace(*C) && !IsObjFaceEnd(*C))
+    {
+        C++;
+    }
+
+    // note(harlequin): positive indices are one based, negative ones count back from the last vertex read
+    if (Index == 0)
+    {
+        return false;
+    }
+    *OutVertexIndex = Negative ? VertexCountSoFar - Index : Index - 1;
+    *At = C;
+    return true;
+}
+
+inline bool
+IsObjCommand(const char *At, const char *End, char Command)
+{
+    return At + 1 < End && At[0] == Command && IsObjSpace(At[1]);
+}
+
+function void
+CountObjChunk(void *Data)
+{
+    obj_chunk *Chunk = (obj_chunk *)Data;
+    const char *At  = Chunk->Begin;
+    const char *End = Chunk->End;
+
+    while (At < End)
+    {
+        At = SkipObjSpaces(At, End);
+        if (IsObjCommand(At, End, 'v'))
+        {
+            Chunk->VertexCount++;
+        }
+        else if (IsObjCommand(At, End, 'f'))
+        {
+            u64 CornerCount = 0;
+            At = SkipObjSpaces(At + 1, End);
+            while (At < End && !IsObjFaceEnd(*At))
+            {
+                CornerCount++;
+                while (At < End && !IsObjSpace(*At) && !IsObjFaceEnd(*At))
+                {
+                    At++;
+                }
+                At = SkipObjSpaces(At, End);
+            }
+            if (CornerCount >= 3)
+            {
+                Chunk->TriangleCount += CornerCount - 2;
+            }
+        }
+        At = SkipObjLine(At, End);
+    }
+}
+
+function void
+ParseObjChunk(void *Data)
+{
+    obj_chunk *Chunk = (obj_chunk *)Data;
+    triangle_mesh *Mesh = Chunk->Mesh;
+    const char *At  = Chunk->Begin;
+    const char *End = Chunk->End;
+
+    f32 *Position = Mesh->Positions + Chunk->FirstVertex * 3;
+    u32 *Index    = Mesh->Indices + Chunk->FirstTriangle * 3;
+    i64 VertexCountSoFar = (i64)Chunk->FirstVertex;
+
+    while (At < End)
+    {
+        At = SkipObjSpaces(At, End);
+        if (IsObjCommand(At, End, 'v'))
+        {
+            At++;
+            for (u32 Axis = 0; Axis < 3; Axis++)
+            {
+                At = SkipObjSpaces(At, End);
+                if (!ParseObjFloat(&At, End, Position++))
+                {
+                    Chunk->Failed = true;
+                    return;
+                }
+            }
+            VertexCountSoFar++;
+        }
+        else if (IsObjCommand(At, End, 'f'))
+        {
+            At = SkipObjSpaces(At + 1, End);
+
+            i64 FirstCorner    = 0;
+            i64 PreviousCorner = 0;
+            u32 CornerCount    = 0;
+            while (At < End && !IsObjFaceEnd(*At))
+            {
+                i64 Corner = 0;
+                if (!ParseObjCorner(&At, End, VertexCountSoFar, &Corner) ||
+                    Corner < 0 || Corner >= (i64)Mesh->VertexCount)
+                {
+                    Chunk->Failed = true;
+                    return;
+                }
+
+                if (CornerCount == 0)
+                {
+                    FirstCorner = Corner;
+                }
+                else if (CornerCount >= 2)
+                {
+                    *Index++ = (u32)FirstCorner;
+                    *Index++ = (u32)PreviousCorner;
+                    *Index++ = (u32)Corner;
+                }
+                PreviousCorner = Corner;
+                CornerCount++;
+                At = SkipObjSpaces(At, End);
+            }
+        }
+        At = SkipObjLine(At, End);
+    }
+
+    Assert(Position == Mesh->Positions + (Chunk->FirstVertex + Chunk->VertexCount) * 3);
+    Assert(Index == Mesh->Indices + (Chunk->FirstTriangle + Chunk->TriangleCount) * 3);
+}
+
+bool
+ParseObjMesh(const char    *Text,
+             u64            Size,
+             triangle_mesh *OutMesh,
+             u32            ThreadCount)
+{
+    *OutMesh = {};
+
+    obj_chunk Chunks[MESH_LOADER_MAX_THREAD_COUNT] = {};
+    u32 ChunkCount = GetMeshChunkCount(ThreadCount, Size);
+
+    // note(harlequin): chunks end right after a newline so no line straddles two chunks
+    const char *End = Text + Size;
+    const char *ChunkBegin = Text;
+    for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+    {
+        const char *ChunkEnd = End;
+        if (ChunkIndex + 1 < ChunkCount)
+        {
+            ChunkEnd = Text + Size / ChunkCount * (ChunkIndex + 1);
+            if (ChunkEnd < ChunkBegin)
+            {
+                ChunkEnd = ChunkBegin;
+            }
+            ChunkEnd = SkipObjLine(ChunkEnd, End);
+        }
+        Chunks[ChunkIndex].Begin = ChunkBegin;
+        Chunks[ChunkIndex].End   = ChunkEnd;
+        ChunkBegin = ChunkEnd;
+    }
+
+    RunMeshChunks(CountObjChunk, Chunks, sizeof(obj_chunk), ChunkCount);
+
+    u64 VertexCount   = 0;
+    u64 TriangleCount = 0;
+    for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+    {
+        Chunks[ChunkIndex].FirstVertex   = VertexCount;
+        Chunks[ChunkIndex].FirstTriangle = TriangleCount;
+        VertexCount   += Chunks[ChunkIndex].VertexCount;
+        TriangleCount += Chunks[ChunkIndex].TriangleCount;
+    }
+
+    if (!AllocateTriangleMesh(OutMesh, VertexCount, TriangleCount))
+    {
+        return false;
+    }
+
+    for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+    {
+        Chunks[ChunkIndex].Mesh = OutMesh;
+    }
+
+    RunMeshChunks(ParseObjChunk, Chunks, sizeof(obj_chunk), ChunkCount);
+
+    for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+    {
+        if (Chunks[ChunkIndex].Failed)
+        {
+            fprintf(stderr, "malformed obj vertex or face near byte %llu\n",
+                    (unsigned long long)(Chunks[ChunkIndex].Begin - Text));
+            FreeTriangleMesh(OutMesh);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// ply
+//
+
+enum ply_type
+{
+    PlyType_Invalid,
+    PlyType_Int8,
+    PlyType_UInt8,
+    PlyType_Int16,
+    PlyType_UInt16,
+    PlyType_Int32,
+    PlyType_UInt32,
+    PlyType_Float32,
+    PlyType_Float64
+};
+
+#define PLY_MAX_ELEMENT_COUNT 16
+#define PLY_MAX_PROPERTY_COUNT 32
+#define PLY_MAX_NAME_LENGTH 32
+
+struct ply_property
+{
+    char     Name[PLY_MAX_NAME_LENGTH];
+    ply_type Type;
+    ply_type CountType; // PlyType_Invalid unless this is a list
+};
+
+struct ply_element
+{
+    char         Name[PLY_MAX_NAME_LENGTH];
+    u64          Count;
+    u32          PropertyCount;
+    ply_property Properties[PLY_MAX_PROPERTY_COUNT];
+};
+
+struct ply_header
+{
+    bool        BigEndian;
+    u32         ElementCount;
+    ply_element Elements[PLY_MAX_ELEMENT_COUNT];
+    u64         DataOffset;
+};
+
+function ply_type
+GetPlyType(const char *Name)
+{
+    if (!strcmp(Name, "char")   || !strcmp(Name, "int8"))    return PlyType_Int8;
+    if (!strcmp(Name, "uchar")  || !strcmp(Name, "uint8"))   return PlyType_UInt8;
+    if (!strcmp(Name, "short")  || !strcmp(Name, "int16"))   return PlyType_Int16;
+    if (!strcmp(Name, "ushort") || !strcmp(Name, "uint16"))  return PlyType_UInt16;
+    if (!strcmp(Name, "int")    || !strcmp(Name, "int32"))   return PlyType_Int32;
+    if (!strcmp(Name, "uint")   || !strcmp(Name, "uint32"))  return PlyType_UInt32;
+    if (!strcmp(Name, "float")  || !strcmp(Name, "float32")) return PlyType_Float32;
+    if (!strcmp(Name, "double") || !strcmp(Name, "float64")) return PlyType_Float64;
+    return PlyType_Invalid;
+}
+
+inline u32
+GetPlyTypeSize(ply_type Type)
+{
+    local_persist const u32 Sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return Sizes[Type];
+}
+
+// note(harlequin): every ply scalar fits a double exactly, memcpy because nothing in the file is aligned
+inline f64
+ReadPlyValue(const u8 *At, ply_type Type, bool BigEndian)
+{
+    u8 Bytes[8];
+    u32 Size = GetPlyTypeSize(Type);
+    for (u32 ByteIndex = 0; ByteIndex < Size; ByteIndex++)
+    {
+        Bytes[ByteIndex] = BigEndian ? At[Size - 1 - ByteIndex] : At[ByteIndex];
+    }
+
+    switch (Type)
+    {
+        case PlyType_Int8:    { i8  Value; memcpy(&Value, Bytes, 1); return Value; }
+        case PlyType_UInt8:   { u8  Value; memcpy(&Value, Bytes, 1); return Value; }
+        case PlyType_Int16:   { i16 Value; memcpy(&Value, Bytes, 2); return Value; }
+        case PlyType_UInt16:  { u16 Value; memcpy(&Value, Bytes, 2); return Value; }
+        case PlyType_Int32:   { i32 Value; memcpy(&Value, Bytes, 4); return Value; }
+        case PlyType_UInt32:  { u32 Value; memcpy(&Value, Bytes, 4); return Value; }
+        case PlyType_Float32: { f32 Value; memcpy(&Value, Bytes, 4); return Value; }
+        case PlyType_Float64: { f64 Value; memcpy(&Value, Bytes, 8); return Value; }
+        default: return 0.0;
+    }
+}
+
+function bool
+ParsePlyHeader(const u8 *Data, u64 Size, ply_header *OutHeader)
+{
+    *OutHeader = {};
+
+    const char *At  = (const char *)Data;
+    const char *End = At + Size;
+    bool FormatFound = false;
+    bool FirstLine   = true;
+
+    while (At < End)
+    {
+        const char *LineEnd = At;
+        while (LineEnd < End && *LineEnd != '\n')
+        {
+            LineEnd++;
+        }
+        if (LineEnd == End)
+        {
+            break;
+        }
+
+        char Line[256];
+        u64 LineLength = (u64)(LineEnd - At);
+        if (LineLength && At[LineLength - 1] == '\r')
+        {
+            LineLength--;
+        }
+        if (LineLength >= sizeof(Line))
+        {
+            LineLength = sizeof(Line) - 1;
+        }
+        memcpy(Line, At, LineLength);
+        Line[LineLength] = 0;
+        At = LineEnd + 1;
+
+        char Words[5][PLY_MAX_NAME_LENGTH] = {};
+        i32 WordCount = sscanf(Line, "%31s %31s %31s %31s %31s", Words[0], Words[1], Words[2], Words[3], Words[4]);
+
+        if (FirstLine)
+        {
+            if (WordCount != 1 || strcmp(Words[0], "ply"))
+            {
+                fprintf(stderr, "not a ply file\n");
+                return false;
+            }
+            FirstLine = false;
+        }
+        else if (WordCount <= 0 || !strcmp(Words[0], "comment") || !strcmp(Words[0], "obj_info"))
+        {
+        }
+        else if (!strcmp(Words[0], "format"))
+        {
+            if (!strcmp(Words[1], "binary_little_endian"))
+            {
+                OutHeader->BigEndian = false;
+            }
+            else if (!strcmp(Words[1], "binary_big_endian"))
+            {
+                OutHeader->BigEndian = true;
+            }
+            else
+            {
+                fprintf(stderr, "unsupported ply format %s\n", Words[1]);
+                return false;
+            }
+            FormatFound = true;
+        }
+        else if (!strcmp(Words[0], "element") && WordCount == 3)
+        {
+            if (OutHeader->ElementCount == PLY_MAX_ELEMENT_COUNT)
+            {
+                fprintf(stderr, "too many ply elements\n");
+                return false;
+            }
+            ply_element *Element = OutHeader->Elements + OutHeader->ElementCount++;
+            memcpy(Element->Name, Words[1], PLY_MAX_NAME_LENGTH);
+            Element->Count = strtoull(Words[2], nullptr, 10);
+        }
+        else if (!strcmp(Words[0], "property") && OutHeader->ElementCount)
+        {
+            ply_element *Element = OutHeader->Elements + OutHeader->ElementCount - 1;
+            if (Element->PropertyCount == PLY_MAX_PROPERTY_COUNT)
+            {
+                fprintf(stderr, "too many ply properties\n");
+                return false;
+            }
+            ply_property *Property = Element->Properties + Element->PropertyCount++;
+
+            if (!strcmp(Words[1], "list") && WordCount == 5)
+            {
+                memcpy(Property->Name, Words[4], PLY_MAX_NAME_LENGTH);
+                Property->CountType = GetPlyType(Words[2]);
+                Property->Type      = GetPlyType(Words[3]);
+                if (Property->CountType == PlyType_Invalid)
+                {
+                    Property->Type = PlyType_Invalid;
+                }
+            }
+            else if (WordCount == 3)
+            {
+                memcpy(Property->Name, Words[2], PLY_MAX_NAME_LENGTH);
+                Property->Type = GetPlyType(Words[1]);
+            }
+
+            if (Property->Type == PlyType_Invalid)
+            {
+                fprintf(stderr, "unsupported ply property: %s\n", Line);
+                return false;
+            }
+        }
+        else if (!strcmp(Words[0], "end_header"))
+        {
+            if (!FormatFound)
+            {
+                fprintf(stderr, "ply header has no format\n");
+                return false;
+            }
+            OutHeader->DataOffset = (u64)(At - (const char *)Data);
+            return true;
+        }
+        else
+        {
+            fprintf(stderr, "unexpected ply header line: %s\n", Line);
+            return false;
+        }
+    }
+
+    fprintf(stderr, "ply header has no end_header\n");
+    return false;
+}
+
+// returns 0 when the element has a list property
+function u32
+GetPlyFixedRecordSize(const ply_element *Element)
+{
+    u32 Size = 0;
+    for (u32 PropertyIndex = 0; PropertyIndex < Element->PropertyCount; PropertyIndex++)
+    {
+        const ply_property *Property = Element->Properties + PropertyIndex;
+        if (Property->CountType != PlyType_Invalid)
+        {
+            return 0;
+        }
+        Size += GetPlyTypeSize(Property->Type);
+    }
+    return Size;
+}
+
+// skips the properties [FirstProperty, EndProperty) of a record, lists by their count, returns nullptr when they
+// run past End
+function const u8 *
+SkipPlyProperties(const u8          *At,
+                  const u8          *End,
+                  const ply_element *Element,
+                  u32                FirstProperty,
+                  u32                EndProperty,
+                  bool               BigEndian)
+{
+    for (u32 PropertyIndex = FirstProperty; PropertyIndex < EndProperty; PropertyIndex++)
+    {
+        const ply_property *Property = Element->Properties + PropertyIndex;
+        u64 Size = GetPlyTypeSize(Property->Type);
+        if (Property->CountType != PlyType_Invalid)
+        {
+            u32 CountSize = GetPlyTypeSize(Property->CountType);
+            if ((u64)(End - At) < CountSize)
+            {
+                return nullptr;
+            }
+            f64 Count = ReadPlyValue(At, Property->CountType, BigEndian);
+            if (Count < 0.0)
+            {
+                return nullptr;
+            }
+            At  += CountSize;
+            Size = Size * (u64)Count;
+        }
+        if ((u64)(End - At) < Size)
+        {
+            return nullptr;
+        }
+        At += Size;
+    }
+    return At;
+}
+
+// returns nullptr when the record runs past End
+inline const u8 *
+SkipPlyRecord(const u8 *At, const u8 *End, const ply_element *Element, bool BigEndian)
+{
+    return SkipPlyProperties(At, End, Element, 0, Element->PropertyCount, BigEndian);
+}
+
+struct ply_vertex_chunk
+{
+    const u8      *Data;
+    u32            Stride;
+    u32            Offsets[3];
+    ply_type       Types[3];
+    bool           BigEndian;
+    u64            FirstVertex;
+    u64            EndVertex;
+    triangle_mesh *Mesh;
+};
+
+function void
+ParsePlyVertexChunk(void *Data)
+{
+    ply_vertex_chunk *Chunk = (ply_vertex_chunk *)Data;
+    f32 *Position = Chunk->Mesh->Positions + Chunk->FirstVertex * 3;
+    for (u64 VertexIndex = Chunk->FirstVertex; VertexIndex < Chunk->EndVertex; VertexIndex++)
+    {
+        const u8 *Record = Chunk->Data + VertexIndex * Chunk->Stride;
+        for (u32 Axis = 0; Axis < 3; Axis++)
+        {
+            *Position++ = (f32)ReadPlyValue(Record + Chunk->Offsets[Axis], Chunk->Types[Axis], Chunk->BigEndian);
+        }
+    }
+}
+
+// note(harlequin): with only triangles every face record has the same size, that is the common case
+// and the only one that can be split across threads without a sequential scan
+struct ply_face_chunk
+{
+    const u8      *Data;
+    u32            Stride;
+    u32            CountOffset;
+    ply_type       CountType;
+    ply_type       IndexType;
+    bool           BigEndian;
+    u64            FirstFace;
+    u64            EndFace;
+    triangle_mesh *Mesh;
+    bool           Failed;
+};
+
+function void
+ParsePlyTriangleChunk(void *Data)
+{
+    ply_face_chunk *Chunk = (ply_face_chunk *)Data;
+    u32 IndexSize   = GetPlyTypeSize(Chunk->IndexType);
+    u32 CountSize   = GetPlyTypeSize(Chunk->CountType);
+    f64 VertexCount = (f64)Chunk->Mesh->VertexCount;
+
+    u32 *Index = Chunk->Mesh->Indices + Chunk->FirstFace * 3;
+    for (u64 FaceIndex = Chunk->FirstFace; FaceIndex < Chunk->EndFace; FaceIndex++)
+    {
+        const u8 *Record = Chunk->Data + FaceIndex * Chunk->Stride + Chunk->CountOffset;
+        if (ReadPlyValue(Record, Chunk->CountType, Chunk->BigEndian) != 3.0)
+        {
+            Chunk->Failed = true;
+            return;
+        }
+        for (u32 Corner = 0; Corner < 3; Corner++)
+        {
+            f64 VertexIndex = ReadPlyValue(Record + CountSize + Corner * IndexSize, Chunk->IndexType, Chunk->BigEndian);
+            if (VertexIndex < 0.0 || VertexIndex >= VertexCount)
+            {
+                Chunk->Failed = true;
+                return;
+            }
+            *Index++ = (u32)VertexIndex;
+        }
+    }
+}
+
+// note(harlequin): general faces, polygons are fan triangulated and extra properties are skipped
+function bool
+ParsePlyFacesSequential(const u8          *At,
+                        const u8          *End,
+                        const ply_element *Element,
+                        u32                ListIndex,
+                        bool               BigEndian,
+                        u64                VertexCount,
+                        triangle_mesh     *OutMesh)
+{
+    const ply_property *List = Element->Properties + ListIndex;
+    u32 IndexSize = GetPlyTypeSize(List->Type);
+    u32 CountSize = GetPlyTypeSize(List->CountType);
+
+    // note(harlequin): the first walk only counts so the index array is allocated once
+    u64 TriangleCount = 0;
+    const u8 *Record = At;
+    for (u64 FaceIndex = 0; FaceIndex < Element->Count; FaceIndex++)
+    {
+        // note(harlequin): a list before the indices changes their offset from one face to the next
+        const u8 *ListAt = SkipPlyProperties(Record, End, Element, 0, ListIndex, BigEndian);
+        Record = SkipPlyRecord(Record, End, Element, BigEndian);
+        if (!Record)
+        {
+            fprintf(stderr, "ply faces run past the end of the file\n");
+            return false;
+        }
+        f64 CornerCount = ReadPlyValue(ListAt, List->CountType, BigEndian);
+        if (CornerCount >= 3.0)
+        {
+            TriangleCount += (u64)CornerCount - 2;
+        }
+    }
+
+    if (TriangleCount >= TRIANGLE_PRIMITIVE_BIT)
+    {
+        fprintf(stderr, "ply mesh has too many triangles\n");
+        return false;
+    }
+    OutMesh->Indices = (u32 *)malloc(sizeof(u32) * 3 * (TriangleCount ? TriangleCount : 1));
+    if (!OutMesh->Indices)
+    {
+        return false;
+    }
+    OutMesh->TriangleCount = (u32)TriangleCount;
+
+    u32 *Index = OutMesh->Indices;
+    Record = At;
+    for (u64 FaceIndex = 0; FaceIndex < Element->Count; FaceIndex++)
+    {
+        const u8 *ListAt = SkipPlyProperties(Record, End, Element, 0, ListIndex, BigEndian);
+        Record = SkipPlyRecord(Record, End, Element, BigEndian);
+
+        u64 CornerCount = (u64)ReadPlyValue(ListAt, List->CountType, BigEndian);
+        const u8 *Corners = ListAt + CountSize;
+        u32 FirstCorner    = 0;
+        u32 PreviousCorner = 0;
+        for (u64 Corner = 0; Corner < CornerCount; Corner++)
+        {
+            f64 VertexIndex = ReadPlyValue(Corners + Corner * IndexSize, List->Type, BigEndian);
+            if (VertexIndex < 0.0 || VertexIndex >= (f64)VertexCount)
+            {
+                fprintf(stderr, "ply face %llu has an out of range vertex index\n", (unsigned long long)FaceIndex);
+                return false;
+            }
+            if (Corner == 0)
+            {
+                FirstCorner = (u32)VertexIndex;
+            }
+            else if (Corner >= 2)
+            {
+                *Index++ = FirstCorner;
+                *Index++ = PreviousCorner;
+                *Index++ = (u32)VertexIndex;
+            }
+            PreviousCorner = (u32)VertexIndex;
+        }
+    }
+
+    Assert(Index == OutMesh->Indices + TriangleCount * 3);
+    return true;
+}
+
+bool
+ParsePlyMesh(const u8      *Data,
+             u64            Size,
+             triangle_mesh *OutMesh,
+             u32            ThreadCount)
+{
+    *OutMesh = {};
+
+    ply_header Header;
+    if (!ParsePlyHeader(Data, Size, &Header))
+    {
+        return false;
+    }
+
+    const u8 *At  = Data + Header.DataOffset;
+    const u8 *End = Data + Size;
+    bool VerticesParsed = false;
+
+    for (u32 ElementIndex = 0; ElementIndex < Header.ElementCount; ElementIndex++)
+    {
+        const ply_element *Element = Header.Elements + ElementIndex;
+        u32 FixedRecordSize = GetPlyFixedRecordSize(Element);
+
+        if (!strcmp(Element->Name, "vertex"))
+        {
+            ply_vertex_chunk Vertices = {};
+            const char *AxisNames[3] = { "x", "y", "z" };
+            u32 FoundAxisCount = 0;
+            u32 Offset = 0;
+            for (u32 PropertyIndex = 0; PropertyIndex < Element->PropertyCount; PropertyIndex++)
+            {
+                const ply_property *Property = Element->Properties + PropertyIndex;
+                for (u32 Axis = 0; Axis < 3; Axis++)
+                {
+                    if (!strcmp(Property->Name, AxisNames[Axis]))
+                    {
+                        Vertices.Offsets[Axis] = Offset;
+                        Vertices.Types[Axis]   = Property->Type;
+                        FoundAxisCount++;
+                    }
+                }
+                Offset += GetPlyTypeSize(Property->Type);
+            }
+
+            if (!FixedRecordSize || FoundAxisCount != 3)
+            {
+                fprintf(stderr, "ply vertices need fixed size records with x, y and z\n");
+                return false;
+            }
+            if (Element->Count > (u64)(End - At) / FixedRecordSize)
+            {
+                fprintf(stderr, "ply vertices run past the end of the file\n");
+                return false;
+            }
+
+            if (Element->Count >= TRIANGLE_PRIMITIVE_BIT)
+            {
+                fprintf(stderr, "ply mesh has too many vertices\n");
+                return false;
+            }
+            OutMesh->Positions = (f32 *)malloc(sizeof(f32) * 3 * (Element->Count ? Element->Count : 1));
+            if (!OutMesh->Positions)
+            {
+                return false;
+            }
+            OutMesh->VertexCount = (u32)Element->Count;
+
+            Vertices.Data      = At;
+            Vertices.Stride    = FixedRecordSize;
+            Vertices.BigEndian = Header.BigEndian;
+            Vertices.Mesh      = OutMesh;
+
+            ply_vertex_chunk Chunks[MESH_LOADER_MAX_THREAD_COUNT];
+            u32 ChunkCount = GetMeshChunkCount(ThreadCount, Element->Count * FixedRecordSize);
+            for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+            {
+                Chunks[ChunkIndex] = Vertices;
+                Chunks[ChunkIndex].FirstVertex = Element->Count * ChunkIndex / ChunkCount;
+                Chunks[ChunkIndex].EndVertex   = Element->Count * (ChunkIndex + 1) / ChunkCount;
+            }
+            RunMeshChunks(ParsePlyVertexChunk, Chunks, sizeof(ply_vertex_chunk), ChunkCount);
+
+            At += Element->Count * FixedRecordSize;
+            VerticesParsed = true;
+        }
+        else if (!strcmp(Element->Name, "face"))
+        {
+            if (!VerticesParsed)
+            {
+                fprintf(stderr, "ply faces before vertices are not supported\n");
+                FreeTriangleMesh(OutMesh);
+                return false;
+            }
+
+            u32 ListIndex   = Element->PropertyCount;
+            u32 ListCount   = 0;
+            u32 FixedSize   = 0;
+            u32 CountOffset = 0;
+            for (u32 PropertyIndex = 0; PropertyIndex < Element->PropertyCount; PropertyIndex++)
+            {
+                const ply_property *Property = Element->Properties + PropertyIndex;
+                if (Property->CountType != PlyType_Invalid)
+                {
+                    ListCount++;
+                    if (!strcmp(Property->Name, "vertex_indices") || !strcmp(Property->Name, "vertex_index"))
+                    {
+                        ListIndex   = PropertyIndex;
+                        CountOffset = FixedSize;
+                    }
+                }
+                else
+                {
+                    FixedSize += GetPlyTypeSize(Property->Type);
+                }
+            }
+
+            if (ListIndex == Element->PropertyCount)
+            {
+                fprintf(stderr, "ply faces have no vertex_indices list\n");
+                FreeTriangleMesh(OutMesh);
+                return false;
+            }
+
+            const ply_property *List = Element->Properties + ListIndex;
+            u32 TriangleRecordSize = FixedSize + GetPlyTypeSize(List->CountType) + 3 * GetPlyTypeSize(List->Type);
+
+            bool Parsed = false;
+            if (ListCount == 1 &&
+                Element->Count <= (u64)(End - At) / TriangleRecordSize &&
+                Element->Count < TRIANGLE_PRIMITIVE_BIT)
+            {
+                OutMesh->Indices = (u32 *)malloc(sizeof(u32) * 3 * (Element->Count ? Element->Count : 1));
+                if (!OutMesh->Indices)
+                {
+                    FreeTriangleMesh(OutMesh);
+                    return false;
+                }
+                OutMesh->TriangleCount = (u32)Element->Count;
+
+                ply_face_chunk Chunks[MESH_LOADER_MAX_THREAD_COUNT];
+                u32 ChunkCount = GetMeshChunkCount(ThreadCount, Element->Count * TriangleRecordSize);
+                for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+                {
+                    ply_face_chunk *Chunk = Chunks + ChunkIndex;
+                    *Chunk = {};
+                    Chunk->Data        = At;
+                    Chunk->Stride      = TriangleRecordSize;
+                    Chunk->CountOffset = CountOffset;
+                    Chunk->CountType   = List->CountType;
+                    Chunk->IndexType   = List->Type;
+                    Chunk->BigEndian   = Header.BigEndian;
+                    Chunk->FirstFace   = Element->Count * ChunkIndex / ChunkCount;
+                    Chunk->EndFace     = Element->Count * (ChunkIndex + 1) / ChunkCount;
+                    Chunk->Mesh        = OutMesh;
+                }
+                RunMeshChunks(ParsePlyTriangleChunk, Chunks, sizeof(ply_face_chunk), ChunkCount);
+
+                Parsed = true;
+                for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ChunkIndex++)
+                {
+                    Parsed &= !Chunks[ChunkIndex].Failed;
+                }
+
+                if (!Parsed)
+                {
+                    free(OutMesh->Indices);
+                    OutMesh->Indices       = nullptr;
+                    OutMesh->TriangleCount = 0;
+                }
+            }
+
+            if (!Parsed && !ParsePlyFacesSequential(At, End, Element, ListIndex, Header.BigEndian,
+                                                    OutMesh->VertexCount, OutMesh))
+            {
+                FreeTriangleMesh(OutMesh);
+                return false;
+            }
+
+            // note(harlequin): nothing after the faces is needed
+            return true;
+        }
+        else if (FixedRecordSize)
+        {
+            if (Element->Count > (u64)(End - At) / FixedRecordSize)
+            {
+                fprintf(stderr, "ply element %s runs past the end of the file\n", Element->Name);
+                FreeTriangleMesh(OutMesh);
+                return false;
+            }
+            At += Element->Count * FixedRecordSize;
+        }
+        else
+        {
+            for (u64 RecordIndex = 0; RecordIndex < Element->Count && At; RecordIndex++)
+            {
+                At = SkipPlyRecord(At, End, Element, Header.BigEndian);
+            }
+            if (!At)
+            {
+                fprintf(stderr, "ply element %s runs past the end of the file\n", Element->Name);
+                FreeTriangleMesh(OutMesh);
+                return false;
+            }
+        }
+    }
+
+    fprintf(stderr, "ply file has no faces\n");
+    FreeTriangleMesh(OutMesh);
+    return false;
+}
+
+//
+// world
+//
+
+bool
+LoadTriangleMesh(const char    *FilePath,
+                 triangle_mesh *OutMesh,
+                 u32            ThreadCount /* = 0 */)
+{
+    *OutMesh = {};
+
+    bool IsObj = HasExtension(FilePath, "obj");
+    bool IsPly = HasExtension(FilePath, "ply");
+    if (!IsObj && !IsPly)
+    {
+        fprintf(stderr, "unknown mesh format: %s\n", FilePath);
+        return false;
+    }
+
+    file_contents Contents;
+    if (!ReadEntireFile(FilePath, &Contents))
+    {
+        return false;
+    }
+
+    bool Success = IsObj ? ParseObjMesh((const char *)Contents.Data, Contents.Size, OutMesh, ThreadCount)
+                         : ParsePlyMesh(Contents.Data, Contents.Size, OutMesh, ThreadCount);
+    FreeFileContents(&Contents);
+
+    if (!Success)
+    {
+        fprintf(stderr, "failed to load mesh %s\n", FilePath);
+    }
+    return Success;
+}
+
+aabb
+GetTriangleMeshBounds(const triangle_mesh *Mesh)
+{
+    aabb Result = EmptyAabb();
+    for (u32 VertexIndex = 0; VertexIndex < Mesh->VertexCount; VertexIndex++)
+    {
+        const f32 *Position = Mesh->Positions + VertexIndex * 3;
+        Result = Union(Result, V3(Position[0], Position[1], Position[2]));
+    }
+    return Result;
+}
+
+bool
+PushTriangleMesh(world               *World,
+                 const triangle_mesh *Mesh,
+                 u32                  MaterialIndex,
+                 v3                   Translation,
+                 f32                  Scale)
+{
+    u32 FirstVertex = 0;
+    if (!PushVertices(World, Mesh->Positions, Mesh->VertexCount, &FirstVertex))
+    {
+        return false;
+    }
+
+    for (u32 VertexIndex = FirstVertex; VertexIndex < World->VertexCount; VertexIndex++)
+    {
+        World->Vertices[VertexIndex] = World->Vertices[VertexIndex] * Scale + Translation;
+    }
+
+    return PushTriangles(World, Mesh->Indices, Mesh->TriangleCount, FirstVertex, MaterialIndex);
+}
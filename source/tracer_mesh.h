@@ -0,0 +1,54 @@
+#pragma once
+
+#include <thread>
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_world.h"
+
+#define MESH_LOADER_MAX_THREAD_COUNT 64
+#define MESH_LOADER_MIN_CHUNK_SIZE (256 * 1024)
+
+// note(harlequin): loader output, indexed triangles with packed xyz positions, polygons are fan triangulated
+struct triangle_mesh
+{
+    u32  VertexCount;
+    f32 *Positions;
+
+    u32  TriangleCount;
+    u32 *Indices;
+};
+
+// picks the parser from the file extension (.obj or .ply), a ThreadCount of 0 uses every hardware thread
+function bool
+LoadTriangleMesh(const char    *FilePath,
+                 triangle_mesh *OutMesh,
+                 u32            ThreadCount = 0);
+
+// Text has to stay readable one byte past Size (ReadEntireFile null terminates)
+function bool
+ParseObjMesh(const char    *Text,
+             u64            Size,
+             triangle_mesh *OutMesh,
+             u32            ThreadCount);
+
+// binary little and big endian ply, ascii ply is not supported
+function bool
+ParsePlyMesh(const u8      *Data,
+             u64            Size,
+             triangle_mesh *OutMesh,
+             u32            ThreadCount);
+
+function void
+FreeTriangleMesh(triangle_mesh *Mesh);
+
+function aabb
+GetTriangleMeshBounds(const triangle_mesh *Mesh);
+
+// every vertex is placed at Vertex * Scale + Translation
+function bool
+PushTriangleMesh(world               *World,
+                 const triangle_mesh *Mesh,
+                 u32                  MaterialIndex,
+                 v3                   Translation,
+                 f32                  Scale);
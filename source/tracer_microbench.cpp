@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <chrono>
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_random.h"
+
+#include "tracer_math.cpp"
+#include "tracer_random.cpp"
+#include "tracer_profile.cpp"
+#include "tracer_framebuffer.cpp"
+#include "tracer_upload.cpp"
+
+// note(harlequin): microbenchmarks for the scalar kernels the integrators call per ray. build.sh builds this
+// twice, with ENABLE_SIMD on (v3 is an __m128) and off (v3 is a struct), so the two v3 paths can be compared.
+// throughput runs the kernel over independent warm inputs, latency feeds every result into the next call.
+// both fold every result into a checksum that is printed, and a validation pass checks the results first.
+// --validate runs only that pass
+
+#define MICROBENCH_INPUT_COUNT 4096 // a power of two, every input array stays in l1/l2
+#define MICROBENCH_MIN_SECONDS 0.2
+
+struct microbench_inputs
+{
+    ray    Rays[MICROBENCH_INPUT_COUNT];
+    sphere Spheres[MICROBENCH_INPUT_COUNT];
+    f32    Ts[MICROBENCH_INPUT_COUNT];
+    v3     Vectors[MICROBENCH_INPUT_COUNT];
+    v3     Normals[MICROBENCH_INPUT_COUNT];
+    v3     Colors[MICROBENCH_INPUT_COUNT];
+};
+
+struct microbench_result
+{
+    f64 ThroughputNanoseconds; // per call
+    f64 LatencyNanoseconds;    // per call
+};
+
+// note(harlequin): the checksum of every run ends up here so the compiler has to compute the results
+global_variable volatile u32 GlobalMicrobenchSink;
+
+inline u32
+F32Bits(f32 Value)
+{
+    u32 Result;
+    memcpy(&Result, &Value, sizeof(Result));
+    return Result;
+}
+
+inline u32
+V3Bits(const v3 &V)
+{
+    return F32Bits(VectorComponent(V, 0)) ^ F32Bits(VectorComponent(V, 1)) ^ F32Bits(VectorComponent(V, 2));
+}
+
+// note(harlequin): the next input index depends on the sign bit of the last result, a real data dependency
+// that -ffast-math cannot fold away the way it folds Result * 0
+inline u32
+NextDependentIndex(u32 Index, u32 ResultBits)
+{
+    return (Index + 1 + (ResultBits >> 31)) & (MICROBENCH_INPUT_COUNT - 1);
+}
+
+function void
+InitializeMicrobenchInputs(microbench_inputs *Inputs, u32 Seed)
+{
+    for (u32 InputIndex = 0; InputIndex < MICROBENCH_INPUT_COUNT; InputIndex++)
+    {
+        random_series Series = RandomSeries(Seed, InputIndex, 0);
+
+        // note(harlequin): rays aim at a random point inside their sphere so most of the sphere tests hit
+        sphere Sphere = SphereCenterRadius(RandomV3(&Series, -10.0f, 10.0f), RandomBetween(&Series, 0.5f, 2.0f));
+        v3 Origin = RandomV3(&Series, -20.0f, 20.0f) + V3(0.0f, 0.0f, 30.0f);
+        v3 Target = Sphere.Center + RandomV3(&Series, -0.5f, 0.5f) * Sphere.Radius;
+
+        Inputs->Spheres[InputIndex] = Sphere;
+        Inputs->Rays[InputIndex]    = RayOriginDirection(Origin, Normalize(Target - Origin));
+        Inputs->Ts[InputIndex]      = RandomBetween(&Series, 1.0f, 40.0f);
+        Inputs->Vectors[InputIndex] = RandomV3(&Series, -1.0f, 1.0f) + V3(0.001f);
+        Inputs->Normals[InputIndex] = RandomUnitV3(&Series);
+        Inputs->Colors[InputIndex]  = RandomV3(&Series, 0.0f, 1.0f);
+    }
+}
+
+// note(harlequin): Kernel(Index) returns the bits of its result, it is called over independent inputs for
+// the throughput and along a dependency chain for the latency, each until MICROBENCH_MIN_SECONDS pass
+template< typename kernel >
+function microbench_result
+MeasureKernel(kernel Kernel)
+{
+    microbench_result Result = {};
+    u32 Checksum = 0;
+
+    for (u32 Pass = 0; Pass < 2; Pass++)
+    {
+        u64 CallCount = 0;
+        f64 Seconds   = 0.0;
+        auto StartTime = std::chrono::steady_clock::now();
+        u32 Index = 0;
+        do
+        {
+            for (u32 Iteration = 0; Iteration < MICROBENCH_INPUT_COUNT; Iteration++)
+            {
+                if (Pass == 0)
+                {
+                    Checksum += Kernel(Iteration);
+                }
+                else
+                {
+                    u32 Bits = Kernel(Index);
+                    Checksum += Bits;
+                    Index = NextDependentIndex(Index, Bits);
+                }
+            }
+            CallCount += MICROBENCH_INPUT_COUNT;
+            Seconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - StartTime).count();
+        }
+        while (Seconds < MICROBENCH_MIN_SECONDS);
+
+        f64 Nanoseconds = Seconds * 1e9 / (f64)CallCount;
+        if (Pass == 0)
+        {
+            Result.ThroughputNanoseconds = Nanoseconds;
+        }
+        else
+        {
+            Result.LatencyNanoseconds = Nanoseconds;
+        }
+    }
+
+    GlobalMicrobenchSink = GlobalMicrobenchSink + Checksum;
+    return Result;
+}
+
+inline bool
+NearlyEqual(f32 A, f32 B, f32 Tolerance)
+{
+    return fabsf(A - B) <= Tolerance * Maximium(1.0f, Maximium(fabsf(A), fabsf(B)));
+}
+
+// note(harlequin): checks the kernels against their definitions before anything is timed
+function bool
+ValidateKernels(const microbench_inputs *Inputs)
+{
+    u32 FailureCount = 0;
+    u32 HitCount = 0;
+    for (u32 InputIndex = 0; InputIndex < MICROBENCH_INPUT_COUNT; InputIndex++)
+    {
+        const ray    &Ray    = Inputs->Rays[InputIndex];
+        const sphere &Sphere = Inputs->Spheres[InputIndex];
+
+        f32 T = 0.0f;
+        if (RayCastSphere(Ray, Sphere, &T))
+        {
+            HitCount++;
+            intersection_info Info = GetRaySphereIntersectionInfo(Ray, Sphere, T);
+            FailureCount += !NearlyEqual(Length(Info.Point - Sphere.Center), Sphere.Radius, 1e-3f);
+            FailureCount += !NearlyEqual(Length(Info.Normal), 1.0f, 1e-4f);
+            FailureCount += Dot(Info.Normal, Ray.Direction) > 0.0f;
+        }
+
+        v3 Normalized = Normalize(Inputs->Vectors[InputIndex]);
+        FailureCount += !NearlyEqual(Length(Normalized), 1.0f, 1e-4f);
+
+        const v3 &Normal = Inputs->Normals[InputIndex];
+        v3 Reflected = Reflect(Ray.Direction, Normal);
+        FailureCount += !NearlyEqual(Dot(Reflected, Normal), -Dot(Ray.Direction, Normal), 1e-4f);
+
+        v3 Color      = Inputs->Colors[InputIndex];
+        v3 RoundTrip  = LinearToSRGB(SRGBToLinear(Color));
+        for (u32 Axis = 0; Axis < 3; Axis++)
+        {
+            FailureCount += !NearlyEqual(VectorComponent(RoundTrip, Axis), VectorComponent(Color, Axis), 1e-3f);
+        }
+
+        // note(harlequin): the lane srgb curve against the exact one, a quarter of an 8 bit step
+        v3 Resolved;
+        ResolvePixels(&Color, nullptr, &Resolved, 1, Tonemapper_Clamp);
+        v3 Exact = LinearToSRGB(Color);
+        for (u32 Axis = 0; Axis < 3; Axis++)
+        {
+            FailureCount += fabsf(VectorComponent(Resolved, Axis) - VectorComponent(Exact, Axis)) > 0.25f / 255.0f;
+        }
+
+        random_series Series = RandomSeries(1, InputIndex, 0);
+        f32 Canonical = RandomCanonical(&Series);
+        FailureCount += Canonical < 0.0f || Canonical >= 1.0f;
+        v3 Random = RandomV3(&Series, -0.5f, 0.5f);
+        for (u32 Axis = 0; Axis < 3; Axis++)
+        {
+            FailureCount += VectorComponent(Random, Axis) < -0.5f || VectorComponent(Random, Axis) > 0.5f;
+        }
+    }
+
+    if (HitCount < MICROBENCH_INPUT_COUNT / 2)
+    {
+        fprintf(stderr, "only %u of %u sphere tests hit\n", HitCount, MICROBENCH_INPUT_COUNT);
+        FailureCount++;
+    }
+    if (FailureCount)
+    {
+        fprintf(stderr, "%u kernel results failed validation\n", FailureCount);
+    }
+    return FailureCount == 0;
+}
+
+// note(harlequin): the viewport upload on the software stand-in, a gpu busy for one poll has to make the third
+// frame skip, and whatever reaches the texture has to be the packed frame
+function bool
+ValidatePixelUpload(const microbench_inputs *Inputs)
+{
+    u32 FailureCount = 0;
+
+    software_upload_device Device = {};
+    Device.FenceLatency = 1;
+    frame_buffer Frame = {};
+    InitializeFrameBuffer(&Frame, 64, MICROBENCH_INPUT_COUNT / 64);
+    memcpy(Frame.Pixels, Inputs->Colors, sizeof(v3) * MICROBENCH_INPUT_COUNT);
+
+    pixel_upload Upload = {};
+    FailureCount += !InitializePixelUpload(&Upload, GetSoftwareUploadBackend(&Device), Frame.Width, Frame.Height);
+    FailureCount += !UploadFrameBuffer(&Upload, &Frame, 1);
+    FailureCount += !UploadFrameBuffer(&Upload, &Frame, 1);
+    FailureCount += UploadFrameBuffer(&Upload, &Frame, 1);
+    FailureCount += !UploadFrameBuffer(&Upload, &Frame, 1);
+    FailureCount += Upload.UploadCount != 3 || Upload.SkippedCount != 1;
+    for (u32 PixelIndex = 0; Device.Texture && PixelIndex < MICROBENCH_INPUT_COUNT; PixelIndex++)
+    {
+        u32 Packed = Device.Texture[PixelIndex];
+        for (u32 Axis = 0; Axis < 3; Axis++)
+        {
+            f32 Expected = VectorComponent(Inputs->Colors[PixelIndex], Axis) * 255.0f;
+            FailureCount += fabsf((f32)((Packed >> (8 * Axis)) & 0xFF) - Expected) > 0.5f;
+        }
+        FailureCount += (Packed >> 24) != 0xFF;
+    }
+    FailureCount += !Device.Texture;
+    FreePixelUpload(&Upload);
+    FreeSoftwareUploadDevice(&Device);
+    FreeFrameBuffer(&Frame);
+
+    if (FailureCount)
+    {
+        fprintf(stderr, "%u pixel upload results failed validation\n", FailureCount);
+    }
+    return FailureCount == 0;
+}
+
+function void
+PrintMicrobenchResult(const char *Name, microbench_result Result)
+{
+    printf("%-30s %12.2f %12.2f %14.1f\n",
+           Name,
+           Result.ThroughputNanoseconds,
+           Result.LatencyNanoseconds,
+           Result.ThroughputNanoseconds > 0.0 ? 1e3 / Result.ThroughputNanoseconds : 0.0);
+}
+
+function void
+PrintUsage(const char *ProgramName)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --validate            only check the kernels against their definitions, nothing is timed\n",
+            ProgramName);
+}
+
+int main(int ArgumentCount, char **Arguments)
+{
+    // note(harlequin): --validate only runs the checks, quick enough for a build script to call
+    bool ValidateOnly = false;
+    for (i32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ArgumentIndex++)
+    {
+        if (strcmp(Arguments[ArgumentIndex], "--validate") == 0)
+        {
+            ValidateOnly = true;
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", Arguments[ArgumentIndex]);
+            PrintUsage(Arguments[0]);
+            return 1;
+        }
+    }
+
+    microbench_inputs *Inputs = (microbench_inputs *)_aligned_malloc(sizeof(microbench_inputs), 64);
+    InitializeMicrobenchInputs(Inputs, 0);
+
+    bool Valid = ValidateKernels(Inputs);
+    Valid &= ValidatePixelUpload(Inputs);
+    if (!Valid || ValidateOnly)
+    {
+        printf("%s\n", Valid ? "validation passed" : "validation failed");
+        _aligned_free(Inputs);
+        return Valid ? 0 : 1;
+    }
+
+    printf("v3 is %s (ENABLE_SIMD=%d), %u warm inputs\n",
+           ENABLE_SIMD ? "__m128" : "a struct", ENABLE_SIMD, MICROBENCH_INPUT_COUNT);
+    printf("%-30s %12s %12s %14s\n", "kernel", "ns/call", "latency ns", "Mcalls/s");
+
+    PrintMicrobenchResult("RayCastSphere", MeasureKernel([&](u32 Index) -> u32
+    {
+        f32 T;
+        bool Hit = RayCastSphere(Inputs->Rays[Index], Inputs->Spheres[Index], &T);
+        return F32Bits(T) ^ (u32)Hit;
+    }));
+
+    PrintMicrobenchResult("GetRaySphereIntersectionInfo", MeasureKernel([&](u32 Index) -> u32
+    {
+        intersection_info Info = GetRaySphereIntersectionInfo(Inputs->Rays[Index], Inputs->Spheres[Index], Inputs->Ts[Index]);
+        return V3Bits(Info.Point) ^ V3Bits(Info.Normal);
+    }));
+
+    PrintMicrobenchResult("Normalize", MeasureKernel([&](u32 Index) -> u32
+    {
+        return V3Bits(Normalize(Inputs->Vectors[Index]));
+    }));
+
+    PrintMicrobenchResult("Reflect", MeasureKernel([&](u32 Index) -> u32
+    {
+        return V3Bits(Reflect(Inputs->Rays[Index].Direction, Inputs->Normals[Index]));
+    }));
+
+    PrintMicrobenchResult("RandomCanonical", MeasureKernel([&](u32 Index) -> u32
+    {
+        random_series Series = RandomSeries(0, Index, 0);
+        return F32Bits(RandomCanonical(&Series));
+    }));
+
+    PrintMicrobenchResult("RandomV3", MeasureKernel([&](u32 Index) -> u32
+    {
+        random_series Series = RandomSeries(0, Index, 0);
+        return V3Bits(RandomV3(&Series, -0.5f, 0.5f));
+    }));
+
+    PrintMicrobenchResult("SRGBToLinear", MeasureKernel([&](u32 Index) -> u32
+    {
+        return V3Bits(SRGBToLinear(Inputs->Colors[Index]));
+    }));
+
+    PrintMicrobenchResult("LinearToSRGB", MeasureKernel([&](u32 Index) -> u32
+    {
+        return V3Bits(LinearToSRGB(Inputs->Colors[Index]));
+    }));
+
+    // note(harlequin): one call resolves LANE_WIDTH pixels, the block wraps around the end of the inputs
+    PrintMicrobenchResult("ResolvePixels (lane)", MeasureKernel([&](u32 Index) -> u32
+    {
+        v3 Resolved[LANE_WIDTH];
+        ResolvePixels(Inputs->Colors + (Index & ~(LANE_WIDTH - 1)), nullptr, Resolved, LANE_WIDTH, Tonemapper_Aces);
+        return V3Bits(Resolved[Index & (LANE_WIDTH - 1)]);
+    }));
+
+    PrintMicrobenchResult("PackRgba8 (4 pixels)", MeasureKernel([&](u32 Index) -> u32
+    {
+        u32 Packed[4];
+        PackRgba8(Inputs->Colors + (Index & ~3u), Packed, 4);
+        return Packed[Index & 3];
+    }));
+
+    printf("checksum %08x\n", (u32)GlobalMicrobenchSink);
+
+    _aligned_free(Inputs);
+    return 0;
+}
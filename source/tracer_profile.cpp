@@ -0,0 +1,235 @@
+#include "tracer_profile.h"
+
+#if TRACER_PROFILE
+
+#include <stdarg.h>
+
+// note(harlequin): the timestamps are raw rdtsc ticks, a handful of cycles to read and constant rate on every x86
+// of the last decade. they turn into microseconds with the tick rate measured between InitializeProfile and the
+// export against the steady clock
+global_variable profile_state Profile;
+global_variable thread_local profile_thread *ProfileThread;
+global_variable thread_local bool ProfileThreadDropped; // registered past PROFILE_MAX_THREAD_COUNT
+
+// note(harlequin): a thread gets its ring the first time it records something
+function profile_thread *
+GetProfileThread()
+{
+    if (ProfileThread || ProfileThreadDropped)
+    {
+        return ProfileThread;
+    }
+
+    u32 ThreadIndex = Profile.ThreadCount.fetch_add(1, std::memory_order_relaxed);
+    profile_thread *Thread = ThreadIndex < PROFILE_MAX_THREAD_COUNT ? (profile_thread *)calloc(1, sizeof(profile_thread)) : nullptr;
+    if (!Thread)
+    {
+        ProfileThreadDropped = true;
+        return nullptr;
+    }
+
+    snprintf(Thread->Name, sizeof(Thread->Name), "thread %u", ThreadIndex);
+    Profile.Threads[ThreadIndex].store(Thread, std::memory_order_release);
+    ProfileThread = Thread;
+    return Thread;
+}
+
+inline
+profile_scope::profile_scope(const char *ScopeName, profile_counter ScopeCounter /* = ProfileCounter_Count */)
+{
+    Name       = ScopeName;
+    Counter    = ScopeCounter;
+    BeginTicks = __rdtsc();
+}
+
+inline
+profile_scope::~profile_scope()
+{
+    u64 EndTicks = __rdtsc();
+    RecordProfileEvent(Name, BeginTicks, EndTicks);
+    if (Counter != ProfileCounter_Count)
+    {
+        AddProfileCount(Counter, EndTicks - BeginTicks);
+    }
+}
+
+void
+InitializeProfile()
+{
+    Profile.StartTicks = __rdtsc();
+    Profile.StartTime  = std::chrono::steady_clock::now();
+    SetProfileThreadName("main");
+}
+
+void
+SetProfileThreadName(const char *Format, ...)
+{
+    profile_thread *Thread = GetProfileThread();
+    if (!Thread)
+    {
+        return;
+    }
+
+    va_list Arguments;
+    va_start(Arguments, Format);
+    vsnprintf(Thread->Name, sizeof(Thread->Name), Format, Arguments);
+    va_end(Arguments);
+}
+
+void
+RecordProfileEvent(const char *Name,
+                   u64         BeginTicks,
+                   u64         EndTicks)
+{
+    profile_thread *Thread = GetProfileThread();
+    if (!Thread)
+    {
+        return;
+    }
+
+    u64 EventIndex = Thread->EventCount.load(std::memory_order_relaxed);
+    profile_event *Event = Thread->Events + (EventIndex & (PROFILE_RING_CAPACITY - 1));
+    Event->Name       = Name;
+    Event->BeginTicks = BeginTicks;
+    Event->EndTicks   = EndTicks;
+    Thread->EventCount.store(EventIndex + 1, std::memory_order_release);
+}
+
+void
+AddProfileCount(profile_counter Counter,
+                u64             Value)
+{
+    profile_thread *Thread = GetProfileThread();
+    if (!Thread)
+    {
+        return;
+    }
+
+    // note(harlequin): only this thread writes the counter, no need for a locked add
+    std::atomic< u64 > &Count = Thread->Counters[Counter];
+    Count.store(Count.load(std::memory_order_relaxed) + Value, std::memory_order_relaxed);
+}
+
+void
+SampleProfileCounters()
+{
+    if (!Profile.Samples)
+    {
+        Profile.Samples = (profile_counter_sample *)calloc(PROFILE_MAX_SAMPLE_COUNT, sizeof(profile_counter_sample));
+    }
+    if (!Profile.Samples || Profile.SampleCount == PROFILE_MAX_SAMPLE_COUNT)
+    {
+        return;
+    }
+
+    profile_counter_sample *Sample = Profile.Samples + Profile.SampleCount++;
+    Sample->Ticks = __rdtsc();
+
+    u32 ThreadCount = Profile.ThreadCount.load(std::memory_order_relaxed);
+    ThreadCount = ThreadCount < PROFILE_MAX_THREAD_COUNT ? ThreadCount : PROFILE_MAX_THREAD_COUNT;
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
+    {
+        profile_thread *Thread = Profile.Threads[ThreadIndex].load(std::memory_order_acquire);
+        for (u32 CounterIndex = 0; Thread && CounterIndex < ProfileCounter_Count; CounterIndex++)
+        {
+            Sample->Values[CounterIndex] += Thread->Counters[CounterIndex].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// microseconds since InitializeProfile, the events from before it are clamped to the start
+inline f64
+GetProfileMicroseconds(u64 Ticks, f64 TicksPerMicrosecond)
+{
+    return Ticks > Profile.StartTicks ? (f64)(Ticks - Profile.StartTicks) / TicksPerMicrosecond : 0.0;
+}
+
+bool
+WriteProfile(const char *FilePath)
+{
+    u64 EndTicks = __rdtsc();
+    f64 ElapsedMicroseconds = std::chrono::duration< f64, std::micro >(std::chrono::steady_clock::now() - Profile.StartTime).count();
+    f64 TicksPerMicrosecond = ElapsedMicroseconds > 0.0 && EndTicks > Profile.StartTicks ? (f64)(EndTicks - Profile.StartTicks) / ElapsedMicroseconds : 1.0;
+
+    FILE *File = fopen(FilePath, "wb");
+    if (!File)
+    {
+        return false;
+    }
+
+    // note(harlequin): one complete event per scope, a thread_name record per thread and one counter track per
+    // counter with what it grew by since the sample before
+    fprintf(File, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char *Separator = "";
+
+    u32 ThreadCount = Profile.ThreadCount.load(std::memory_order_acquire);
+    ThreadCount = ThreadCount < PROFILE_MAX_THREAD_COUNT ? ThreadCount : PROFILE_MAX_THREAD_COUNT;
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
+    {
+        profile_thread *Thread = Profile.Threads[ThreadIndex].load(std::memory_order_acquire);
+        if (!Thread)
+        {
+            continue;
+        }
+
+        fprintf(File, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                Separator, ThreadIndex, Thread->Name);
+        Separator = ",\n";
+
+        u64 EventCount = Thread->EventCount.load(std::memory_order_acquire);
+        u64 FirstEvent = EventCount > PROFILE_RING_CAPACITY ? EventCount - PROFILE_RING_CAPACITY : 0;
+        if (FirstEvent)
+        {
+            fprintf(stderr, "%s recorded %llu events, the profile only has the last %u\n",
+                    Thread->Name, (unsigned long long)EventCount, PROFILE_RING_CAPACITY);
+        }
+
+        for (u64 EventIndex = FirstEvent; EventIndex < EventCount; EventIndex++)
+        {
+            const profile_event *Event = Thread->Events + (EventIndex & (PROFILE_RING_CAPACITY - 1));
+            f64 Begin = GetProfileMicroseconds(Event->BeginTicks, TicksPerMicrosecond);
+            f64 End   = GetProfileMicroseconds(Event->EndTicks, TicksPerMicrosecond);
+            fprintf(File, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    Event->Name, ThreadIndex, Begin, End - Begin);
+        }
+    }
+
+    for (u32 SampleIndex = 0; SampleIndex < Profile.SampleCount; SampleIndex++)
+    {
+        const profile_counter_sample *Sample = Profile.Samples + SampleIndex;
+        f64 Time = GetProfileMicroseconds(Sample->Ticks, TicksPerMicrosecond);
+        for (u32 CounterIndex = 0; CounterIndex < ProfileCounter_Count; CounterIndex++)
+        {
+            u64 Value = Sample->Values[CounterIndex] - (SampleIndex ? Sample[-1].Values[CounterIndex] : 0);
+            f64 Shown = CounterIndex == ProfileCounter_IdleTicks ? (f64)Value / (TicksPerMicrosecond * 1000.0) : (f64)Value;
+            fprintf(File, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%.3f}}",
+                    Separator, ProfileCounterNames[CounterIndex], Time, Shown);
+            Separator = ",\n";
+        }
+    }
+
+    fprintf(File, "\n]}\n");
+    bool Success = !ferror(File);
+    Success &= fclose(File) == 0;
+    return Success;
+}
+
+void
+FreeProfile()
+{
+    u32 ThreadCount = Profile.ThreadCount.load(std::memory_order_acquire);
+    ThreadCount = ThreadCount < PROFILE_MAX_THREAD_COUNT ? ThreadCount : PROFILE_MAX_THREAD_COUNT;
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
+    {
+        free(Profile.Threads[ThreadIndex].exchange(nullptr, std::memory_order_acq_rel));
+    }
+    free(Profile.Samples);
+    Profile.Samples     = nullptr;
+    Profile.SampleCount = 0;
+
+    // note(harlequin): the calling thread records nothing from here on instead of writing into a freed ring
+    ProfileThread        = nullptr;
+    ProfileThreadDropped = true;
+}
+
+#endif
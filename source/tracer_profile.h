@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "tracer_core.h"
+
+// note(harlequin): build with -DTRACER_PROFILE=1 to time the hot paths, every macro below is empty otherwise and
+// the renderer does not pay a single instruction for it
+#ifndef TRACER_PROFILE
+#define TRACER_PROFILE 0
+#endif
+
+enum profile_counter
+{
+    ProfileCounter_Rays,          // every ray segment, camera rays and bounces
+    ProfileCounter_Bounces,       // the segments after the camera ray
+    ProfileCounter_SphereTests,
+    ProfileCounter_TriangleTests,
+    ProfileCounter_IdleTicks,     // spent spinning or parked with nothing to trace
+    ProfileCounter_Count
+};
+
+#if TRACER_PROFILE
+
+#define PROFILE_RING_CAPACITY    65536 // events a thread keeps, the oldest are overwritten, must be a power of two
+#define PROFILE_MAX_THREAD_COUNT 256   // threads that get a ring, the ones after that are not recorded
+#define PROFILE_MAX_SAMPLE_COUNT 65536 // counter samples, one per frame, the ones after that are dropped
+
+global_variable const char *ProfileCounterNames[ProfileCounter_Count] =
+{
+    "rays", "bounces", "sphere tests", "triangle tests", "idle ms"
+};
+
+struct profile_event
+{
+    const char *Name; // a string literal, only the pointer is kept
+    u64         BeginTicks;
+    u64         EndTicks;
+};
+
+// note(harlequin): only the owning thread writes its ring and counters, the export reads them once the threads
+// stopped, the counters are atomics only so the per frame samples can read them while the workers spin
+struct profile_thread
+{
+    profile_event      Events[PROFILE_RING_CAPACITY];
+    std::atomic< u64 > EventCount; // ever recorded, the ring holds the last PROFILE_RING_CAPACITY of them
+    std::atomic< u64 > Counters[ProfileCounter_Count];
+    char               Name[32];
+};
+
+struct profile_counter_sample
+{
+    u64 Ticks;
+    u64 Values[ProfileCounter_Count]; // summed over every thread since the start
+};
+
+struct profile_state
+{
+    u64 StartTicks;
+    std::chrono::steady_clock::time_point StartTime; // with StartTicks, converts the ticks to microseconds
+
+    std::atomic< u32 >              ThreadCount;
+    std::atomic< profile_thread * > Threads[PROFILE_MAX_THREAD_COUNT];
+
+    // note(harlequin): written by the thread that runs the frames
+    u32                     SampleCount;
+    profile_counter_sample *Samples;
+};
+
+struct profile_scope
+{
+    const char     *Name;
+    profile_counter Counter; // gets the ticks of the scope added, ProfileCounter_Count adds them nowhere
+    u64             BeginTicks;
+
+    profile_scope(const char *ScopeName, profile_counter ScopeCounter = ProfileCounter_Count);
+    ~profile_scope();
+};
+
+function void
+InitializeProfile();
+
+// names the calling thread in the trace, printf style
+function void
+SetProfileThreadName(const char *Format, ...);
+
+function void
+RecordProfileEvent(const char *Name,
+                   u64         BeginTicks,
+                   u64         EndTicks);
+
+function void
+AddProfileCount(profile_counter Counter,
+                u64             Value);
+
+// sums the counters of every thread into a sample, once per frame
+function void
+SampleProfileCounters();
+
+// writes what the rings still hold and the counter samples as chrome trace_event json, for chrome://tracing or
+// ui.perfetto.dev, every recording thread has to be stopped
+function bool
+WriteProfile(const char *FilePath);
+
+// the recording threads have to be stopped, the calling one records nothing afterwards
+function void
+FreeProfile();
+
+#define PROFILE_CONCATENATE_(A, B) A##B
+#define PROFILE_CONCATENATE(A, B) PROFILE_CONCATENATE_(A, B)
+
+#define PROFILE_INITIALIZE()             InitializeProfile()
+#define PROFILE_THREAD_NAME(...)         SetProfileThreadName(__VA_ARGS__)
+#define PROFILE_SCOPE(Name)              profile_scope PROFILE_CONCATENATE(ProfileScope, __LINE__)(Name)
+#define PROFILE_IDLE_SCOPE(Name)         profile_scope PROFILE_CONCATENATE(ProfileScope, __LINE__)(Name, ProfileCounter_IdleTicks)
+#define PROFILE_COUNT(Counter, Value)    AddProfileCount(Counter, Value)
+#define PROFILE_SAMPLE_COUNTERS()        SampleProfileCounters()
+
+#else
+
+#define PROFILE_INITIALIZE()
+#define PROFILE_THREAD_NAME(...)
+#define PROFILE_SCOPE(Name)
+#define PROFILE_IDLE_SCOPE(Name)
+#define PROFILE_COUNT(Counter, Value)
+#define PROFILE_SAMPLE_COUNTERS()
+
+#endif
@@ -0,0 +1,179 @@
+#include "tracer_progressive.h"
+#include "tracer_framebuffer.h"
+
+void
+BeginProgressiveRender(progressive_render         *Render,
+                       const progressive_settings &Settings)
+{
+    ResetArena(&Render->Arena);
+    Render->Settings                = Settings;
+    Render->StartTime               = std::chrono::steady_clock::now();
+    Render->ElapsedSeconds          = 0.0;
+    Render->LongestFrameSeconds     = 0.0;
+    Render->FrameCount              = 0;
+    Render->MinimumPixelSampleCount = 0;
+    Render->RayCount                = 0;
+    Render->Error                   = MAX_F32;
+    Render->SamplesPerPixel         = 0.0f;
+    Render->StopReason              = ProgressiveStop_None;
+    Render->Curve                   = nullptr;
+    Render->CurveCount              = 0;
+    Render->CurveCapacity           = 0;
+}
+
+void
+ResumeProgressiveRender(progressive_render  *Render,
+                        const sample_buffer *SampleBuffer,
+                        u32                  FrameCount,
+                        u64                  RayCount,
+                        f64                  ElapsedSeconds)
+{
+    Render->StartTime      = std::chrono::steady_clock::now() -
+                             std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< f64 >(ElapsedSeconds));
+    Render->ElapsedSeconds = ElapsedSeconds;
+    Render->FrameCount     = FrameCount;
+    Render->RayCount       = RayCount;
+    Render->Error          = EstimateImageError(SampleBuffer, &Render->SamplesPerPixel, &Render->MinimumPixelSampleCount);
+}
+
+bool
+ShouldTraceFrame(progressive_render *Render)
+{
+    if (Render->StopReason != ProgressiveStop_None)
+    {
+        return false;
+    }
+
+    const progressive_settings &Settings = Render->Settings;
+    f64 ElapsedSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - Render->StartTime).count();
+    if (Settings.MaxSampleCount && Render->MinimumPixelSampleCount >= Settings.MaxSampleCount)
+    {
+        Render->StopReason = ProgressiveStop_SampleCount;
+    }
+    else if (Settings.TargetError > 0.0f &&
+             Render->FrameCount >= Settings.MinimumSampleCount &&
+             Render->Error <= Settings.TargetError)
+    {
+        Render->StopReason = ProgressiveStop_TargetError;
+    }
+    else if (Settings.TimeBudgetSeconds > 0.0 &&
+             Render->FrameCount &&
+             ElapsedSeconds + Render->LongestFrameSeconds > Settings.TimeBudgetSeconds)
+    {
+        Render->StopReason = ProgressiveStop_TimeBudget;
+    }
+    return Render->StopReason == ProgressiveStop_None;
+}
+
+void
+EndProgressiveFrame(progressive_render  *Render,
+                    const sample_buffer *SampleBuffer,
+                    u64                  FrameRayCount,
+                    u32                  ActiveTileCount)
+{
+    f64 ElapsedSeconds = std::chrono::duration< f64 >(std::chrono::steady_clock::now() - Render->StartTime).count();
+    f64 FrameSeconds   = ElapsedSeconds - Render->ElapsedSeconds;
+
+    Render->ElapsedSeconds      = ElapsedSeconds;
+    Render->LongestFrameSeconds = FrameSeconds > Render->LongestFrameSeconds ? FrameSeconds : Render->LongestFrameSeconds;
+    Render->FrameCount++;
+    Render->RayCount += FrameRayCount;
+    Render->Error     = EstimateImageError(SampleBuffer, &Render->SamplesPerPixel, &Render->MinimumPixelSampleCount);
+
+    if (!ActiveTileCount)
+    {
+        Render->StopReason = ProgressiveStop_Converged;
+    }
+
+    // note(harlequin): a curve that cannot grow only loses its tail, the render goes on
+    convergence_point *Curve = (convergence_point *)GrowArray(&Render->Arena, Render->Curve, Render->CurveCount,
+                                                              &Render->CurveCapacity, Render->CurveCount + 1);
+    if (Curve)
+    {
+        Render->Curve = Curve;
+
+        convergence_point *Point = Render->Curve + Render->CurveCount++;
+        Point->Seconds         = ElapsedSeconds;
+        Point->FrameCount      = Render->FrameCount;
+        Point->SamplesPerPixel = Render->SamplesPerPixel;
+        Point->Error           = Render->Error;
+        Point->RayCount        = Render->RayCount;
+    }
+}
+
+f32
+EstimateImageError(const sample_buffer *SampleBuffer,
+                   f32                 *OutSamplesPerPixel,
+                   u32                 *OutMinimumSampleCount)
+{
+    u32 PixelCount = SampleBuffer->Width * SampleBuffer->Height;
+    u64 SampleCount = 0;
+    u32 MinimumSampleCount = PixelCount ? UINT_MAX : 0;
+    f64 SquaredErrorSum = 0.0;
+    bool Estimated = true;
+
+    for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+    {
+        const pixel_statistics *Statistics = SampleBuffer->Pixels + PixelIndex;
+        SampleCount += Statistics->SampleCount;
+        MinimumSampleCount = Statistics->SampleCount < MinimumSampleCount ? Statistics->SampleCount : MinimumSampleCount;
+
+        f32 Error = GetPixelRelativeError(Statistics);
+        if (Error == MAX_F32)
+        {
+            Estimated = false;
+        }
+        else
+        {
+            SquaredErrorSum += (f64)Error * (f64)Error;
+        }
+    }
+
+    *OutSamplesPerPixel    = PixelCount ? (f32)((f64)SampleCount / (f64)PixelCount) : 0.0f;
+    *OutMinimumSampleCount = MinimumSampleCount;
+    return Estimated && PixelCount ? (f32)sqrt(SquaredErrorSum / (f64)PixelCount) : MAX_F32;
+}
+
+bool
+SaveConvergenceCurve(const progressive_render *Render,
+                     const char               *FilePath)
+{
+    FILE *File = fopen(FilePath, "w");
+    if (!File)
+    {
+        fprintf(stderr, "failed to open %s for writing\n", FilePath);
+        return false;
+    }
+
+    fprintf(File, "seconds,frame,samples_per_pixel,error,rays\n");
+    for (u32 PointIndex = 0; PointIndex < Render->CurveCount; PointIndex++)
+    {
+        const convergence_point *Point = Render->Curve + PointIndex;
+        if (Point->Error == MAX_F32)
+        {
+            fprintf(File, "%.6f,%u,%.3f,,%llu\n", Point->Seconds, Point->FrameCount, Point->SamplesPerPixel,
+                    (unsigned long long)Point->RayCount);
+        }
+        else
+        {
+            fprintf(File, "%.6f,%u,%.3f,%.6g,%llu\n", Point->Seconds, Point->FrameCount, Point->SamplesPerPixel,
+                    Point->Error, (unsigned long long)Point->RayCount);
+        }
+    }
+
+    bool Success = fclose(File) == 0;
+    if (!Success)
+    {
+        fprintf(stderr, "failed to write %s\n", FilePath);
+    }
+    return Success;
+}
+
+void
+FreeProgressiveRender(progressive_render *Render)
+{
+    FreeArena(&Render->Arena);
+    Render->Curve         = nullptr;
+    Render->CurveCount    = 0;
+    Render->CurveCapacity = 0;
+}
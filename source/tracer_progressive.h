@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+
+#include "tracer_core.h"
+#include "tracer_memory.h"
+
+struct sample_buffer;
+
+// note(harlequin): a progressive render traces whole frames until the first of its limits is reached,
+// a limit of 0 is disabled. every frame adds a point to the convergence curve so the error can be
+// plotted against time, the error is the root mean square of the relative pixel errors estimated by
+// the sample buffer, so a few noisy regions keep it up even when most of the image is flat
+
+enum progressive_stop_reason
+{
+    ProgressiveStop_None,
+    ProgressiveStop_TimeBudget,
+    ProgressiveStop_SampleCount,
+    ProgressiveStop_TargetError,
+    ProgressiveStop_Converged, // adaptive sampling retired every tile
+    ProgressiveStop_Count
+};
+
+global_variable const char *ProgressiveStopReasonNames[ProgressiveStop_Count] =
+{
+    "running",
+    "time budget",
+    "sample count",
+    "target error",
+    "converged"
+};
+
+struct progressive_settings
+{
+    f64 TimeBudgetSeconds;
+    u32 MaxSampleCount;
+    f32 TargetError;
+    u32 MinimumSampleCount; // frames traced before the target error is trusted, two sample estimates are noisy
+};
+
+struct convergence_point
+{
+    f64 Seconds;
+    u32 FrameCount;
+    f32 SamplesPerPixel;
+    f32 Error;
+    u64 RayCount;
+};
+
+struct progressive_render
+{
+    progressive_settings Settings;
+    std::chrono::steady_clock::time_point StartTime;
+
+    f64 ElapsedSeconds;
+    f64 LongestFrameSeconds;
+    u32 FrameCount; // frames traced so far
+    // note(harlequin): the sample count limit is checked against the least sampled pixel, adaptive sampling
+    // gives a noisy tile several samples a frame so the frame count says little about it
+    u32 MinimumPixelSampleCount;
+    u64 RayCount;
+    f32 Error;      // MAX_F32 until every pixel has two samples
+    f32 SamplesPerPixel;
+    progressive_stop_reason StopReason;
+
+    memory_arena       Arena;
+    convergence_point *Curve;
+    u32                CurveCount;
+    u32                CurveCapacity;
+};
+
+function void
+BeginProgressiveRender(progressive_render         *Render,
+                       const progressive_settings &Settings);
+
+// picks a render up where a checkpoint of it left off, the elapsed time counts against the time budget and
+// the error is estimated from the restored sample buffer. the convergence curve starts over
+function void
+ResumeProgressiveRender(progressive_render  *Render,
+                        const sample_buffer *SampleBuffer,
+                        u32                  FrameCount,
+                        u64                  RayCount,
+                        f64                  ElapsedSeconds);
+
+// returns false and sets Render->StopReason once a limit is reached. the time budget is checked against
+// the slowest frame so far, a frame that would end past the budget is not started
+function bool
+ShouldTraceFrame(progressive_render *Render);
+
+function void
+EndProgressiveFrame(progressive_render  *Render,
+                    const sample_buffer *SampleBuffer,
+                    u64                  FrameRayCount,
+                    u32                  ActiveTileCount);
+
+function f32
+EstimateImageError(const sample_buffer *SampleBuffer,
+                   f32                 *OutSamplesPerPixel,
+                   u32                 *OutMinimumSampleCount);
+
+// writes the curve as csv, one convergence_point per line
+function bool
+SaveConvergenceCurve(const progressive_render *Render,
+                     const char               *FilePath);
+
+function void
+FreeProgressiveRender(progressive_render *Render);
@@ -3,31 +3,64 @@
 #include "tracer_core.h"
 #include "tracer_math.h"
 
-#include <time.h>
-
+// note(harlequin): counter based, every random number is a hash of where it is used instead of the next
+// state of a sequence, so a pixel gets the same numbers whichever thread or tile order traces it and
+// the same seed renders the same image on any thread count. the hash is pcg4d from jarzynski and olano,
+// "hash functions for gpu rendering" (jcgt 2020)
 struct random_series
 {
-    u64 ShuffleTable[2];
+    u32 Seed;
+    u32 PixelIndex;
+    u32 SampleIndex;
+    u32 Dimension; // bounce in the high 16 bits, draw within the bounce in the low 16
 };
 
 inline random_series
-RandomSeries()
+RandomSeries(u32 Seed,
+             u32 PixelIndex,
+             u32 SampleIndex,
+             u32 Bounce = 0)
 {
-    random_series Series = {};
-    Series.ShuffleTable[0] = time(nullptr);
-    Series.ShuffleTable[1] = time(nullptr);
+    random_series Series;
+    Series.Seed        = Seed;
+    Series.PixelIndex  = PixelIndex;
+    Series.SampleIndex = SampleIndex;
+    Series.Dimension   = Bounce << 16;
     return Series;
 }
 
+// note(harlequin): every bounce starts at a fixed dimension so the integrators draw the same numbers
+// for the same bounce no matter how many draws the bounces before it made
+inline void
+NextRandomBounce(random_series *Series)
+{
+    Series->Dimension = ((Series->Dimension >> 16) + 1) << 16;
+}
+
+inline u32
+Pcg4dHash(u32 X, u32 Y, u32 Z, u32 W)
+{
+    X = X * 1664525u + 1013904223u;
+    Y = Y * 1664525u + 1013904223u;
+    Z = Z * 1664525u + 1013904223u;
+    W = W * 1664525u + 1013904223u;
+
+    X += Y * W; Y += Z * X; Z += X * Y; W += Y * Z;
+    X ^= X >> 16; Y ^= Y >> 16; Z ^= Z >> 16; W ^= W >> 16;
+    X += Y * W; Y += Z * X; Z += X * Y; W += Y * Z;
+
+    return X ^ Y ^ Z ^ W;
+}
+
+inline u32 RandomU32(random_series *Series)
+{
+    return Pcg4dHash(Series->PixelIndex, Series->SampleIndex, Series->Dimension++, Series->Seed);
+}
+
+// [0, 1), the top 24 bits fill the float mantissa exactly
 inline f32 RandomCanonical(random_series *Series)
 {
-    u64 Seed0  = Series->ShuffleTable[1];
-    u64 Seed1  = Series->ShuffleTable[0];
-    u64 Result = Seed0 + Seed1;
-    Series->ShuffleTable[0] = Seed0;
-    Seed1 ^= Seed1 << 23;
-    Series->ShuffleTable[1] = Seed1 ^ Seed0 ^ (Seed1 >> 18) ^ (Seed0 >> 5);
-    return f32((f64(Result) / f64(ULLONG_MAX)));
+    return (f32)(RandomU32(Series) >> 8) * (1.0f / 16777216.0f);
 }
 
 inline f32 RandomBetween(random_series *Series,
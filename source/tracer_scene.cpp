@@ -0,0 +1,460 @@
+#include <ctype.h>
+
+#include "tracer_scene.h"
+#include "tracer_mesh.h"
+
+// note(harlequin): mesh paths in a scene are relative to the scene file unless they are absolute
+function void
+ResolveScenePath(const char *ScenePath,
+                 const char *Path,
+                 char       *OutPath,
+                 u32         OutPathSize)
+{
+    const char *Slash     = strrchr(ScenePath, '/');
+    const char *Backslash = strrchr(ScenePath, '\\');
+    if (Backslash > Slash)
+    {
+        Slash = Backslash;
+    }
+
+    bool IsAbsolute = Path[0] == '/' || Path[0] == '\\' || (Path[0] && Path[1] == ':');
+    if (IsAbsolute || !Slash)
+    {
+        snprintf(OutPath, OutPathSize, "%s", Path);
+    }
+    else
+    {
+        snprintf(OutPath, OutPathSize, "%.*s%s", (int)(Slash - ScenePath + 1), ScenePath, Path);
+    }
+}
+
+// note(harlequin): true when the line starts with Command as a whole word
+function bool
+IsSceneCommand(const char *Line, const char *Command)
+{
+    while (*Line == ' ' || *Line == '\t')
+    {
+        Line++;
+    }
+    u64 Length = strlen(Command);
+    return strncmp(Line, Command, Length) == 0 && isspace((unsigned char)Line[Length]);
+}
+
+// counts the material and sphere lines of a scene before it is parsed, commented ones are skipped
+function void
+CountSceneCommands(const char *Text,
+                   u64        *OutMaterialCount,
+                   u64        *OutSphereCount)
+{
+    *OutMaterialCount = 0;
+    *OutSphereCount   = 0;
+    for (const char *Line = Text; Line; )
+    {
+        *OutMaterialCount += IsSceneCommand(Line, "material");
+        *OutSphereCount   += IsSceneCommand(Line, "sphere");
+
+        Line = strchr(Line, '\n');
+        Line = Line ? Line + 1 : nullptr;
+    }
+}
+
+bool
+LoadTextScene(world      *World,
+              const char *FilePath,
+              u32         ThreadCount /* = 0 */)
+{
+    file_contents Contents;
+    if (!ReadEntireFile(FilePath, &Contents))
+    {
+        return false;
+    }
+
+    // note(harlequin): a grown world array leaves its old copy in the arena, so the arrays get their final size
+    // once before anything is pushed. meshes are pushed a whole mesh at a time and need no count
+    u64 MaterialCount = 0;
+    u64 SphereCount   = 0;
+    CountSceneCommands((const char *)Contents.Data, &MaterialCount, &SphereCount);
+    if (!ReserveWorld(World, MaterialCount, SphereCount, 0, 0))
+    {
+        fprintf(stderr, "%s: out of memory\n", FilePath);
+        FreeFileContents(&Contents);
+        return false;
+    }
+
+    bool Success = true;
+    char *Line = (char *)Contents.Data;
+    for (u32 LineNumber = 1; Success && Line; LineNumber++)
+    {
+        char *NextLine = strchr(Line, '\n');
+        if (NextLine)
+        {
+            *NextLine++ = '\0';
+        }
+        char *Comment = strchr(Line, '#');
+        if (Comment)
+        {
+            *Comment = '\0';
+        }
+
+        char Command[16];
+        i32 Consumed = 0;
+        if (sscanf(Line, " %15s%n", Command, &Consumed) != 1)
+        {
+            Line = NextLine;
+            continue;
+        }
+        const char *Arguments = Line + Consumed;
+
+        if (strcmp(Command, "material") == 0)
+        {
+            f32 R, G, B, Roughness;
+            if (sscanf(Arguments, "%f %f %f %f", &R, &G, &B, &Roughness) != 4)
+            {
+                fprintf(stderr, "%s(%u): expected material <r> <g> <b> <roughness>\n", FilePath, LineNumber);
+                Success = false;
+            }
+            else if (PushMaterial(World, V3(R, G, B), Roughness) == WORLD_INVALID_INDEX)
+            {
+                fprintf(stderr, "%s(%u): out of memory\n", FilePath, LineNumber);
+                Success = false;
+            }
+        }
+        else if (strcmp(Command, "sphere") == 0)
+        {
+            f32 X, Y, Z, Radius;
+            u32 MaterialIndex;
+            if (sscanf(Arguments, "%f %f %f %f %u", &X, &Y, &Z, &Radius, &MaterialIndex) != 5)
+            {
+                fprintf(stderr, "%s(%u): expected sphere <x> <y> <z> <radius> <material>\n", FilePath, LineNumber);
+                Success = false;
+            }
+            else if (MaterialIndex >= World->MaterialCount)
+            {
+                fprintf(stderr, "%s(%u): material %u is not defined\n", FilePath, LineNumber, MaterialIndex);
+                Success = false;
+            }
+            else if (PushSphere(World, V3(X, Y, Z), Radius, MaterialIndex) == WORLD_INVALID_INDEX)
+            {
+                fprintf(stderr, "%s(%u): out of memory\n", FilePath, LineNumber);
+                Success = false;
+            }
+        }
+        else if (strcmp(Command, "mesh") == 0)
+        {
+            char MeshPath[512];
+            u32 MaterialIndex;
+            f32 X, Y, Z, Scale;
+            if (sscanf(Arguments, " %511s %u %f %f %f %f", MeshPath, &MaterialIndex, &X, &Y, &Z, &Scale) != 6)
+            {
+                fprintf(stderr, "%s(%u): expected mesh <path> <material> <x> <y> <z> <scale>\n", FilePath, LineNumber);
+                Success = false;
+            }
+            else if (MaterialIndex >= World->MaterialCount)
+            {
+                fprintf(stderr, "%s(%u): material %u is not defined\n", FilePath, LineNumber, MaterialIndex);
+                Success = false;
+            }
+            else
+            {
+                char ResolvedPath[1024];
+                ResolveScenePath(FilePath, MeshPath, ResolvedPath, sizeof(ResolvedPath));
+
+                triangle_mesh Mesh;
+                Success = LoadTriangleMesh(ResolvedPath, &Mesh, ThreadCount) &&
+                          PushTriangleMesh(World, &Mesh, MaterialIndex, V3(X, Y, Z), Scale);
+                FreeTriangleMesh(&Mesh);
+                if (!Success)
+                {
+                    fprintf(stderr, "%s(%u): failed to add %s\n", FilePath, LineNumber, ResolvedPath);
+                }
+            }
+        }
+        else
+        {
+            fprintf(stderr, "%s(%u): unknown command %s\n", FilePath, LineNumber, Command);
+            Success = false;
+        }
+
+        Line = NextLine;
+    }
+
+    FreeFileContents(&Contents);
+    return Success;
+}
+
+inline u64
+AlignSceneOffset(u64 Offset)
+{
+    return (Offset + SCENE_FILE_ALIGNMENT - 1) & ~(u64)(SCENE_FILE_ALIGNMENT - 1);
+}
+
+// note(harlequin): the soa stores are one allocation each, the first array pointer is the base
+inline u64
+GetSphereSoaSize(u32 PaddedCount)
+{
+    return sizeof(f32) * (u64)GetSoaArrayStride(PaddedCount) * 4;
+}
+
+inline u64
+GetTriangleSoaSize(u32 PaddedCount)
+{
+    return sizeof(f32) * (u64)GetSoaArrayStride(PaddedCount) * 9;
+}
+
+function void
+GetSceneSectionSizes(const scene_file_header *Header,
+                     u64                     *OutSizes)
+{
+    OutSizes[SceneSection_Materials]                   = sizeof(material) * (u64)Header->MaterialCount;
+    OutSizes[SceneSection_Spheres]                     = sizeof(sphere) * (u64)Header->SphereCount;
+    OutSizes[SceneSection_SphereMaterialIndices]       = sizeof(u32) * (u64)Header->SphereCount;
+    OutSizes[SceneSection_Vertices]                    = sizeof(v3) * (u64)Header->VertexCount;
+    OutSizes[SceneSection_TriangleVertexIndices]       = sizeof(u32) * 3 * (u64)Header->TriangleCount;
+    OutSizes[SceneSection_TriangleMaterialIndices]     = sizeof(u32) * (u64)Header->TriangleCount;
+    OutSizes[SceneSection_SphereBvhNodes]              = sizeof(bvh_node) * (u64)Header->SphereBvhNodeCount;
+    OutSizes[SceneSection_SphereBvhPrimitiveIndices]   = sizeof(u32) * (u64)Header->SphereCount;
+    OutSizes[SceneSection_TriangleBvhNodes]            = sizeof(bvh_node) * (u64)Header->TriangleBvhNodeCount;
+    OutSizes[SceneSection_TriangleBvhPrimitiveIndices] = sizeof(u32) * (u64)Header->TriangleCount;
+    OutSizes[SceneSection_SphereSoa]                   = Header->SphereSoaPaddedCount ? GetSphereSoaSize(Header->SphereSoaPaddedCount) : 0;
+    OutSizes[SceneSection_TriangleSoa]                 = Header->TriangleSoaPaddedCount ? GetTriangleSoaSize(Header->TriangleSoaPaddedCount) : 0;
+}
+
+bool
+SaveSceneFile(const world *World,
+              const char  *FilePath)
+{
+    if (World->SphereBvh.PrimitiveCount != World->SphereCount ||
+        World->TriangleBvh.PrimitiveCount != World->TriangleCount ||
+        World->SphereSoa.Count != World->SphereCount ||
+        World->TriangleSoa.Count != World->TriangleCount)
+    {
+        fprintf(stderr, "the bvhs are out of date, build them before saving %s\n", FilePath);
+        return false;
+    }
+
+    scene_file_header Header = {};
+    Header.Magic                  = SCENE_FILE_MAGIC;
+    Header.Version                = SCENE_FILE_VERSION;
+    Header.HeaderSize             = sizeof(scene_file_header);
+    Header.LaneWidth              = LANE_WIDTH;
+    Header.V3Size                 = sizeof(v3);
+    Header.MaterialSize           = sizeof(material);
+    Header.SphereSize             = sizeof(sphere);
+    Header.BvhNodeSize            = sizeof(bvh_node);
+    Header.MaterialCount          = World->MaterialCount;
+    Header.SphereCount            = World->SphereCount;
+    Header.VertexCount            = World->VertexCount;
+    Header.TriangleCount          = World->TriangleCount;
+    Header.SphereBvhNodeCount     = World->SphereBvh.NodeCount;
+    Header.TriangleBvhNodeCount   = World->TriangleBvh.NodeCount;
+    Header.SphereSoaPaddedCount   = World->SphereSoa.PaddedCount;
+    Header.TriangleSoaPaddedCount = World->TriangleSoa.PaddedCount;
+
+    const void *SectionData[SceneSection_Count];
+    SectionData[SceneSection_Materials]                   = World->Materials;
+    SectionData[SceneSection_Spheres]                     = World->Spheres;
+    SectionData[SceneSection_SphereMaterialIndices]       = World->SphereMaterialIndices;
+    SectionData[SceneSection_Vertices]                    = World->Vertices;
+    SectionData[SceneSection_TriangleVertexIndices]       = World->TriangleVertexIndices;
+    SectionData[SceneSection_TriangleMaterialIndices]     = World->TriangleMaterialIndices;
+    SectionData[SceneSection_SphereBvhNodes]              = World->SphereBvh.Nodes;
+    SectionData[SceneSection_SphereBvhPrimitiveIndices]   = World->SphereBvh.PrimitiveIndices;
+    SectionData[SceneSection_TriangleBvhNodes]            = World->TriangleBvh.Nodes;
+    SectionData[SceneSection_TriangleBvhPrimitiveIndices] = World->TriangleBvh.PrimitiveIndices;
+    SectionData[SceneSection_SphereSoa]                   = World->SphereSoa.CenterX;
+    SectionData[SceneSection_TriangleSoa]                 = World->TriangleSoa.Vertex0X;
+
+    u64 SectionSizes[SceneSection_Count];
+    GetSceneSectionSizes(&Header, SectionSizes);
+
+    u64 Offset = AlignSceneOffset(sizeof(scene_file_header));
+    for (u32 SectionIndex = 0; SectionIndex < SceneSection_Count; SectionIndex++)
+    {
+        Header.Sections[SectionIndex].Offset = Offset;
+        Header.Sections[SectionIndex].Size   = SectionSizes[SectionIndex];
+        Offset = AlignSceneOffset(Offset + SectionSizes[SectionIndex]);
+    }
+    Header.FileSize = Offset;
+
+    FILE *File = fopen(FilePath, "wb");
+    if (!File)
+    {
+        fprintf(stderr, "failed to open %s for writing\n", FilePath);
+        return false;
+    }
+
+    local_persist const u8 Padding[SCENE_FILE_ALIGNMENT] = {};
+    bool Success = fwrite(&Header, sizeof(Header), 1, File) == 1;
+    u64 Written = sizeof(Header);
+    for (u32 SectionIndex = 0; Success && SectionIndex < SceneSection_Count; SectionIndex++)
+    {
+        const scene_file_section *Section = Header.Sections + SectionIndex;
+        u64 PaddingSize = Section->Offset - Written;
+        Success = fwrite(Padding, 1, (size_t)PaddingSize, File) == PaddingSize &&
+                  (!Section->Size || fwrite(SectionData[SectionIndex], 1, (size_t)Section->Size, File) == Section->Size);
+        Written = Section->Offset + Section->Size;
+    }
+    if (Success)
+    {
+        u64 PaddingSize = Header.FileSize - Written;
+        Success = fwrite(Padding, 1, (size_t)PaddingSize, File) == PaddingSize;
+    }
+
+    Success = fclose(File) == 0 && Success;
+    if (!Success)
+    {
+        fprintf(stderr, "failed to write %s\n", FilePath);
+    }
+    return Success;
+}
+
+inline void *
+GetSceneSection(const mapped_file *File, scene_section Section)
+{
+    const scene_file_section *Entry = ((const scene_file_header *)File->Data)->Sections + Section;
+    return Entry->Size ? File->Data + Entry->Offset : nullptr;
+}
+
+bool
+LoadSceneFile(world      *World,
+              const char *FilePath)
+{
+    Assert(!World->MaterialCount && !World->SphereCount && !World->VertexCount && !World->TriangleCount);
+
+    mapped_file File;
+    if (!MapFile(FilePath, &File))
+    {
+        return false;
+    }
+
+    const scene_file_header *Header = (const scene_file_header *)File.Data;
+    if (File.Size < sizeof(scene_file_header) || Header->Magic != SCENE_FILE_MAGIC)
+    {
+        fprintf(stderr, "%s is not a scene file\n", FilePath);
+        UnmapFile(&File);
+        return false;
+    }
+    if (Header->Version != SCENE_FILE_VERSION || Header->HeaderSize != sizeof(scene_file_header))
+    {
+        fprintf(stderr, "%s is scene file version %u, this build reads version %u\n",
+                FilePath, Header->Version, SCENE_FILE_VERSION);
+        UnmapFile(&File);
+        return false;
+    }
+    if (Header->V3Size != sizeof(v3) || Header->MaterialSize != sizeof(material) ||
+        Header->SphereSize != sizeof(sphere) || Header->BvhNodeSize != sizeof(bvh_node))
+    {
+        fprintf(stderr, "%s was written by a build with a different memory layout, convert it again\n", FilePath);
+        UnmapFile(&File);
+        return false;
+    }
+
+    // note(harlequin): only the header and the section table are checked, the contents are trusted like
+    // any other build artifact so loading never touches the pages of the big arrays
+    u64 SectionSizes[SceneSection_Count];
+    GetSceneSectionSizes(Header, SectionSizes);
+    bool Valid = Header->FileSize == File.Size &&
+                 Header->SphereSoaPaddedCount == GetLanePaddedCount(Header->SphereCount) &&
+                 Header->TriangleSoaPaddedCount == GetLanePaddedCount(Header->TriangleCount);
+    for (u32 SectionIndex = 0; Valid && SectionIndex < SceneSection_Count; SectionIndex++)
+    {
+        const scene_file_section *Section = Header->Sections + SectionIndex;
+        Valid = Section->Size == SectionSizes[SectionIndex] &&
+                Section->Offset % SCENE_FILE_ALIGNMENT == 0 &&
+                Section->Offset <= File.Size &&
+                Section->Size <= File.Size - Section->Offset;
+    }
+    if (!Valid)
+    {
+        fprintf(stderr, "%s is truncated or corrupt\n", FilePath);
+        UnmapFile(&File);
+        return false;
+    }
+
+    // note(harlequin): capacities equal the counts, so a later push copies the array into the arena
+    World->MaterialCount    = Header->MaterialCount;
+    World->MaterialCapacity = Header->MaterialCount;
+    World->Materials        = (material *)GetSceneSection(&File, SceneSection_Materials);
+
+    World->SphereCount           = Header->SphereCount;
+    World->SphereCapacity        = Header->SphereCount;
+    World->Spheres               = (sphere *)GetSceneSection(&File, SceneSection_Spheres);
+    World->SphereMaterialIndices = (u32 *)GetSceneSection(&File, SceneSection_SphereMaterialIndices);
+
+    World->VertexCount    = Header->VertexCount;
+    World->VertexCapacity = Header->VertexCount;
+    World->Vertices       = (v3 *)GetSceneSection(&File, SceneSection_Vertices);
+
+    World->TriangleCount           = Header->TriangleCount;
+    World->TriangleCapacity        = Header->TriangleCount;
+    World->TriangleVertexIndices   = (u32 *)GetSceneSection(&File, SceneSection_TriangleVertexIndices);
+    World->TriangleMaterialIndices = (u32 *)GetSceneSection(&File, SceneSection_TriangleMaterialIndices);
+
+    World->SphereBvh.NodeCount        = Header->SphereBvhNodeCount;
+    World->SphereBvh.Nodes            = (bvh_node *)GetSceneSection(&File, SceneSection_SphereBvhNodes);
+    World->SphereBvh.PrimitiveCount   = Header->SphereCount;
+    World->SphereBvh.PrimitiveIndices = (u32 *)GetSceneSection(&File, SceneSection_SphereBvhPrimitiveIndices);
+
+    World->TriangleBvh.NodeCount        = Header->TriangleBvhNodeCount;
+    World->TriangleBvh.Nodes            = (bvh_node *)GetSceneSection(&File, SceneSection_TriangleBvhNodes);
+    World->TriangleBvh.PrimitiveCount   = Header->TriangleCount;
+    World->TriangleBvh.PrimitiveIndices = (u32 *)GetSceneSection(&File, SceneSection_TriangleBvhPrimitiveIndices);
+
+    sphere_soa *Spheres = &World->SphereSoa;
+    *Spheres = {};
+    if (Header->SphereSoaPaddedCount)
+    {
+        u32 ArrayStride = GetSoaArrayStride(Header->SphereSoaPaddedCount);
+        f32 *Memory = (f32 *)GetSceneSection(&File, SceneSection_SphereSoa);
+        Spheres->Count         = Header->SphereCount;
+        Spheres->PaddedCount   = Header->SphereSoaPaddedCount;
+        Spheres->CenterX       = Memory;
+        Spheres->CenterY       = Memory + ArrayStride;
+        Spheres->CenterZ       = Memory + ArrayStride * 2;
+        Spheres->RadiusSquared = Memory + ArrayStride * 3;
+    }
+
+    triangle_soa *Triangles = &World->TriangleSoa;
+    *Triangles = {};
+    if (Header->TriangleSoaPaddedCount)
+    {
+        u32 ArrayStride = GetSoaArrayStride(Header->TriangleSoaPaddedCount);
+        f32 *Memory = (f32 *)GetSceneSection(&File, SceneSection_TriangleSoa);
+        Triangles->Count       = Header->TriangleCount;
+        Triangles->PaddedCount = Header->TriangleSoaPaddedCount;
+        Triangles->Vertex0X    = Memory;
+        Triangles->Vertex0Y    = Memory + ArrayStride;
+        Triangles->Vertex0Z    = Memory + ArrayStride * 2;
+        Triangles->Edge1X      = Memory + ArrayStride * 3;
+        Triangles->Edge1Y      = Memory + ArrayStride * 4;
+        Triangles->Edge1Z      = Memory + ArrayStride * 5;
+        Triangles->Edge2X      = Memory + ArrayStride * 6;
+        Triangles->Edge2Y      = Memory + ArrayStride * 7;
+        Triangles->Edge2Z      = Memory + ArrayStride * 8;
+    }
+
+    World->SceneFile = File;
+    return true;
+}
+
+bool
+LoadScene(world      *World,
+          const char *FilePath,
+          u32         ThreadCount /* = 0 */)
+{
+    if (HasExtension(FilePath, "scene"))
+    {
+        return LoadSceneFile(World, FilePath);
+    }
+
+    if (!LoadTextScene(World, FilePath, ThreadCount))
+    {
+        return false;
+    }
+    if (!BuildWorldBvh(World))
+    {
+        fprintf(stderr, "failed to build the bvhs of %s\n", FilePath);
+        return false;
+    }
+    return true;
+}
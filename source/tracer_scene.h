@@ -0,0 +1,87 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_world.h"
+#include "tracer_file.h"
+
+// note(harlequin): text scenes are one command per line, '#' starts a comment
+//   material <r> <g> <b> <roughness>
+//   sphere <x> <y> <z> <radius> <material index>
+//   mesh <path> <material index> <x> <y> <z> <scale>     (path relative to the scene file)
+// binary scenes (.scene) are the world arrays, bvhs and soa stores laid out as they are in memory so
+// loading is a mapping and a pointer per array, tracer_convert turns text scenes into binary ones
+
+#define SCENE_FILE_MAGIC 0x43535254u // "TRSC"
+#define SCENE_FILE_VERSION 2 // 2: materials hold linear albedo
+#define SCENE_FILE_ALIGNMENT 64
+
+enum scene_section
+{
+    SceneSection_Materials,
+    SceneSection_Spheres,
+    SceneSection_SphereMaterialIndices,
+    SceneSection_Vertices,
+    SceneSection_TriangleVertexIndices,
+    SceneSection_TriangleMaterialIndices,
+    SceneSection_SphereBvhNodes,
+    SceneSection_SphereBvhPrimitiveIndices,
+    SceneSection_TriangleBvhNodes,
+    SceneSection_TriangleBvhPrimitiveIndices,
+    SceneSection_SphereSoa,
+    SceneSection_TriangleSoa,
+    SceneSection_Count
+};
+
+struct scene_file_section
+{
+    u64 Offset; // from the start of the file, a multiple of SCENE_FILE_ALIGNMENT
+    u64 Size;
+};
+
+struct scene_file_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 HeaderSize;
+    u32 LaneWidth; // of the build that wrote the file, informational
+
+    // note(harlequin): sizes of the in memory structs, a file only loads into a build with the same layout
+    u32 V3Size;
+    u32 MaterialSize;
+    u32 SphereSize;
+    u32 BvhNodeSize;
+
+    u64 FileSize;
+
+    u32 MaterialCount;
+    u32 SphereCount;
+    u32 VertexCount;
+    u32 TriangleCount;
+    u32 SphereBvhNodeCount;
+    u32 TriangleBvhNodeCount;
+    u32 SphereSoaPaddedCount;
+    u32 TriangleSoaPaddedCount;
+
+    scene_file_section Sections[SceneSection_Count];
+};
+
+function bool
+LoadTextScene(world      *World,
+              const char *FilePath,
+              u32         ThreadCount = 0);
+
+// the world must have its bvhs built
+function bool
+SaveSceneFile(const world *World,
+              const char  *FilePath);
+
+// World has to be empty, the result is ready to render without BuildWorldBvh
+function bool
+LoadSceneFile(world      *World,
+              const char *FilePath);
+
+// picks LoadSceneFile for .scene files and LoadTextScene followed by BuildWorldBvh otherwise
+function bool
+LoadScene(world      *World,
+          const char *FilePath,
+          u32         ThreadCount = 0);
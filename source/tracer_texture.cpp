@@ -52,50 +52,163 @@ ResizeTexture(opengl_texture *Texture,
                  0);
 }
 
-struct pixel
+// note(harlequin): persistent coherent mappings need gl 4.4, without them the buffer
+// is mapped unsynchronized for every frame, which is just as safe since the fence already said the copy is done
+struct opengl_upload_context
 {
-    f32 X;
-    f32 Y;
-    f32 Z;
+    bool Persistent;
+    u32  Buffers[UPLOAD_BUFFER_COUNT];
+    u8  *Mappings[UPLOAD_BUFFER_COUNT];
+    u64  Sizes[UPLOAD_BUFFER_COUNT];
 };
 
-void
-CopyFrameBufferToTexture(frame_buffer   *FrameBuffer,
-                         opengl_texture *Texture)
+global_variable opengl_upload_context GlobalOpenglUploadContext;
+
+function i32
+FindOpenglUploadSlot(opengl_upload_context *Context, u32 Buffer)
+{
+    for (u32 Slot = 0; Slot < UPLOAD_BUFFER_COUNT; Slot++)
+    {
+        if (Context->Buffers[Slot] == Buffer)
+        {
+            return (i32)Slot;
+        }
+    }
+    return -1;
+}
+
+function bool
+OpenglCreateBuffer(void *ContextPointer, u64 Size, u32 *OutBuffer)
+{
+    opengl_upload_context *Context = (opengl_upload_context *)ContextPointer;
+    i32 Slot = FindOpenglUploadSlot(Context, 0);
+    if (Slot < 0)
+    {
+        return false;
+    }
+
+    u32 Buffer = 0;
+    glGenBuffers(1, &Buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+
+    u8 *Mapping = nullptr;
+    if (Context->Persistent)
+    {
+        GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)Size, nullptr, Flags);
+        Mapping = (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)Size, Flags);
+        if (!Mapping)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &Buffer);
+            return false;
+        }
+    }
+    else
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)Size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    Context->Buffers[Slot]  = Buffer;
+    Context->Mappings[Slot] = Mapping;
+    Context->Sizes[Slot]    = Size;
+    *OutBuffer = Buffer;
+    return true;
+}
+
+function void
+OpenglDestroyBuffer(void *ContextPointer, u32 Buffer)
 {
-    Assert(FrameBuffer->Width == Texture->Width);
-    Assert(FrameBuffer->Height == Texture->Height);
+    opengl_upload_context *Context = (opengl_upload_context *)ContextPointer;
+    i32 Slot = FindOpenglUploadSlot(Context, Buffer);
+    Assert(Slot >= 0);
+    if (Context->Mappings[Slot])
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &Buffer);
+    Context->Buffers[Slot]  = 0;
+    Context->Mappings[Slot] = nullptr;
+    Context->Sizes[Slot]    = 0;
+}
 
-#if ENABLE_SIMD
-    u32 PixelCount = Texture->Width * Texture->Height;
-    pixel *Pixels = (pixel *)malloc(sizeof(pixel) * PixelCount);
-    for (u32 PixelIndex = 0; PixelIndex < PixelCount; PixelIndex++)
+function u8 *
+OpenglMapBuffer(void *ContextPointer, u32 Buffer)
+{
+    opengl_upload_context *Context = (opengl_upload_context *)ContextPointer;
+    i32 Slot = FindOpenglUploadSlot(Context, Buffer);
+    Assert(Slot >= 0);
+    if (Context->Persistent)
     {
-        v3 *Src = FrameBuffer->Pixels + PixelIndex;
-        pixel *Dst = Pixels + PixelIndex;
-        Dst->X = VectorComponent(*Src, 0);
-        Dst->Y = VectorComponent(*Src, 1);
-        Dst->Z = VectorComponent(*Src, 2);
+        return Context->Mappings[Slot];
     }
-    glTexSubImage2D(GL_TEXTURE_2D,
-                    0,
-                    0,
-                    0,
-                    Texture->Width,
-                    Texture->Height,
-                    Texture->Format,
-                    Texture->PixelType,
-                    Pixels);
-    free(Pixels);
-#else
-    glTexSubImage2D(GL_TEXTURE_2D,
-                    0,
-                    0,
-                    0,
-                    Texture->Width,
-                    Texture->Height,
-                    Texture->Format,
-                    Texture->PixelType,
-                    FrameBuffer->Pixels);
-#endif
-}
\ No newline at end of file
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+    u8 *Mapping = (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)Context->Sizes[Slot],
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return Mapping;
+}
+
+function void
+OpenglUnmapBuffer(void *ContextPointer, u32 Buffer)
+{
+    opengl_upload_context *Context = (opengl_upload_context *)ContextPointer;
+    if (!Context->Persistent)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+}
+
+function void
+OpenglCopyToTexture(void *ContextPointer, u32 Buffer, u32 Texture, u32 Width, u32 Height)
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+    glBindTexture(GL_TEXTURE_2D, Texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+function void *
+OpenglInsertFence(void *ContextPointer)
+{
+    return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+function bool
+OpenglIsFenceSignaled(void *ContextPointer, void *Fence)
+{
+    GLenum Status = glClientWaitSync((GLsync)Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return Status == GL_ALREADY_SIGNALED || Status == GL_CONDITION_SATISFIED;
+}
+
+function void
+OpenglDeleteFence(void *ContextPointer, void *Fence)
+{
+    glDeleteSync((GLsync)Fence);
+}
+
+upload_backend
+GetOpenglUploadBackend()
+{
+    opengl_upload_context *Context = &GlobalOpenglUploadContext;
+    *Context = {};
+    Context->Persistent = GLAD_GL_VERSION_4_4 != 0;
+
+    upload_backend Backend;
+    Backend.Context         = Context;
+    Backend.CreateBuffer    = OpenglCreateBuffer;
+    Backend.DestroyBuffer   = OpenglDestroyBuffer;
+    Backend.MapBuffer       = OpenglMapBuffer;
+    Backend.UnmapBuffer     = OpenglUnmapBuffer;
+    Backend.CopyToTexture   = OpenglCopyToTexture;
+    Backend.InsertFence     = OpenglInsertFence;
+    Backend.IsFenceSignaled = OpenglIsFenceSignaled;
+    Backend.DeleteFence     = OpenglDeleteFence;
+    return Backend;
+}
@@ -2,6 +2,7 @@
 
 #include "tracer_core.h"
 #include "tracer_framebuffer.h"
+#include "tracer_upload.h"
 
 struct opengl_texture
 {
@@ -26,6 +27,6 @@ ResizeTexture(opengl_texture *Texture,
               u32             NewWidth,
               u32             NewHeight);
 
-function void
-CopyFrameBufferToTexture(frame_buffer   *FrameBuffer,
-                         opengl_texture *Texture);
\ No newline at end of file
+// note(harlequin): the pixel_upload backend of the viewport, needs a current context with its functions loaded
+function upload_backend
+GetOpenglUploadBackend();
@@ -0,0 +1,272 @@
+#include "tracer_upload.h"
+#include "tracer_profile.h"
+
+void
+PackRgba8(const v3 *Pixels,
+          u32      *Output,
+          u32       Count)
+{
+    u32 PixelIndex = 0;
+#if ENABLE_SIMD
+    // note(harlequin): four pixels become one register, the w lane of every pixel is replaced by the alpha. the
+    // rounding is the + 0.5 and truncation of the scalar loop, not the round half to even of _mm_cvtps_epi32, so
+    // a pixel packs the same in any lane and in either build
+    __m128  Zero  = _mm_setzero_ps();
+    __m128  One   = _mm_set1_ps(1.0f);
+    __m128  Scale = _mm_set1_ps(255.0f);
+    __m128  Half  = _mm_set1_ps(0.5f);
+    __m128i Alpha = _mm_set1_epi32((i32)0xFF000000);
+    for (; PixelIndex + 4 <= Count; PixelIndex += 4)
+    {
+        __m128i P0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(Pixels[PixelIndex + 0], Zero), One), Scale), Half));
+        __m128i P1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(Pixels[PixelIndex + 1], Zero), One), Scale), Half));
+        __m128i P2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(Pixels[PixelIndex + 2], Zero), One), Scale), Half));
+        __m128i P3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(Pixels[PixelIndex + 3], Zero), One), Scale), Half));
+        __m128i Packed = _mm_packus_epi16(_mm_packs_epi32(P0, P1), _mm_packs_epi32(P2, P3));
+        Packed = _mm_or_si128(_mm_and_si128(Packed, _mm_set1_epi32(0x00FFFFFF)), Alpha);
+        _mm_storeu_si128((__m128i *)(Output + PixelIndex), Packed);
+    }
+#endif
+    for (; PixelIndex < Count; PixelIndex++)
+    {
+        const v3 &Pixel = Pixels[PixelIndex];
+        u32 Packed = 0xFF000000u;
+        for (u32 Component = 0; Component < 3; Component++)
+        {
+            f32 Value = VectorComponent(Pixel, Component);
+            Value = Value < 0.0f ? 0.0f : (Value > 1.0f ? 1.0f : Value);
+            Packed |= (u32)(Value * 255.0f + 0.5f) << (8 * Component);
+        }
+        Output[PixelIndex] = Packed;
+    }
+}
+
+function void
+DestroyPixelUploadBuffers(pixel_upload *Upload)
+{
+    upload_backend &Backend = Upload->Backend;
+    for (u32 BufferIndex = 0; BufferIndex < UPLOAD_BUFFER_COUNT; BufferIndex++)
+    {
+        if (Upload->Fences[BufferIndex])
+        {
+            Backend.DeleteFence(Backend.Context, Upload->Fences[BufferIndex]);
+            Upload->Fences[BufferIndex] = nullptr;
+        }
+        if (Upload->Buffers[BufferIndex])
+        {
+            Backend.DestroyBuffer(Backend.Context, Upload->Buffers[BufferIndex]);
+            Upload->Buffers[BufferIndex] = 0;
+        }
+    }
+}
+
+bool
+ResizePixelUpload(pixel_upload *Upload,
+                  u32           NewWidth,
+                  u32           NewHeight)
+{
+    DestroyPixelUploadBuffers(Upload);
+    Upload->Width      = NewWidth;
+    Upload->Height     = NewHeight;
+    Upload->NextBuffer = 0;
+
+    u64 Size = sizeof(u32) * (u64)NewWidth * NewHeight;
+    for (u32 BufferIndex = 0; BufferIndex < UPLOAD_BUFFER_COUNT; BufferIndex++)
+    {
+        if (!Upload->Backend.CreateBuffer(Upload->Backend.Context, Size, Upload->Buffers + BufferIndex))
+        {
+            fprintf(stderr, "failed to create a %ux%u pixel upload buffer\n", NewWidth, NewHeight);
+            DestroyPixelUploadBuffers(Upload);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+InitializePixelUpload(pixel_upload         *Upload,
+                      const upload_backend &Backend,
+                      u32                   Width,
+                      u32                   Height)
+{
+    *Upload = {};
+    Upload->Backend = Backend;
+    return ResizePixelUpload(Upload, Width, Height);
+}
+
+bool
+UploadFrameBuffer(pixel_upload       *Upload,
+                  const frame_buffer *FrameBuffer,
+                  u32                 Texture)
+{
+    PROFILE_SCOPE("UploadFrameBuffer");
+    Assert(FrameBuffer->Width == Upload->Width && FrameBuffer->Height == Upload->Height);
+    upload_backend &Backend = Upload->Backend;
+
+    u32 BufferIndex = Upload->NextBuffer;
+    u32 Buffer = Upload->Buffers[BufferIndex];
+    if (!Buffer)
+    {
+        return false;
+    }
+
+    void *&Fence = Upload->Fences[BufferIndex];
+    if (Fence)
+    {
+        if (!Backend.IsFenceSignaled(Backend.Context, Fence))
+        {
+            Upload->SkippedCount++;
+            return false;
+        }
+        Backend.DeleteFence(Backend.Context, Fence);
+        Fence = nullptr;
+    }
+
+    u8 *Mapping = Backend.MapBuffer(Backend.Context, Buffer);
+    if (!Mapping)
+    {
+        return false;
+    }
+    PackRgba8(FrameBuffer->Pixels, (u32 *)Mapping, FrameBuffer->Width * FrameBuffer->Height);
+    Backend.UnmapBuffer(Backend.Context, Buffer);
+
+    {
+        PROFILE_SCOPE("CopyToTexture");
+        Backend.CopyToTexture(Backend.Context, Buffer, Texture, Upload->Width, Upload->Height);
+    }
+    Fence = Backend.InsertFence(Backend.Context);
+
+    Upload->NextBuffer = (BufferIndex + 1) % UPLOAD_BUFFER_COUNT;
+    Upload->UploadCount++;
+    return true;
+}
+
+void
+FreePixelUpload(pixel_upload *Upload)
+{
+    DestroyPixelUploadBuffers(Upload);
+    *Upload = {};
+}
+
+//
+// note(harlequin): software stand-in
+//
+
+function bool
+SoftwareCreateBuffer(void *Context, u64 Size, u32 *OutBuffer)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    for (u32 Buffer = 1; Buffer < ArrayCount(Device->Buffers); Buffer++)
+    {
+        if (!Device->Buffers[Buffer])
+        {
+            Device->Buffers[Buffer] = (u8 *)malloc(Size);
+            if (!Device->Buffers[Buffer])
+            {
+                return false;
+            }
+            Device->BufferSizes[Buffer] = Size;
+            *OutBuffer = Buffer;
+            return true;
+        }
+    }
+    return false;
+}
+
+function void
+SoftwareDestroyBuffer(void *Context, u32 Buffer)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    free(Device->Buffers[Buffer]);
+    Device->Buffers[Buffer]     = nullptr;
+    Device->BufferSizes[Buffer] = 0;
+}
+
+function u8 *
+SoftwareMapBuffer(void *Context, u32 Buffer)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    return Device->Buffers[Buffer];
+}
+
+function void
+SoftwareUnmapBuffer(void *Context, u32 Buffer)
+{
+}
+
+function void
+SoftwareCopyToTexture(void *Context, u32 Buffer, u32 Texture, u32 Width, u32 Height)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    if (Device->TextureWidth != Width || Device->TextureHeight != Height)
+    {
+        free(Device->Texture);
+        Device->Texture       = (u32 *)malloc(sizeof(u32) * Width * Height);
+        Device->TextureWidth  = Width;
+        Device->TextureHeight = Height;
+    }
+    Assert(Device->BufferSizes[Buffer] >= sizeof(u32) * (u64)Width * Height);
+    if (Device->Texture)
+    {
+        memcpy(Device->Texture, Device->Buffers[Buffer], sizeof(u32) * (u64)Width * Height);
+    }
+}
+
+function void *
+SoftwareInsertFence(void *Context)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    for (u32 Slot = 1; Slot < ArrayCount(Device->FenceUsed); Slot++)
+    {
+        if (!Device->FenceUsed[Slot])
+        {
+            Device->FenceUsed[Slot]  = true;
+            Device->FencePolls[Slot] = 0;
+            return (void *)(uintptr_t)Slot;
+        }
+    }
+    Assert(!"out of software fences");
+    return nullptr;
+}
+
+function bool
+SoftwareIsFenceSignaled(void *Context, void *Fence)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    u32 Slot = (u32)(uintptr_t)Fence;
+    return ++Device->FencePolls[Slot] > Device->FenceLatency;
+}
+
+function void
+SoftwareDeleteFence(void *Context, void *Fence)
+{
+    software_upload_device *Device = (software_upload_device *)Context;
+    Device->FenceUsed[(u32)(uintptr_t)Fence] = false;
+}
+
+upload_backend
+GetSoftwareUploadBackend(software_upload_device *Device)
+{
+    upload_backend Backend;
+    Backend.Context         = Device;
+    Backend.CreateBuffer    = SoftwareCreateBuffer;
+    Backend.DestroyBuffer   = SoftwareDestroyBuffer;
+    Backend.MapBuffer       = SoftwareMapBuffer;
+    Backend.UnmapBuffer     = SoftwareUnmapBuffer;
+    Backend.CopyToTexture   = SoftwareCopyToTexture;
+    Backend.InsertFence     = SoftwareInsertFence;
+    Backend.IsFenceSignaled = SoftwareIsFenceSignaled;
+    Backend.DeleteFence     = SoftwareDeleteFence;
+    return Backend;
+}
+
+void
+FreeSoftwareUploadDevice(software_upload_device *Device)
+{
+    for (u32 Buffer = 0; Buffer < ArrayCount(Device->Buffers); Buffer++)
+    {
+        free(Device->Buffers[Buffer]);
+    }
+    free(Device->Texture);
+    *Device = {};
+}
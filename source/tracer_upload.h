@@ -0,0 +1,93 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_framebuffer.h"
+
+// note(harlequin): the viewport reaches the gpu through UPLOAD_BUFFER_COUNT pixel buffers that stay mapped, a
+// frame is packed straight into the one the gpu is done with and copied to the texture from there, a fence per
+// buffer tells when that copy has finished. when every buffer is still in flight the frame is skipped instead of
+// waiting on the driver. the backend hides the api, the opengl one lives in tracer_texture.cpp and the software
+// one below runs the same logic on plain memory without a context
+
+#define UPLOAD_BUFFER_COUNT 2
+
+typedef bool  upload_create_buffer(void *Context, u64 Size, u32 *OutBuffer);
+typedef void  upload_destroy_buffer(void *Context, u32 Buffer);
+typedef u8   *upload_map_buffer(void *Context, u32 Buffer); // write only, only called on a buffer out of flight
+typedef void  upload_unmap_buffer(void *Context, u32 Buffer);
+typedef void  upload_copy_to_texture(void *Context, u32 Buffer, u32 Texture, u32 Width, u32 Height);
+typedef void *upload_insert_fence(void *Context);
+typedef bool  upload_is_fence_signaled(void *Context, void *Fence); // never blocks
+typedef void  upload_delete_fence(void *Context, void *Fence);
+
+struct upload_backend
+{
+    void                     *Context;
+    upload_create_buffer     *CreateBuffer;
+    upload_destroy_buffer    *DestroyBuffer;
+    upload_map_buffer        *MapBuffer;
+    upload_unmap_buffer      *UnmapBuffer;
+    upload_copy_to_texture   *CopyToTexture;
+    upload_insert_fence      *InsertFence;
+    upload_is_fence_signaled *IsFenceSignaled;
+    upload_delete_fence      *DeleteFence;
+};
+
+struct pixel_upload
+{
+    upload_backend Backend;
+    u32            Width;
+    u32            Height;
+    u32            Buffers[UPLOAD_BUFFER_COUNT];
+    void          *Fences[UPLOAD_BUFFER_COUNT];
+    u32            NextBuffer;
+    u32            UploadCount;
+    u32            SkippedCount; // frames dropped because every buffer was still in flight
+};
+
+function bool
+InitializePixelUpload(pixel_upload         *Upload,
+                      const upload_backend &Backend,
+                      u32                   Width,
+                      u32                   Height);
+
+function bool
+ResizePixelUpload(pixel_upload *Upload,
+                  u32           NewWidth,
+                  u32           NewHeight);
+
+// packs FrameBuffer as rgba8 into the next free buffer and starts its copy to Texture, returns false when the frame
+// was skipped, the caller keeps the frame and tries again later
+function bool
+UploadFrameBuffer(pixel_upload       *Upload,
+                  const frame_buffer *FrameBuffer,
+                  u32                 Texture);
+
+function void
+FreePixelUpload(pixel_upload *Upload);
+
+// note(harlequin): [0, 1] colors to rgba8 with an opaque alpha, rounded to nearest
+function void
+PackRgba8(const v3 *Pixels,
+          u32      *Output,
+          u32       Count);
+
+// note(harlequin): the software stand-in, buffers are heap blocks, the texture is an rgba8 array and a fence
+// signals after it has been polled FenceLatency times, which is how long the fake gpu is busy
+struct software_upload_device
+{
+    u8  *Buffers[UPLOAD_BUFFER_COUNT + 1]; // index 0 is never handed out, like a gl name
+    u64  BufferSizes[UPLOAD_BUFFER_COUNT + 1];
+    u32 *Texture;
+    u32  TextureWidth;
+    u32  TextureHeight;
+    u32  FenceLatency;
+    u32  FencePolls[UPLOAD_BUFFER_COUNT + 1]; // per fence, fences are handed out as 1 + slot
+    bool FenceUsed[UPLOAD_BUFFER_COUNT + 1];
+};
+
+function upload_backend
+GetSoftwareUploadBackend(software_upload_device *Device);
+
+function void
+FreeSoftwareUploadDevice(software_upload_device *Device);
@@ -0,0 +1,378 @@
+#include "tracer_wavefront.h"
+#include "tracer_jobs.h"
+#include "tracer_camera.h"
+#include "tracer_framebuffer.h"
+#include "tracer_world.h"
+
+#define PATH_QUEUE_STREAM_COUNT 27
+
+bool
+AllocatePathQueue(path_queue   *Queue,
+                  memory_arena *Arena,
+                  u32           PathCount)
+{
+    *Queue = {};
+    u32 Capacity = ((PathCount + LANE_WIDTH - 1) / LANE_WIDTH) * LANE_WIDTH;
+
+    // note(harlequin): one block for every stream, each stream starts on its own cache line
+    u32 StreamStride = ((Capacity * sizeof(f32) + 63) / 64) * 64;
+    u8 *Memory = (u8 *)PushSize(Arena, (u64)StreamStride * PATH_QUEUE_STREAM_COUNT, 64);
+    if (!Memory)
+    {
+        return false;
+    }
+
+    u8 *Stream = Memory;
+#define NextStream(Type) (Type *)Stream; Stream += StreamStride
+    Queue->PixelIndices        = NextStream(u32);
+    Queue->OriginX             = NextStream(f32);
+    Queue->OriginY             = NextStream(f32);
+    Queue->OriginZ             = NextStream(f32);
+    Queue->DirectionX          = NextStream(f32);
+    Queue->DirectionY          = NextStream(f32);
+    Queue->DirectionZ          = NextStream(f32);
+    Queue->Throughput          = NextStream(f32);
+    Queue->HitT                = NextStream(f32);
+    Queue->HitPrimitiveIndices = NextStream(u32);
+    Queue->NormalX             = NextStream(f32);
+    Queue->NormalY             = NextStream(f32);
+    Queue->NormalZ             = NextStream(f32);
+    Queue->AlbedoR             = NextStream(f32);
+    Queue->AlbedoG             = NextStream(f32);
+    Queue->AlbedoB             = NextStream(f32);
+    Queue->Roughness           = NextStream(f32);
+    Queue->RandomX             = NextStream(f32);
+    Queue->RandomY             = NextStream(f32);
+    Queue->RandomZ             = NextStream(f32);
+    Queue->EmittedR            = NextStream(f32);
+    Queue->EmittedG            = NextStream(f32);
+    Queue->EmittedB            = NextStream(f32);
+    Queue->Alive               = NextStream(u32);
+    Queue->RadianceR           = NextStream(f32);
+    Queue->RadianceG           = NextStream(f32);
+    Queue->RadianceB           = NextStream(f32);
+#undef NextStream
+    Assert(Stream == Memory + StreamStride * PATH_QUEUE_STREAM_COUNT);
+
+    // note(harlequin): the lane loops read past Count up to the next multiple of LANE_WIDTH, keep that garbage finite
+    memset(Memory, 0, StreamStride * PATH_QUEUE_STREAM_COUNT);
+
+    Queue->Capacity = Capacity;
+    Queue->Count    = 0;
+    return true;
+}
+
+function void
+GeneratePaths(trace_rays_job *Job, path_queue *Queue)
+{
+    const tile &Tile = Job->Tile;
+    u32 Width = Job->FrameBuffer->Width;
+    u32 FirstRow = Job->Settings.FirstRow;
+
+    u32 PathIndex = 0;
+    for (u32 Y = Tile.MinY; Y < Tile.MaxY; Y++)
+    {
+        for (u32 X = Tile.MinX; X < Tile.MaxX; X++)
+        {
+            u32 PixelIndex = GetPixelIndex(X, Y, Width);
+            random_series CameraSeries = RandomSeries(Job->Settings.Seed, GetPixelIndex(X, FirstRow + Y, Width),
+                                                      GetPixelSampleIndex(Job->SampleBuffer, PixelIndex), CAMERA_RANDOM_BOUNCE);
+            ray Ray = GenerateCameraRay(Job->Camera, X, FirstRow + Y, &CameraSeries);
+            Queue->PixelIndices[PathIndex] = PathIndex;
+            Queue->OriginX[PathIndex]      = VectorComponent(Ray.Origin, 0);
+            Queue->OriginY[PathIndex]      = VectorComponent(Ray.Origin, 1);
+            Queue->OriginZ[PathIndex]      = VectorComponent(Ray.Origin, 2);
+            Queue->DirectionX[PathIndex]   = VectorComponent(Ray.Direction, 0);
+            Queue->DirectionY[PathIndex]   = VectorComponent(Ray.Direction, 1);
+            Queue->DirectionZ[PathIndex]   = VectorComponent(Ray.Direction, 2);
+            Queue->Throughput[PathIndex]   = 1.0f;
+            Queue->RadianceR[PathIndex]    = 0.0f;
+            Queue->RadianceG[PathIndex]    = 0.0f;
+            Queue->RadianceB[PathIndex]    = 0.0f;
+            PathIndex++;
+        }
+    }
+    Queue->Count = PathIndex;
+}
+
+function void
+IntersectPaths(trace_rays_job *Job, path_queue *Queue)
+{
+    const world *World = Job->World;
+
+    for (u32 PathIndex = 0; PathIndex < Queue->Count; PathIndex++)
+    {
+        ray Ray = RayOriginDirection(V3(Queue->OriginX[PathIndex],
+                                        Queue->OriginY[PathIndex],
+                                        Queue->OriginZ[PathIndex]),
+                                     V3(Queue->DirectionX[PathIndex],
+                                        Queue->DirectionY[PathIndex],
+                                        Queue->DirectionZ[PathIndex]));
+
+        f32 T              = MAX_F32;
+        u32 PrimitiveIndex = 0;
+        if (!RayCastWorld(World, Ray, &T, &PrimitiveIndex, Job->Stats))
+        {
+            T = MAX_F32;
+        }
+        Queue->HitT[PathIndex]                = T;
+        Queue->HitPrimitiveIndices[PathIndex] = PrimitiveIndex;
+    }
+
+    Job->Stats->RayCount += Queue->Count;
+}
+
+// note(harlequin): the gathers, the surface normals and the random numbers are the only per path scalar work
+// of the shade stage, the normal depends on the primitive kind so it is resolved here
+function void
+GatherShadeInputs(trace_rays_job *Job, path_queue *Queue, u32 BounceIndex)
+{
+    const world *World = Job->World;
+    const tile &Tile = Job->Tile;
+    u32 TileWidth = Tile.MaxX - Tile.MinX;
+    u32 Width     = Job->FrameBuffer->Width;
+
+    for (u32 PathIndex = 0; PathIndex < Queue->Count; PathIndex++)
+    {
+        if (Queue->HitT[PathIndex] == MAX_F32)
+        {
+            continue;
+        }
+
+        u32 PrimitiveIndex = Queue->HitPrimitiveIndices[PathIndex];
+        ray Ray = RayOriginDirection(V3(Queue->OriginX[PathIndex],
+                                        Queue->OriginY[PathIndex],
+                                        Queue->OriginZ[PathIndex]),
+                                     V3(Queue->DirectionX[PathIndex],
+                                        Queue->DirectionY[PathIndex],
+                                        Queue->DirectionZ[PathIndex]));
+        intersection_info IntersectionInfo = GetPrimitiveIntersectionInfo(World, Ray, PrimitiveIndex, Queue->HitT[PathIndex]);
+
+        const material &Material = World->Materials[GetPrimitiveMaterialIndex(World, PrimitiveIndex)];
+        const v3 &Albedo = Material.Albedo;
+        // note(harlequin): keyed like the recursive integrator, so both draw the same numbers for a pixel
+        u32 LocalPixelIndex = Queue->PixelIndices[PathIndex];
+        u32 X = Tile.MinX + LocalPixelIndex % TileWidth;
+        u32 Y = Tile.MinY + LocalPixelIndex / TileWidth;
+        u32 PixelIndex = GetPixelIndex(X, Y, Width);
+        random_series Series = RandomSeries(Job->Settings.Seed, GetPixelIndex(X, Job->Settings.FirstRow + Y, Width),
+                                            GetPixelSampleIndex(Job->SampleBuffer, PixelIndex), BounceIndex);
+        v3 Random = RandomV3(&Series, -0.5f, 0.5f);
+
+        Queue->NormalX[PathIndex]   = VectorComponent(IntersectionInfo.Normal, 0);
+        Queue->NormalY[PathIndex]   = VectorComponent(IntersectionInfo.Normal, 1);
+        Queue->NormalZ[PathIndex]   = VectorComponent(IntersectionInfo.Normal, 2);
+        Queue->AlbedoR[PathIndex]   = VectorComponent(Albedo, 0);
+        Queue->AlbedoG[PathIndex]   = VectorComponent(Albedo, 1);
+        Queue->AlbedoB[PathIndex]   = VectorComponent(Albedo, 2);
+        Queue->Roughness[PathIndex] = Material.Roughness;
+        Queue->RandomX[PathIndex]   = VectorComponent(Random, 0);
+        Queue->RandomY[PathIndex]   = VectorComponent(Random, 1);
+        Queue->RandomZ[PathIndex]   = VectorComponent(Random, 2);
+    }
+}
+
+inline lane_f32
+LaneLengthOrOne(lane_f32 X, lane_f32 Y, lane_f32 Z)
+{
+    lane_f32 LengthSquared = X * X + Y * Y + Z * Z;
+    return Select(LengthSquared > LaneF32(0.0f), SquareRoot(LengthSquared), LaneF32(1.0f));
+}
+
+// note(harlequin): same math as ShadeRayHit and GetSkyColor, LANE_WIDTH paths at a time
+function void
+ShadePaths(path_queue *Queue, const v3 &SkyBottom, const v3 &SkyTop)
+{
+    lane_f32 Zero    = LaneF32(0.0f);
+    lane_f32 One     = LaneF32(1.0f);
+    lane_f32 Half    = LaneF32(0.5f);
+    lane_f32 Epsilon = LaneF32(0.00001f);
+    lane_f32 Miss    = LaneF32(MAX_F32);
+    lane_f32 Bounce  = LaneF32(0.2f);
+
+    lane_f32 SkyBottomR = LaneF32(VectorComponent(SkyBottom, 0));
+    lane_f32 SkyBottomG = LaneF32(VectorComponent(SkyBottom, 1));
+    lane_f32 SkyBottomB = LaneF32(VectorComponent(SkyBottom, 2));
+    lane_f32 SkyTopR    = LaneF32(VectorComponent(SkyTop, 0));
+    lane_f32 SkyTopG    = LaneF32(VectorComponent(SkyTop, 1));
+    lane_f32 SkyTopB    = LaneF32(VectorComponent(SkyTop, 2));
+
+    for (u32 PathIndex = 0; PathIndex < Queue->Count; PathIndex += LANE_WIDTH)
+    {
+        lane_f32 OriginX    = LoadLaneF32(Queue->OriginX + PathIndex);
+        lane_f32 OriginY    = LoadLaneF32(Queue->OriginY + PathIndex);
+        lane_f32 OriginZ    = LoadLaneF32(Queue->OriginZ + PathIndex);
+        lane_f32 DirectionX = LoadLaneF32(Queue->DirectionX + PathIndex);
+        lane_f32 DirectionY = LoadLaneF32(Queue->DirectionY + PathIndex);
+        lane_f32 DirectionZ = LoadLaneF32(Queue->DirectionZ + PathIndex);
+        lane_f32 Throughput = LoadLaneF32(Queue->Throughput + PathIndex);
+        lane_f32 T          = LoadLaneF32(Queue->HitT + PathIndex);
+        lane_f32 Hit        = T < Miss;
+        T = Select(Hit, T, Zero);
+
+        lane_f32 PointX = OriginX + DirectionX * T;
+        lane_f32 PointY = OriginY + DirectionY * T;
+        lane_f32 PointZ = OriginZ + DirectionZ * T;
+
+        // note(harlequin): the gathered normals are unit length and already face the ray
+        lane_f32 NormalX = LoadLaneF32(Queue->NormalX + PathIndex);
+        lane_f32 NormalY = LoadLaneF32(Queue->NormalY + PathIndex);
+        lane_f32 NormalZ = LoadLaneF32(Queue->NormalZ + PathIndex);
+
+        lane_f32 Roughness = LoadLaneF32(Queue->Roughness + PathIndex);
+        lane_f32 NewNormalX = NormalX + Roughness * LoadLaneF32(Queue->RandomX + PathIndex);
+        lane_f32 NewNormalY = NormalY + Roughness * LoadLaneF32(Queue->RandomY + PathIndex);
+        lane_f32 NewNormalZ = NormalZ + Roughness * LoadLaneF32(Queue->RandomZ + PathIndex);
+        lane_f32 OneOverNewNormalLength = One / LaneLengthOrOne(NewNormalX, NewNormalY, NewNormalZ);
+        NewNormalX = NewNormalX * OneOverNewNormalLength;
+        NewNormalY = NewNormalY * OneOverNewNormalLength;
+        NewNormalZ = NewNormalZ * OneOverNewNormalLength;
+
+        lane_f32 TwoDot = LaneF32(2.0f) * (DirectionX * NewNormalX + DirectionY * NewNormalY + DirectionZ * NewNormalZ);
+        lane_f32 ReflectedX = DirectionX - TwoDot * NewNormalX;
+        lane_f32 ReflectedY = DirectionY - TwoDot * NewNormalY;
+        lane_f32 ReflectedZ = DirectionZ - TwoDot * NewNormalZ;
+
+        lane_f32 Reflects = (ReflectedX * NormalX + ReflectedY * NormalY + ReflectedZ * NormalZ) > Zero;
+        lane_f32 Alive    = Hit & Reflects;
+
+        lane_f32 SkyT = Half * (DirectionY + One);
+        lane_f32 SkyR = (One - SkyT) * SkyBottomR + SkyT * SkyTopR;
+        lane_f32 SkyG = (One - SkyT) * SkyBottomG + SkyT * SkyTopG;
+        lane_f32 SkyB = (One - SkyT) * SkyBottomB + SkyT * SkyTopB;
+
+        lane_f32 EmittedR = Select(Hit, Select(Reflects, LoadLaneF32(Queue->AlbedoR + PathIndex), Zero), SkyR) * Throughput;
+        lane_f32 EmittedG = Select(Hit, Select(Reflects, LoadLaneF32(Queue->AlbedoG + PathIndex), Zero), SkyG) * Throughput;
+        lane_f32 EmittedB = Select(Hit, Select(Reflects, LoadLaneF32(Queue->AlbedoB + PathIndex), Zero), SkyB) * Throughput;
+
+        StoreLaneF32(Queue->OriginX + PathIndex, PointX + NormalX * Epsilon);
+        StoreLaneF32(Queue->OriginY + PathIndex, PointY + NormalY * Epsilon);
+        StoreLaneF32(Queue->OriginZ + PathIndex, PointZ + NormalZ * Epsilon);
+        StoreLaneF32(Queue->DirectionX + PathIndex, ReflectedX);
+        StoreLaneF32(Queue->DirectionY + PathIndex, ReflectedY);
+        StoreLaneF32(Queue->DirectionZ + PathIndex, ReflectedZ);
+        StoreLaneF32(Queue->Throughput + PathIndex, Throughput * Bounce);
+        StoreLaneF32(Queue->EmittedR + PathIndex, EmittedR);
+        StoreLaneF32(Queue->EmittedG + PathIndex, EmittedG);
+        StoreLaneF32(Queue->EmittedB + PathIndex, EmittedB);
+        StoreLaneF32((f32 *)(Queue->Alive + PathIndex), Alive);
+    }
+}
+
+// note(harlequin): runs after the first gather, while the paths are still in pixel order
+function void
+RecordFirstHits(path_queue *Queue, first_hit *FirstHits)
+{
+    for (u32 PathIndex = 0; PathIndex < Queue->Count; PathIndex++)
+    {
+        Assert(Queue->PixelIndices[PathIndex] == PathIndex);
+        first_hit *FirstHit = FirstHits + PathIndex;
+        f32 T = Queue->HitT[PathIndex];
+        if (T == MAX_F32)
+        {
+            ray Ray = RayOriginDirection(V3(Queue->OriginX[PathIndex], Queue->OriginY[PathIndex], Queue->OriginZ[PathIndex]),
+                                         V3(Queue->DirectionX[PathIndex], Queue->DirectionY[PathIndex], Queue->DirectionZ[PathIndex]));
+            *FirstHit = GetSkyFirstHit(Ray);
+        }
+        else
+        {
+            FirstHit->Albedo = V3(Queue->AlbedoR[PathIndex], Queue->AlbedoG[PathIndex], Queue->AlbedoB[PathIndex]);
+            FirstHit->Normal = V3(Queue->NormalX[PathIndex], Queue->NormalY[PathIndex], Queue->NormalZ[PathIndex]);
+            FirstHit->Depth  = T;
+        }
+    }
+}
+
+// note(harlequin): scatters the emitted radiance to the pixels and packs the surviving paths to the front, keeping their order
+function void
+CompactPaths(path_queue *Queue)
+{
+    u32 AliveCount = 0;
+    for (u32 PathIndex = 0; PathIndex < Queue->Count; PathIndex++)
+    {
+        u32 PixelIndex = Queue->PixelIndices[PathIndex];
+        Queue->RadianceR[PixelIndex] += Queue->EmittedR[PathIndex];
+        Queue->RadianceG[PixelIndex] += Queue->EmittedG[PathIndex];
+        Queue->RadianceB[PixelIndex] += Queue->EmittedB[PathIndex];
+
+        if (!Queue->Alive[PathIndex])
+        {
+            continue;
+        }
+
+        if (AliveCount != PathIndex)
+        {
+            Queue->PixelIndices[AliveCount] = PixelIndex;
+            Queue->OriginX[AliveCount]      = Queue->OriginX[PathIndex];
+            Queue->OriginY[AliveCount]      = Queue->OriginY[PathIndex];
+            Queue->OriginZ[AliveCount]      = Queue->OriginZ[PathIndex];
+            Queue->DirectionX[AliveCount]   = Queue->DirectionX[PathIndex];
+            Queue->DirectionY[AliveCount]   = Queue->DirectionY[PathIndex];
+            Queue->DirectionZ[AliveCount]   = Queue->DirectionZ[PathIndex];
+            Queue->Throughput[AliveCount]   = Queue->Throughput[PathIndex];
+        }
+        AliveCount++;
+    }
+    Queue->Count = AliveCount;
+}
+
+void
+TraceRaysWavefront(trace_rays_job *Job)
+{
+    const tile &Tile = Job->Tile;
+    u32 TileWidth = Tile.MaxX - Tile.MinX;
+    u32 PathCount = TileWidth * (Tile.MaxY - Tile.MinY);
+
+    // note(harlequin): the queue lives for one tile on the thread's scratch arena
+    temporary_memory TemporaryMemory = BeginTemporaryMemory(Job->ScratchArena);
+    path_queue QueueStorage;
+    path_queue *Queue = &QueueStorage;
+    if (!AllocatePathQueue(Queue, Job->ScratchArena, PathCount))
+    {
+        EndTemporaryMemory(TemporaryMemory);
+        return;
+    }
+
+    first_hit *FirstHits = nullptr;
+    if (Job->FeatureBuffer)
+    {
+        FirstHits = PushArray(Job->ScratchArena, first_hit, PathCount);
+        if (!FirstHits)
+        {
+            EndTemporaryMemory(TemporaryMemory);
+            return;
+        }
+    }
+
+    v3 SkyBottom = SKY_BOTTOM_COLOR;
+    v3 SkyTop    = SKY_TOP_COLOR;
+
+    GeneratePaths(Job, Queue);
+
+    for (u32 BounceIndex = 0;
+         BounceIndex < Job->Settings.RayBounceCount && Queue->Count;
+         BounceIndex++)
+    {
+        IntersectPaths(Job, Queue);
+        GatherShadeInputs(Job, Queue, BounceIndex);
+        if (FirstHits && BounceIndex == 0)
+        {
+            RecordFirstHits(Queue, FirstHits);
+        }
+        ShadePaths(Queue, SkyBottom, SkyTop);
+        CompactPaths(Queue);
+    }
+
+    u32 Width = Job->FrameBuffer->Width;
+    for (u32 PathIndex = 0; PathIndex < PathCount; PathIndex++)
+    {
+        u32 X = Tile.MinX + PathIndex % TileWidth;
+        u32 Y = Tile.MinY + PathIndex / TileWidth;
+        AccumulatePixel(Job,
+                        GetPixelIndex(X, Y, Width),
+                        V3(Queue->RadianceR[PathIndex], Queue->RadianceG[PathIndex], Queue->RadianceB[PathIndex]),
+                        FirstHits ? FirstHits + PathIndex : nullptr);
+    }
+
+    EndTemporaryMemory(TemporaryMemory);
+}
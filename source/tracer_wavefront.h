@@ -0,0 +1,60 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_memory.h"
+
+struct trace_rays_job;
+
+// note(harlequin): structure of arrays queue of live paths for the wavefront integrator, every stage
+// streams over the whole queue so each loop body stays small and the lane loops read contiguous memory
+struct path_queue
+{
+    u32 Capacity; // multiple of LANE_WIDTH
+    u32 Count;
+
+    u32 *PixelIndices; // tile local
+    f32 *OriginX;
+    f32 *OriginY;
+    f32 *OriginZ;
+    f32 *DirectionX;
+    f32 *DirectionY;
+    f32 *DirectionZ;
+    f32 *Throughput;
+
+    f32 *HitT;
+    u32 *HitPrimitiveIndices;
+
+    // note(harlequin): per path inputs gathered for the shade stage
+    f32 *NormalX;
+    f32 *NormalY;
+    f32 *NormalZ;
+    f32 *AlbedoR;
+    f32 *AlbedoG;
+    f32 *AlbedoB;
+    f32 *Roughness;
+    f32 *RandomX;
+    f32 *RandomY;
+    f32 *RandomZ;
+
+    // note(harlequin): per path outputs of the shade stage
+    f32 *EmittedR;
+    f32 *EmittedG;
+    f32 *EmittedB;
+    u32 *Alive;
+
+    // note(harlequin): tile local radiance, indexed by PixelIndices
+    f32 *RadianceR;
+    f32 *RadianceG;
+    f32 *RadianceB;
+};
+
+// carves every stream out of Arena, the queue is valid until the arena is reset
+function bool
+AllocatePathQueue(path_queue   *Queue,
+                  memory_arena *Arena,
+                  u32           PathCount);
+
+// traces every pixel of Job->Tile one stage at a time: generate, intersect, shade, compact
+function void
+TraceRaysWavefront(trace_rays_job *Job);
@@ -0,0 +1,809 @@
+#include "tracer_world.h"
+#include "tracer_profile.h"
+
+u32
+PushMaterial(world *World,
+             v3     Albedo,
+             f32    Roughness)
+{
+    material *Materials = (material *)GrowArray(&World->Arena,
+                                                World->Materials,
+                                                World->MaterialCount,
+                                                &World->MaterialCapacity,
+                                                (u64)World->MaterialCount + 1);
+    if (!Materials)
+    {
+        fprintf(stderr, "out of memory for materials\n");
+        return WORLD_INVALID_INDEX;
+    }
+    World->Materials = Materials;
+
+    u32 MaterialIndex   = World->MaterialCount++;
+    material *Material  = World->Materials + MaterialIndex;
+    Material->Albedo    = SRGBToLinear(Albedo);
+    Material->Roughness = Roughness;
+    return MaterialIndex;
+}
+
+// note(harlequin): grows every sphere array to the same capacity
+function bool
+ReserveSpheres(world *World, u64 SphereCount)
+{
+    u32 Capacity = World->SphereCapacity;
+    sphere *Spheres = (sphere *)GrowArray(&World->Arena, World->Spheres, World->SphereCount, &Capacity, SphereCount);
+    if (!Spheres)
+    {
+        return false;
+    }
+    World->Spheres = Spheres;
+
+    u32 MaterialCapacity = World->SphereCapacity;
+    u32 *MaterialIndices = (u32 *)GrowArray(&World->Arena, World->SphereMaterialIndices, World->SphereCount, &MaterialCapacity, Capacity);
+    if (!MaterialIndices)
+    {
+        return false;
+    }
+    World->SphereMaterialIndices = MaterialIndices;
+
+    Assert(MaterialCapacity == Capacity);
+    World->SphereCapacity = Capacity;
+    return true;
+}
+
+u32
+PushSphere(world *World,
+           v3     Center,
+           f32    Radius,
+           u32    MaterialIndex /* = 0 */)
+{
+    if (World->SphereCount >= TRIANGLE_PRIMITIVE_BIT - 1 || !ReserveSpheres(World, (u64)World->SphereCount + 1))
+    {
+        fprintf(stderr, "out of memory for spheres\n");
+        return WORLD_INVALID_INDEX;
+    }
+
+    u32 SphereIndex = World->SphereCount++;
+    World->Spheres[SphereIndex]               = SphereCenterRadius(Center, Radius);
+    World->SphereMaterialIndices[SphereIndex] = MaterialIndex;
+    return SphereIndex;
+}
+
+bool
+PushVertices(world     *World,
+             const f32 *Positions,
+             u32        VertexCount,
+             u32       *OutFirstVertex)
+{
+    u64 NewCount = (u64)World->VertexCount + VertexCount;
+    v3 *Vertices = (v3 *)GrowArray(&World->Arena, World->Vertices, World->VertexCount, &World->VertexCapacity, NewCount);
+    if (!Vertices || NewCount >= TRIANGLE_PRIMITIVE_BIT)
+    {
+        return false;
+    }
+    World->Vertices = Vertices;
+
+    u32 FirstVertex = World->VertexCount;
+    for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++)
+    {
+        const f32 *Position = Positions + VertexIndex * 3;
+        World->Vertices[FirstVertex + VertexIndex] = V3(Position[0], Position[1], Position[2]);
+    }
+    World->VertexCount = (u32)NewCount;
+    *OutFirstVertex    = FirstVertex;
+    return true;
+}
+
+// note(harlequin): see ReserveSpheres, the vertex indices grow as one 12 byte element per triangle
+function bool
+ReserveTriangles(world *World, u64 TriangleCount)
+{
+    u32 Capacity = World->TriangleCapacity;
+    u32 *MaterialIndices = (u32 *)GrowArray(&World->Arena, World->TriangleMaterialIndices, World->TriangleCount, &Capacity, TriangleCount);
+    if (!MaterialIndices)
+    {
+        return false;
+    }
+    World->TriangleMaterialIndices = MaterialIndices;
+
+    u32 *VertexIndices = (u32 *)GrowArenaArray(&World->Arena,
+                                               World->TriangleVertexIndices,
+                                               sizeof(u32) * 3,
+                                               alignof(u32),
+                                               World->TriangleCount,
+                                               &World->TriangleCapacity,
+                                               Capacity);
+    if (!VertexIndices)
+    {
+        return false;
+    }
+    World->TriangleVertexIndices = VertexIndices;
+
+    Assert(World->TriangleCapacity == Capacity);
+    return true;
+}
+
+bool
+PushTriangles(world     *World,
+              const u32 *Indices,
+              u32        TriangleCount,
+              u32        FirstVertex,
+              u32        MaterialIndex /* = 0 */)
+{
+    u64 NewCount = (u64)World->TriangleCount + TriangleCount;
+    if (NewCount >= TRIANGLE_PRIMITIVE_BIT || !ReserveTriangles(World, NewCount))
+    {
+        return false;
+    }
+
+    u32 *VertexIndices   = World->TriangleVertexIndices + World->TriangleCount * 3;
+    u32 *MaterialIndices = World->TriangleMaterialIndices + World->TriangleCount;
+    for (u32 TriangleIndex = 0; TriangleIndex < TriangleCount; TriangleIndex++)
+    {
+        for (u32 Corner = 0; Corner < 3; Corner++)
+        {
+            u32 VertexIndex = FirstVertex + Indices[TriangleIndex * 3 + Corner];
+            Assert(VertexIndex < World->VertexCount);
+            VertexIndices[TriangleIndex * 3 + Corner] = VertexIndex;
+        }
+        MaterialIndices[TriangleIndex] = MaterialIndex;
+    }
+    World->TriangleCount = (u32)NewCount;
+    return true;
+}
+
+bool
+ReserveWorld(world *World,
+             u64    MaterialCount,
+             u64    SphereCount,
+             u64    VertexCount,
+             u64    TriangleCount)
+{
+    // note(harlequin): an empty array that gets nothing stays null, GrowArray hands that back as a failure
+    if (MaterialCount)
+    {
+        material *Materials = (material *)GrowArray(&World->Arena,
+                                                    World->Materials,
+                                                    World->MaterialCount,
+                                                    &World->MaterialCapacity,
+                                                    World->MaterialCount + MaterialCount);
+        if (!Materials)
+        {
+            return false;
+        }
+        World->Materials = Materials;
+    }
+
+    if (VertexCount)
+    {
+        v3 *Vertices = (v3 *)GrowArray(&World->Arena,
+                                       World->Vertices,
+                                       World->VertexCount,
+                                       &World->VertexCapacity,
+                                       World->VertexCount + VertexCount);
+        if (!Vertices)
+        {
+            return false;
+        }
+        World->Vertices = Vertices;
+    }
+
+    return (!SphereCount || ReserveSpheres(World, World->SphereCount + SphereCount)) &&
+           (!TriangleCount || ReserveTriangles(World, World->TriangleCount + TriangleCount));
+}
+
+void
+PushDemoScene(world *World)
+{
+    PushMaterial(World, V3(1.0f, 0.0f, 0.0f), 0.0f);
+    PushMaterial(World, V3(0.0f, 1.0f, 0.0f), 0.0f);
+    PushMaterial(World, V3(0.0f, 0.0f, 1.0f), 0.2f);
+
+    PushSphere(World, V3(0.5f, 0.0f, -1.0f), 0.5f, 0);
+    PushSphere(World, V3(-0.5f, 0.0f, -1.0f), 0.5f, 1);
+    PushSphere(World, V3(0.0f, -100.5f, -1.0f), 100.0f, 2);
+}
+
+intersection_info
+GetPrimitiveIntersectionInfo(const world *World,
+                             const ray   &Ray,
+                             u32          PrimitiveIndex,
+                             f32          T)
+{
+    if (IsTrianglePrimitive(PrimitiveIndex))
+    {
+        return GetRayTriangleIntersectionInfo(Ray,
+                                              GetWorldTriangle(World, PrimitiveIndex & ~TRIANGLE_PRIMITIVE_BIT),
+                                              T);
+    }
+    return GetRaySphereIntersectionInfo(Ray, World->Spheres[PrimitiveIndex], T);
+}
+
+// note(harlequin): the bvh leaves index a contiguous run of primitives, so every per primitive array is
+// permuted into leaf order with the arena as scratch
+function bool
+PermuteIntoLeafOrder(memory_arena *Arena,
+                     void         *Array,
+                     u64           ElementSize,
+                     u32          *PrimitiveIndices,
+                     u32           PrimitiveCount)
+{
+    if (!PrimitiveCount)
+    {
+        return true;
+    }
+
+    temporary_memory TemporaryMemory = BeginTemporaryMemory(Arena);
+    u8 *Sorted = (u8 *)PushSize(Arena, ElementSize * PrimitiveCount);
+    if (Sorted)
+    {
+        for (u32 Index = 0; Index < PrimitiveCount; Index++)
+        {
+            memcpy(Sorted + Index * ElementSize, (u8 *)Array + PrimitiveIndices[Index] * ElementSize, ElementSize);
+        }
+        memcpy(Array, Sorted, ElementSize * PrimitiveCount);
+    }
+    EndTemporaryMemory(TemporaryMemory);
+    return Sorted != nullptr;
+}
+
+bool
+BuildWorldBvh(world *World)
+{
+    // note(harlequin): the bvhs of a scene file point into the mapping and cannot be freed
+    if (World->SceneFile.Data)
+    {
+        fprintf(stderr, "scene files come with their bvhs, they cannot be rebuilt\n");
+        return false;
+    }
+
+    memory_arena *Arena = &World->Arena;
+
+    u32 SphereCount = World->SphereCount;
+    temporary_memory TemporaryMemory = BeginTemporaryMemory(Arena);
+    aabb *SphereBounds = PushArray(Arena, aabb, SphereCount);
+    bool Success = SphereBounds != nullptr;
+    if (Success)
+    {
+        for (u32 SphereIndex = 0; SphereIndex < SphereCount; SphereIndex++)
+        {
+            SphereBounds[SphereIndex] = GetSphereBounds(World->Spheres[SphereIndex]);
+        }
+        Success = BuildBvh(&World->SphereBvh, SphereBounds, SphereCount);
+    }
+    EndTemporaryMemory(TemporaryMemory);
+
+    u32 *SphereOrder = World->SphereBvh.PrimitiveIndices;
+    if (!Success ||
+        !PermuteIntoLeafOrder(Arena, World->Spheres, sizeof(sphere), SphereOrder, SphereCount) ||
+        !PermuteIntoLeafOrder(Arena, World->SphereMaterialIndices, sizeof(u32), SphereOrder, SphereCount))
+    {
+        return false;
+    }
+    for (u32 Index = 0; Index < SphereCount; Index++)
+    {
+        SphereOrder[Index] = Index;
+    }
+
+    u32 TriangleCount = World->TriangleCount;
+    TemporaryMemory = BeginTemporaryMemory(Arena);
+    aabb *TriangleBounds = PushArray(Arena, aabb, TriangleCount);
+    Success = TriangleBounds != nullptr;
+    if (Success)
+    {
+        for (u32 TriangleIndex = 0; TriangleIndex < TriangleCount; TriangleIndex++)
+        {
+            TriangleBounds[TriangleIndex] = GetTriangleBounds(GetWorldTriangle(World, TriangleIndex));
+        }
+        Success = BuildBvh(&World->TriangleBvh, TriangleBounds, TriangleCount);
+    }
+    EndTemporaryMemory(TemporaryMemory);
+
+    u32 *TriangleOrder = World->TriangleBvh.PrimitiveIndices;
+    if (!Success ||
+        !PermuteIntoLeafOrder(Arena, World->TriangleVertexIndices, sizeof(u32) * 3, TriangleOrder, TriangleCount) ||
+        !PermuteIntoLeafOrder(Arena, World->TriangleMaterialIndices, sizeof(u32), TriangleOrder, TriangleCount))
+    {
+        return false;
+    }
+    for (u32 Index = 0; Index < TriangleCount; Index++)
+    {
+        TriangleOrder[Index] = Index;
+    }
+
+    return BuildWorldSphereSoa(World) && BuildWorldTriangleSoa(World);
+}
+
+void
+FreeWorld(world *World)
+{
+    if (World->SceneFile.Data)
+    {
+        UnmapFile(&World->SceneFile);
+    }
+    else
+    {
+        FreeBvh(&World->SphereBvh);
+        FreeBvh(&World->TriangleBvh);
+        _aligned_free(World->SphereSoa.CenterX);
+        _aligned_free(World->TriangleSoa.Vertex0X);
+    }
+    FreeArena(&World->Arena);
+    *World = {};
+}
+
+bool
+BuildWorldSphereSoa(world *World)
+{
+    sphere_soa *Spheres = &World->SphereSoa;
+    _aligned_free(Spheres->CenterX);
+    *Spheres = {};
+
+    u32 Count       = World->SphereCount;
+    u32 PaddedCount = GetLanePaddedCount(Count);
+    if (!PaddedCount)
+    {
+        return true;
+    }
+
+    // note(harlequin): one allocation for the four arrays, each one starts on its own cache line
+    u32 ArrayStride = GetSoaArrayStride(PaddedCount);
+    f32 *Memory = (f32 *)_aligned_malloc(sizeof(f32) * ArrayStride * 4, 64);
+    if (!Memory)
+    {
+        return false;
+    }
+    memset(Memory, 0, sizeof(f32) * ArrayStride * 4);
+
+    Spheres->Count         = Count;
+    Spheres->PaddedCount   = PaddedCount;
+    Spheres->CenterX       = Memory;
+    Spheres->CenterY       = Memory + ArrayStride;
+    Spheres->CenterZ       = Memory + ArrayStride * 2;
+    Spheres->RadiusSquared = Memory + ArrayStride * 3;
+
+    for (u32 SphereIndex = 0; SphereIndex < Count; SphereIndex++)
+    {
+        const sphere *Sphere = World->Spheres + SphereIndex;
+        Spheres->CenterX[SphereIndex]       = VectorComponent(Sphere->Center, 0);
+        Spheres->CenterY[SphereIndex]       = VectorComponent(Sphere->Center, 1);
+        Spheres->CenterZ[SphereIndex]       = VectorComponent(Sphere->Center, 2);
+        Spheres->RadiusSquared[SphereIndex] = Sphere->Radius * Sphere->Radius;
+    }
+
+    return true;
+}
+
+bool
+BuildWorldTriangleSoa(world *World)
+{
+    triangle_soa *Triangles = &World->TriangleSoa;
+    _aligned_free(Triangles->Vertex0X);
+    *Triangles = {};
+
+    u32 Count       = World->TriangleCount;
+    u32 PaddedCount = GetLanePaddedCount(Count);
+    if (!PaddedCount)
+    {
+        return true;
+    }
+
+    // note(harlequin): same layout as the sphere store, the padding lanes are zero area triangles that never hit
+    u32 ArrayStride = GetSoaArrayStride(PaddedCount);
+    f32 *Memory = (f32 *)_aligned_malloc(sizeof(f32) * ArrayStride * 9, 64);
+    if (!Memory)
+    {
+        return false;
+    }
+    memset(Memory, 0, sizeof(f32) * ArrayStride * 9);
+
+    Triangles->Count       = Count;
+    Triangles->PaddedCount = PaddedCount;
+    Triangles->Vertex0X    = Memory;
+    Triangles->Vertex0Y    = Memory + ArrayStride;
+    Triangles->Vertex0Z    = Memory + ArrayStride * 2;
+    Triangles->Edge1X      = Memory + ArrayStride * 3;
+    Triangles->Edge1Y      = Memory + ArrayStride * 4;
+    Triangles->Edge1Z      = Memory + ArrayStride * 5;
+    Triangles->Edge2X      = Memory + ArrayStride * 6;
+    Triangles->Edge2Y      = Memory + ArrayStride * 7;
+    Triangles->Edge2Z      = Memory + ArrayStride * 8;
+
+    for (u32 TriangleIndex = 0; TriangleIndex < Count; TriangleIndex++)
+    {
+        triangle Triangle = GetWorldTriangle(World, TriangleIndex);
+        Triangles->Vertex0X[TriangleIndex] = VectorComponent(Triangle.Vertex0, 0);
+        Triangles->Vertex0Y[TriangleIndex] = VectorComponent(Triangle.Vertex0, 1);
+        Triangles->Vertex0Z[TriangleIndex] = VectorComponent(Triangle.Vertex0, 2);
+        Triangles->Edge1X[TriangleIndex]   = VectorComponent(Triangle.Edge1, 0);
+        Triangles->Edge1Y[TriangleIndex]   = VectorComponent(Triangle.Edge1, 1);
+        Triangles->Edge1Z[TriangleIndex]   = VectorComponent(Triangle.Edge1, 2);
+        Triangles->Edge2X[TriangleIndex]   = VectorComponent(Triangle.Edge2, 0);
+        Triangles->Edge2Y[TriangleIndex]   = VectorComponent(Triangle.Edge2, 1);
+        Triangles->Edge2Z[TriangleIndex]   = VectorComponent(Triangle.Edge2, 2);
+    }
+
+    return true;
+}
+
+// note(harlequin): walks one of the two bvhs, ClosestT is shared so the second walk is culled by the first
+function void
+RayCastBvh(const world     *World,
+           const bvh       *Bvh,
+           bool             Triangles,
+           const bvh_ray   &TraversalRay,
+           const ray_lanes &PrimitiveRay,
+           f32             *ClosestT,
+           i64             *ClosestPrimitiveIndex,
+           trace_stats     *Stats)
+{
+    if (!Bvh->NodeCount)
+    {
+        return;
+    }
+
+    u32 Stack[BVH_MAX_DEPTH];
+    u32 StackCount = 0;
+
+    u64 NodeTestCount      = 1;
+    u64 PrimitiveTestCount = 0;
+
+    if (RayCastBvhNode(TraversalRay, Bvh->Nodes, *ClosestT) != MAX_F32)
+    {
+        Stack[StackCount++] = 0;
+    }
+
+    while (StackCount)
+    {
+        const bvh_node *Node = Bvh->Nodes + Stack[--StackCount];
+
+        if (Node->PrimitiveCount)
+        {
+            PrimitiveTestCount += Node->PrimitiveCount;
+
+            u32 HitIndex = 0;
+            if (Triangles)
+            {
+                if (RayCastTriangleLanes(PrimitiveRay,
+                                         &World->TriangleSoa,
+                                         Node->Offset,
+                                         Node->PrimitiveCount,
+                                         ClosestT,
+                                         &HitIndex))
+                {
+                    *ClosestPrimitiveIndex = (i64)(HitIndex | TRIANGLE_PRIMITIVE_BIT);
+                }
+            }
+            else if (RayCastSphereLanes(PrimitiveRay,
+                                        &World->SphereSoa,
+                                        Node->Offset,
+                                        Node->PrimitiveCount,
+                                        ClosestT,
+                                        &HitIndex))
+            {
+                *ClosestPrimitiveIndex = (i64)HitIndex;
+            }
+            continue;
+        }
+
+        u32 NearIndex = (u32)(Node - Bvh->Nodes) + 1;
+        u32 FarIndex  = Node->Offset;
+        f32 NearT = RayCastBvhNode(TraversalRay, Bvh->Nodes + NearIndex, *ClosestT);
+        f32 FarT  = RayCastBvhNode(TraversalRay, Bvh->Nodes + FarIndex, *ClosestT);
+        NodeTestCount += 2;
+
+        if (FarT < NearT)
+        {
+            u32 TempIndex = NearIndex;
+            NearIndex = FarIndex;
+            FarIndex  = TempIndex;
+            f32 TempT = NearT;
+            NearT = FarT;
+            FarT  = TempT;
+        }
+
+        // note(harlequin): push the far child first so the near one is popped next
+        if (FarT != MAX_F32)
+        {
+            Assert(StackCount < BVH_MAX_DEPTH);
+            Stack[StackCount++] = FarIndex;
+        }
+        if (NearT != MAX_F32)
+        {
+            Assert(StackCount < BVH_MAX_DEPTH);
+            Stack[StackCount++] = NearIndex;
+        }
+    }
+
+    Stats->NodeTestCount      += NodeTestCount;
+    Stats->PrimitiveTestCount += PrimitiveTestCount;
+    PROFILE_COUNT(Triangles ? ProfileCounter_TriangleTests : ProfileCounter_SphereTests, PrimitiveTestCount);
+}
+
+bool
+RayCastWorld(const world *World,
+             const ray   &Ray,
+             f32         *OutT,
+             u32         *OutPrimitiveIndex,
+             trace_stats *Stats)
+{
+    bvh_ray   TraversalRay = BvhRayFromRay(Ray);
+    ray_lanes PrimitiveRay = RayLanes(Ray);
+
+    f32 ClosestT              = MAX_F32;
+    i64 ClosestPrimitiveIndex = -1;
+
+    RayCastBvh(World, &World->SphereBvh, false, TraversalRay, PrimitiveRay, &ClosestT, &ClosestPrimitiveIndex, Stats);
+    RayCastBvh(World, &World->TriangleBvh, true, TraversalRay, PrimitiveRay, &ClosestT, &ClosestPrimitiveIndex, Stats);
+
+    if (ClosestPrimitiveIndex == -1)
+    {
+        return false;
+    }
+
+    *OutT              = ClosestT;
+    *OutPrimitiveIndex = (u32)ClosestPrimitiveIndex;
+    return true;
+}
+
+inline v3 GetSkyColor(const ray &Ray)
+{
+    f32 T = 0.5f * (VectorComponent(Ray.Direction, 1) + 1.0f);
+    return (1.0f - T) * SKY_BOTTOM_COLOR + T * SKY_TOP_COLOR;
+}
+
+first_hit
+GetSkyFirstHit(const ray &Ray)
+{
+    first_hit Result;
+    Result.Albedo = GetSkyColor(Ray);
+    Result.Normal = -Ray.Direction;
+    Result.Depth  = FIRST_HIT_SKY_DEPTH;
+    return Result;
+}
+
+function v3
+ShadeRayHit(const ray     &Ray,
+            const world   *World,
+            u32            PrimitiveIndex,
+            f32            T,
+            i32            Depth,
+            random_series *RandomSeries,
+            trace_stats   *Stats,
+            first_hit     *OutFirstHit)
+{
+    intersection_info IntersectionInfo = GetPrimitiveIntersectionInfo(World, Ray, PrimitiveIndex, T);
+
+    const v3       &Point    = IntersectionInfo.Point + IntersectionInfo.Normal * 0.00001f;
+    const v3       &Normal   = IntersectionInfo.Normal;
+    const material &Material = World->Materials[GetPrimitiveMaterialIndex(World, PrimitiveIndex)];
+
+    if (OutFirstHit)
+    {
+        OutFirstHit->Albedo = Material.Albedo;
+        OutFirstHit->Normal = Normal;
+        OutFirstHit->Depth  = T;
+    }
+
+    v3 NewNormal = Normalize(Normal + Material.Roughness * RandomV3(RandomSeries, -0.5f, 0.5f));
+    v3 Reflected = Reflect(Ray.Direction, NewNormal);
+    NextRandomBounce(RandomSeries);
+
+    if (Dot(Reflected, Normal) > 0.0f)
+    {
+        ray NewRay = RayOriginDirection(Point, Reflected);
+        return Material.Albedo + 0.2f * TraceRay(NewRay, World, Depth - 1, RandomSeries, Stats);
+    }
+    else
+    {
+        return V3(0.0f);
+    }
+}
+
+v3
+TraceRay(ray            Ray,
+         const world   *World,
+         i32            Depth,
+         random_series *RandomSeries,
+         trace_stats   *Stats,
+         first_hit     *OutFirstHit /* = nullptr */)
+{
+    if (Depth <= 0)
+    {
+        return V3(0.0f);
+    }
+
+    Stats->RayCount++;
+
+    u32 ClosestPrimitiveIndex = 0;
+    f32 ClosestT              = MAX_F32;
+
+    if (RayCastWorld(World, Ray, &ClosestT, &ClosestPrimitiveIndex, Stats))
+    {
+        return ShadeRayHit(Ray, World, ClosestPrimitiveIndex, ClosestT, Depth, RandomSeries, Stats, OutFirstHit);
+    }
+
+    if (OutFirstHit)
+    {
+        *OutFirstHit = GetSkyFirstHit(Ray);
+    }
+    return GetSkyColor(Ray);
+}
+
+// note(harlequin): packet version of RayCastBvh
+function lane_f32
+RayPacketCastBvh(const world      *World,
+                 const bvh        *Bvh,
+                 bool              Triangles,
+                 const ray_packet &Packet,
+                 lane_f32         *ClosestT,
+                 lane_u32         *ClosestPrimitiveIndex,
+                 trace_stats      *Stats)
+{
+    lane_f32 AnyHit = LaneF32(0.0f) < LaneF32(0.0f);
+    if (!Bvh->NodeCount)
+    {
+        return AnyHit;
+    }
+
+    u32 Stack[BVH_MAX_DEPTH];
+    u32 StackCount = 0;
+
+    u64 NodeTestCount      = 1;
+    u64 PrimitiveTestCount = 0;
+
+    lane_f32 EntryT;
+    if (AnyTrue(RayPacketCastBvhNode(Packet, Bvh->Nodes, *ClosestT, &EntryT)))
+    {
+        Stack[StackCount++] = 0;
+    }
+
+    while (StackCount)
+    {
+        const bvh_node *Node = Bvh->Nodes + Stack[--StackCount];
+
+        if (Node->PrimitiveCount)
+        {
+            u32 FirstPrimitive = Node->Offset;
+            u32 EndPrimitive   = FirstPrimitive + Node->PrimitiveCount;
+            PrimitiveTestCount += Node->PrimitiveCount;
+
+            for (u32 PrimitiveIndex = FirstPrimitive; PrimitiveIndex < EndPrimitive; PrimitiveIndex++)
+            {
+                if (Triangles)
+                {
+                    AnyHit |= RayPacketCastTriangle(Packet,
+                                                    &World->TriangleSoa,
+                                                    PrimitiveIndex,
+                                                    PrimitiveIndex | TRIANGLE_PRIMITIVE_BIT,
+                                                    ClosestT,
+                                                    ClosestPrimitiveIndex);
+                }
+                else
+                {
+                    AnyHit |= RayPacketCastSphere(Packet,
+                                                  &World->SphereSoa,
+                                                  PrimitiveIndex,
+                                                  ClosestT,
+                                                  ClosestPrimitiveIndex);
+                }
+            }
+            continue;
+        }
+
+        u32 NearIndex = (u32)(Node - Bvh->Nodes) + 1;
+        u32 FarIndex  = Node->Offset;
+
+        lane_f32 NearEntryT;
+        lane_f32 FarEntryT;
+        lane_f32 NearHit = RayPacketCastBvhNode(Packet, Bvh->Nodes + NearIndex, *ClosestT, &NearEntryT);
+        lane_f32 FarHit  = RayPacketCastBvhNode(Packet, Bvh->Nodes + FarIndex, *ClosestT, &FarEntryT);
+        NodeTestCount += 2;
+
+        // note(harlequin): the packet descends into a child if any of its rays does, the closest
+        // entry among the hitting lanes decides which child is visited first
+        u32 LaneIndex = 0;
+        f32 NearT = AnyTrue(NearHit) ? HorizontalMinimum(Select(NearHit, NearEntryT, LaneF32(MAX_F32)), &LaneIndex) : MAX_F32;
+        f32 FarT  = AnyTrue(FarHit) ? HorizontalMinimum(Select(FarHit, FarEntryT, LaneF32(MAX_F32)), &LaneIndex) : MAX_F32;
+
+        if (FarT < NearT)
+        {
+            u32 TempIndex = NearIndex;
+            NearIndex = FarIndex;
+            FarIndex  = TempIndex;
+            f32 TempT = NearT;
+            NearT = FarT;
+            FarT  = TempT;
+        }
+
+        if (FarT != MAX_F32)
+        {
+            Assert(StackCount < BVH_MAX_DEPTH);
+            Stack[StackCount++] = FarIndex;
+        }
+        if (NearT != MAX_F32)
+        {
+            Assert(StackCount < BVH_MAX_DEPTH);
+            Stack[StackCount++] = NearIndex;
+        }
+    }
+
+    Stats->NodeTestCount      += NodeTestCount;
+    Stats->PrimitiveTestCount += PrimitiveTestCount;
+    PROFILE_COUNT(Triangles ? ProfileCounter_TriangleTests : ProfileCounter_SphereTests, PrimitiveTestCount);
+    return AnyHit;
+}
+
+lane_f32
+RayCastWorldPacket(const world      *World,
+                   const ray_packet &Packet,
+                   lane_f32         *OutClosestT,
+                   lane_u32         *OutPrimitiveIndex,
+                   trace_stats      *Stats)
+{
+    lane_f32 ClosestT              = LaneF32(MAX_F32);
+    lane_u32 ClosestPrimitiveIndex = LaneU32(0);
+
+    lane_f32 AnyHit = RayPacketCastBvh(World, &World->SphereBvh, false, Packet, &ClosestT, &ClosestPrimitiveIndex, Stats);
+    AnyHit |= RayPacketCastBvh(World, &World->TriangleBvh, true, Packet, &ClosestT, &ClosestPrimitiveIndex, Stats);
+
+    *OutClosestT       = ClosestT;
+    *OutPrimitiveIndex = ClosestPrimitiveIndex;
+    return AnyHit;
+}
+
+void
+TraceRayPacket(const ray     *Rays,
+               const world   *World,
+               i32            Depth,
+               random_series *RandomSeries,
+               trace_stats   *Stats,
+               v3            *OutColors,
+               first_hit     *OutFirstHits /* = nullptr */)
+{
+    if (Depth <= 0)
+    {
+        for (u32 LaneIndex = 0; LaneIndex < LANE_WIDTH; LaneIndex++)
+        {
+            OutColors[LaneIndex] = V3(0.0f);
+        }
+        return;
+    }
+
+    Stats->RayCount += LANE_WIDTH;
+
+    ray_packet Packet = RayPacket(Rays);
+
+    lane_f32 ClosestT;
+    lane_u32 ClosestPrimitiveIndex;
+    u32 HitMask = MaskBits(RayCastWorldPacket(World, Packet, &ClosestT, &ClosestPrimitiveIndex, Stats));
+
+    f32 Ts[LANE_WIDTH];
+    u32 PrimitiveIndices[LANE_WIDTH];
+    StoreLaneF32(Ts, ClosestT);
+    StoreLaneU32(PrimitiveIndices, ClosestPrimitiveIndex);
+
+    // note(harlequin): secondary bounces scatter in every direction, so each lane continues on its own
+    for (u32 LaneIndex = 0; LaneIndex < LANE_WIDTH; LaneIndex++)
+    {
+        const ray &Ray = Rays[LaneIndex];
+        if (HitMask & (1u << LaneIndex))
+        {
+            OutColors[LaneIndex] = ShadeRayHit(Ray,
+                                               World,
+                                               PrimitiveIndices[LaneIndex],
+                                               Ts[LaneIndex],
+                                               Depth,
+                                               RandomSeries + LaneIndex,
+                                               Stats,
+                                               OutFirstHits ? OutFirstHits + LaneIndex : nullptr);
+        }
+        else
+        {
+            OutColors[LaneIndex] = GetSkyColor(Ray);
+            if (OutFirstHits)
+            {
+                OutFirstHits[LaneIndex] = GetSkyFirstHit(Ray);
+            }
+        }
+    }
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "tracer_core.h"
+#include "tracer_math.h"
+#include "tracer_random.h"
+#include "tracer_bvh.h"
+#include "tracer_memory.h"
+#include "tracer_file.h"
+
+struct material
+{
+    v3  Albedo; // linear, PushMaterial decodes the srgb color it is given
+    f32 Roughness;
+};
+
+// note(harlequin): the sky gradient from white at the horizon to srgb (0.5, 0.7, 1.0) straight up, as linear colors
+#define SKY_BOTTOM_COLOR V3(1.0f, 1.0f, 1.0f)
+#define SKY_TOP_COLOR    V3(0.2140411f, 0.4479884f, 1.0f)
+
+// note(harlequin): returned by the push functions when the arena is out of memory
+#define WORLD_INVALID_INDEX 0xFFFFFFFFu
+
+// note(harlequin): primitive indices with this bit set refer to the triangles, the rest to the spheres
+#define TRIANGLE_PRIMITIVE_BIT 0x80000000u
+
+// note(harlequin): every array lives in Arena and grows geometrically, parallel arrays share one count
+// and grow together. a grown array leaves its old copy in the arena, so loaders that know their counts
+// reserve them first. FreeWorld releases the whole scene at once
+struct world
+{
+    memory_arena Arena;
+
+    u32       MaterialCount;
+    u32       MaterialCapacity;
+    material *Materials;
+
+    u32     SphereCount;
+    u32     SphereCapacity;
+    sphere *Spheres;
+    u32    *SphereMaterialIndices;
+
+    u32 VertexCount;
+    u32 VertexCapacity;
+    v3 *Vertices;
+
+    u32  TriangleCount;
+    u32  TriangleCapacity;
+    u32 *TriangleVertexIndices; // three per triangle
+    u32 *TriangleMaterialIndices;
+
+    bvh        SphereBvh;
+    sphere_soa SphereSoa; // mirrors Spheres in leaf order for the simd kernels
+
+    bvh          TriangleBvh;
+    triangle_soa TriangleSoa; // mirrors the triangles in leaf order
+
+    // note(harlequin): set when the world was loaded from a scene file, every array above except the
+    // ones pushed afterwards points into the mapping and the bvhs and soa stores are not owned
+    mapped_file SceneFile;
+};
+
+struct trace_stats
+{
+    u64 RayCount;
+    u64 NodeTestCount;
+    u64 PrimitiveTestCount;
+};
+
+// Albedo is an srgb color, it is stored linear
+function u32
+PushMaterial(world *World,
+             v3     Albedo,
+             f32    Roughness);
+
+function u32
+PushSphere(world *World,
+           v3     Center,
+           f32    Radius,
+           u32    MaterialIndex = 0);
+
+// returns the index of the first vertex, Positions is VertexCount packed xyz triples
+function bool
+PushVertices(world     *World,
+             const f32 *Positions,
+             u32        VertexCount,
+             u32       *OutFirstVertex);
+
+// Indices are relative to FirstVertex
+function bool
+PushTriangles(world     *World,
+              const u32 *Indices,
+              u32        TriangleCount,
+              u32        FirstVertex,
+              u32        MaterialIndex = 0);
+
+// makes room for that many more of each at once, false when out of memory
+function bool
+ReserveWorld(world *World,
+             u64    MaterialCount,
+             u64    SphereCount,
+             u64    VertexCount,
+             u64    TriangleCount);
+
+function void
+PushDemoScene(world *World);
+
+// frees the arena, the bvhs and the soa stores, the world is empty and reusable afterwards
+function void
+FreeWorld(world *World);
+
+inline bool
+IsTrianglePrimitive(u32 PrimitiveIndex)
+{
+    return (PrimitiveIndex & TRIANGLE_PRIMITIVE_BIT) != 0;
+}
+
+inline triangle
+GetWorldTriangle(const world *World, u32 TriangleIndex)
+{
+    const u32 *VertexIndices = World->TriangleVertexIndices + TriangleIndex * 3;
+    return TriangleVertices(World->Vertices[VertexIndices[0]],
+                            World->Vertices[VertexIndices[1]],
+                            World->Vertices[VertexIndices[2]]);
+}
+
+inline u32
+GetPrimitiveMaterialIndex(const world *World, u32 PrimitiveIndex)
+{
+    if (IsTrianglePrimitive(PrimitiveIndex))
+    {
+        return World->TriangleMaterialIndices[PrimitiveIndex & ~TRIANGLE_PRIMITIVE_BIT];
+    }
+    return World->SphereMaterialIndices[PrimitiveIndex];
+}
+
+// the normal faces the ray like GetRaySphereIntersectionInfo
+function intersection_info
+GetPrimitiveIntersectionInfo(const world *World,
+                             const ray   &Ray,
+                             u32          PrimitiveIndex,
+                             f32          T);
+
+// note(harlequin): leaves start at any primitive index, so a full register load from the last primitive
+// has to stay inside the arrays. padding for the widest build keeps scene files valid for every build
+inline u32
+GetLanePaddedCount(u32 Count)
+{
+    return Count ? ((Count + 2 * MAX_LANE_WIDTH - 2) / MAX_LANE_WIDTH) * MAX_LANE_WIDTH : 0;
+}
+
+inline u32
+GetSoaArrayStride(u32 PaddedCount)
+{
+    return ((PaddedCount * sizeof(f32) + 63) / 64) * 64 / sizeof(f32);
+}
+
+// reorders the spheres and the triangles into leaf order and rebuilds both soa stores,
+// call it again whenever primitives are pushed. scene files come with their bvhs already built
+function bool
+BuildWorldBvh(world *World);
+
+function bool
+BuildWorldSphereSoa(world *World);
+
+function bool
+BuildWorldTriangleSoa(world *World);
+
+function bool
+RayCastWorld(const world *World,
+             const ray   &Ray,
+             f32         *OutT,
+             u32         *OutPrimitiveIndex,
+             trace_stats *Stats);
+
+// note(harlequin): what the camera ray of a sample saw first, the features that guide the denoiser.
+// rays that miss see the sky at FIRST_HIT_SKY_DEPTH
+#define FIRST_HIT_SKY_DEPTH 1e6f
+
+struct first_hit
+{
+    v3  Albedo; // linear
+    v3  Normal;
+    f32 Depth;  // distance along the camera ray
+};
+
+function first_hit
+GetSkyFirstHit(const ray &Ray);
+
+// OutFirstHit is optional and only written by the camera ray
+function v3
+TraceRay(ray            Ray,
+         const world   *World,
+         i32            Depth,
+         random_series *RandomSeries,
+         trace_stats   *Stats,
+         first_hit     *OutFirstHit = nullptr);
+
+function lane_f32
+RayCastWorldPacket(const world      *World,
+                   const ray_packet &Packet,
+                   lane_f32         *OutClosestT,
+                   lane_u32         *OutPrimitiveIndex,
+                   trace_stats      *Stats);
+
+// traces LANE_WIDTH rays through the bvh together for their first hit, the bounces continue per ray.
+// RandomSeries holds one series per ray, OutFirstHits is optional and holds one first_hit per ray
+function void
+TraceRayPacket(const ray     *Rays,
+               const world   *World,
+               i32            Depth,
+               random_series *RandomSeries,
+               trace_stats   *Stats,
+               v3            *OutColors,
+               first_hit     *OutFirstHits = nullptr);